@@ -0,0 +1,97 @@
+/**
+ * Microbenchmark for the NUL-separated set union used by the NULAPPENDSET
+ * merge operator, comparing the std::set based implementation to NULSetMerger.
+ *
+ * The scenario is a posting list of an inverted index:
+ * A sorted existing value with many entries and a few small operands.
+ *
+ * Usage: merge_algorithms_benchmark [entries] [operands] [iterations]
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <boost/algorithm/string/join.hpp>
+#include "MergeAlgorithms.hpp"
+
+using namespace std;
+
+static double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @return A NUL-separated list of document IDs i * step + offset for i in [0, count)
+ */
+static string createPostingList(size_t count, size_t step, size_t offset) {
+    string result;
+    char id[32];
+    for (size_t i = 0; i < count; i++) {
+        int len = snprintf(id, sizeof(id), "doc%012zu", i * step + offset);
+        if (i > 0) {
+            result.push_back('\0');
+        }
+        result.append(id, len);
+    }
+    return result;
+}
+
+int main(int argc, char** argv) {
+    size_t numEntries = argc > 1 ? atoll(argv[1]) : 100000;
+    size_t numOperands = argc > 2 ? atoll(argv[2]) : 100;
+    size_t iterations = argc > 3 ? atoll(argv[3]) : 100;
+    string existing = createPostingList(numEntries, 2, 0);
+    vector<string> operands;
+    for (size_t i = 0; i < numOperands; i++) {
+        operands.push_back(createPostingList(10, numEntries / 5, i));
+    }
+    cout << "Merging " << numOperands << " operands into "
+         << numEntries << " entries (" << existing.size() << " bytes)" << endl;
+    //Split only
+    size_t checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        vector<rocksdb::Slice> slices;
+        splitSlicesByNUL(slices, existing.data(), existing.size());
+        checksum += slices.size();
+    }
+    double splitSeconds = secondsSince(start);
+    //std::set + join (previous implementation)
+    static const string nul = string("\0", 1);
+    string setResult;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        set<string> resultSet;
+        splitByNUL(resultSet, existing.data(), existing.size());
+        for (const string& operand : operands) {
+            splitByNUL(resultSet, operand.data(), operand.size());
+        }
+        setResult = boost::algorithm::join(resultSet, nul);
+    }
+    double setSeconds = secondsSince(start);
+    //k-way merge
+    string mergerResult;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        NULSetMerger merger;
+        merger.add(existing.data(), existing.size());
+        for (const string& operand : operands) {
+            merger.add(operand.data(), operand.size());
+        }
+        merger.mergeInto(mergerResult);
+    }
+    double mergerSeconds = secondsSince(start);
+    double megabytes = (double) existing.size() * iterations / 1e6;
+    cout << "Split into slices: " << megabytes / splitSeconds << " MB/s" << endl
+         << "std::set union: " << iterations / setSeconds << " merges/s" << endl
+         << "NULSetMerger union: " << iterations / mergerSeconds << " merges/s" << endl
+         << "Checksum: " << checksum << endl;
+    if (setResult != mergerResult) {
+        cout << "ERROR: Results differ" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,260 @@
+/**
+ * Microbenchmark comparing the single-pass numeric merge operators
+ * to the previous AssociativeMergeOperator implementation,
+ * which merges one operand at a time and builds a new string for each.
+ *
+ * Each scenario merges long operand chains of a single hot key,
+ * as RocksDB does when reading the key (full merge)
+ * or when collapsing the operands during a flush or compaction (partial merge).
+ * The APPEND scenario builds a multi-megabyte value from many appends,
+ * the OR scenario merges sparse 64 KiB bitmaps.
+ *
+ * Usage: merge_operator_benchmark [operands per chain] [number of chains]
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <functional>
+#include <algorithm>
+#include "MergeOperators.hpp"
+
+using namespace std;
+
+/**
+ * The previous implementation: AssociativeMergeOperator::Merge(),
+ * called once per operand by the associative full merge.
+ */
+template<typename T>
+static bool legacyMerge(const rocksdb::Slice* existing_value,
+                        const rocksdb::Slice& value,
+                        std::string* new_value,
+                        const std::function<T (T, T)>& operation) {
+    T existing = 0;
+    if (existing_value != nullptr && existing_value->size() == sizeof(T)) {
+        memcpy(&existing, existing_value->data(), sizeof(T));
+    }
+    T operand = 0;
+    if (value.size() == sizeof(T)) {
+        memcpy(&operand, value.data(), sizeof(T));
+    }
+    T result = operation(existing, operand);
+    *new_value = std::move(std::string((char*)&result, sizeof(T)));
+    return true;
+}
+
+/**
+ * Equivalent to AssociativeMergeOperator::FullMergeV2()
+ */
+template<typename T>
+static void legacyFullMerge(const vector<rocksdb::Slice>& operands,
+                            std::string& new_value,
+                            const std::function<T (T, T)>& operation) {
+    rocksdb::Slice tempExisting;
+    const rocksdb::Slice* existing = nullptr;
+    for (const rocksdb::Slice& operand : operands) {
+        std::string tempValue;
+        legacyMerge<T>(existing, operand, &tempValue, operation);
+        swap(tempValue, new_value);
+        tempExisting = rocksdb::Slice(new_value);
+        existing = &tempExisting;
+    }
+}
+
+/**
+ * The previous AppendOperator::Merge(), which copies the existing value for every operand
+ */
+static void legacyAppendFullMerge(const vector<rocksdb::Slice>& operands, std::string& new_value) {
+    new_value.clear();
+    for (const rocksdb::Slice& operand : operands) {
+        std::string existing = new_value;
+        new_value = std::move(existing + operand.ToString());
+    }
+}
+
+/**
+ * The previous OROperator::Merge(): Bytewise OR into a temporary buffer,
+ * which is then copied into a new string
+ */
+static void legacyOrFullMerge(const vector<rocksdb::Slice>& operands, std::string& new_value) {
+    new_value = operands[0].ToString();
+    for (size_t i = 1; i < operands.size(); i++) {
+        std::string existing = new_value;
+        const rocksdb::Slice& value = operands[i];
+        size_t dstSize = std::max(existing.size(), value.size());
+        char* dst = new char[dstSize];
+        size_t numCommonBytes = std::min(existing.size(), value.size());
+        for (size_t j = 0; j < numCommonBytes; j++) {
+            dst[j] = existing[j] | value[j];
+        }
+        if (existing.size() > numCommonBytes) {
+            memcpy(dst + numCommonBytes, existing.data() + numCommonBytes, existing.size() - numCommonBytes);
+        } else if (value.size() > numCommonBytes) {
+            memcpy(dst + numCommonBytes, value.data() + numCommonBytes, value.size() - numCommonBytes);
+        }
+        new_value = std::move(std::string(dst, dstSize));
+        delete[] dst;
+    }
+}
+
+static double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+template<typename T>
+static void benchmarkOperator(const char* name,
+                              rocksdb::MergeOperator& mergeOperator,
+                              const std::function<T (T, T)>& operation,
+                              size_t chainLength, size_t numChains) {
+    //Operand chain of a hot key: Small increments / factors close to 1
+    vector<string> operandData(chainLength);
+    for (size_t i = 0; i < chainLength; i++) {
+        T operand = (T) 1 + (T) (i % 2);
+        operandData[i].assign((const char*) &operand, sizeof(T));
+    }
+    vector<rocksdb::Slice> operands(operandData.begin(), operandData.end());
+    deque<rocksdb::Slice> operandDeque(operands.begin(), operands.end());
+    double numOperands = (double) chainLength * numChains;
+    //Previous implementation
+    string legacyResult;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < numChains; i++) {
+        legacyFullMerge<T>(operands, legacyResult, operation);
+    }
+    double legacySeconds = secondsSince(start);
+    //Full merge
+    string fullResult;
+    rocksdb::Slice existingOperand;
+    rocksdb::Slice key("counter");
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < numChains; i++) {
+        rocksdb::MergeOperator::MergeOperationInput mergeIn(key, nullptr, operands, nullptr);
+        rocksdb::MergeOperator::MergeOperationOutput mergeOut(fullResult, existingOperand);
+        mergeOperator.FullMergeV2(mergeIn, &mergeOut);
+    }
+    double fullSeconds = secondsSince(start);
+    //Partial merge
+    string partialResult;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < numChains; i++) {
+        mergeOperator.PartialMergeMulti(key, operandDeque, &partialResult, nullptr);
+    }
+    double partialSeconds = secondsSince(start);
+    cout << name << ":" << endl
+         << "  Associative merge: " << numOperands / legacySeconds << " operands/s" << endl
+         << "  Full merge: " << numOperands / fullSeconds << " operands/s" << endl
+         << "  Partial merge: " << numOperands / partialSeconds << " operands/s" << endl;
+    if (legacyResult != fullResult) {
+        cout << "  ERROR: Full merge result differs from the associative merge result" << endl;
+    }
+}
+
+/**
+ * Builds a large value from many appends of a fixed size.
+ */
+static void benchmarkAppend(rocksdb::MergeOperator& mergeOperator,
+                            size_t chainLength, size_t numChains) {
+    string operandData(256, 'x');
+    vector<rocksdb::Slice> operands(chainLength, rocksdb::Slice(operandData));
+    double numBytes = (double) operandData.size() * chainLength * numChains;
+    //Previous implementation
+    string legacyResult;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < numChains; i++) {
+        legacyAppendFullMerge(operands, legacyResult);
+    }
+    double legacySeconds = secondsSince(start);
+    //Full merge
+    string fullResult;
+    rocksdb::Slice existingOperand;
+    rocksdb::Slice key("log");
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < numChains; i++) {
+        rocksdb::MergeOperator::MergeOperationInput mergeIn(key, nullptr, operands, nullptr);
+        rocksdb::MergeOperator::MergeOperationOutput mergeOut(fullResult, existingOperand);
+        mergeOperator.FullMergeV2(mergeIn, &mergeOut);
+    }
+    double fullSeconds = secondsSince(start);
+    cout << "APPEND (" << fullResult.size() << " byte values):" << endl
+         << "  Associative merge: " << numBytes / legacySeconds / 1e6 << " MB/s" << endl
+         << "  Full merge: " << numBytes / fullSeconds / 1e6 << " MB/s" << endl;
+    if (legacyResult != fullResult) {
+        cout << "  ERROR: Full merge result differs from the associative merge result" << endl;
+    }
+}
+
+/**
+ * ORs many large bitmaps with a few bits set each,
+ * in the plain and in the compressed representation.
+ */
+static void benchmarkBitwiseOr(size_t bitmapSize, size_t chainLength, size_t numChains) {
+    vector<string> operandData(chainLength, string(bitmapSize, '\0'));
+    vector<string> rawOperandData(chainLength, string(bitmapSize + 1, '\0'));
+    for (size_t i = 0; i < chainLength; i++) {
+        size_t byte = (i * 7919) % bitmapSize;
+        operandData[i][byte] = 1;
+        rawOperandData[i][byte + 1] = 1;
+    }
+    vector<rocksdb::Slice> operands(operandData.begin(), operandData.end());
+    vector<rocksdb::Slice> rawOperands(rawOperandData.begin(), rawOperandData.end());
+    double numBytes = (double) bitmapSize * chainLength * numChains;
+    //Previous implementation
+    string legacyResult;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < numChains; i++) {
+        legacyOrFullMerge(operands, legacyResult);
+    }
+    double legacySeconds = secondsSince(start);
+    //Full merge
+    OROperator orOperator;
+    CompressedBitmapOperator compressedOperator(BitwiseOperation::Or, "Compressed bitmap OR");
+    string fullResult, compressedResult;
+    rocksdb::Slice existingOperand;
+    rocksdb::Slice key("bitmap");
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < numChains; i++) {
+        rocksdb::MergeOperator::MergeOperationInput mergeIn(key, nullptr, operands, nullptr);
+        rocksdb::MergeOperator::MergeOperationOutput mergeOut(fullResult, existingOperand);
+        orOperator.FullMergeV2(mergeIn, &mergeOut);
+    }
+    double fullSeconds = secondsSince(start);
+    //Compressed bitmaps, from raw operands
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < numChains; i++) {
+        rocksdb::MergeOperator::MergeOperationInput mergeIn(key, nullptr, rawOperands, nullptr);
+        rocksdb::MergeOperator::MergeOperationOutput mergeOut(compressedResult, existingOperand);
+        compressedOperator.FullMergeV2(mergeIn, &mergeOut);
+    }
+    double compressedSeconds = secondsSince(start);
+    cout << "OR (" << bitmapSize << " byte bitmaps):" << endl
+         << "  Associative merge: " << numBytes / legacySeconds / 1e6 << " MB/s" << endl
+         << "  Full merge: " << numBytes / fullSeconds / 1e6 << " MB/s" << endl
+         << "  Compressed full merge: " << numBytes / compressedSeconds / 1e6 << " MB/s, "
+         << compressedResult.size() << " bytes stored" << endl;
+    if (legacyResult != fullResult) {
+        cout << "  ERROR: Full merge result differs from the associative merge result" << endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t chainLength = argc > 1 ? atoll(argv[1]) : 1000;
+    size_t numChains = argc > 2 ? atoll(argv[2]) : 10000;
+    cout << numChains << " chains of " << chainLength << " operands" << endl;
+    Int64AddOperator int64Add;
+    DAddOperator doubleAdd;
+    DMulOperator doubleMultiply;
+    benchmarkOperator<int64_t>("INT64ADD", int64Add,
+        [](int64_t a, int64_t b) { return a + b; }, chainLength, numChains);
+    benchmarkOperator<double>("DADD", doubleAdd,
+        [](double a, double b) { return a + b; }, chainLength, numChains);
+    benchmarkOperator<double>("DMUL", doubleMultiply,
+        [](double a, double b) { return a * b; }, chainLength, numChains);
+    //Appending is quadratic in the chain length for the previous implementation
+    AppendOperator append;
+    benchmarkAppend(append, chainLength * 10, std::max<size_t>(numChains / 1000, 1));
+    benchmarkBitwiseOr(65536, std::max<size_t>(chainLength / 10, 2), std::max<size_t>(numChains / 100, 1));
+    return 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * Microbenchmark comparing the specialized scan loops of the scan engine
+ * to the previous scan loop, which checks direction, range end
+ * and filters at runtime for each record.
+ *
+ * An in-memory iterator is used, so the loop overhead
+ * is measured instead of the RocksDB block decoding.
+ *
+ * Usage: scan_engine_benchmark [table size in MiB]
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "ScanEngine.hpp"
+
+using namespace std;
+
+static const size_t keySize = 16;
+static const size_t valueSize = 112;
+
+/**
+ * Iterator over consecutive fixed-size records in a single buffer
+ */
+class BufferIterator {
+public:
+    BufferIterator(const string& buffer)
+        : buffer(buffer), numRecords(buffer.size() / (keySize + valueSize)), position(0) {
+    }
+    bool Valid() const {
+        return position < numRecords;
+    }
+    void SeekToFirst() {
+        position = 0;
+    }
+    void SeekToLast() {
+        position = numRecords - 1;
+    }
+    void Seek(const rocksdb::Slice& target) {
+        //Binary search for the first key >= target
+        size_t low = 0, high = numRecords;
+        while (low < high) {
+            size_t mid = (low + high) / 2;
+            if (keyAt(mid).compare(target) < 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        position = low;
+    }
+    void Next() {
+        position++;
+    }
+    void Prev() {
+        position--; //Wraps around to an invalid position
+    }
+    rocksdb::Slice key() const {
+        return keyAt(position);
+    }
+    rocksdb::Slice value() const {
+        return rocksdb::Slice(buffer.data() + position * (keySize + valueSize) + keySize, valueSize);
+    }
+private:
+    rocksdb::Slice keyAt(size_t index) const {
+        return rocksdb::Slice(buffer.data() + index * (keySize + valueSize), keySize);
+    }
+    const string& buffer;
+    size_t numRecords;
+    size_t position;
+};
+
+/**
+ * The scan loop before the scan engine has been introduced
+ */
+template<typename Visitor>
+static void branchingScan(BufferIterator* it, const ScanRange& range,
+                          ScanFilter& filter, bool haveFilter, Visitor& visitor) {
+    bool invertScanDirection = range.inverted;
+    bool haveRangeEnd = !range.end.empty();
+    rocksdb::Slice rangeEndSlice(range.end);
+    uint64_t scanLimit = range.limit;
+    uint64_t scanSkipCount = range.skip;
+    seekToRangeStart(it, range);
+    for (; it->Valid(); (invertScanDirection ? it->Prev() : it->Next())) {
+        rocksdb::Slice key = it->key();
+        if (scanLimit <= 0) {
+            break;
+        }
+        scanLimit--;
+        int compareResult = (haveRangeEnd ? key.compare(rangeEndSlice) : 0);
+        if (haveRangeEnd
+                && (!invertScanDirection || compareResult <= 0)
+                && (invertScanDirection  || compareResult >= 0)) {
+            break;
+        }
+        rocksdb::Slice value = it->value();
+        if (haveFilter && !filter.matches(key, value)) {
+            scanLimit++;
+            continue;
+        }
+        if (scanSkipCount > 0) {
+            scanSkipCount--;
+            continue;
+        }
+        visitor(key, value);
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t tableSize = (argc > 1 ? atoll(argv[1]) : 1024) * 1024 * 1024;
+    size_t numRecords = tableSize / (keySize + valueSize);
+    //Generate ascending keys, so the buffer is a sorted table
+    string buffer(numRecords * (keySize + valueSize), 'v');
+    for (size_t i = 0; i < numRecords; i++) {
+        char key[keySize + 1];
+        snprintf(key, sizeof(key), "%016zu", i);
+        buffer.replace(i * (keySize + valueSize), keySize, key, keySize);
+    }
+    char rangeEnd[keySize + 1];
+    snprintf(rangeEnd, sizeof(rangeEnd), "%016zu", numRecords - 1);
+    //Sum of all visited data, so the loops can't be optimized away
+    uint64_t checksum = 0;
+    auto visitor = [&checksum](const rocksdb::Slice& key, const rocksdb::Slice& value) -> bool {
+        checksum += key.size() + value.size() + key[keySize - 1];
+        return true;
+    };
+    ScanFilter noFilter("", "");
+    struct Scenario {
+        const char* name;
+        bool inverted;
+        bool haveEnd;
+    };
+    const Scenario scenarios[] = {
+        {"forward, no range end", false, false},
+        {"forward, range end", false, true},
+        {"inverted, range end", true, true}
+    };
+    cout << "Table size " << (buffer.size() / (1024 * 1024)) << " MiB, "
+         << numRecords << " records" << endl;
+    for (const Scenario& scenario : scenarios) {
+        ScanRange range;
+        range.inverted = scenario.inverted;
+        if (scenario.haveEnd) {
+            range.end = scenario.inverted ? string(keySize, '0') : string(rangeEnd);
+        }
+        BufferIterator it(buffer);
+        cout << scenario.name << ":" << endl;
+        //Previous implementation
+        auto start = chrono::steady_clock::now();
+        branchingScan(&it, range, noFilter, false, visitor);
+        double branchingSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        //Scan engine
+        start = chrono::steady_clock::now();
+        scanRange<true>(&it, range, noFilter, visitor);
+        double specializedSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        double mib = buffer.size() / (1024.0 * 1024.0);
+        cout << "  Branching loop: " << mib / branchingSeconds << " MiB/s" << endl
+             << "  Specialized loop: " << mib / specializedSeconds << " MiB/s" << endl;
+    }
+    cout << "(checksum " << checksum << ")" << endl;
+    return 0;
+}
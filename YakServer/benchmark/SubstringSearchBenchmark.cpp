@@ -0,0 +1,68 @@
+/**
+ * Microbenchmark comparing the substring search implementations
+ * used for scan filters.
+ *
+ * Usage: substring_search_benchmark [corpus size in MiB]
+ */
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include "SubstringSearch.hpp"
+
+using namespace std;
+
+static const char* implementationName(SubstringSearcher::Implementation impl) {
+    switch (impl) {
+        case SubstringSearcher::Implementation::BoyerMooreHorspool: return "BMH";
+        case SubstringSearcher::Implementation::SSE2: return "SSE2";
+        case SubstringSearcher::Implementation::AVX2: return "AVX2";
+        default: return "Auto";
+    }
+}
+
+/**
+ * Generate a JSON-like corpus with a limited alphabet,
+ * so partial matches of the patterns occur frequently
+ */
+static string generateCorpus(size_t size) {
+    static const char alphabet[] = "{}\":,abcdefghijklmnopqrstuvwxyz0123456789 ";
+    mt19937 rng(42);
+    uniform_int_distribution<size_t> dist(0, sizeof(alphabet) - 2);
+    string corpus(size, ' ');
+    for (char& c : corpus) {
+        c = alphabet[dist(rng)];
+    }
+    return corpus;
+}
+
+int main(int argc, char** argv) {
+    size_t corpusSize = (argc > 1 ? atoll(argv[1]) : 256) * 1024 * 1024;
+    string corpus = generateCorpus(corpusSize);
+    //The patterns do not occur, so the whole corpus is searched
+    const string patterns[] = {"\"id\":\"~", "\"timestamp\":\"~0", "\"description\":\"lorem ipsum dolor sit amet~"};
+    const SubstringSearcher::Implementation implementations[] = {
+        SubstringSearcher::Implementation::BoyerMooreHorspool,
+        SubstringSearcher::Implementation::SSE2,
+        SubstringSearcher::Implementation::AVX2
+    };
+    for (const string& pattern : patterns) {
+        cout << "Pattern length " << pattern.size() << ":" << endl;
+        for (SubstringSearcher::Implementation impl : implementations) {
+            if (!SubstringSearcher::isSupported(impl)) {
+                cout << "  " << implementationName(impl) << ": not supported" << endl;
+                continue;
+            }
+            SubstringSearcher searcher(pattern, impl);
+            auto start = chrono::steady_clock::now();
+            int64_t result = searcher.find(corpus);
+            auto end = chrono::steady_clock::now();
+            double seconds = chrono::duration<double>(end - start).count();
+            cout << "  " << implementationName(impl) << ": "
+                 << (corpusSize / (1024.0 * 1024.0)) / seconds << " MiB/s"
+                 << " (result " << result << ")" << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,127 @@
+#ifndef __AHO_CORASICK_HPP
+#define __AHO_CORASICK_HPP
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+
+/**
+ * Aho-Corasick automaton to search for multiple patterns
+ * in a single pass over the corpus.
+ *
+ * The transitions are stored in a dense table (256 entries per state),
+ * so each corpus byte costs a single table lookup.
+ * This is intended for a moderate total pattern length (up to some kiB).
+ */
+class AhoCorasickAutomaton {
+public:
+    /**
+     * Build the automaton. Empty patterns are ignored.
+     */
+    explicit AhoCorasickAutomaton(const std::vector<std::string>& patterns)
+            : numPatterns(0), generation(0) {
+        transitions.assign(256, 0);
+        outputs.resize(1);
+        //Step 1: Build the trie
+        for (const std::string& pattern : patterns) {
+            if (pattern.empty()) {
+                continue;
+            }
+            uint32_t state = 0;
+            for (unsigned char c : pattern) {
+                uint32_t& next = transitions[state * 256 + c];
+                if (next == 0) {
+                    next = outputs.size();
+                    outputs.emplace_back();
+                    transitions.resize(transitions.size() + 256, 0);
+                }
+                state = transitions[state * 256 + c];
+            }
+            outputs[state].push_back(numPatterns++);
+        }
+        //Step 2: Compute the failure links in BFS order and
+        // replace missing transitions by the transitions of the failure state.
+        std::vector<uint32_t> failure(outputs.size(), 0);
+        std::deque<uint32_t> queue;
+        for (unsigned int c = 0; c < 256; c++) {
+            if (transitions[c] != 0) {
+                queue.push_back(transitions[c]);
+            }
+        }
+        while (!queue.empty()) {
+            uint32_t state = queue.front();
+            queue.pop_front();
+            //Patterns ending at the failure state also end here
+            const std::vector<uint32_t>& failureOutputs = outputs[failure[state]];
+            outputs[state].insert(outputs[state].end(), failureOutputs.begin(), failureOutputs.end());
+            for (unsigned int c = 0; c < 256; c++) {
+                uint32_t& next = transitions[state * 256 + c];
+                uint32_t failureNext = transitions[failure[state] * 256 + c];
+                if (next == 0) {
+                    next = failureNext;
+                } else {
+                    failure[next] = failureNext;
+                    queue.push_back(next);
+                }
+            }
+        }
+        seen.assign(numPatterns, 0);
+    }
+
+    /**
+     * @return The number of (non-empty) patterns
+     */
+    size_t getNumPatterns() const {
+        return numPatterns;
+    }
+
+    /**
+     * @return true if any of the patterns occurs in the corpus
+     */
+    bool matchesAny(const char* corpus, size_t length) const {
+        uint32_t state = 0;
+        for (size_t i = 0; i < length; i++) {
+            state = transitions[state * 256 + (unsigned char)corpus[i]];
+            if (!outputs[state].empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @return true if every pattern occurs in the corpus
+     */
+    bool matchesAll(const char* corpus, size_t length) {
+        if (numPatterns == 0) {
+            return true;
+        }
+        //Use a new generation instead of clearing the seen flags
+        if (++generation == 0) {
+            seen.assign(numPatterns, 0);
+            generation = 1;
+        }
+        size_t remaining = numPatterns;
+        uint32_t state = 0;
+        for (size_t i = 0; i < length; i++) {
+            state = transitions[state * 256 + (unsigned char)corpus[i]];
+            for (uint32_t pattern : outputs[state]) {
+                if (seen[pattern] != generation) {
+                    seen[pattern] = generation;
+                    if (--remaining == 0) {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+private:
+    std::vector<uint32_t> transitions; //state * 256 + byte --> next state
+    std::vector<std::vector<uint32_t> > outputs; //state --> IDs of the patterns ending here
+    uint32_t numPatterns;
+    std::vector<uint32_t> seen; //Pattern ID --> generation it has last been found in
+    uint32_t generation;
+};
+
+#endif //__AHO_CORASICK_HPP
@@ -9,7 +9,10 @@
 #include "AbstractFrameProcessor.hpp"
 #include "SequentialIDGenerator.hpp"
 #include "Tablespace.hpp"
+#include "ConfigParser.hpp"
 #include "JobInfo.hpp"
+#include "ClientSidePassiveJob.hpp"
+#include "ScanEngine.hpp"
 
 
 /**
@@ -21,7 +24,7 @@ public:
      * Creates a new async job router controller.
      * Does not automatically start the thread
      */
-    AsyncJobRouterController(void* ctx, Tablespace& tablespace);
+    AsyncJobRouterController(void* ctx, Tablespace& tablespace, ConfigParser& cfg);
     ~AsyncJobRouterController();
     void start();
     /**
@@ -37,6 +40,7 @@ private:
     std::thread* childThread;
     Tablespace& tablespace;
     void* ctx;
+    ConfigParser& cfg;
 };
 
 
@@ -54,7 +58,7 @@ private:
 class AsyncJobRouter : private AbstractFrameProcessor
 {
 public:
-    AsyncJobRouter(void* ctx, Tablespace& tablespace);
+    AsyncJobRouter(void* ctx, Tablespace& tablespace, ConfigParser& cfg);
     ~AsyncJobRouter();
     /**
      * Process the next request message that is received from the input socket.
@@ -62,6 +66,12 @@ public:
      */
     bool processNextRequest();
 private:
+    /**
+     * Check if the given number of jobs may be started without exceeding
+     * the configured maximum number of concurrent jobs.
+     * Scrubs finished jobs if neccessary.
+     */
+    bool canStartJob(uint32_t numJobs = 1);
     /**
      * Create a new Job.
      * Assigns a new APID, initializes a socket and saves both in
@@ -75,6 +85,37 @@ private:
         uint32_t blocksize,
         uint64_t scanLimit,
         const std::string& rangeStart,
+        const std::string& rangeEnd,
+        ClientSidePassiveJob::SharedSnapshot snapshot = nullptr);
+    /**
+     * Start a job copying a range from one table to another.
+     * The tables are opened by the job thread if neccessary.
+     */
+    void startCopyRangeJob(uint64_t apid,
+        uint32_t sourceTableId,
+        uint32_t targetTableId,
+        const ScanRange& range,
+        uint8_t writeFlags,
+        uint8_t copyFlags);
+    /**
+     * Send the statistics of all running jobs and of all jobs
+     * that have finished recently.
+     */
+    void handleJobStatisticsRequest(zmq_msg_t* routingFrame,
+        zmq_msg_t* delimiterFrame,
+        uint8_t statisticsRequestType);
+    JobState getJobState(uint64_t apid);
+    /**
+     * Split a range into partitions of approximately equal size
+     * and start one client-side passive job per partition.
+     * All partitions use the same snapshot.
+     * @return The APID of the first partition.
+     *  The partitions have consecutive APIDs in key order.
+     */
+    uint64_t startPartitionedClientSidePassiveJob(uint32_t& numPartitions,
+        uint32_t tableId,
+        uint32_t blocksize,
+        const std::string& rangeStart,
         const std::string& rangeEnd);
     /**
      * Terminate all jobs and cleanup
@@ -124,7 +165,11 @@ private:
     std::map<uint64_t, void*> processSocketMap; //APID --> ZMQ socket
     std::map<uint64_t, std::thread*> processThreadMap; //APID --> ZMQ socket
     std::map<uint64_t, ThreadTerminationInfo*> apTerminationInfo; //APID --> TTI object
-    std::map<uint64_t, ThreadStatisticsInfo*> apStatisticsInfo; //APID --> TTI object
+    /**
+     * APID --> Statistics object.
+     * The statistics are kept for some time after the job has been cleaned up.
+     */
+    std::map<uint64_t, ThreadStatisticsInfo*> apStatisticsInfo;
     /**
      * This variable is incremented by APs when they exit
      * to request a scrub job.
@@ -137,6 +182,7 @@ private:
     SequentialIDGenerator apidGenerator;
     void* ctx;
     Tablespace& tablespace;
+    ConfigParser& cfg;
     /**
      * This is set to zclock_time() when a scrub job is excecuted.
      *
@@ -0,0 +1,106 @@
+#ifndef __BITMAP_HPP
+#define __BITMAP_HPP
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <rocksdb/slice.h>
+
+enum class BitwiseOperation : uint8_t {
+    And,
+    Or,
+    Xor
+};
+
+/**
+ * Compute dst[i] = dst[i] <operation> src[i] for all i in [0, n).
+ * Uses AVX2 or SSE2 (whatever is the fastest supported implementation)
+ * and 64-bit words for the remaining bytes.
+ */
+void applyBitwiseOperation(BitwiseOperation operation, char* dst, const char* src, size_t n);
+
+/**
+ * Compressed bitmaps with Roaring-style containers, as stored
+ * by the ROARINGAND, ROARINGOR and ROARINGXOR merge operators.
+ *
+ * The bit indices (32 bits) are split into the upper 16 bits (container key)
+ * and the lower 16 bits. Each container with at most compressedBitmapArrayMaximum set bits
+ * is stored as a sorted array of the lower 16 bits, any other container
+ * is stored as a 8 KiB bitmap. Containers without set bits are not stored.
+ *
+ * Format (integers in server platform endianness):
+ *  - [0x01 Compressed bitmap marker]
+ *  - For each container, in ascending key order:
+ *      16-bit key, 16-bit (number of set bits - 1), array or bitmap
+ *
+ * A raw bitmap is prefixed by [0x00] instead.
+ * Bit i is stored in byte i / 8 as bit (i % 8), LSB first.
+ */
+static const size_t compressedBitmapArrayMaximum = 4096;
+static const size_t compressedBitmapContainerBytes = 8192;
+
+/**
+ * Applies a bitwise operation to a sequence of compressed or raw bitmaps
+ * and serializes the result as a compressed bitmap.
+ * Array containers are combined as sorted arrays (union, intersection
+ * or symmetric difference) and only expanded to a 8 KiB bitmap once their
+ * cardinality exceeds compressedBitmapArrayMaximum, so sparse bitmaps
+ * with many containers stay small. Bitmap containers are combined
+ * using applyBitwiseOperation().
+ *
+ * Unlike the plain AND operator, missing bits are always treated as 0.
+ */
+class CompressedBitmapBuilder {
+public:
+    explicit CompressedBitmapBuilder(BitwiseOperation operation);
+    /**
+     * Apply the next bitmap. The first bitmap initializes the result.
+     * @return false if the bitmap is corrupt or too large (the result is unchanged)
+     */
+    bool add(const rocksdb::Slice& bitmap);
+    /**
+     * Serialize the result into dst (replacing its content) and reset the builder.
+     */
+    void finish(std::string& dst);
+private:
+    /**
+     * A container of a bitmap being added. data points either to
+     * a sorted uint16 array (cardinality entries) or to a bitmap of size bytes.
+     */
+    struct ContainerView {
+        uint16_t key;
+        bool isArray;
+        const char* data;
+        size_t size; //Number of array entries or bitmap bytes
+    };
+    /**
+     * A container of the result. It is stored in array unless bitmap
+     * is non-empty, in which case bitmap has compressedBitmapContainerBytes bytes.
+     */
+    struct Container {
+        std::vector<uint16_t> array;
+        std::string bitmap;
+    };
+    bool parse(const rocksdb::Slice& bitmap);
+    /**
+     * Initialize a result container from a container view
+     */
+    void assign(const ContainerView& view, Container& container);
+    /**
+     * Apply the operation to a result container and a container view
+     */
+    void apply(const ContainerView& view, Container& container);
+    /**
+     * Convert an array container into a bitmap container
+     */
+    static void toBitmap(Container& container);
+    BitwiseOperation operation;
+    bool initialized;
+    std::map<uint16_t, Container> containers;
+    //Buffers for the currently added bitmap
+    std::vector<ContainerView> views;
+    std::vector<uint16_t> operand;
+    std::vector<uint16_t> merged;
+};
+
+#endif //__BITMAP_HPP
@@ -22,10 +22,12 @@ public:
     BoyerMooreHorspoolSearcher(const std::string& pattern);
     /**
      * Find an occurrence of the pattern in a given corpus
+     * @return The offset of the first occurrence or -1 if the pattern
+     *         does not occur in the corpus (or the pattern is empty)
      */
-    const int find(const char* corpus);
-    const int find(const std::string& corpus);
-    const int find(const char* corpus, size_t corpusLength);
+    int64_t find(const char* corpus) const;
+    int64_t find(const std::string& corpus) const;
+    int64_t find(const char* corpus, size_t corpusLength) const;
 private:
     void initializeSkipTable();
     /**
@@ -0,0 +1,92 @@
+#ifndef __BULK_LOADER_HPP
+#define __BULK_LOADER_HPP
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <vector>
+#include <rocksdb/db.h>
+#include <rocksdb/sst_file_writer.h>
+#include "KeyCounter.hpp"
+#include "SortedRun.hpp"
+
+/**
+ * Writes records into SST files that are ingested into a table,
+ * bypassing the WAL, the memtable and most of the compaction work.
+ *
+ * If the input is sorted, records are written to the SST file directly.
+ * Otherwise they are collected in a run of limited size,
+ * which is sorted and written to an SST file once it is full.
+ * Every file is ingested as soon as it is finished,
+ * so later records replace (or are merged with) earlier ones.
+ *
+ * The SST files are created in the table directory,
+ * so ingesting them only needs to link the file.
+ */
+class BulkLoader {
+public:
+    /**
+     * @param fileBasename Path prefix for the SST files
+     * @param runSize Maximum number of bytes per SST file / sorted run
+     * @param inputSorted true if the keys are added in strictly ascending order
+     * @param mergeRequired true if the table uses a merge operator other than REPLACE
+     * @param keyCounter The key counter of the table or nullptr
+     */
+    BulkLoader(rocksdb::DB* db,
+               const std::string& fileBasename,
+               uint64_t runSize,
+               bool inputSorted,
+               bool mergeRequired,
+               KeyCounter* keyCounter);
+    /**
+     * Removes the current SST file, if it has not been ingested
+     */
+    ~BulkLoader();
+    /**
+     * Add a record. In sorted mode, the key must be larger than the previous key.
+     * @return false if an error occured, see getStatus()
+     */
+    bool add(const rocksdb::Slice& key, const rocksdb::Slice& value);
+    /**
+     * Write and ingest the remaining records.
+     * @return false if an error occured, see getStatus()
+     */
+    bool finish();
+    const rocksdb::Status& getStatus() const {
+        return status;
+    }
+    uint64_t getIngestedFileCount() const {
+        return ingestedFileCount;
+    }
+private:
+    bool writeRecord(const rocksdb::Slice& key, const rocksdb::Slice& value);
+    /**
+     * Sort the current run and write it into SST files
+     */
+    bool writeRun();
+    /**
+     * Finish the current SST file and ingest it into the table
+     */
+    bool ingestFile();
+    rocksdb::DB* db;
+    std::string fileBasename;
+    uint64_t runSize;
+    bool inputSorted;
+    bool mergeRequired;
+    KeyCounter* keyCounter;
+    /**
+     * The keys in the current SST file, only collected if the table has a key counter.
+     * They are counted when the file is ingested, so the write mutex of the counter
+     * only blocks other writes to the table while a single file is ingested.
+     */
+    std::vector<std::string> fileKeys;
+    SortedRun run;
+    std::unique_ptr<rocksdb::SstFileWriter> sstFileWriter;
+    std::string sstFilename; //Empty --> no SST file is open
+    //Only used for unsorted input with a merge operator. See writeRun()
+    std::shared_ptr<rocksdb::MergeOperator> mergeOperator;
+    std::string mergedValue;
+    uint64_t ingestedFileCount;
+    rocksdb::Status status;
+};
+
+#endif //__BULK_LOADER_HPP
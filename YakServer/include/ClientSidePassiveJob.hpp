@@ -1,6 +1,7 @@
 #ifndef CLIENTSIDEPASSIVEJOB_HPP
 #define CLIENTSIDEPASSIVEJOB_HPP
 #include <zmq.h>
+#include <memory>
 #include <rocksdb/db.h>
 #include "JobInfo.hpp"
 #include "Tablespace.hpp"
@@ -13,6 +14,11 @@
  */
 class ClientSidePassiveJob {
 public:
+    typedef std::shared_ptr<const rocksdb::Snapshot> SharedSnapshot;
+    /**
+     * @param snapshot The snapshot to scan. If this is nullptr,
+     *  a new snapshot is created for this job only.
+     */
     ClientSidePassiveJob(void* ctxParam,
              uint64_t apid,
              uint32_t tableId,
@@ -22,9 +28,16 @@ public:
              uint64_t scanLimit,
              Tablespace& tablespace,
              ThreadTerminationInfo* tti,
-             ThreadStatisticsInfo* statisticsInfo
+             ThreadStatisticsInfo* statisticsInfo,
+             SharedSnapshot snapshot = nullptr
             );
     void mainLoop();
+    /**
+     * Create a snapshot that can be used by multiple jobs
+     * (e.g. partitions of the same scan).
+     * The snapshot is released when the last job using it exits.
+     */
+    static SharedSnapshot createSharedSnapshot(rocksdb::DB* db);
     /**
      * Called when the last message has been received.
      * Implements the termination protocol, see
@@ -41,7 +54,7 @@ private:
     uint64_t scanLimit;
     uint32_t chunksize;
     rocksdb::DB* db;
-    rocksdb::Snapshot* snapshot;
+    SharedSnapshot snapshot;
     ThreadTerminationInfo* tti;
     ThreadStatisticsInfo* threadStatisticsInfo;
     Logger logger;
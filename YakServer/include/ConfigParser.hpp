@@ -9,6 +9,15 @@ enum class CompactionStyle {
     UniversalStyleCompaction
 };
 
+/**
+ * How update requests are assigned to shards that are processed in order
+ */
+enum class UpdateSharding {
+    NoSharding,
+    TableSharding, //One shard per table
+    KeySharding //Single-key writes: One shard per table and key hash
+};
+
 class ConfigParser {
 public:
     ConfigParser(int argc, char** argv);
@@ -23,6 +32,12 @@ public:
      */
     std::string getTableConfigFile(uint32_t tableIndex) const;
 
+    /**
+     * For the given table index, get the file the key counters are saved to
+     * while the table is closed
+     */
+    std::string getTableKeyCounterFile(uint32_t tableIndex) const;
+
     /**
      * Safer stoull version that logs issues if a value could not be converted.
      */
@@ -32,6 +47,20 @@ public:
      * Safer stoull version that logs issues if a value could not be converted.
      */
     int safeStoi(std::map<std::string, std::string>& cfg, const std::string& cfgKey);
+
+    /**
+     * Parse a thread count. "auto" is parsed as the number of processors
+     * available on the system.
+     */
+    unsigned int parseThreadCount(std::map<std::string, std::string>& cfg, const std::string& cfgKey);
+
+    /**
+     * Parse the maximum thread count of a worker pool.
+     * It is at least the initial thread count and must not be 0,
+     * else requests for the pool would never be processed.
+     */
+    unsigned int parseMaxThreadCount(std::map<std::string, std::string>& cfg,
+                                     const std::string& cfgKey, unsigned int minThreads);
     /*
      * Config options accessible as fields.
      * To simplify the code and to avoid possible performance issues,
@@ -44,10 +73,15 @@ public:
     std::string logFile;
     //Statistics options
     uint64_t statisticsExpungeTimeout;
+    bool enableTableStatistics;
     //ZMQ options
     std::vector<std::string> repEndpoints;
     std::vector<std::string> pullEndpoints;
     std::vector<std::string> subEndpoints;
+    std::vector<std::string> subConnectEndpoints;
+    std::vector<std::string> subTopics;
+    std::vector<std::string> watchEndpoints; //Empty --> Watch notify disabled
+    bool watchValues;
     bool zmqIPv4Only;
     int externalRCVHWM;
     int externalSNDHWM;
@@ -56,15 +90,38 @@ public:
     //RocksDB table options
     bool useMMapReads;
     bool useMMapWrites;
-    uint64_t defaultLRUCacheSize;
+    bool pipelinedWrite;
+    bool unorderedWrite;
+    uint64_t blockCacheSize; //Shared by all tables
+    int blockCacheShardBits;
+    uint64_t writeBufferManagerSize;
     uint64_t defaultTableBlockSize;
     uint64_t defaultWriteBufferSize;
     uint64_t defaultBloomFilterBitsPerKey;
     rocksdb::CompressionType defaultCompression;
     std::string defaultMergeOperator;
+    //Worker thread options
+    unsigned int readWorkerThreads;
+    unsigned int readWorkerThreadsMax;
+    unsigned int scanWorkerThreads;
+    unsigned int scanWorkerThreadsMax;
+    unsigned int updateWorkerThreads;
+    unsigned int updateWorkerThreadsMax;
+    unsigned int longUpdateWorkerThreads;
+    unsigned int longUpdateWorkerThreadsMax;
+    unsigned int asyncJobThreads;
+    uint32_t workerScaleUpQueueDepth;
+    uint64_t workerIdleTimeout;
+    uint64_t groupCommitMaxBytes;
+    uint64_t groupCommitDelay;
+    UpdateSharding updateSharding;
     //Other RocksDB options
     int rocksdbConcurrency;
     uint32_t putBatchSize;
+    uint64_t putBatchBytes;
+    uint64_t putBatchLatency;
+    uint32_t readBatchSize;
+    uint64_t bulkLoadRunSize;
     uint64_t compactionMemoryBudget;
     CompactionStyle compactionStyle;
     //Save folder, normalized to have a terminal slash.
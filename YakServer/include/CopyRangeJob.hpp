@@ -0,0 +1,152 @@
+#ifndef COPYRANGEJOB_HPP
+#define COPYRANGEJOB_HPP
+#include <zmq.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <rocksdb/db.h>
+#include <rocksdb/sst_file_writer.h>
+#include "JobInfo.hpp"
+#include "Tablespace.hpp"
+#include "ConfigParser.hpp"
+#include "ScanEngine.hpp"
+#include "Logger.hpp"
+
+/**
+ * An instance of this class represents a running asynchronous
+ * table range copy job.
+ *
+ * The source range is read from a snapshot by a reader thread,
+ * which hands chunks of (at most) putBatchSize records to the job thread.
+ * Only a fixed number of chunk buffers exists, so the memory usage
+ * does not depend on the size of the range.
+ *
+ * The job thread writes the chunks to the target table, either as
+ * write batches or (if requested) into SST files that are ingested
+ * into the target table, bypassing the memtable.
+ */
+class CopyRangeJob {
+public:
+    CopyRangeJob(void* ctxParam,
+                 uint64_t apid,
+                 uint32_t sourceTableId,
+                 uint32_t targetTableId,
+                 const ScanRange& range,
+                 uint8_t writeFlags,
+                 uint8_t copyFlags,
+                 Tablespace& tablespace,
+                 ConfigParser& cfg,
+                 ThreadTerminationInfo* tti,
+                 ThreadStatisticsInfo* statisticsInfo);
+    /**
+     * Copy the range. Returns when the copy is finished,
+     * has failed or the job has been stopped.
+     */
+    void run();
+    /**
+     * Implements the termination protocol, see
+     * ThreadTerminationInfo documentation.
+     */
+    ~CopyRangeJob();
+private:
+    /**
+     * A buffer for consecutive records of the source range.
+     * All keys and values are stored in a single string, so the buffer
+     * does not need any allocations once it has been used.
+     */
+    struct Chunk {
+        std::string data;
+        std::vector<std::pair<uint32_t, uint32_t> > sizes; //(key size, value size)
+        void add(const rocksdb::Slice& key, const rocksdb::Slice& value) {
+            data.append(key.data(), key.size());
+            data.append(value.data(), value.size());
+            sizes.emplace_back(key.size(), value.size());
+        }
+        void clear() {
+            data.clear();
+            sizes.clear();
+        }
+        /**
+         * Call visitor(key, value) for each record in the chunk
+         * until it returns false.
+         */
+        template<typename Visitor>
+        bool forEach(Visitor& visitor) const {
+            const char* record = data.data();
+            for (const auto& recordSize : sizes) {
+                rocksdb::Slice key(record, recordSize.first);
+                rocksdb::Slice value(record + recordSize.first, recordSize.second);
+                if (!visitor(key, value)) {
+                    return false;
+                }
+                record += recordSize.first + recordSize.second;
+            }
+            return true;
+        }
+    };
+    /**
+     * Main function of the reader thread
+     */
+    void readSourceRange();
+    /**
+     * Delete the range from the target table (synchronous delete copy flag)
+     */
+    bool deleteTargetRange();
+    bool writeChunk(Chunk* chunk);
+    bool writeChunkToSstFile(Chunk* chunk);
+    /**
+     * Finish the current SST file and ingest it into the target table
+     */
+    bool ingestSstFile();
+    /**
+     * @return true if the router sent a stop message
+     */
+    bool isStopRequested();
+    /**
+     * Log the error and mark the job as failed if the status is not OK
+     */
+    bool checkStatus(const rocksdb::Status& status, const char* description);
+    //Chunk queue between the reader and the job thread
+    Chunk* acquireFreeChunk();
+    void pushFullChunk(Chunk* chunk);
+    Chunk* popFullChunk();
+    void releaseChunk(Chunk* chunk);
+    void abort();
+    static const size_t numChunkBuffers = 3;
+    Chunk chunkBuffers[numChunkBuffers];
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::vector<Chunk*> freeChunks;
+    std::deque<Chunk*> fullChunks;
+    bool readerFinished;
+    bool aborted;
+    rocksdb::Status readStatus;
+    //Copy parameters
+    uint64_t apid;
+    ScanRange range;
+    uint32_t chunkSize;
+    bool synchronousDelete;
+    bool ingestFiles;
+    bool mergeRequired;
+    rocksdb::WriteOptions writeOptions;
+    rocksdb::DB* sourceTable;
+    rocksdb::DB* targetTable;
+    const rocksdb::Snapshot* snapshot;
+    KeyCounter* keyCounter;
+    //SST file ingestion state
+    std::unique_ptr<rocksdb::SstFileWriter> sstFileWriter;
+    std::string sstFilename;
+    uint32_t sstFileCount;
+    uint64_t sstFileSizeLimit;
+    void* inSocket;
+    ConfigParser& cfg;
+    ThreadTerminationInfo* tti;
+    ThreadStatisticsInfo* statisticsInfo;
+    Logger logger;
+};
+
+#endif //COPYRANGEJOB_HPP
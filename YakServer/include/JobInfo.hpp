@@ -6,16 +6,28 @@
 #include "Logger.hpp"
 
 enum class JobType : uint8_t {
-    CLIENTSIDE_PASSIVE,
-    CLIENTSIDE_ACTIVE,
-    SERVERSIDE,
-    TABLE_COPY
+    CLIENTSIDE_PASSIVE = 0x10,
+    CLIENTSIDE_ACTIVE = 0x11,
+    SERVERSIDE = 0x12,
+    TABLE_COPY = 0x20
+};
+
+enum class JobState : uint8_t {
+    UNKNOWN = 0x00,
+    INITIALIZING = 0x10,
+    RUNNING = 0x20,
+    TERMINATING = 0x30,
+    TERMINATED = 0x40
 };
 
 struct ThreadStatisticsInfo {
     inline ThreadStatisticsInfo() : 
         transferredDataBytes(0),
         transferredRecords(0),
+        expectedDataBytes(0),
+        jobStartTime(Logger::getCurrentLogTime()),
+        jobEndTime(0),
+        failed(false),
         jobExpungeTime(std::numeric_limits<int64_t>::max()) {
     }
     JobType jobType;
@@ -23,6 +35,17 @@ struct ThreadStatisticsInfo {
     // but this might have to change in the future
     uint64_t transferredDataBytes;
     uint64_t transferredRecords;
+    /**
+     * Estimated total number of bytes the job will transfer
+     * (used to report the progress). 0 --> unknown
+     */
+    uint64_t expectedDataBytes;
+    int64_t jobStartTime;
+    /**
+     * This is set to the current time when the job has finished. 0 --> still running
+     */
+    int64_t jobEndTime;
+    bool failed;
     /**
      * This is set to zclock_time() when the job is finished.
      * It is used to expunge the statistics some time after 
@@ -32,12 +55,23 @@ struct ThreadStatisticsInfo {
     inline void addTransferredDataBytes(uint64_t bytes) {
         transferredDataBytes += bytes;
     }
-    inline void addTransferredRecords(uint64_t bytes) {
-        transferredDataBytes += bytes;
+    inline void addTransferredRecords(uint64_t records) {
+        transferredRecords += records;
+    }
+    inline void setFinished() {
+        if(jobEndTime == 0) {
+            jobEndTime = Logger::getCurrentLogTime();
+        }
+    }
+    /**
+     * @return The job runtime in milliseconds (until now if the job is still running)
+     */
+    inline uint64_t getRuntime() const {
+        int64_t endTime = (jobEndTime == 0 ? Logger::getCurrentLogTime() : jobEndTime);
+        return endTime - jobStartTime;
     }
     /**
      * Set the expunge time
-     * TODO unfinished
      */
     void setExpungeTime() {
         jobExpungeTime = Logger::getCurrentLogTime();
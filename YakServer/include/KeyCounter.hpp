@@ -0,0 +1,149 @@
+#ifndef __KEY_COUNTER_HPP
+#define __KEY_COUNTER_HPP
+#include <cstdint>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <rocksdb/db.h>
+
+/**
+ * Number of keys in a table, in total and per key prefix of a fixed length.
+ *
+ * The counters are maintained by the update workers for tables opened
+ * with the KeyCounterPrefixLength parameter, so count requests for the entire table
+ * or a prefix don't need to iterate over the keys.
+ */
+class KeyCounter {
+public:
+    /**
+     * @param prefixLength The length of the prefixes to count individually.
+     *        0 --> Only count the total number of keys
+     */
+    explicit KeyCounter(uint32_t prefixLength);
+    uint32_t getPrefixLength() const {
+        return prefixLength;
+    }
+    /**
+     * Add a delta to the counters for the given key.
+     * Thread-safe.
+     */
+    void add(const rocksdb::Slice& key, int64_t delta);
+    /**
+     * @return The total number of keys in the table
+     */
+    uint64_t getTotal() const {
+        return total.load(std::memory_order_relaxed);
+    }
+    /**
+     * Count the keys starting with a given prefix.
+     * Thread-safe.
+     * @return false if the prefix is longer than the counted prefix length
+     */
+    bool countPrefix(const rocksdb::Slice& prefix, uint64_t& count) const;
+    /**
+     * Recompute all counters by iterating over the entire table
+     * @return The iterator status
+     */
+    rocksdb::Status recount(rocksdb::DB* db);
+    /**
+     * Load the counters saved by save().
+     * The file is deleted, so the counters are only reused
+     * after the table has been closed properly.
+     * @return false if the file does not exist or is not valid
+     */
+    bool load(const std::string& filename);
+    /**
+     * Save the counters to a file.
+     * No updates may be performed after the counters have been saved.
+     */
+    bool save(const std::string& filename) const;
+    /**
+     * Writes to a table with key counters must hold this mutex while
+     * checking the existence of the written keys and writing them,
+     * so concurrent writes of the same key are counted once.
+     * See KeyCountTracker.
+     */
+    std::mutex& getWriteMutex() {
+        return writeMutex;
+    }
+private:
+    uint32_t prefixLength;
+    std::atomic<int64_t> total;
+    mutable std::mutex prefixCountsMutex;
+    std::map<std::string, int64_t> prefixCounts; //Prefix --> number of keys
+    std::mutex writeMutex;
+};
+
+/**
+ * Collects the key count changes caused by the writes to a table
+ * and applies them to the key counter once the writes have been performed.
+ *
+ * If the table does not have a key counter, all methods are no-ops.
+ * Otherwise the write mutex of the counter is held for the lifetime of the tracker,
+ * so all writes to the table must be performed while the tracker exists.
+ */
+class KeyCountTracker {
+public:
+    KeyCountTracker(KeyCounter* counter, rocksdb::DB* db);
+    /**
+     * @return true if the table has a key counter
+     */
+    bool isEnabled() const {
+        return counter != nullptr;
+    }
+    /**
+     * Record a Put or Merge. The key exists after the write.
+     */
+    void recordPut(const rocksdb::Slice& key) {
+        if (counter != nullptr) {
+            record(key, false, true);
+        }
+    }
+    /**
+     * Record a Delete of a key that might not exist
+     */
+    void recordDelete(const rocksdb::Slice& key) {
+        if (counter != nullptr) {
+            record(key, false, false);
+        }
+    }
+    /**
+     * Record a Delete of a key that is known to exist
+     * (e.g. because it has just been read from the table)
+     */
+    void recordDeleteExisting(const rocksdb::Slice& key) {
+        if (counter != nullptr) {
+            record(key, true, false);
+        }
+    }
+    /**
+     * Record the deletion of an existing key by a range deletion.
+     * Only the change per prefix is recorded, so the memory usage
+     * does not depend on the number of deleted keys.
+     */
+    void recordRangeDeleteExisting(const rocksdb::Slice& key) {
+        if (counter != nullptr) {
+            size_t prefixSize = std::min<size_t>(key.size(), counter->getPrefixLength());
+            prefixDeltas[std::string(key.data(), prefixSize)]--;
+        }
+    }
+    /**
+     * Apply the recorded changes to the counter.
+     * Call this after the writes have been performed successfully.
+     */
+    void apply();
+private:
+    void record(const rocksdb::Slice& key, bool knownToExist, bool existsAfterWrite);
+    KeyCounter* counter;
+    rocksdb::DB* db;
+    std::unique_lock<std::mutex> writeLock;
+    //Key --> (existed before the first recorded write, exists after the last recorded write)
+    std::unordered_map<std::string, std::pair<bool, bool> > changes;
+    //Prefix --> Count change by range deletions
+    std::unordered_map<std::string, int64_t> prefixDeltas;
+};
+
+#endif //__KEY_COUNTER_HPP
@@ -1,6 +1,12 @@
 #ifndef __MERGE_ALGORITHMS_HPP
 #define __MERGE_ALGORITHMS_HPP
 
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <rocksdb/slice.h>
 #include "macros.hpp"
 
 
@@ -32,4 +38,134 @@ void HOT splitByNUL(Container& container, const char* data, size_t n) {
     container.emplace(data + currentSubstrOffset, n - currentSubstrOffset);
 }
 
+/**
+ * Split at NUL characters into slices referencing the original data.
+ * Yields the same elements as splitByNUL(), but does not copy them.
+ * The NUL characters are searched using memchr(),
+ * which the C library implements using vector instructions.
+ */
+inline void HOT splitSlicesByNUL(std::vector<rocksdb::Slice>& slices, const char* data, size_t n) {
+    if(n == 0) {
+        return;
+    }
+    const char* end = data + n;
+    const char* nul;
+    while((nul = (const char*) memchr(data, '\0', end - data)) != nullptr) {
+        slices.emplace_back(data, nul - data);
+        data = nul + 1;
+    }
+    slices.emplace_back(data, end - data);
+}
+
+/**
+ * Computes the union of NUL-separated sets and serializes it
+ * as a sorted, NUL-separated list without duplicates.
+ *
+ * The elements are never copied except into the result:
+ * Each added value is split into slices and sorted unless it is
+ * already sorted (which is the case for any result of this class).
+ * The sorted inputs are then combined using a k-way merge.
+ *
+ * The data referenced by the added values must stay valid until the set has been merged.
+ */
+class NULSetMerger {
+public:
+    NULSetMerger() : dataSize(0) {
+    }
+    void add(const char* data, size_t n) {
+        if(n == 0) {
+            return;
+        }
+        size_t begin = elements.size();
+        splitSlicesByNUL(elements, data, n);
+        auto first = elements.begin() + begin;
+        if(!std::is_sorted(first, elements.end(), sliceLess)) {
+            std::sort(first, elements.end(), sliceLess);
+        }
+        inputs.emplace_back(begin, elements.size());
+        dataSize += n + 1;
+    }
+    void add(const rocksdb::Slice& value) {
+        add(value.data(), value.size());
+    }
+    /**
+     * Serialize the merged set into dst, replacing its previous content.
+     * The merger may be reused after calling clear().
+     */
+    void HOT mergeInto(std::string& dst) {
+        dst.clear();
+        //Upper bound of the result size
+        dst.reserve(dataSize);
+        bool firstElement = true;
+        auto appendElement = [&dst, &firstElement](const rocksdb::Slice& element) {
+            if(!firstElement) {
+                dst.push_back('\0');
+            }
+            dst.append(element.data(), element.size());
+            firstElement = false;
+        };
+        forEachMerged(appendElement);
+    }
+    /**
+     * Call visitor(element) for each element of the merged set in ascending order.
+     * The merger may be reused after calling clear().
+     */
+    template<typename Visitor>
+    void HOT forEachMerged(Visitor& visitor) {
+        //Min-heap of the current input positions
+        std::make_heap(inputs.begin(), inputs.end(), heapOrder(elements));
+        size_t heapSize = inputs.size();
+        const rocksdb::Slice* last = nullptr;
+        while(heapSize > 0) {
+            std::pop_heap(inputs.begin(), inputs.begin() + heapSize, heapOrder(elements));
+            std::pair<size_t, size_t>& input = inputs[heapSize - 1];
+            /**
+             * Emit elements from this input until the smallest element of
+             * the other inputs is reached, so long runs (e.g. a large existing value
+             * with few new elements) only need one comparison per element.
+             */
+            const rocksdb::Slice* bound = heapSize > 1 ? &elements[inputs[0].first] : nullptr;
+            do {
+                const rocksdb::Slice& element = elements[input.first];
+                if(last == nullptr || element != *last) {
+                    visitor(element);
+                    last = &element;
+                }
+            } while(++input.first < input.second
+                    && (bound == nullptr || !sliceLess(*bound, elements[input.first])));
+            //Reinsert the input or remove it from the heap if it is exhausted
+            if(input.first < input.second) {
+                std::push_heap(inputs.begin(), inputs.begin() + heapSize, heapOrder(elements));
+            } else {
+                heapSize--;
+            }
+        }
+    }
+    void clear() {
+        elements.clear();
+        inputs.clear();
+        dataSize = 0;
+    }
+private:
+    static bool sliceLess(const rocksdb::Slice& a, const rocksdb::Slice& b) {
+        return a.compare(b) < 0;
+    }
+    /**
+     * Heap comparator that puts the input with the smallest current element on top
+     */
+    struct heapOrder {
+        heapOrder(const std::vector<rocksdb::Slice>& elementsParam) : elements(elementsParam) {
+        }
+        bool operator()(const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b) const {
+            return sliceLess(elements[b.first], elements[a.first]);
+        }
+        const std::vector<rocksdb::Slice>& elements;
+    };
+    //All elements of all inputs. Each input is a sorted range
+    std::vector<rocksdb::Slice> elements;
+    //[current, end) element index of each input
+    std::vector<std::pair<size_t, size_t> > inputs;
+    size_t dataSize;
+};
+
 #endif //__MERGE_ALGORITHMS_HPP
\ No newline at end of file
@@ -3,68 +3,89 @@
 
 #include <rocksdb/merge_operator.h>
 #include <rocksdb/db.h>
+#include "Bitmap.hpp"
 
 /**
- * Signed 64-bit add operator
+ * Signed 64-bit add operator.
+ * All operands are folded in a single pass, and partial merges
+ * collapse operand chains of hot keys into a single operand.
  */
-class Int64AddOperator : public rocksdb::AssociativeMergeOperator {
+class Int64AddOperator : public rocksdb::MergeOperator {
  public:
-  virtual bool Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const override;
-
-    virtual const char* Name() const override;
+    bool FullMergeV2(const MergeOperationInput& merge_in,
+                     MergeOperationOutput* merge_out) const override;
+    bool PartialMerge(const rocksdb::Slice& key,
+                      const rocksdb::Slice& left_operand,
+                      const rocksdb::Slice& right_operand,
+                      std::string* new_value,
+                      rocksdb::Logger* logger) const override;
+    bool PartialMergeMulti(const rocksdb::Slice& key,
+                           const std::deque<rocksdb::Slice>& operand_list,
+                           std::string* new_value,
+                           rocksdb::Logger* logger) const override;
+    const char* Name() const override;
 };
 
 /**
- * Signed 64-bit double multiply operator
+ * Signed 64-bit double multiply operator.
+ * A missing existing value is treated as 0.
  */
-class DMulOperator : public rocksdb::AssociativeMergeOperator {
+class DMulOperator : public rocksdb::MergeOperator {
  public:
-  virtual bool Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const override;
-
-    virtual const char* Name() const override;
+    bool FullMergeV2(const MergeOperationInput& merge_in,
+                     MergeOperationOutput* merge_out) const override;
+    bool PartialMerge(const rocksdb::Slice& key,
+                      const rocksdb::Slice& left_operand,
+                      const rocksdb::Slice& right_operand,
+                      std::string* new_value,
+                      rocksdb::Logger* logger) const override;
+    bool PartialMergeMulti(const rocksdb::Slice& key,
+                           const std::deque<rocksdb::Slice>& operand_list,
+                           std::string* new_value,
+                           rocksdb::Logger* logger) const override;
+    const char* Name() const override;
 };
 
 /**
  * Signed 64-bit double add operator
  */
-class DAddOperator : public rocksdb::AssociativeMergeOperator {
+class DAddOperator : public rocksdb::MergeOperator {
  public:
-  virtual bool Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const override;
-
-    virtual const char* Name() const override;
+    bool FullMergeV2(const MergeOperationInput& merge_in,
+                     MergeOperationOutput* merge_out) const override;
+    bool PartialMerge(const rocksdb::Slice& key,
+                      const rocksdb::Slice& left_operand,
+                      const rocksdb::Slice& right_operand,
+                      std::string* new_value,
+                      rocksdb::Logger* logger) const override;
+    bool PartialMergeMulti(const rocksdb::Slice& key,
+                           const std::deque<rocksdb::Slice>& operand_list,
+                           std::string* new_value,
+                           rocksdb::Logger* logger) const override;
+    const char* Name() const override;
 };
 
 /**
- * Binary append operator
+ * Binary append operator.
+ * The result size is computed first, so all operands
+ * are appended to the existing value with a single allocation.
  */
-class AppendOperator : public rocksdb::AssociativeMergeOperator {
+class AppendOperator : public rocksdb::MergeOperator {
  public:
-  virtual bool Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const override;
-
-    virtual const char* Name() const override;
+    bool FullMergeV2(const MergeOperationInput& merge_in,
+                     MergeOperationOutput* merge_out) const override;
+    bool PartialMerge(const rocksdb::Slice& key,
+                      const rocksdb::Slice& left_operand,
+                      const rocksdb::Slice& right_operand,
+                      std::string* new_value,
+                      rocksdb::Logger* logger) const override;
+    bool PartialMergeMulti(const rocksdb::Slice& key,
+                           const std::deque<rocksdb::Slice>& operand_list,
+                           std::string* new_value,
+                           rocksdb::Logger* logger) const override;
+    const char* Name() const override;
 };
 
-
 /**
  * Replace merge operator. Acts as if no merge but a normal Put would be done.
  */
@@ -81,95 +102,158 @@ class ReplaceOperator : public rocksdb::AssociativeMergeOperator {
 };
 
 /**
- * List append merge operator. Acts as if no merge but a normal Put would be done.
+ * List append merge operator.
+ * Every operand is appended with a 4-byte size prefix.
+ * Operands are only combined in a full merge: A combined operand
+ * could not be distinguished from a single operand
+ * and would be prefixed again.
  */
-class ListAppendOperator : public rocksdb::AssociativeMergeOperator {
+class ListAppendOperator : public rocksdb::MergeOperator {
  public:
-  virtual bool Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const override;
-
-    virtual const char* Name() const override;
+    bool FullMergeV2(const MergeOperationInput& merge_in,
+                     MergeOperationOutput* merge_out) const override;
+    bool PartialMerge(const rocksdb::Slice& key,
+                      const rocksdb::Slice& left_operand,
+                      const rocksdb::Slice& right_operand,
+                      std::string* new_value,
+                      rocksdb::Logger* logger) const override;
+    bool PartialMergeMulti(const rocksdb::Slice& key,
+                           const std::deque<rocksdb::Slice>& operand_list,
+                           std::string* new_value,
+                           rocksdb::Logger* logger) const override;
+    const char* Name() const override;
 };
 
-class NULAppendOperator : public rocksdb::AssociativeMergeOperator {
+/**
+ * NUL-separated append operator.
+ * Operands are appended to the existing value with a NUL separator
+ * unless the value so far is empty.
+ */
+class NULAppendOperator : public rocksdb::MergeOperator {
  public:
-  virtual bool Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const override;
-
-    virtual const char* Name() const override;
+    bool FullMergeV2(const MergeOperationInput& merge_in,
+                     MergeOperationOutput* merge_out) const override;
+    bool PartialMerge(const rocksdb::Slice& key,
+                      const rocksdb::Slice& left_operand,
+                      const rocksdb::Slice& right_operand,
+                      std::string* new_value,
+                      rocksdb::Logger* logger) const override;
+    bool PartialMergeMulti(const rocksdb::Slice& key,
+                           const std::deque<rocksdb::Slice>& operand_list,
+                           std::string* new_value,
+                           rocksdb::Logger* logger) const override;
+    const char* Name() const override;
 };
 
+/**
+ * NUL-separated set union operator.
+ * The result is sorted and does not contain duplicates,
+ * so it can be merged with the operands without building a set.
+ */
 class NULAppendSetOperator : public rocksdb::MergeOperator {
  public:
-
-    bool FullMerge(const rocksdb::Slice& key,
-                           const rocksdb::Slice* existing_value,
-                           const std::deque<std::string>& operand_list,
+    bool FullMergeV2(const MergeOperationInput& merge_in,
+                     MergeOperationOutput* merge_out) const override;
+    bool PartialMergeMulti(const rocksdb::Slice& key,
+                           const std::deque<rocksdb::Slice>& operand_list,
                            std::string* new_value,
                            rocksdb::Logger* logger) const override;
-  
+    const char* Name() const override;
+};
+
+/**
+ * Posting list operator for inverted indices.
+ * Operands are NUL-separated entity lists (or posting lists from partial merges).
+ * The result is the set union, stored as a compressed posting list (see PostingList.hpp).
+ */
+class PostingsOperator : public rocksdb::MergeOperator {
+ public:
+    bool FullMergeV2(const MergeOperationInput& merge_in,
+                     MergeOperationOutput* merge_out) const override;
     bool PartialMergeMulti(const rocksdb::Slice& key,
-                                   const std::deque<rocksdb::Slice>& operand_list,
-                                   std::string* new_value,
-                                   rocksdb::Logger* logger) const override;
-  
+                           const std::deque<rocksdb::Slice>& operand_list,
+                           std::string* new_value,
+                           rocksdb::Logger* logger) const override;
     const char* Name() const override;
 };
 
+/**
+ * Arbitrary size binary boolean operation.
+ * The result is as long as the longest input. All inputs are
+ * applied to the result in a single pass, using vector instructions.
+ */
+class BitwiseMergeOperator : public rocksdb::MergeOperator {
+ public:
+    explicit BitwiseMergeOperator(BitwiseOperation operation);
+    bool FullMergeV2(const MergeOperationInput& merge_in,
+                     MergeOperationOutput* merge_out) const override;
+    bool PartialMerge(const rocksdb::Slice& key,
+                      const rocksdb::Slice& left_operand,
+                      const rocksdb::Slice& right_operand,
+                      std::string* new_value,
+                      rocksdb::Logger* logger) const override;
+    bool PartialMergeMulti(const rocksdb::Slice& key,
+                           const std::deque<rocksdb::Slice>& operand_list,
+                           std::string* new_value,
+                           rocksdb::Logger* logger) const override;
+ private:
+    BitwiseOperation operation;
+};
+
 /**
  * Arbitrary size binary boolean AND.
  * If existing/new value is shorter, missing bytes are assumed to be 0xFF (i.e. copied)
  */
-class ANDOperator : public rocksdb::AssociativeMergeOperator {
+class ANDOperator : public BitwiseMergeOperator {
  public:
-  virtual bool Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const override;
-
-    virtual const char* Name() const override;
+    ANDOperator();
+    const char* Name() const override;
 };
 
 /**
  * Arbitrary size binary boolean OR.
  * If existing/new value is shorter, missing bytes are assumed to be 0x00 (i.e. copied)
  */
-class OROperator : public rocksdb::AssociativeMergeOperator {
+class OROperator : public BitwiseMergeOperator {
  public:
-  virtual bool Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const override;
-
-    virtual const char* Name() const override;
+    OROperator();
+    const char* Name() const override;
 };
 
 /**
  * Arbitrary size binary boolean XOR.
  * If existing/new value is shorter, missing bytes are assumed to be 0x00 (i.e. copied)
  */
-class XOROperator : public rocksdb::AssociativeMergeOperator {
+class XOROperator : public BitwiseMergeOperator {
  public:
-  virtual bool Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const override;
+    XOROperator();
+    const char* Name() const override;
+};
 
-    virtual const char* Name() const override;
+/**
+ * Boolean operation on compressed bitmaps (see Bitmap.hpp),
+ * so sparse bitmaps don't store large ranges of zero bytes.
+ * Operands may be compressed or raw bitmaps, the result is always compressed.
+ * Corrupt bitmaps (e.g. raw bitmaps without the 0x00 prefix) are logged and ignored.
+ */
+class CompressedBitmapOperator : public rocksdb::MergeOperator {
+ public:
+    CompressedBitmapOperator(BitwiseOperation operation, const char* name);
+    bool FullMergeV2(const MergeOperationInput& merge_in,
+                     MergeOperationOutput* merge_out) const override;
+    bool PartialMerge(const rocksdb::Slice& key,
+                      const rocksdb::Slice& left_operand,
+                      const rocksdb::Slice& right_operand,
+                      std::string* new_value,
+                      rocksdb::Logger* logger) const override;
+    bool PartialMergeMulti(const rocksdb::Slice& key,
+                           const std::deque<rocksdb::Slice>& operand_list,
+                           std::string* new_value,
+                           rocksdb::Logger* logger) const override;
+    const char* Name() const override;
+ private:
+    BitwiseOperation operation;
+    const char* name;
 };
 
 /**
@@ -185,4 +269,10 @@ std::shared_ptr<rocksdb::MergeOperator> createMergeOperator(
  */
 bool isReplaceMergeOperator(const char* mergeOperatorCode);
 
+/**
+ * @return true if the given merge operator name represents
+ *   the POSTINGS operator, i.e. all values are compressed posting lists
+ */
+bool isPostingsMergeOperator(const char* mergeOperatorName);
+
 #endif //__MERGE_OPERATORS_HPP
\ No newline at end of file
@@ -0,0 +1,288 @@
+/*
+ * File:   PostOffice.hpp
+ * Author: uli
+ *
+ * Created on 16. Oktober 2014, 18:02
+ */
+
+#ifndef POSTOFFICE_HPP
+#define	POSTOFFICE_HPP
+#include <thread>
+#include <vector>
+#include <deque>
+#include <string>
+#include <functional>
+#include <chrono>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <zmq.h>
+#include "Logger.hpp"
+
+/**
+ * Lanes used by the read and update worker controllers.
+ * Short requests (point lookups, puts, deletes) never wait for
+ * long-running requests (scans, counts, compactions, range operations).
+ */
+const uint8_t shortRequestLane = 0;
+const uint8_t longRequestLane = 1;
+
+/**
+ * A multipart message that has been received completely.
+ * The frames are owned by the message until they have been sent.
+ */
+typedef std::vector<zmq_msg_t*> BufferedMessage;
+
+/**
+ * The minimum and maximum number of worker threads in a lane
+ */
+struct WorkerPoolSize {
+    unsigned int minWorkers;
+    unsigned int maxWorkers;
+};
+
+/**
+ * Post-office style request scheduler.
+ *
+ * Instead of distributing requests round-robin among the worker threads
+ * (airport-style, where a huge request blocks all requests queued behind it
+ * in the same worker's queue even if other workers are idle),
+ * the post office keeps one queue per lane and hands out a request
+ * only to a worker that has reported to be idle.
+ *
+ * Each lane has its own pool of workers, so long requests
+ * can't delay requests in another lane.
+ *
+ * The pools are resized dynamically: If too many requests are waiting
+ * in a lane, an additional worker is started (up to the maximum pool size).
+ * Workers that have been idle for longer than the idle timeout are stopped
+ * (down to the minimum pool size).
+ *
+ * Internal protocol:
+ *  - Requests are PUSHed to the PULL socket bound to the request endpoint.
+ *    An empty single-frame message stops the post office after all queued
+ *    requests have been processed.
+ *  - Workers connect a DEALER socket to the ROUTER socket bound to the worker endpoint
+ *    using connectWorker() and send a single-frame message containing their lane (1 byte)
+ *    each time they are ready to process a request.
+ *  - Workers receive requests exactly as they were pushed to the post office.
+ *    An empty single-frame message tells a worker to stop.
+ *  - If request groups are enabled, several requests may be dispatched at once.
+ *    They are preceded by a single-frame message containing their number
+ *    (4 bytes). The worker reports ready once for the entire group.
+ *
+ * If sharding is enabled, requests with the same shard key are processed
+ * one after another in the order they have been received, even across lanes:
+ * A request is only dispatched when no earlier request of its shard
+ * is queued or being processed. Requests of other shards overtake blocked ones.
+ */
+class PostOffice {
+public:
+    /**
+     * Determines the lane a request belongs to
+     */
+    typedef std::function<uint8_t (const BufferedMessage&)> LaneClassifier;
+    /**
+     * Determines the group of a request. Consecutive requests in the same lane
+     * with the same non-empty group key may be dispatched to a single worker
+     * at once, e.g. writes to the same table that can be written in one batch.
+     */
+    typedef std::function<std::string (const BufferedMessage&)> GroupClassifier;
+    /**
+     * Determines the shard of a request. Requests with the same non-empty
+     * shard key are processed in order, one at a time.
+     */
+    typedef std::function<std::string (const BufferedMessage&)> ShardClassifier;
+    /**
+     * Starts a new worker thread for the given lane.
+     * The worker must connect to the post office using connectWorker()
+     * with the given worker ID.
+     */
+    typedef std::function<std::thread* (uint8_t lane, uint32_t workerId)> WorkerFactory;
+    /**
+     * Create a new post office and bind its sockets.
+     * The sockets need to be bound synchronously because workers can only connect
+     * to endpoints that have already been bound.
+     * @param poolSizes The minimum and maximum number of worker threads for each lane
+     * @param maxQueuedRequests If this number of requests is queued,
+     *                  the post office stops accepting requests
+     *                  (i.e. the HWM of the request socket applies)
+     * @param scaleUpQueueDepth Start a new worker if this number of requests
+     *                  is waiting in a single lane.
+     * @param idleTimeout Stop workers that have been idle for this number of milliseconds
+     *                  unless the pool has the minimum size. 0 disables shrinking.
+     */
+    PostOffice(void* ctx,
+               const char* requestEndpoint,
+               const char* workerEndpoint,
+               const std::vector<WorkerPoolSize>& poolSizes,
+               LaneClassifier classifier,
+               WorkerFactory workerFactory,
+               size_t maxQueuedRequests,
+               size_t scaleUpQueueDepth,
+               uint64_t idleTimeout,
+               const std::string& name);
+    ~PostOffice();
+    /**
+     * Enable request groups. Must be called before start().
+     * @param maxGroupBytes The maximum total frame size of a group.
+     *                  Larger requests are dispatched alone.
+     * @param maxGroupDelay If a groupable request arrives while a worker is idle,
+     *                  wait up to this time for further requests of the group.
+     *                  0 dispatches immediately, i.e. groups are only formed
+     *                  from requests that had to wait for a worker anyway.
+     */
+    void enableRequestGroups(GroupClassifier groupClassifier,
+                             size_t maxGroupBytes,
+                             std::chrono::milliseconds maxGroupDelay);
+    /**
+     * Enable ordered processing of requests by shard. Must be called before start().
+     */
+    void enableSharding(ShardClassifier shardClassifier);
+    /**
+     * Start the post office thread which starts the worker threads
+     */
+    void start();
+    /**
+     * Wait for the post office thread and all worker threads to exit.
+     * The stop message needs to be sent to the request endpoint first.
+     */
+    void join();
+    /**
+     * Set the identity of a worker's DEALER socket and connect it
+     * to the worker endpoint.
+     * Shall be called from the worker thread.
+     * @return The zmq_connect() return code
+     */
+    static int connectWorker(void* socket, const char* workerEndpoint, uint32_t workerId);
+    /**
+     * Tell the post office a worker is ready to process the next request.
+     * Shall be called from the worker thread.
+     * @param socket The DEALER socket connected to the worker endpoint
+     */
+    static void reportReady(void* socket, uint8_t lane, Logger& logger);
+    /**
+     * Receive all frames of a message
+     * @return false if receiving any frame failed
+     */
+    static bool receiveMessage(void* socket, BufferedMessage& msg, Logger& logger);
+    /**
+     * Close and free all frames of a message
+     */
+    static void closeMessage(BufferedMessage& msg);
+private:
+    typedef std::chrono::steady_clock Clock;
+    struct IdleWorker {
+        std::string identity;
+        Clock::time_point idleSince;
+    };
+    struct QueuedRequest {
+        BufferedMessage msg;
+        std::string groupKey; //Empty --> Not groupable
+        size_t size; //Total frame size, only computed for groupable requests
+        std::string shardKey; //Empty --> Not sharded
+        uint64_t sequence; //Reception order, used to order the requests of a shard
+    };
+    void run();
+    /**
+     * Receive a ready message from a worker and dispatch
+     * a queued request to it, if any.
+     */
+    void handleWorkerMessage();
+    /**
+     * Receive a request and dispatch it to an idle worker or queue it.
+     * @return false if the stop message has been received
+     */
+    bool handleRequest();
+    /**
+     * Send a request to a worker and free the buffered frames
+     */
+    void dispatch(const std::string& worker, BufferedMessage& msg);
+    /**
+     * Dispatch queued requests to idle workers, grouped if possible.
+     * Incomplete groups are held back until their deadline.
+     */
+    void dispatchQueuedRequests(uint8_t lane);
+    /**
+     * Check if no earlier request of the shard of a request
+     * is queued or being processed.
+     * @param position The number of requests of the same shard that precede
+     *        the request in the group being formed
+     */
+    bool isShardReady(const QueuedRequest& request, size_t position = 0) const;
+    /**
+     * Find the first queued request in a lane that can be dispatched.
+     * @return The queue index or the queue size if all requests are blocked by their shard
+     */
+    size_t findDispatchableRequest(uint8_t lane) const;
+    /**
+     * Determine the number of requests starting at the given queue index
+     * that can be dispatched as a group.
+     * @param complete Set to false if further requests could join the group
+     */
+    size_t getGroupSize(uint8_t lane, size_t start, bool& complete) const;
+    /**
+     * Mark the shards a worker has been processing as idle.
+     * @return true if any shard has been released
+     */
+    bool releaseShards(const std::string& worker);
+    /**
+     * Compute the poll timeout, taking the group deadlines into account
+     */
+    long getPollTimeout(long defaultTimeout) const;
+    /**
+     * Start a new worker thread in the given lane
+     */
+    void startWorker(uint8_t lane);
+    /**
+     * Send a stop message to an idle worker and wait for it to exit
+     */
+    void stopWorker(uint8_t lane, const std::string& worker);
+    /**
+     * If stopping and there is no work left for the idle workers
+     * in the given lane, stop them.
+     */
+    void stopIdleWorkers(uint8_t lane);
+    /**
+     * Stop workers that have been idle for longer than the idle timeout,
+     * unless the pool would shrink below its minimum size.
+     */
+    void shrinkPools();
+    void* requestSocket; //PULL
+    void* workerSocket; //ROUTER
+    std::vector<WorkerPoolSize> poolSizes;
+    LaneClassifier classifier;
+    WorkerFactory workerFactory;
+    size_t maxQueuedRequests;
+    size_t scaleUpQueueDepth;
+    std::chrono::milliseconds idleTimeout;
+    size_t queuedRequests;
+    std::vector<std::deque<QueuedRequest> > queues; //One per lane
+    GroupClassifier groupClassifier; //Empty --> groups disabled
+    size_t maxGroupBytes;
+    std::chrono::milliseconds maxGroupDelay;
+    //Dispatch deadline of the held back group at the front of each queue (max --> none)
+    std::vector<Clock::time_point> groupDeadlines;
+    ShardClassifier shardClassifier; //Empty --> sharding disabled
+    uint64_t nextSequence;
+    //Sequence numbers of the queued requests of each shard, in reception order
+    std::unordered_map<std::string, std::deque<uint64_t> > queuedShardRequests;
+    std::set<std::string> busyShards; //Shards being processed by a worker
+    std::map<std::string, std::vector<std::string> > workerShards; //Identity --> busy shards
+    /**
+     * Idle workers for each lane, the worker that has been idle the longest
+     * time at the front. Requests are dispatched to the back so that surplus
+     * workers stay idle and can be stopped.
+     */
+    std::vector<std::deque<IdleWorker> > idleWorkers;
+    std::vector<unsigned int> numWorkers; //Running workers per lane
+    std::vector<unsigned int> numStartingWorkers; //Workers per lane that have not reported yet
+    std::map<std::string, std::thread*> workerThreads; //Identity --> thread
+    std::set<std::string> startingWorkers; //Identities that have not reported yet
+    uint32_t nextWorkerId;
+    bool stopping;
+    std::thread* thread;
+    Logger logger;
+};
+
+#endif	/* POSTOFFICE_HPP */
@@ -0,0 +1,188 @@
+#ifndef __POSTING_LIST_HPP
+#define __POSTING_LIST_HPP
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <rocksdb/slice.h>
+
+/**
+ * Compressed posting lists, i.e. sorted sets of entity IDs
+ * as stored by the POSTINGS merge operator. See doc/inverted-index.md.
+ *
+ * The entries are split into blocks of postingBlockSize entries.
+ * Within a block, each entry only stores the suffix that differs
+ * from the previous entry (front coding). The first entry of each block
+ * is stored in full in the skip index at the beginning of the value,
+ * so a reader can skip to the block that contains a given entry
+ * without decoding the blocks before it.
+ *
+ * Format (all integers are unsigned LEB128 varints):
+ *  - [0x00][0x01 format version]
+ *  - Number of entries, number of blocks
+ *  - For each block: Offset of the block in the data section, first entry length, first entry
+ *  - Data section: For each entry except the first of its block:
+ *      Length of the prefix shared with the previous entry, suffix length, suffix
+ *
+ * A plain NUL-separated list starting with an empty entity ID also starts with
+ * the marker, so a value is only a posting list if it can be decoded completely.
+ */
+static const size_t postingBlockSize = 64;
+
+/**
+ * @return true if the value starts with the posting list marker.
+ *    Use decodeEntityList() to check if it actually is a posting list.
+ */
+static inline bool isPostingList(const rocksdb::Slice& value) {
+    return value.size() >= 2 && value[0] == '\x00' && value[1] == '\x01';
+}
+
+/**
+ * Builds a posting list from entries added in strictly ascending order.
+ */
+class PostingListWriter {
+public:
+    PostingListWriter();
+    /**
+     * Add an entry. It must be larger than the previous entry.
+     */
+    void add(const rocksdb::Slice& entry);
+    /**
+     * Serialize the posting list into dst (replacing its content)
+     * and reset the writer.
+     */
+    void finish(std::string& dst);
+    uint64_t size() const {
+        return count;
+    }
+private:
+    std::string index;
+    std::string data;
+    std::string previous;
+    uint64_t count;
+    uint64_t blockCount;
+};
+
+/**
+ * Encode a plain NUL-separated entity list (in any order, possibly
+ * containing duplicates) as a posting list. Empty entity IDs are dropped.
+ */
+void encodeEntityList(const rocksdb::Slice& entityList, std::string& dst);
+
+/**
+ * Decode a posting list into a sorted NUL-separated entity list (replacing the content of dst).
+ * @return false if the value is not a valid posting list. dst is undefined in that case.
+ */
+bool decodeEntityList(const rocksdb::Slice& value, std::string& dst);
+
+/**
+ * Forward iterator over a compressed posting list.
+ * The data must stay valid while the reader is used.
+ */
+class PostingListReader {
+public:
+    PostingListReader();
+    /**
+     * Parse the header and skip index and position the reader at the first entry.
+     * @return false if the value is not a valid posting list
+     */
+    bool open(const rocksdb::Slice& value);
+    /**
+     * @return The total number of entries in the list
+     */
+    uint64_t size() const {
+        return count;
+    }
+    /**
+     * @return false if the end of the list has been reached (or the list is corrupt)
+     */
+    bool valid() const {
+        return isValid;
+    }
+    /**
+     * @return The entry at the current position. Only valid until the reader is moved.
+     */
+    rocksdb::Slice current() const {
+        return rocksdb::Slice(currentEntry);
+    }
+    void next();
+    /**
+     * Move forward to the first entry that is >= target.
+     * Blocks that can not contain the target are skipped without being decoded.
+     */
+    void seek(const rocksdb::Slice& target);
+    /**
+     * @return true if decoding failed because the data is corrupt
+     */
+    bool isCorrupted() const {
+        return corrupted;
+    }
+private:
+    struct Block {
+        rocksdb::Slice firstEntry;
+        uint64_t offset;
+    };
+    /**
+     * Position the reader at the first entry of the given block
+     */
+    void loadBlock(size_t block);
+    void setCorrupted();
+    std::vector<Block> blocks;
+    const char* dataStart;
+    const char* dataEnd;
+    const char* position; //Next entry in the data section
+    uint64_t count;
+    size_t currentBlock;
+    size_t remainingInBlock; //Entries after the current one in the current block
+    std::string currentEntry;
+    bool isValid;
+    bool corrupted;
+};
+
+/**
+ * Compute the intersection of posting lists using a leapfrog join:
+ * The lists are alternately advanced to the largest current entry,
+ * which skips entire blocks of long lists when the shortest list is sparse.
+ *
+ * @param lists The lists to intersect, at least one. The readers are advanced.
+ * @param limit The maximum number of entries to emit
+ * @param visitor Called with each entry of the intersection in ascending order.
+ *        Returns false to abort.
+ * @return false if the visitor aborted the intersection
+ */
+template<typename Visitor>
+bool intersectPostingLists(std::vector<PostingListReader*>& lists, uint64_t limit, Visitor& visitor) {
+    if (lists.empty() || limit == 0) {
+        return true;
+    }
+    PostingListReader* first = lists[0];
+    std::string candidate;
+    uint64_t emitted = 0;
+    while (first->valid()) {
+        candidate.assign(first->current().data(), first->current().size());
+        bool matched = true;
+        for (size_t i = 1; i < lists.size(); i++) {
+            lists[i]->seek(candidate);
+            if (!lists[i]->valid()) {
+                return true;
+            }
+            if (lists[i]->current() != rocksdb::Slice(candidate)) {
+                //Continue with the larger entry
+                first->seek(lists[i]->current());
+                matched = false;
+                break;
+            }
+        }
+        if (matched) {
+            if (!visitor(rocksdb::Slice(candidate))) {
+                return false;
+            }
+            if (++emitted >= limit) {
+                return true;
+            }
+            first->next();
+        }
+    }
+    return true;
+}
+
+#endif //__POSTING_LIST_HPP
@@ -0,0 +1,71 @@
+#ifndef __RANGE_SPLIT_HPP
+#define __RANGE_SPLIT_HPP
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * A part of a table whose data size is known,
+ * e.g. a SST file
+ */
+struct KeyRangeWeight {
+    std::string smallestKey;
+    std::string largestKey;
+    uint64_t size;
+};
+
+/**
+ * Compute split keys that divide the key range [rangeStart, rangeEnd)
+ * into at most numPartitions partitions of approximately equal data size.
+ *
+ * The data size of each part is attributed to its smallest key,
+ * so the result is only an approximation if parts overlap
+ * (e.g. files on different LSM levels).
+ *
+ * @param parts The parts of the table, in any order
+ * @param rangeStart The first key of the range or empty (--> no limit)
+ * @param rangeEnd The key after the range or empty (--> no limit)
+ * @return Ascending, distinct split keys with rangeStart < key < rangeEnd.
+ *         Partition i is [key[i-1], key[i]). Contains less than numPartitions - 1
+ *         keys if there are not enough parts to split at.
+ */
+inline std::vector<std::string> computeSplitKeys(const std::vector<KeyRangeWeight>& parts,
+        const std::string& rangeStart,
+        const std::string& rangeEnd,
+        unsigned int numPartitions) {
+    std::vector<std::string> splitKeys;
+    if (numPartitions <= 1) {
+        return splitKeys;
+    }
+    bool haveRangeEnd = !rangeEnd.empty();
+    //Collect the split candidates inside the range
+    std::vector<std::pair<std::string, uint64_t> > candidates;
+    uint64_t totalSize = 0;
+    for (const KeyRangeWeight& part : parts) {
+        if (part.largestKey < rangeStart
+                || (haveRangeEnd && part.smallestKey >= rangeEnd)) {
+            continue;
+        }
+        candidates.emplace_back(std::max(part.smallestKey, rangeStart), part.size);
+        totalSize += part.size;
+    }
+    std::sort(candidates.begin(), candidates.end());
+    //Split at the first candidate after each 1/n-th of the total size
+    uint64_t partitionSize = totalSize / numPartitions;
+    uint64_t accumulatedSize = 0;
+    unsigned int nextPartition = 1;
+    for (size_t i = 0; i < candidates.size() && nextPartition < numPartitions; i++) {
+        const std::string& key = candidates[i].first;
+        if (accumulatedSize >= partitionSize * nextPartition
+                && key > candidates.front().first //Never yield an empty first partition
+                && (splitKeys.empty() || key > splitKeys.back())) {
+            splitKeys.push_back(key);
+            nextPartition++;
+        }
+        accumulatedSize += candidates[i].second;
+    }
+    return splitKeys;
+}
+
+#endif //__RANGE_SPLIT_HPP
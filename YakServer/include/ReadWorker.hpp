@@ -8,10 +8,12 @@
 #ifndef READWORKER_HPP
 #define	READWORKER_HPP
 #include <thread>
+#include <vector>
 #include <zmq.h>
-#include "BoyerMoore.hpp"
+#include "ScanEngine.hpp"
 #include "Tablespace.hpp"
 #include "AbstractFrameProcessor.hpp"
+#include "PostOffice.hpp"
 
 class ReadWorkerController {
 public:
@@ -25,15 +27,14 @@ public:
     void start();
     void* workerPushSocket; //inproc PUSH socket to communicate to the workers
     /**
-     * Gracefully terminates all update worker threads by sending them stop messages.
+     * Gracefully terminates all read worker threads by sending them stop messages.
      */
     void terminateAll();
 private:
-    std::thread** threads;
     Tablespace& tablespace;
-    size_t numThreads; //size of this->threads
     void* context;
     ConfigParser& cfg;
+    PostOffice postOffice;
 };
 
 /**
@@ -44,20 +45,73 @@ private:
  */
 class ReadWorker : private AbstractFrameProcessor {
 public:
+    /**
+     * @param workerId The ID assigned by the post office
+     */
     ReadWorker(void* ctx, Tablespace& tablespace,
-               ConfigParser& cfg);
+               ConfigParser& cfg, uint32_t workerId);
     ~ReadWorker();
     bool processNextRequest();
+    /**
+     * Tell the post office this worker is ready to process the next request
+     */
+    void reportReady(uint8_t lane);
 private:
     Tablespace& tablespace;
     TableOpenHelper tableOpenHelper;
     ConfigParser& cfg;
+    /**
+     * Buffers for batched point lookups, allocated once per worker.
+     * Each has cfg.readBatchSize entries.
+     */
+    std::vector<zmq_msg_t> keyFrames;
+    std::vector<rocksdb::Slice> sortedKeys;
+    std::vector<rocksdb::PinnableSlice> values;
+    std::vector<rocksdb::Status> statuses;
+    //sortedKeys[i] is the key from keyFrames[keyOrder[i]]
+    std::vector<uint32_t> keyOrder;
+    //Inverse of keyOrder: Index in sortedKeys for each key in request order
+    std::vector<uint32_t> sortedPosition;
+    bool* keyExists;
+    /**
+     * Receive up to cfg.readBatchSize key frames of the current request into keyFrames.
+     * @return The number of keys received or -1 if an error occured (already handled)
+     */
+    ssize_t receiveKeyBatch(const char* frameDesc);
+    /**
+     * Close the first numKeys frames of keyFrames
+     */
+    void closeKeyBatch(size_t numKeys);
+    /**
+     * Sort the first numKeys indices in keyOrder by the key they reference
+     * and fill sortedKeys accordingly so they can be looked up using MultiGet.
+     */
+    void sortKeyBatch(size_t numKeys);
+    /**
+     * Receive and compile the optional predicate frame
+     * of a scan or list request, if there is any.
+     * @return false if the predicate is invalid (error response has been sent)
+     */
+    bool receivePredicate(ScanPredicate& predicate);
     void handleExistsRequest(zmq_msg_t* headerFrame);
     void handleReadRequest(zmq_msg_t* headerFrame);
     void handleScanRequest(zmq_msg_t* headerFrame);
     void handleListRequest(zmq_msg_t* headerFrame);
+    /**
+     * Common implementation of scan and list requests
+     * @param emitValues true for scan requests, false for list requests
+     */
+    void processScanRequest(zmq_msg_t* headerFrame, bool emitValues);
+    /**
+     * Iterate over the range and send the response for a scan or list request
+     * @return false if an error occured (already handled)
+     */
+    template<bool EmitValues>
+    bool sendScanResponse(rocksdb::Iterator* it, const ScanRange& range,
+                          ScanFilter& filter, const char* ackResponse);
     void handleLimitedScanRequest(zmq_msg_t* headerFrame);
     void handleCountRequest(zmq_msg_t* headerFrame);
+    void handleIntersectRequest(zmq_msg_t* headerFrame);
     void handleTableInfoRequest(zmq_msg_t* headerFrame);
 };
 
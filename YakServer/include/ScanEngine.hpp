@@ -0,0 +1,198 @@
+#ifndef __SCAN_ENGINE_HPP
+#define __SCAN_ENGINE_HPP
+#include <cstdint>
+#include <string>
+#include <limits>
+#include <memory>
+#include <rocksdb/slice.h>
+#include <rocksdb/db.h>
+#include "SubstringSearch.hpp"
+#include "ScanPredicate.hpp"
+
+/**
+ * Parameters of a range iteration
+ */
+struct ScanRange {
+    ScanRange() : inverted(false),
+                  limit(std::numeric_limits<uint64_t>::max()),
+                  skip(0) {
+    }
+    std::string start; //Empty --> start of table (end of table if inverted)
+    std::string end; //Exclusive. Empty --> no limit
+    bool inverted; //true --> iterate from the end to the start
+    uint64_t limit; //Maximum number of matching records (including skipped ones)
+    uint64_t skip; //Number of matching records to skip
+};
+
+/**
+ * Record filter combining the scan key/value substring filters
+ * and the predicate program.
+ */
+class ScanFilter {
+public:
+    ScanFilter(const std::string& keyFilterStr, const std::string& valueFilterStr)
+        : haveKeyFilter(!keyFilterStr.empty()),
+          haveValueFilter(!valueFilterStr.empty()),
+          keyFilter(keyFilterStr),
+          valueFilter(valueFilterStr) {
+    }
+    /**
+     * @return true if every record matches
+     */
+    bool isEmpty() const {
+        return !haveKeyFilter && !haveValueFilter && predicate.isEmpty();
+    }
+    bool matches(const rocksdb::Slice& key, const rocksdb::Slice& value) {
+        return (!haveKeyFilter || keyFilter.find(key.data(), key.size()) != -1)
+            && (!haveValueFilter || valueFilter.find(value.data(), value.size()) != -1)
+            && predicate.matches(key.data(), key.size(), value.data(), value.size());
+    }
+    ScanPredicate predicate;
+private:
+    bool haveKeyFilter;
+    bool haveValueFilter;
+    SubstringSearcher keyFilter;
+    SubstringSearcher valueFilter;
+};
+
+/**
+ * Filter used for range iterations without any filter
+ */
+struct NoScanFilter {
+    bool isEmpty() const {
+        return true;
+    }
+    bool matches(const rocksdb::Slice& key, const rocksdb::Slice& value) {
+        return true;
+    }
+};
+
+/**
+ * The inner iteration loop, specialized at compile time so the loop body
+ * does not contain any branches for features that are not used.
+ *
+ * The visitor is called as visitor(key, value) for each matching,
+ * non-skipped record and returns false to abort the iteration.
+ * If EmitValues is false, the value is not read from the iterator
+ * unless the filter needs it and the visitor receives an empty value.
+ *
+ * @return false if the visitor aborted the iteration
+ */
+template<bool Inverted, bool HasEnd, bool HasFilter, bool EmitValues,
+         typename Iterator, typename Filter, typename Visitor>
+inline bool scanLoop(Iterator* it, const rocksdb::Slice& rangeEnd,
+                     uint64_t limit, uint64_t skip,
+                     Filter& filter, Visitor& visitor) {
+    for (; limit > 0 && it->Valid(); (Inverted ? it->Prev() : it->Next())) {
+        rocksdb::Slice key = it->key();
+        //Check if we have to stop here
+        if (HasEnd) {
+            int compareResult = key.compare(rangeEnd);
+            if (Inverted ? (compareResult <= 0) : (compareResult >= 0)) {
+                break;
+            }
+        }
+        rocksdb::Slice value;
+        if (EmitValues || HasFilter) {
+            value = it->value();
+        }
+        if (HasFilter && !filter.matches(key, value)) {
+            continue; //Does not count against the limit
+        }
+        limit--;
+        if (skip > 0) {
+            skip--;
+            continue;
+        }
+        if (!visitor(key, EmitValues ? value : rocksdb::Slice())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Position the iterator at the first record of the range
+ */
+template<typename Iterator>
+inline void seekToRangeStart(Iterator* it, const ScanRange& range) {
+    if (!range.start.empty()) {
+        it->Seek(range.start);
+    } else if (range.inverted) {
+        it->SeekToLast();
+    } else {
+        it->SeekToFirst();
+    }
+}
+
+/**
+ * Iterate over a range, calling the visitor for each matching record.
+ * Selects the specialized loop for the given range and filter once.
+ * The iterator is positioned at the range start by this function.
+ *
+ * Used by all range-based requests (scan, list, count, delete range, copy range).
+ *
+ * @return false if the visitor aborted the iteration.
+ *         The iterator status must be checked by the caller.
+ */
+template<bool EmitValues, typename Iterator, typename Filter, typename Visitor>
+bool scanRange(Iterator* it, const ScanRange& range, Filter& filter, Visitor& visitor) {
+    seekToRangeStart(it, range);
+    const rocksdb::Slice rangeEnd(range.end);
+    bool hasEnd = !range.end.empty();
+    bool hasFilter = !filter.isEmpty();
+    if (range.inverted) {
+        if (hasEnd) {
+            return hasFilter
+                ? scanLoop<true, true, true, EmitValues>(it, rangeEnd, range.limit, range.skip, filter, visitor)
+                : scanLoop<true, true, false, EmitValues>(it, rangeEnd, range.limit, range.skip, filter, visitor);
+        } else {
+            return hasFilter
+                ? scanLoop<true, false, true, EmitValues>(it, rangeEnd, range.limit, range.skip, filter, visitor)
+                : scanLoop<true, false, false, EmitValues>(it, rangeEnd, range.limit, range.skip, filter, visitor);
+        }
+    } else {
+        if (hasEnd) {
+            return hasFilter
+                ? scanLoop<false, true, true, EmitValues>(it, rangeEnd, range.limit, range.skip, filter, visitor)
+                : scanLoop<false, true, false, EmitValues>(it, rangeEnd, range.limit, range.skip, filter, visitor);
+        } else {
+            return hasFilter
+                ? scanLoop<false, false, true, EmitValues>(it, rangeEnd, range.limit, range.skip, filter, visitor)
+                : scanLoop<false, false, false, EmitValues>(it, rangeEnd, range.limit, range.skip, filter, visitor);
+        }
+    }
+}
+
+/**
+ * Iterate over a range without filtering
+ */
+template<bool EmitValues, typename Iterator, typename Visitor>
+bool scanRange(Iterator* it, const ScanRange& range, Visitor& visitor) {
+    NoScanFilter filter;
+    return scanRange<EmitValues>(it, range, filter, visitor);
+}
+
+/**
+ * Get an explicit (exclusive) end key for a range,
+ * for RocksDB functions that don't support an open range end.
+ * @param rangeEnd Set to the end key of the range. If the range is open,
+ *        this is the smallest key after the last key of the table
+ *        or empty if the table is empty.
+ */
+inline rocksdb::Status getExplicitRangeEnd(rocksdb::DB* db, const ScanRange& range,
+                                           std::string& rangeEnd) {
+    rangeEnd = range.end;
+    if (!rangeEnd.empty()) {
+        return rocksdb::Status::OK();
+    }
+    std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(rocksdb::ReadOptions()));
+    it->SeekToLast();
+    if (it->Valid()) {
+        rangeEnd = it->key().ToString();
+        rangeEnd.push_back('\0');
+    }
+    return it->status();
+}
+
+#endif //__SCAN_ENGINE_HPP
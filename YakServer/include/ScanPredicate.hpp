@@ -0,0 +1,78 @@
+#ifndef __SCAN_PREDICATE_HPP
+#define __SCAN_PREDICATE_HPP
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <re2/re2.h>
+#include "SubstringSearch.hpp"
+#include "AhoCorasick.hpp"
+
+/**
+ * Opcodes of the scan predicate program, see external-protocol.md.
+ * For the matching opcodes, the PredicateTargetValue bit selects
+ * whether the value or the key is matched.
+ */
+enum class PredicateOpcode : uint8_t {
+    Prefix = 0x01,
+    Suffix = 0x02,
+    Contains = 0x03,
+    EqualsAt = 0x04,
+    Regex = 0x05,
+    ContainsAny = 0x06,
+    ContainsAll = 0x07,
+    Not = 0x10,
+    And = 0x11,
+    Or = 0x12
+};
+
+const uint8_t PredicateTargetValue = 0x80;
+
+/**
+ * A compiled predicate to filter scanned records in the worker,
+ * so only matching records are sent to the client.
+ *
+ * The predicate is sent as a program in reverse polish notation
+ * and compiled into an expression tree that is evaluated with short-circuiting.
+ */
+class ScanPredicate {
+public:
+    ScanPredicate();
+    /**
+     * Compile a predicate program.
+     * @param errorMessage Set to a description of the error if the program is invalid
+     * @return false if the program is invalid
+     */
+    bool compile(const char* program, size_t length, std::string& errorMessage);
+    /**
+     * @return true if no predicate has been compiled (--> everything matches)
+     */
+    bool isEmpty() const {
+        return nodes.empty();
+    }
+    /**
+     * Evaluate the predicate for a single record
+     */
+    bool matches(const char* key, size_t keySize, const char* value, size_t valueSize) {
+        return isEmpty() || evaluate(root, key, keySize, value, valueSize);
+    }
+private:
+    struct Node {
+        PredicateOpcode opcode;
+        bool targetValue;
+        uint32_t left; //Operand of NOT, AND, OR
+        uint32_t right; //Second operand of AND, OR
+        uint64_t offset; //EqualsAt only
+        std::string pattern;
+        uint32_t matcher; //Index in the searcher, regex or automaton vector
+    };
+    bool evaluate(uint32_t nodeIndex, const char* key, size_t keySize,
+                  const char* value, size_t valueSize);
+    std::vector<Node> nodes;
+    uint32_t root;
+    std::vector<std::unique_ptr<SubstringSearcher> > searchers;
+    std::vector<std::unique_ptr<RE2> > regexes;
+    std::vector<std::unique_ptr<AhoCorasickAutomaton> > automata;
+};
+
+#endif //__SCAN_PREDICATE_HPP
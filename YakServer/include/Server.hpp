@@ -14,6 +14,7 @@
 #include "Logger.hpp"
 #include "TableOpenServer.hpp"
 #include "LogServer.hpp"
+#include "WatchDistributor.hpp"
 
 class KeyValueServer {
 public:
@@ -33,6 +34,7 @@ public:
     void* externalPullSocket; //PULL socket for UPDATE load balancinge
     void* responseProxySocket; //Worker threads connect to this PULL socket -- messages need to contain envelopes and area automatically proxied to the main router socket
     TableOpenServer tableOpenServer;
+    WatchDistributor watchDistributor; //Must be started before the update workers
     UpdateWorkerController updateWorkerController;
     ReadWorkerController readWorkerController;
     AsyncJobRouterController asyncJobRouterController;
@@ -40,7 +42,16 @@ public:
     ConfigParser& configParser;
 private:
     void handleRequestResponse();
-    void handlePushPull();
+    /**
+     * Handle an update request without response envelope,
+     * received from the PULL or SUB socket
+     */
+    void handlePushPull(void* sock);
+    /**
+     * Receive the topic frame of a message from the SUB socket
+     * and process the update request following it.
+     */
+    void handleSubscription();
 };
 
 
@@ -0,0 +1,110 @@
+#ifndef __SORTED_RUN_HPP
+#define __SORTED_RUN_HPP
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <rocksdb/slice.h>
+
+/**
+ * A buffer of key/value records that can be sorted by key,
+ * used to write unsorted input into SST files.
+ *
+ * All keys and values are stored in a single string,
+ * so the buffer does not need any allocations once it has been used.
+ */
+class SortedRun {
+public:
+    void add(const rocksdb::Slice& key, const rocksdb::Slice& value) {
+        records.push_back({data.size(), (uint32_t) key.size(), (uint32_t) value.size()});
+        data.append(key.data(), key.size());
+        data.append(value.data(), value.size());
+    }
+    /**
+     * @return The number of bytes occupied by the keys and values
+     */
+    size_t getDataSize() const {
+        return data.size();
+    }
+    bool isEmpty() const {
+        return records.empty();
+    }
+    void clear() {
+        data.clear();
+        records.clear();
+    }
+    /**
+     * Sort the records by key.
+     * Records with equal keys stay in the order they were added.
+     * @param keepDuplicates If this is false, only the last record added
+     *        is kept for any key
+     */
+    void sort(bool keepDuplicates) {
+        std::stable_sort(records.begin(), records.end(),
+            [this](const Record& a, const Record& b) {
+                return getKey(a).compare(getKey(b)) < 0;
+            });
+        if (keepDuplicates || records.empty()) {
+            return;
+        }
+        size_t out = 0;
+        for (size_t i = 0; i + 1 < records.size(); i++) {
+            if (getKey(records[i]) != getKey(records[i + 1])) {
+                records[out++] = records[i];
+            }
+        }
+        records[out++] = records.back();
+        records.resize(out);
+    }
+    /**
+     * Call visitor(key, value) for each record until it returns false.
+     * @return false if the visitor aborted the iteration
+     */
+    template<typename Visitor>
+    bool forEach(Visitor& visitor) const {
+        for (const Record& record : records) {
+            if (!visitor(getKey(record), getValue(record))) {
+                return false;
+            }
+        }
+        return true;
+    }
+    /**
+     * Call visitor(key, values) for each distinct key until it returns false.
+     * values contains the values of all records with the key in sorted order,
+     * i.e. in the order they were added if the run has been sorted with duplicates.
+     * @return false if the visitor aborted the iteration
+     */
+    template<typename Visitor>
+    bool forEachKey(Visitor& visitor) const {
+        std::deque<rocksdb::Slice> values;
+        for (size_t i = 0; i < records.size();) {
+            rocksdb::Slice key = getKey(records[i]);
+            values.clear();
+            for (; i < records.size() && getKey(records[i]) == key; i++) {
+                values.push_back(getValue(records[i]));
+            }
+            if (!visitor(key, values)) {
+                return false;
+            }
+        }
+        return true;
+    }
+private:
+    struct Record {
+        size_t offset;
+        uint32_t keySize;
+        uint32_t valueSize;
+    };
+    rocksdb::Slice getKey(const Record& record) const {
+        return rocksdb::Slice(data.data() + record.offset, record.keySize);
+    }
+    rocksdb::Slice getValue(const Record& record) const {
+        return rocksdb::Slice(data.data() + record.offset + record.keySize, record.valueSize);
+    }
+    std::string data;
+    std::vector<Record> records;
+};
+
+#endif //__SORTED_RUN_HPP
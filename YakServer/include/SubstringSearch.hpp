@@ -0,0 +1,64 @@
+#ifndef __SUBSTRING_SEARCH_HPP
+#define __SUBSTRING_SEARCH_HPP
+
+#include <cstdint>
+#include <string>
+#include "BoyerMoore.hpp"
+
+/**
+ * Substring searcher used for scan key/value filters.
+ *
+ * On x86 CPUs, candidate positions are found using SIMD comparisons
+ * of the first and the last pattern byte for 16 (SSE2) or 32 (AVX2)
+ * positions at once. Only the candidates are compared completely.
+ * The implementation is selected at runtime based on the CPU features,
+ * so the server binary does not need to be compiled for a specific CPU.
+ * On other CPUs, Boyer-Moore-Horspool is used.
+ *
+ * Offsets are 64 bits wide, so corpora larger than 2 GiB are supported.
+ */
+class SubstringSearcher {
+public:
+    enum class Implementation : uint8_t {
+        Auto = 0, //Select the fastest implementation supported by the CPU
+        BoyerMooreHorspool = 1,
+        SSE2 = 2,
+        AVX2 = 3
+    };
+    /**
+     * Initialize a new searcher.
+     * The pattern is copied.
+     * @param implementation The implementation to use. If the CPU does not support
+     *        the given implementation, the fastest supported one is used.
+     */
+    SubstringSearcher(const std::string& pattern,
+                      Implementation implementation = Implementation::Auto);
+    SubstringSearcher(const SubstringSearcher& other) = delete;
+    /**
+     * Find an occurrence of the pattern in a given corpus
+     * @return The offset of the first occurrence or -1 if the pattern
+     *         does not occur in the corpus (or the pattern is empty)
+     */
+    int64_t find(const char* corpus, size_t corpusLength) const;
+    int64_t find(const std::string& corpus) const;
+    /**
+     * @return The implementation used by this instance
+     */
+    Implementation getImplementation() const {
+        return implementation;
+    }
+    /**
+     * Check if the current CPU supports the given implementation
+     */
+    static bool isSupported(Implementation implementation);
+    /**
+     * @return The fastest implementation supported by the current CPU
+     */
+    static Implementation getFastestImplementation();
+private:
+    std::string pattern;
+    Implementation implementation;
+    BoyerMooreHorspoolSearcher bmhSearcher; //References pattern
+};
+
+#endif //__SUBSTRING_SEARCH_HPP
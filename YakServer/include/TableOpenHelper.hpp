@@ -12,6 +12,7 @@
 #include <zmq.h>
 #include <thread>
 #include <rocksdb/db.h>
+#include <rocksdb/cache.h>
 #include <vector>
 #include "Logger.hpp"
 #include "ConfigParser.hpp"
@@ -25,7 +26,8 @@ enum class TableOperationRequestType : uint8_t {
     StopServer = 0,
     OpenTable = 1,
     CloseTable = 2,
-    TruncateTable = 3
+    TruncateTable = 3,
+    MoveTable = 4
 };
 
 
@@ -37,12 +39,22 @@ int sendTableOperationRequest(void* socket, TableOperationRequestType requestTyp
 class Tablespace;
 
 struct TableOpenParameters  {
-    uint64_t lruCacheSize;
+    /**
+     * Size of a block cache only used by this table.
+     * 0 means the table uses the block cache shared by all tables.
+     */
+    uint64_t dedicatedCacheSize;
     uint64_t tableBlockSize;
     uint64_t writeBufferSize;
     uint64_t bloomFilterBitsPerKey;
     rocksdb::CompressionType compression;
     std::string mergeOperatorCode;
+    /**
+     * Length of the key prefixes whose keys are counted individually
+     * by the update workers (0 --> only count the total number of keys).
+     * -1 disables the key counters.
+     */
+    int64_t keyCounterPrefixLength;
 
     /**
      * Return code of the getOptions() function
@@ -72,9 +84,11 @@ struct TableOpenParameters  {
     /**
      * Convert the current instance to a rocksdb optionset
      * @param options In this reference the values are stored.
+     * @param sharedCache The block cache to use unless a dedicated cache is configured.
      * @return One of the status codes defined in GetOptionsResult
      */
-    GetOptionsResult getOptions(rocksdb::Options& options);
+    GetOptionsResult getOptions(rocksdb::Options& options,
+                                const std::shared_ptr<rocksdb::Cache>& sharedCache);
 
     /**
      * Read a table config file (request is ignored if file does not exist).
@@ -112,6 +126,11 @@ public:
     std::string openTable(IndexType tableId, void* srcSock=nullptr);
     void closeTable(IndexType index);
     void truncateTable(IndexType index);
+    /**
+     * Move a table into an unused table slot
+     * @return String with 1st byte: return code, remaining bytes: error message
+     */
+    std::string moveTable(IndexType source, IndexType target);
     void* reqSocket; //This ZMQ socket is used to send requests
 private:
     void* context;
@@ -3,6 +3,8 @@
 
 
 #include <thread>
+#include <map>
+#include <string>
 #include "Tablespace.hpp"
 #include "ConfigParser.hpp"
 
@@ -25,6 +27,18 @@ public:
     void terminate();
     void tableOpenWorkerThread();
 private:
+    /**
+     * Open a table that is not open yet.
+     * @return The reply to send to the requester (response code + error message)
+     */
+    std::string openTable(uint32_t tableIndex,
+                          std::map<std::string, std::string>& parameterMap);
+    /**
+     * Move a table into an unused table slot by renaming its directory and files.
+     * If the table is open, it is closed before and reopened after the move.
+     * @return The reply to send to the requester (response code + error message)
+     */
+    std::string moveTable(uint32_t tableIndex, uint32_t targetTableIndex);
     std::thread* workerThread;
     ConfigParser& configParser;
     Tablespace& tablespace;
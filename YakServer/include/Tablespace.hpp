@@ -7,24 +7,41 @@
 
 #ifndef TABLESPACE_HPP
 #define	TABLESPACE_HPP
-#include <vector>
+#include <atomic>
 #include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <zmq.h>
 #include <rocksdb/db.h>
+#include <rocksdb/cache.h>
+#include <rocksdb/write_buffer_manager.h>
 
 #include "TableOpenHelper.hpp"
+#include "KeyCounter.hpp"
+#include "WriteStatistics.hpp"
 
 /**
  * Encapsulates multiple key-value tables in one interface.
- * The tables are addressed by number and
+ * The tables are addressed by number.
+ *
+ * The table entries are stored in a singly-linked list of fixed-size chunks.
+ * Chunks are never reallocated or freed while the tablespace is alive,
+ * so any thread may look up a table without locking while the
+ * table open server opens or closes tables concurrently.
+ *
+ * Write access is serialized using the TableOpenHelper/TableOpenServer classes.
+ *
+ * The tablespace also owns the resources shared by all tables,
+ * so memory usage is bounded independently of the number of open tables.
  */
 class Tablespace {
 public:
     typedef uint32_t IndexType;
     typedef rocksdb::DB* TableType;
-    typedef typename std::vector<TableType> TableCollectionType;
+    static const IndexType chunkSize = 128;
 
-    Tablespace(ConfigParser& cfg, IndexType defaultTablespaceSize = 128);
+    Tablespace(ConfigParser& cfg, IndexType defaultTablespaceSize = chunkSize);
     Tablespace(const Tablespace& other) = delete;
 
     ~Tablespace();
@@ -63,10 +80,15 @@ public:
 
     /*
      * Get the pointer to a table, but don't create / open the table if it is not
-     * open yet
+     * open yet.
+     * This method is wait-free and thread-safe.
      * @return A pointer to the table or nullptr if it is not open
      */
-    TableType getTableIfOpen(IndexType index);
+    inline TableType getTableIfOpen(IndexType index) {
+        TableEntry* entry = findEntry(index);
+        return entry == nullptr ? nullptr
+            : entry->table.load(std::memory_order_acquire);
+    }
 
     /**
      * Close a table immediately.
@@ -77,26 +99,12 @@ public:
      */
     void closeTable(IndexType index);
 
-    inline TableType getExistingTable(IndexType index) {
-        return databases[index];
-    }
-
-    inline TableCollectionType& getDatabases() {
-        return databases;
-    }
-
     /**
      * Get the maximum 0-based table index i so that t_i is currently open
      * so there is no j > i so that t_j is open (or -1 if no table is open)
      */
     inline int32_t getMaximumOpenTableNumber() {
-        int32_t ret = -1;
-        for(uint32_t i = 0; i < databases.size(); i++) {
-            if(getExistingTable(i) != nullptr) {
-                ret = i;
-            }
-        }
-        return ret;
+        return maximumOpenTableNumber.load(std::memory_order_relaxed);
     }
 
     /**
@@ -104,73 +112,149 @@ public:
      * This method is reentrant and thread-safe.
      */
     inline bool isTableOpen(IndexType index) {
-        return getExistingTable(index) != nullptr;
+        return getTableIfOpen(index) != nullptr;
     }
 
     /**
-     * Ensure the internal vectors have at least an appropriate size
-     * to store a table at the given index
+     * Publish a newly opened table so other threads can use it.
+     * The merge operator flags and the key counter are set
+     * and the write statistics are reset before the table becomes visible.
+     * Only the table open server may call this method.
+     * @param postingsTable true if the table uses the POSTINGS merge operator
+     * @param keyCounter The key counter of the table (ownership is transferred)
+     *        or nullptr if the keys of the table are not counted
      */
-    inline void ensureSize(IndexType tableIndex) {
-        //Avoid scaling superlinearly by only reserving a small margin
-        // beyond the required size
-        databases.reserve(tableIndex + 16);
-        mergeRequired.reserve(tableIndex + 16);
-    }
+    void setTable(IndexType index, TableType table, bool mergeRequired,
+                  bool postingsTable, KeyCounter* keyCounter = nullptr);
 
     /**
      * Erase a table entry and get the (now erased)
      * table entry. Might return nullptr if the table
      * wasn't open in the first place.
-     * This operation is not executed atomically.
+     * The key counter of the table, if any, is saved and retired.
+     * Only the table open server may call this method.
+     */
+    TableType eraseAndGetTableEntry(IndexType index);
+
+    /**
+     * Get the merge required flag for a given table index.
+     * Returns false if the table is not open.
      */
-    inline TableType eraseAndGetTableEntry(IndexType index) {
-        TableType db = databases[index];
-        databases[index] = nullptr;
-        return db;
+    inline bool isMergeRequired(IndexType index) {
+        TableEntry* entry = findEntry(index);
+        return entry != nullptr
+            && entry->mergeRequired.load(std::memory_order_relaxed);
     }
 
     /**
-     * Get a pointer to the memory location in the databases vector
-     * where the caller may store a pointer to a newly opened table.
+     * Get the postings table flag for a given table index,
+     * i.e. whether the values are compressed posting lists.
+     * Returns false if the table is not open.
      */
-    inline TableType* getTablePointer(IndexType index) {
-        return &databases[index];
+    inline bool isPostingsTable(IndexType index) {
+        TableEntry* entry = findEntry(index);
+        return entry != nullptr
+            && entry->postingsTable.load(std::memory_order_relaxed);
     }
 
     /**
-     * Set the merge required flag for a given table index.
-     * Does not automatically resize the vectors.
+     * Get the key counter for a given table index.
+     * @return The counter or nullptr if the table is not open
+     *         or has been opened without key counters
      */
-    inline void setMergeRequired(IndexType index, bool newValue) {
-        mergeRequired[index] = newValue;
+    inline KeyCounter* getKeyCounter(IndexType index) {
+        TableEntry* entry = findEntry(index);
+        return entry == nullptr ? nullptr
+            : entry->keyCounter.load(std::memory_order_relaxed);
     }
 
     /**
-     * Get the merge required flag for a given table index.
-     * Does not automatically resize the vectors.
+     * Get the write statistics and the adaptive write batch size for a given table index.
+     * @return The statistics or nullptr if the table entry does not exist
      */
-    inline bool isMergeRequired(IndexType index) {
-        return mergeRequired[index];
+    inline TableWriteStatistics* getWriteStatistics(IndexType index) {
+        TableEntry* entry = findEntry(index);
+        return entry == nullptr ? nullptr : &entry->writeStatistics;
+    }
+
+    /**
+     * Get the block cache shared by all tables that don't use a dedicated cache.
+     * @return The cache or nullptr if the block cache is disabled
+     */
+    inline const std::shared_ptr<rocksdb::Cache>& getBlockCache() const {
+        return blockCache;
+    }
+
+    /**
+     * Get the write buffer manager limiting the memtable size of all tables.
+     * @return The manager or nullptr if the memtable size is not limited
+     */
+    inline const std::shared_ptr<rocksdb::WriteBufferManager>& getWriteBufferManager() const {
+        return writeBufferManager;
     }
 
 private:
+    struct TableEntry {
+        std::atomic<TableType> table;
+        /**
+         * true if it is required to use the Merge operation instead of the
+         * Put operation.
+         * This is true exactly if a non-REPLACE merge operator is selected.
+         */
+        std::atomic<bool> mergeRequired;
+        /**
+         * true if the POSTINGS merge operator is selected
+         */
+        std::atomic<bool> postingsTable;
+        /**
+         * Number of keys in the table, if enabled for the table
+         */
+        std::atomic<KeyCounter*> keyCounter;
+        /**
+         * Reset whenever the table is opened
+         */
+        TableWriteStatistics writeStatistics;
+    };
+    struct TableChunk {
+        TableChunk();
+        TableEntry entries[chunkSize];
+        std::atomic<TableChunk*> next;
+    };
+
     /**
-     * The databases vector.
-     * Any method in this class has read-only access (tables may be closed by this class however)
-     *
-     * Write acess is serialized using the TableOpenHelper/TableOpenServer classes.
-     *
-     * Therefore locks and double initialization are avoided.
+     * Find the entry for a given table index without allocating chunks.
+     * @return The entry or nullptr if the chunk has not been allocated yet
      */
-    TableCollectionType databases; //Indexed by table num
+    inline TableEntry* findEntry(IndexType index) {
+        TableChunk* chunk = firstChunk;
+        for (IndexType i = index / chunkSize; i > 0 && chunk != nullptr; i--) {
+            chunk = chunk->next.load(std::memory_order_acquire);
+        }
+        return chunk == nullptr ? nullptr : &chunk->entries[index % chunkSize];
+    }
+
+    /**
+     * Find the entry for a given table index,
+     * appending chunks to the list as required.
+     */
+    TableEntry* getOrCreateEntry(IndexType index);
+
+    /**
+     * Save the key counter of a table, if any, and retire it.
+     * Workers and jobs might still reference the counter (and lock its write mutex),
+     * so retired counters are only deleted when the tablespace is destroyed.
+     */
+    void releaseKeyCounter(IndexType index, TableEntry& entry);
+
     /**
-     * This vector stores true for any table if it is required to use the
-     * Merge operation instead of the Put operation.
-     * This is true exactly if a non-REPLACE merge operator is selected.
-     * The details of selecting either PUT o
+     * The first chunk of the table list. Never nullptr.
      */
-    std::vector<bool> mergeRequired; //Indexed by table num
+    TableChunk* firstChunk;
+    std::atomic<int32_t> maximumOpenTableNumber;
+    std::shared_ptr<rocksdb::Cache> blockCache;
+    std::shared_ptr<rocksdb::WriteBufferManager> writeBufferManager;
+    std::mutex retiredKeyCountersMutex;
+    std::vector<KeyCounter*> retiredKeyCounters;
     ConfigParser& cfg;
 };
 
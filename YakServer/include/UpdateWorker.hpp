@@ -11,6 +11,8 @@
 #include <zmq.h>
 #include "Tablespace.hpp"
 #include "AbstractFrameProcessor.hpp"
+#include "PostOffice.hpp"
+#include "protocol.hpp"
 
 class UpdateWorkerController {
 public:
@@ -26,17 +28,19 @@ public:
      */
     void terminateAll();
 private:
-    std::thread** threads;
     Tablespace& tablespace;
-    size_t numThreads; //size of this->threads
     void* context;
     Logger logger;
     ConfigParser& configParser;
+    PostOffice postOffice;
 };
 
 class UpdateWorker : private AbstractFrameProcessor {
 public:
-    UpdateWorker(void* ctx, Tablespace& tablespace, ConfigParser& configParser);
+    /**
+     * @param workerId The ID assigned by the post office
+     */
+    UpdateWorker(void* ctx, Tablespace& tablespace, ConfigParser& configParser, uint32_t workerId);
     ~UpdateWorker();
     /**
      * The main function for the update worker thread.
@@ -47,6 +51,8 @@ public:
      * If its one byte is 0, no address and delimiter frame shall be sent.
      * It its one byte is 1, an address and delimiter frame must follow.
      * If its one byte is 0xFF, the thread shall stop.
+     * A 4-byte frame announces a group of put and delete requests
+     * for the same table, see PostOffice and handleWriteGroup().
      * 
      * This function parses the header, calls the appropriate handler function
      * and sends the response for PARTSYNC requests
@@ -54,19 +60,51 @@ public:
      * @return false if a stop message was received, true else
      */
     bool processNextMessage();
+    /**
+     * Tell the post office this worker is ready to process the next request
+     */
+    void reportReady(uint8_t lane);
 private:
     TableOpenHelper tableOpenHelper;
     Tablespace& tablespace;
     ConfigParser& cfg;
     void handlePutRequest(bool generateResponse);
+    /**
+     * Write a put or delete batch and record the write in the table write statistics
+     * @param fullBatch true if the batch has reached the adaptive batch size
+     * @return false if an error occured (the error response has been sent)
+     */
+    bool writeUpdateBatch(rocksdb::DB* db,
+                          const rocksdb::WriteOptions& writeOptions,
+                          rocksdb::WriteBatch& batch,
+                          TableWriteStatistics& writeStatistics,
+                          bool fullBatch,
+                          bool generateResponse);
+    /**
+     * Write a group of put and delete requests for the same table
+     * using a single write batch, i.e. a single WAL write (and sync).
+     * The responses are sent after the write.
+     */
+    void handleWriteGroup(uint32_t groupSize);
     void handleDeleteRequest(bool generateResponse);
     void handleDeleteRangeRequest(bool generateResponse);
-    void handleCopyRangeRequest(bool generateResponse);
     void handleLimitedDeleteRangeRequest(bool generateResponse);
+    void handleBulkLoadRequest(bool generateResponse);
     void handleCompactRequest(bool generateResponse);
     void handleTableOpenRequest(bool generateResponse);
     void handleTableCloseRequest(bool generateResponse);
     void handleTableTruncateRequest(bool generateResponse);
+    void handleTableMoveRequest(bool generateResponse);
+    void handleWatchTestRequest(bool generateResponse);
+    /**
+     * Publish a table change event to the watch distributor, if enabled.
+     * @param eventType The request type. For put events, frames contains key/value pairs
+     *        of which only the keys are published unless watch-values is enabled.
+     * @param firstFrame The index of the first key frame in frames
+     */
+    void publishWatchEvent(uint32_t tableId, RequestType eventType,
+                           const BufferedMessage& frames, size_t firstFrame = 0);
+    void* watchSocket; //PUSH to the watch distributor, nullptr if watch notify is disabled
 };
 
 #endif	/* UPDATEWORKER_HPP */
@@ -0,0 +1,56 @@
+#ifndef WATCHDISTRIBUTOR_HPP
+#define	WATCHDISTRIBUTOR_HPP
+#include <thread>
+#include <string>
+#include <vector>
+#include <zmq.h>
+#include "Logger.hpp"
+
+class ConfigParser;
+
+/**
+ * Publishes table change events (watch notify) to the external PUB endpoints.
+ *
+ * The update workers push their events to the PULL socket bound to
+ * watchDistributorEndpoint, so they never block on slow subscribers.
+ * The watch distributor thread forwards them unmodified to the PUB socket.
+ *
+ * Events (all frames of a message):
+ *  - Topic frame: Table ID (4 bytes, little-endian) and event type (1 byte),
+ *    so subscribers can filter by table and event type using prefixes.
+ *  - Event data, see the watch section of the external protocol docs.
+ *
+ * An empty single-frame message stops the distributor.
+ * The distributor is only started if any watch endpoint is configured.
+ */
+class WatchDistributor {
+public:
+    /**
+     * Bind the sockets and start the distributor thread, if enabled
+     */
+    WatchDistributor(void* ctx, ConfigParser& cfg);
+    ~WatchDistributor();
+    /**
+     * Stop the distributor thread after all pending events have been published.
+     */
+    void terminate();
+    /**
+     * Create a PUSH socket an update worker can use to send events.
+     * Shall be called from the worker thread.
+     * @return The socket or nullptr if watch notify is disabled
+     */
+    static void* connectPublisher(void* ctx, ConfigParser& cfg, Logger& logger);
+    /**
+     * @return true if any watch endpoint is configured
+     */
+    static bool isEnabled(const ConfigParser& cfg);
+private:
+    void run();
+    void* ctx;
+    void* pullSocket;
+    void* pubSocket;
+    std::thread* thread;
+    Logger logger;
+};
+
+#endif	/* WATCHDISTRIBUTOR_HPP */
@@ -0,0 +1,97 @@
+#ifndef __WRITE_STATISTICS_HPP
+#define __WRITE_STATISTICS_HPP
+#include <cstdint>
+#include <string>
+#include <map>
+#include <atomic>
+#include <algorithm>
+
+//Limits of the adaptive write batch size in bytes
+static const uint64_t minWriteBatchBytes = 4096;
+static const uint64_t maxWriteBatchBytes = 64 * 1024 * 1024;
+
+/**
+ * Write statistics of a table and the adaptive write batch size.
+ *
+ * Put requests are split into write batches of a given number of bytes.
+ * The batch size is adapted to the measured write latency:
+ * It is doubled while full batches are written faster than half the target latency
+ * and halved when a full batch takes longer than the target latency.
+ * This yields large batches for tiny records without
+ * blocking the table for a long time when the records are large.
+ *
+ * All methods may be called concurrently by the update workers.
+ */
+class TableWriteStatistics {
+public:
+    TableWriteStatistics() {
+        reset(minWriteBatchBytes, 0);
+    }
+    /**
+     * Reset the statistics when a table is opened
+     * @param initialBatchBytes The initial batch size in bytes
+     * @param targetLatencyParam The target write latency in microseconds (0 --> never adapt)
+     */
+    void reset(uint64_t initialBatchBytes, uint64_t targetLatencyParam) {
+        batchBytes.store(std::min(std::max(initialBatchBytes, minWriteBatchBytes), maxWriteBatchBytes),
+                         std::memory_order_relaxed);
+        targetLatency.store(targetLatencyParam, std::memory_order_relaxed);
+        writes.store(0, std::memory_order_relaxed);
+        writtenRecords.store(0, std::memory_order_relaxed);
+        writtenBytes.store(0, std::memory_order_relaxed);
+        writeMicros.store(0, std::memory_order_relaxed);
+    }
+    /**
+     * @return The number of bytes after which a write batch shall be written
+     */
+    uint64_t getBatchBytes() const {
+        return batchBytes.load(std::memory_order_relaxed);
+    }
+    /**
+     * Record a batch write and adapt the batch size.
+     * @param full true if the batch has been written because it reached
+     *        the batch size. Only full batches are used to adapt the batch size.
+     */
+    void recordWrite(uint64_t records, uint64_t bytes, uint64_t micros, bool full) {
+        writes.fetch_add(1, std::memory_order_relaxed);
+        writtenRecords.fetch_add(records, std::memory_order_relaxed);
+        writtenBytes.fetch_add(bytes, std::memory_order_relaxed);
+        writeMicros.fetch_add(micros, std::memory_order_relaxed);
+        uint64_t target = targetLatency.load(std::memory_order_relaxed);
+        if (!full || target == 0) {
+            return;
+        }
+        uint64_t current = batchBytes.load(std::memory_order_relaxed);
+        if (micros * 2 < target) {
+            batchBytes.store(std::min(current * 2, maxWriteBatchBytes), std::memory_order_relaxed);
+        } else if (micros > target) {
+            batchBytes.store(std::max(current / 2, minWriteBatchBytes), std::memory_order_relaxed);
+        }
+    }
+    /**
+     * Add the statistics to a table info map
+     */
+    void toMap(std::map<std::string, std::string>& map) const {
+        uint64_t numWrites = writes.load(std::memory_order_relaxed);
+        uint64_t bytes = writtenBytes.load(std::memory_order_relaxed);
+        uint64_t micros = writeMicros.load(std::memory_order_relaxed);
+        map["Writes"] = std::to_string(numWrites);
+        map["WrittenRecords"] = std::to_string(writtenRecords.load(std::memory_order_relaxed));
+        map["WrittenBytes"] = std::to_string(bytes);
+        map["WriteTime"] = std::to_string(micros);
+        map["WriteBatchBytes"] = std::to_string(getBatchBytes());
+        if (numWrites > 0) {
+            map["AverageWriteBatchBytes"] = std::to_string(bytes / numWrites);
+            map["AverageWriteLatency"] = std::to_string(micros / numWrites);
+        }
+    }
+private:
+    std::atomic<uint64_t> batchBytes;
+    std::atomic<uint64_t> targetLatency;
+    std::atomic<uint64_t> writes;
+    std::atomic<uint64_t> writtenRecords;
+    std::atomic<uint64_t> writtenBytes;
+    std::atomic<uint64_t> writeMicros;
+};
+
+#endif //__WRITE_STATISTICS_HPP
@@ -18,11 +18,16 @@
 #define tableOpenEndpoint "inproc://tableopenWorker"
 
 //Internal endpoints. Do not use externally.
+//Requests are pushed to the post offices, the workers connect to the thread addresses
+#define updateWorkerRequestAddr "inproc://updateWorkerRequests"
 #define updateWorkerThreadAddr "inproc://updateWorkerThreads"
+#define readWorkerRequestAddr "inproc://readWorkerRequests"
 #define readWorkerThreadAddr "inproc://readWorkerThreads"
 //"Fast-path" to the main router, NOT the return path!
 #define mainRouterAddr "inproc://mainRouter" 
 #define asyncJobRouterAddr "inproc://asyncJobRouter"
+//The update workers push table change events to the watch distributor
+#define watchDistributorEndpoint "inproc://watchDistributor"
 
 #endif	/* ENDPOINTS_HPP */
 
@@ -54,20 +54,25 @@ enum class RequestType : uint8_t {
     TruncateTableRequest = 0x04,
     StopServerRequest = 0x05,
     TableInfoRequest = 0x06,
+    MoveTableRequest = 0x07,
+    WatchTestRequest = 0x08,
     ReadRequest = 0x10,
     CountRequest = 0x11,
     ExistsRequest = 0x12,
     ScanRequest = 0x13,
     ListRequest = 0x14,
+    IntersectRequest = 0x15,
     PutRequest = 0x20,
     DeleteRequest = 0x21,
     DeleteRangeRequest = 0x22,
     MultiTableWriteRequest = 0x23,
-    CopyRangeRequest = 0x24,
+    BulkLoadRequest = 0x25,
     ForwardRangeToSocketRequest = 0x40,
     ServerSideTableSinkedMapInitializationRequest = 0x41,
     ClientSidePassiveTableMapInitializationRequest = 0x42,
-    ClientDataRequest = 0x50
+    JobStatisticsRequest = 0x48,
+    ClientDataRequest = 0x50,
+    TableRangeCopyRequest = 0x60
 };
 
 enum class ResponseType : uint8_t {
@@ -94,13 +99,32 @@ enum class WriteFlag : uint8_t {
 
 enum class CopyFlag : uint8_t {
     SynchronousDelete = 0x01,
+    IngestExternalFiles = 0x02
+};
+
+enum class BulkLoadFlag : uint8_t {
+    KeysSorted = 0x01
+};
+
+enum class DeleteRangeFlag : uint8_t {
+    CompactAfterDelete = 0x01
 };
 
 
+enum class IntersectFlag : uint8_t {
+    IgnoreMissingKeys = 0x01
+};
+
 enum class ScanFlag : uint8_t {
     InvertDirection = 0x01
 };
 
+enum class CountMode : uint8_t {
+    Iterate = 0x00, //Exact, iterates over the range
+    Approximate = 0x01, //Estimate from the table metadata
+    KeyCounters = 0x02 //Exact, from the key counters of the table
+};
+
 /**
  * Check if a given frame is a header frame.
  *
@@ -145,11 +169,31 @@ static inline uint8_t getWriteFlags(zmq_msg_t* frame) {
     return (zmq_msg_size(frame) >= 4 ? ((uint8_t*)zmq_msg_data(frame))[3] : 0x00);
 }
 
+static inline CountMode getCountMode(zmq_msg_t* frame) {
+    //The count mode is optional and defaults to iteration
+    return (CountMode) (zmq_msg_size(frame) >= 4 ? ((uint8_t*)zmq_msg_data(frame))[3] : 0x00);
+}
+
 static inline uint8_t getCopyFlags(zmq_msg_t* frame) {
     //Write flags are optional and default to 0x00
     return (zmq_msg_size(frame) >= 5 ? ((uint8_t*)zmq_msg_data(frame))[4] : 0x00);
 }
 
+static inline uint8_t getDeleteRangeFlags(zmq_msg_t* frame) {
+    //Delete range flags are optional and default to 0x00
+    return (zmq_msg_size(frame) >= 5 ? ((uint8_t*)zmq_msg_data(frame))[4] : 0x00);
+}
+
+static inline uint8_t getIntersectFlags(zmq_msg_t* frame) {
+    //Intersect flags are optional and default to 0x00
+    return (zmq_msg_size(frame) >= 4 ? ((uint8_t*)zmq_msg_data(frame))[3] : 0x00);
+}
+
+static inline uint8_t getBulkLoadFlags(zmq_msg_t* frame) {
+    //Bulk load flags are optional and default to 0x00
+    return (zmq_msg_size(frame) >= 5 ? ((uint8_t*)zmq_msg_data(frame))[4] : 0x00);
+}
+
 static inline bool isPartsync(uint8_t writeFlags) {
     return (writeFlags & (uint8_t)WriteFlag::PartiallySynchronous);
 }
@@ -162,6 +206,22 @@ static inline bool isSynchronousDelete(uint8_t writeFlags) {
     return (writeFlags & (uint8_t)CopyFlag::SynchronousDelete);
 }
 
+static inline bool isIngestExternalFiles(uint8_t copyFlags) {
+    return (copyFlags & (uint8_t)CopyFlag::IngestExternalFiles);
+}
+
+static inline bool isKeysSorted(uint8_t bulkLoadFlags) {
+    return (bulkLoadFlags & (uint8_t)BulkLoadFlag::KeysSorted);
+}
+
+static inline bool isCompactAfterDelete(uint8_t deleteRangeFlags) {
+    return (deleteRangeFlags & (uint8_t)DeleteRangeFlag::CompactAfterDelete);
+}
+
+static inline bool isIgnoreMissingKeys(uint8_t intersectFlags) {
+    return (intersectFlags & (uint8_t)IntersectFlag::IgnoreMissingKeys);
+}
+
 static inline bool isScanDirectionInverted(uint8_t scanFlags) {
     return (scanFlags & (uint8_t)ScanFlag::InvertDirection);
 }
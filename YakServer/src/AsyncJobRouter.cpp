@@ -2,12 +2,15 @@
 #include <zmq.h>
 #include <limits>
 #include <atomic>
+#include <cstring>
 #include "AsyncJobRouter.hpp"
 #include "TableOpenHelper.hpp"
 #include "ThreadUtil.hpp"
 #include "endpoints.hpp"
 #include "protocol.hpp"
 #include "ClientSidePassiveJob.hpp"
+#include "CopyRangeJob.hpp"
+#include "RangeSplit.hpp"
 #include "zutil.hpp"
 
 /**
@@ -23,30 +26,72 @@ static void clientSidePassiveWorkerThreadFn(void* ctxParam,
              uint64_t scanLimit,
              Tablespace& tablespace,
              ThreadTerminationInfo* tti,
-             ThreadStatisticsInfo* statisticsInfo) {
+             ThreadStatisticsInfo* statisticsInfo,
+             ClientSidePassiveJob::SharedSnapshot snapshot) {
     assert(tti);
     assert(statisticsInfo);
-    ClientSidePassiveJob job(ctxParam, apid, tableId, chunksize, rangeStart, rangeEnd, scanLimit, tablespace, tti, statisticsInfo);
+    ClientSidePassiveJob job(ctxParam, apid, tableId, chunksize, rangeStart, rangeEnd, scanLimit, tablespace, tti, statisticsInfo, snapshot);
     job.mainLoop();
 }
 
-COLD AsyncJobRouterController::AsyncJobRouterController(void* ctxArg, Tablespace& tablespace)
+/**
+ * This function contains the main loop for the thread
+ * that copies a range from one table to another
+ */
+static void copyRangeJobThreadFn(void* ctxParam,
+             uint64_t apid,
+             uint32_t sourceTableId,
+             uint32_t targetTableId,
+             ScanRange range,
+             uint8_t writeFlags,
+             uint8_t copyFlags,
+             Tablespace& tablespace,
+             ConfigParser& cfg,
+             ThreadTerminationInfo* tti,
+             ThreadStatisticsInfo* statisticsInfo) {
+    assert(tti);
+    assert(statisticsInfo);
+    setCurrentThreadName("Yak copy job");
+    CopyRangeJob job(ctxParam, apid, sourceTableId, targetTableId, range,
+        writeFlags, copyFlags, tablespace, cfg, tti, statisticsInfo);
+    job.run();
+}
+
+/**
+ * Compute the keys to split a range of a table at, based on the SST file sizes.
+ */
+static std::vector<std::string> computeTableSplitKeys(rocksdb::DB* db,
+        const std::string& rangeStart,
+        const std::string& rangeEnd,
+        uint32_t numPartitions) {
+    std::vector<rocksdb::LiveFileMetaData> files;
+    db->GetLiveFilesMetaData(&files);
+    std::vector<KeyRangeWeight> parts;
+    parts.reserve(files.size());
+    for(const rocksdb::LiveFileMetaData& file : files) {
+        parts.push_back({file.smallestkey, file.largestkey, file.size});
+    }
+    return computeSplitKeys(parts, rangeStart, rangeEnd, numPartitions);
+}
+
+COLD AsyncJobRouterController::AsyncJobRouterController(void* ctxArg, Tablespace& tablespace, ConfigParser& cfg)
     : routerSocket(zmq_socket_new_bind(ctxArg, ZMQ_PUSH, asyncJobRouterAddr)), 
         childThread(nullptr),
         tablespace(tablespace),
-        ctx(ctxArg) {
+        ctx(ctxArg),
+        cfg(cfg) {
     assert(routerSocket);
 }
 
 void COLD AsyncJobRouterController::start() {
     //Lambdas rock
-    childThread = new std::thread([](void* ctx, Tablespace& tablespace) {
+    childThread = new std::thread([](void* ctx, Tablespace& tablespace, ConfigParser& cfg) {
         setCurrentThreadName("Yak job router");
-        AsyncJobRouter worker(ctx, tablespace);
+        AsyncJobRouter worker(ctx, tablespace, cfg);
         while(worker.processNextRequest()) {
             //Loop until stop msg is received (--> processNextRequest() returns false)
         }
-    }, ctx, std::ref(tablespace));
+    }, ctx, std::ref(tablespace), std::ref(cfg));
 }
 
 void COLD AsyncJobRouterController::terminate() {
@@ -67,7 +112,7 @@ COLD AsyncJobRouterController::~AsyncJobRouterController() {
     terminate();
 }
 
-COLD AsyncJobRouter::AsyncJobRouter(void* ctxArg, Tablespace& tablespaceArg) :
+COLD AsyncJobRouter::AsyncJobRouter(void* ctxArg, Tablespace& tablespaceArg, ConfigParser& cfgArg) :
 AbstractFrameProcessor(ctxArg, ZMQ_PULL, ZMQ_PUSH, "Async job router"),
 processSocketMap(),
 processThreadMap(),
@@ -75,7 +120,8 @@ apTerminationInfo(),
 scrubJobsRequested(),
 apidGenerator("next-apid.txt"),
 ctx(ctxArg),
-tablespace(tablespaceArg) {
+tablespace(tablespaceArg),
+cfg(cfgArg) {
     //Print warnings if not using lockfree atomics
     std::atomic<bool> boolAtomic;
     std::atomic<unsigned int> uintAtomic;
@@ -105,6 +151,9 @@ AsyncJobRouter::~AsyncJobRouter() {
     //Clean up everything
     terminateAll();
     doScrubJob();
+    for(auto statisticsPair : apStatisticsInfo) {
+        delete statisticsPair.second;
+    }
     //Sockets are cleaned up in AbstractFrameProcessor
 }
 
@@ -149,11 +198,14 @@ bool AsyncJobRouter::processNextRequest() {
         /*
          * Directly reply "No data" if:
          *  1) There is no such job (any more?)
-         *  2) The job has sent already the last non-empty data packet and
+         *  2) The job does not serve data chunks (e.g. table copy jobs)
+         *  3) The job has sent already the last non-empty data packet and
          *     reached its end-of-life, only expect
          * Else forward to corresponding worker
          */
-        if(!haveProcess(apid) || doesAPWantToTerminate(apid)) {
+        if(!haveProcess(apid)
+                || apStatisticsInfo[apid]->jobType != JobType::CLIENTSIDE_PASSIVE
+                || doesAPWantToTerminate(apid)) {
             //Respond "No more data"
             if(zmq_msg_send(&routingFrame, processorOutputSocket, ZMQ_SNDMORE) == -1) {
                 logMessageSendError("Routing frame (branch: No such APID)", logger);
@@ -208,9 +260,34 @@ bool AsyncJobRouter::processNextRequest() {
         std::string rangeStart;
         std::string rangeEnd;
         parseRangeFrames(rangeStart, rangeEnd, "CSPTMIR range", true);
+        //Optional: Number of partitions to scan in parallel
+        bool partitioned = socketHasMoreFrames(processorInputSocket);
+        uint32_t numPartitions = 1;
+        if(partitioned && !parseUint32FrameOrAssumeDefault(numPartitions, 1, "Partitions frame", true)) {
+            return true;
+        }
+        numPartitions = std::max<uint32_t>(numPartitions, 1);
+        std::string errstr;
+        if(numPartitions > 1 && scanLimit != UINT64_MAX) {
+            errstr = "Scan limit can't be used with multiple partitions";
+        } else if(!canStartJob(numPartitions)) {
+            errstr = "Too many concurrent jobs (" + std::to_string(cfg.asyncJobThreads) + ")";
+        }
+        if(!errstr.empty()) {
+            zmq_msg_send(&routingFrame, processorOutputSocket, ZMQ_SNDMORE);
+            zmq_msg_send(&delimiterFrame, processorOutputSocket, ZMQ_SNDMORE);
+            sendConstFrame(errorResponse, 4, processorOutputSocket, logger, "CSPTMI error response header", ZMQ_SNDMORE);
+            sendFrame(errstr, processorOutputSocket, logger, "CSPTMI error message");
+            return true;
+        }
         //Initialize it
-        uint64_t apid = initializeJob();
-        startClientSidePassiveJob(apid, tableId, chunkSize, scanLimit, rangeStart, rangeEnd);
+        uint64_t apid;
+        if(numPartitions > 1) {
+            apid = startPartitionedClientSidePassiveJob(numPartitions, tableId, chunkSize, rangeStart, rangeEnd);
+        } else {
+            apid = initializeJob();
+            startClientSidePassiveJob(apid, tableId, chunkSize, scanLimit, rangeStart, rangeEnd);
+        }
         //Send the reply
         if(zmq_msg_send(&routingFrame, processorOutputSocket, ZMQ_SNDMORE) == -1) {
             zmq_msg_close(&routingFrame);
@@ -223,10 +300,60 @@ bool AsyncJobRouter::processNextRequest() {
             logMessageSendError("Header frame (CSPTMI Response)", logger);
         }
         //Send APID frame //TODO error check
-        sendUint64Frame(apid, "CSPTMI Response APID");
+        sendUint64Frame(apid, "CSPTMI Response APID", (partitioned ? ZMQ_SNDMORE : 0));
+        if(partitioned) {
+            sendBinary<uint32_t>(numPartitions, processorOutputSocket, logger, "CSPTMI Response partitions");
+        }
         //Persist the latest APID to generate strictly ascending APIDs after
         // server restart
         apidGenerator.persist();
+    } else if (requestType == RequestType::TableRangeCopyRequest) {
+        uint8_t writeFlags = getWriteFlags(&headerFrame);
+        uint8_t copyFlags = getCopyFlags(&headerFrame);
+        zmq_msg_close(&headerFrame);
+        //Parse all parameters
+        errorResponse = "\x31\01\x60\x01";
+        uint32_t sourceTableId;
+        if(!parseUint32Frame(sourceTableId, "Source table ID frame", true)) {
+            return true;
+        }
+        uint32_t targetTableId;
+        if(!parseUint32Frame(targetTableId, "Target table ID frame", true)) {
+            return true;
+        }
+        ScanRange range;
+        if(!parseUint64FrameOrAssumeDefault(range.limit, UINT64_MAX, "Copy limit frame", true)) {
+            return true;
+        }
+        parseRangeFrames(range.start, range.end, "Table range copy request range", true);
+        if(!canStartJob()) {
+            std::string errstr = "Too many concurrent jobs (" + std::to_string(cfg.asyncJobThreads) + ")";
+            zmq_msg_send(&routingFrame, processorOutputSocket, ZMQ_SNDMORE);
+            zmq_msg_send(&delimiterFrame, processorOutputSocket, ZMQ_SNDMORE);
+            sendConstFrame(errorResponse, 4, processorOutputSocket, logger, "Table range copy error response header", ZMQ_SNDMORE);
+            sendFrame(errstr, processorOutputSocket, logger, "Table range copy error message");
+            return true;
+        }
+        uint64_t apid = initializeJob();
+        startCopyRangeJob(apid, sourceTableId, targetTableId, range, writeFlags, copyFlags);
+        //Send the reply. The copy progress can be checked using job statistics requests.
+        if(zmq_msg_send(&routingFrame, processorOutputSocket, ZMQ_SNDMORE) == -1) {
+            zmq_msg_close(&routingFrame);
+            logMessageSendError("Routing frame (Table range copy response)", logger);
+        }
+        if(zmq_msg_send(&delimiterFrame, processorOutputSocket, ZMQ_SNDMORE) == -1) {
+            logMessageSendError("Delimiter frame (Table range copy response)", logger);
+        }
+        if(zmq_send(processorOutputSocket, "\x31\x01\x60\x00", 4, ZMQ_SNDMORE) == -1) {
+            logMessageSendError("Header frame (Table range copy response)", logger);
+        }
+        sendUint64Frame(apid, "Table range copy response APID");
+        apidGenerator.persist();
+    } else if (requestType == RequestType::JobStatisticsRequest) {
+        //Statistics request type defaults to 0x00 (APID statistics)
+        uint8_t statisticsRequestType = getWriteFlags(&headerFrame);
+        zmq_msg_close(&headerFrame);
+        handleJobStatisticsRequest(&routingFrame, &delimiterFrame, statisticsRequestType);
     }  else {
         std::string errstr = "Internal routing error: request type " + std::to_string((int) requestType) + " routed to read worker thread!";
         logger.error(errstr);
@@ -240,6 +367,17 @@ bool AsyncJobRouter::processNextRequest() {
     return true;
 }
 
+bool AsyncJobRouter::canStartJob(uint32_t numJobs) {
+    //0 means: No limit
+    if(cfg.asyncJobThreads == 0) {
+        return true;
+    }
+    if(processThreadMap.size() + numJobs > cfg.asyncJobThreads && isThereAnyScrubJobRequest()) {
+        doScrubJob();
+    }
+    return processThreadMap.size() + numJobs <= cfg.asyncJobThreads;
+}
+
 uint64_t AsyncJobRouter::initializeJob() {
     uint64_t apid = apidGenerator.getNewId();
     //Endpoint must unique for the APID
@@ -262,7 +400,8 @@ void AsyncJobRouter::startClientSidePassiveJob(uint64_t apid,
     uint32_t chunksize,
     uint64_t scanLimit,
     const std::string& rangeStart,
-    const std::string& rangeEnd) {
+    const std::string& rangeEnd,
+    ClientSidePassiveJob::SharedSnapshot snapshot) {
 
     //initializeJob() must be called before this
     apStatisticsInfo[apid]->jobType = JobType::CLIENTSIDE_PASSIVE;
@@ -276,10 +415,119 @@ void AsyncJobRouter::startClientSidePassiveJob(uint64_t apid,
             scanLimit,
             std::ref(tablespace),
             apTerminationInfo[apid],
+            apStatisticsInfo[apid],
+            snapshot
+    );
+}
+
+void AsyncJobRouter::startCopyRangeJob(uint64_t apid,
+    uint32_t sourceTableId,
+    uint32_t targetTableId,
+    const ScanRange& range,
+    uint8_t writeFlags,
+    uint8_t copyFlags) {
+    //initializeJob() must be called before this
+    apStatisticsInfo[apid]->jobType = JobType::TABLE_COPY;
+    processThreadMap[apid] = new std::thread(copyRangeJobThreadFn,
+            ctx,
+            apid,
+            sourceTableId,
+            targetTableId,
+            range,
+            writeFlags,
+            copyFlags,
+            std::ref(tablespace),
+            std::ref(cfg),
+            apTerminationInfo[apid],
             apStatisticsInfo[apid]
     );
 }
 
+void AsyncJobRouter::handleJobStatisticsRequest(zmq_msg_t* routingFrame,
+    zmq_msg_t* delimiterFrame,
+    uint8_t statisticsRequestType) {
+    if(zmq_msg_send(routingFrame, processorOutputSocket, ZMQ_SNDMORE) == -1) {
+        logMessageSendError("Routing frame (JobStatR response)", logger);
+    }
+    if(zmq_msg_send(delimiterFrame, processorOutputSocket, ZMQ_SNDMORE) == -1) {
+        logMessageSendError("Delimiter frame (JobStatR response)", logger);
+    }
+    if(statisticsRequestType != 0x00) {
+        std::string errstr = "Unknown job statistics request type " + std::to_string(statisticsRequestType);
+        sendConstFrame("\x31\x01\x48\x01", 4, processorOutputSocket, logger, "JobStatR error response header", ZMQ_SNDMORE);
+        sendFrame(errstr, processorOutputSocket, logger, "JobStatR error message");
+        return;
+    }
+    size_t remainingJobs = apStatisticsInfo.size();
+    sendConstFrame("\x31\x01\x48\x00", 4, processorOutputSocket, logger,
+        "JobStatR response header", (remainingJobs > 0 ? ZMQ_SNDMORE : 0));
+    for(const auto& statisticsPair : apStatisticsInfo) {
+        uint64_t apid = statisticsPair.first;
+        const ThreadStatisticsInfo* info = statisticsPair.second;
+        //Header: [64-bit APID] [8-bit job type] [8-bit job state]
+        char jobHeader[sizeof(uint64_t) + 2];
+        memcpy(jobHeader, &apid, sizeof(uint64_t));
+        jobHeader[sizeof(uint64_t)] = (uint8_t) info->jobType;
+        jobHeader[sizeof(uint64_t) + 1] = (uint8_t) getJobState(apid);
+        sendFrame(jobHeader, sizeof(jobHeader), processorOutputSocket, logger,
+            "JobStatR job header", ZMQ_SNDMORE);
+        uint64_t runtime = info->getRuntime();
+        std::map<std::string, std::string> statistics;
+        statistics["transferredRecords"] = std::to_string(info->transferredRecords);
+        statistics["transferredDataBytes"] = std::to_string(info->transferredDataBytes);
+        statistics["expectedDataBytes"] = std::to_string(info->expectedDataBytes);
+        statistics["runtime"] = std::to_string(runtime);
+        statistics["throughput"] = std::to_string(
+            runtime == 0 ? 0 : info->transferredDataBytes * 1000 / runtime);
+        statistics["failed"] = (info->failed ? "1" : "0");
+        sendMap(statistics, "JobStatR statistics", false, true);
+        remainingJobs--;
+        sendFrame("", 0, processorOutputSocket, logger,
+            "JobStatR delimiter frame", (remainingJobs > 0 ? ZMQ_SNDMORE : 0));
+    }
+}
+
+JobState AsyncJobRouter::getJobState(uint64_t apid) {
+    //The termination info is released when the job is cleaned up
+    auto it = apTerminationInfo.find(apid);
+    if(it == apTerminationInfo.end() || it->second->hasTerminated()) {
+        return JobState::TERMINATED;
+    }
+    return it->second->wantsToTerminate() ? JobState::TERMINATING : JobState::RUNNING;
+}
+
+uint64_t AsyncJobRouter::startPartitionedClientSidePassiveJob(uint32_t& numPartitions,
+    uint32_t tableId,
+    uint32_t chunksize,
+    const std::string& rangeStart,
+    const std::string& rangeEnd) {
+    rocksdb::DB* db = tablespace.getTable(tableId, ctx);
+    //Take the snapshot first. The split keys are only a hint for load balancing,
+    // so it does not matter if the files change afterwards.
+    ClientSidePassiveJob::SharedSnapshot snapshot =
+        ClientSidePassiveJob::createSharedSnapshot(db);
+    std::vector<std::string> splitKeys =
+        computeTableSplitKeys(db, rangeStart, rangeEnd, numPartitions);
+    //There might not be enough data to split the range as requested
+    numPartitions = splitKeys.size() + 1;
+    uint64_t firstApid = 0;
+    for(uint32_t i = 0; i < numPartitions; i++) {
+        //The router is the only thread generating APIDs, so they are consecutive
+        uint64_t apid = initializeJob();
+        if(i == 0) {
+            firstApid = apid;
+        }
+        assert(apid == firstApid + i);
+        const std::string& partitionStart = (i == 0 ? rangeStart : splitKeys[i - 1]);
+        const std::string& partitionEnd = (i == splitKeys.size() ? rangeEnd : splitKeys[i]);
+        startClientSidePassiveJob(apid, tableId, chunksize, UINT64_MAX,
+            partitionStart, partitionEnd, snapshot);
+    }
+    logger.debug("Started scan of table " + std::to_string(tableId)
+        + " in " + std::to_string(numPartitions) + " partitions");
+    return firstApid;
+}
+
 void AsyncJobRouter::cleanupJob(uint64_t apid) {
     //We assume the process has already received an exit signal
     // or finished processing its data.
@@ -291,25 +539,32 @@ void AsyncJobRouter::cleanupJob(uint64_t apid) {
     zmq_close(socket);
     //Remove the map entries
     delete apTerminationInfo[apid];
-    delete apStatisticsInfo[apid];
     processSocketMap.erase(apid);
     processThreadMap.erase(apid);
     apTerminationInfo.erase(apid);
     //Don't delete the statistics info immediately
     // -- clients might request info after the job has finished
+    apStatisticsInfo[apid]->setFinished();
+    apStatisticsInfo[apid]->setExpungeTime();
 }
 
 void AsyncJobRouter::terminate(uint64_t apid) {
     void* socket = processSocketMap[apid];
-    //Send stop signal to thread
-    sendEmptyFrameMessage(socket);
+    //Send stop signal to thread (unless it has already exited)
+    if(!apTerminationInfo[apid]->hasTerminated()) {
+        sendEmptyFrameMessage(socket);
+    }
     //Wait for thread to exit completely and cleanup
     cleanupJob(apid);
 }
 
 void COLD AsyncJobRouter::terminateAll() {
+    //terminate() modifies the map, so collect the APIDs first
+    std::vector<uint64_t> apids;
     for(auto pair : processThreadMap) {
-        uint64_t apid = pair.first;
+        apids.push_back(pair.first);
+    }
+    for(uint64_t apid : apids) {
         logger.trace("terminateAll(): Terminating job " + std::to_string(apid));
         terminate(apid);
     }
@@ -342,12 +597,27 @@ void AsyncJobRouter::doScrubJob() {
      //Substract one from the scrub job request counter
      std::atomic_fetch_sub(&scrubJobsRequested, (unsigned int)1);
      //Find jobs that have already terminated and scrub them
+     //cleanupJob() modifies the map, so collect the APIDs first
+     std::vector<uint64_t> terminatedJobs;
      typedef std::pair<uint64_t, ThreadTerminationInfo*> JobPair;
      for(const JobPair& jobPair: apTerminationInfo) {
-         //Cleanup job-related resources if it has been stopped already.
          if(jobPair.second->hasTerminated()) {
-             logger.trace("Scrubbing job with APID " + std::to_string(jobPair.first));
-             cleanupJob(jobPair.first);
+             terminatedJobs.push_back(jobPair.first);
+         }
+     }
+     //Cleanup job-related resources if it has been stopped already.
+     for(uint64_t apid : terminatedJobs) {
+         logger.trace("Scrubbing job with APID " + std::to_string(apid));
+         cleanupJob(apid);
+     }
+     //Expunge the statistics of jobs that have been cleaned up a long time ago
+     int64_t now = Logger::getCurrentLogTime();
+     for(auto it = apStatisticsInfo.begin(); it != apStatisticsInfo.end();) {
+         if(it->second->jobExpungeTime < now - (int64_t) cfg.statisticsExpungeTimeout) {
+             delete it->second;
+             it = apStatisticsInfo.erase(it);
+         } else {
+             ++it;
          }
      }
 }
@@ -0,0 +1,327 @@
+#include "Bitmap.hpp"
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <immintrin.h>
+#include "macros.hpp"
+
+/**
+ * Process the bytes that do not fill a vector register using 64-bit words
+ */
+static inline void applyScalar(BitwiseOperation operation, char* dst, const char* src, size_t n) {
+    size_t i = 0;
+    uint64_t a, b;
+    for (; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+        memcpy(&a, dst + i, sizeof(uint64_t));
+        memcpy(&b, src + i, sizeof(uint64_t));
+        switch (operation) {
+            case BitwiseOperation::And: a &= b; break;
+            case BitwiseOperation::Or: a |= b; break;
+            case BitwiseOperation::Xor: a ^= b; break;
+        }
+        memcpy(dst + i, &a, sizeof(uint64_t));
+    }
+    for (; i < n; i++) {
+        switch (operation) {
+            case BitwiseOperation::And: dst[i] &= src[i]; break;
+            case BitwiseOperation::Or: dst[i] |= src[i]; break;
+            case BitwiseOperation::Xor: dst[i] ^= src[i]; break;
+        }
+    }
+}
+
+static void HOT __attribute__((target("sse2"))) applySSE2(
+        BitwiseOperation operation, char* dst, const char* src, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+        switch (operation) {
+            case BitwiseOperation::And: a = _mm_and_si128(a, b); break;
+            case BitwiseOperation::Or: a = _mm_or_si128(a, b); break;
+            case BitwiseOperation::Xor: a = _mm_xor_si128(a, b); break;
+        }
+        _mm_storeu_si128((__m128i*)(dst + i), a);
+    }
+    applyScalar(operation, dst + i, src + i, n - i);
+}
+
+static void HOT __attribute__((target("avx2"))) applyAVX2(
+        BitwiseOperation operation, char* dst, const char* src, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i));
+        switch (operation) {
+            case BitwiseOperation::And: a = _mm256_and_si256(a, b); break;
+            case BitwiseOperation::Or: a = _mm256_or_si256(a, b); break;
+            case BitwiseOperation::Xor: a = _mm256_xor_si256(a, b); break;
+        }
+        _mm256_storeu_si256((__m256i*)(dst + i), a);
+    }
+    applyScalar(operation, dst + i, src + i, n - i);
+}
+
+void HOT applyBitwiseOperation(BitwiseOperation operation, char* dst, const char* src, size_t n) {
+    static const bool haveAVX2 = __builtin_cpu_supports("avx2");
+    static const bool haveSSE2 = __builtin_cpu_supports("sse2");
+    if (haveAVX2) {
+        applyAVX2(operation, dst, src, n);
+    } else if (haveSSE2) {
+        applySSE2(operation, dst, src, n);
+    } else {
+        applyScalar(operation, dst, src, n);
+    }
+}
+
+CompressedBitmapBuilder::CompressedBitmapBuilder(BitwiseOperation operation) :
+    operation(operation), initialized(false) {
+}
+
+static inline bool isZero(const char* data, size_t n) {
+    return n == 0 || (data[0] == 0 && memcmp(data, data + 1, n - 1) == 0);
+}
+
+bool CompressedBitmapBuilder::parse(const rocksdb::Slice& bitmap) {
+    views.clear();
+    if (bitmap.empty()) {
+        return true;
+    }
+    const char* pos = bitmap.data() + 1;
+    const char* end = bitmap.data() + bitmap.size();
+    if (bitmap[0] == '\x00') {
+        //Raw bitmap: Every 8 KiB chunk is a container. Empty chunks are skipped
+        size_t size = end - pos;
+        if (size > (size_t) 65536 * compressedBitmapContainerBytes) {
+            return false;
+        }
+        for (size_t offset = 0; offset < size; offset += compressedBitmapContainerBytes) {
+            size_t chunkSize = std::min(compressedBitmapContainerBytes, size - offset);
+            if (!isZero(pos + offset, chunkSize)) {
+                views.push_back({(uint16_t) (offset / compressedBitmapContainerBytes),
+                                 false, pos + offset, chunkSize});
+            }
+        }
+        return true;
+    } else if (bitmap[0] != '\x01') {
+        return false;
+    }
+    while (pos < end) {
+        if (end - pos < 4) {
+            return false;
+        }
+        uint16_t key, cardinalityMinusOne;
+        memcpy(&key, pos, sizeof(uint16_t));
+        memcpy(&cardinalityMinusOne, pos + 2, sizeof(uint16_t));
+        pos += 4;
+        size_t cardinality = (size_t) cardinalityMinusOne + 1;
+        bool isArray = cardinality <= compressedBitmapArrayMaximum;
+        size_t dataSize = isArray ? cardinality * sizeof(uint16_t) : compressedBitmapContainerBytes;
+        if ((size_t) (end - pos) < dataSize || (!views.empty() && views.back().key >= key)) {
+            return false;
+        }
+        //The array entries must be strictly ascending for the sorted set operations
+        if (isArray) {
+            uint16_t previous, bit;
+            memcpy(&previous, pos, sizeof(uint16_t));
+            for (size_t i = 1; i < cardinality; i++) {
+                memcpy(&bit, pos + i * sizeof(uint16_t), sizeof(uint16_t));
+                if (bit <= previous) {
+                    return false;
+                }
+                previous = bit;
+            }
+        }
+        views.push_back({key, isArray, pos, isArray ? cardinality : dataSize});
+        pos += dataSize;
+    }
+    return true;
+}
+
+static inline void loadArray(const char* data, size_t n, std::vector<uint16_t>& dst) {
+    dst.resize(n);
+    memcpy(dst.data(), data, n * sizeof(uint16_t));
+}
+
+static inline bool testBit(const char* bitmap, size_t size, uint16_t bit) {
+    return (size_t) (bit >> 3) < size && (bitmap[bit >> 3] & (1 << (bit & 7)));
+}
+
+void CompressedBitmapBuilder::toBitmap(Container& container) {
+    container.bitmap.assign(compressedBitmapContainerBytes, '\0');
+    for (uint16_t bit : container.array) {
+        container.bitmap[bit >> 3] |= (char) (1 << (bit & 7));
+    }
+    container.array.clear();
+}
+
+void CompressedBitmapBuilder::assign(const ContainerView& view, Container& container) {
+    if (view.isArray) {
+        loadArray(view.data, view.size, container.array);
+        container.bitmap.clear();
+    } else {
+        container.bitmap.assign(compressedBitmapContainerBytes, '\0');
+        memcpy(&container.bitmap[0], view.data, view.size);
+        container.array.clear();
+    }
+}
+
+void HOT CompressedBitmapBuilder::apply(const ContainerView& view, Container& container) {
+    if (!container.bitmap.empty()) {
+        char* dst = &container.bitmap[0];
+        if (!view.isArray) {
+            applyBitwiseOperation(operation, dst, view.data, view.size);
+            //Raw bitmaps may end within the container
+            if (operation == BitwiseOperation::And) {
+                memset(dst + view.size, 0, compressedBitmapContainerBytes - view.size);
+            }
+            return;
+        }
+        loadArray(view.data, view.size, operand);
+        if (operation == BitwiseOperation::And) {
+            //The result has at most as many bits as the array
+            container.array.clear();
+            for (uint16_t bit : operand) {
+                if (testBit(dst, compressedBitmapContainerBytes, bit)) {
+                    container.array.push_back(bit);
+                }
+            }
+            container.bitmap.clear();
+        } else {
+            //Set or toggle the bits directly
+            for (uint16_t bit : operand) {
+                if (operation == BitwiseOperation::Or) {
+                    dst[bit >> 3] |= (char) (1 << (bit & 7));
+                } else {
+                    dst[bit >> 3] ^= (char) (1 << (bit & 7));
+                }
+            }
+        }
+        return;
+    }
+    std::vector<uint16_t>& array = container.array;
+    if (!view.isArray) {
+        if (operation == BitwiseOperation::And) {
+            merged.clear();
+            for (uint16_t bit : array) {
+                if (testBit(view.data, view.size, bit)) {
+                    merged.push_back(bit);
+                }
+            }
+            array.swap(merged);
+        } else {
+            toBitmap(container);
+            applyBitwiseOperation(operation, &container.bitmap[0], view.data, view.size);
+        }
+        return;
+    }
+    //Both containers are sorted arrays
+    loadArray(view.data, view.size, operand);
+    merged.clear();
+    switch (operation) {
+        case BitwiseOperation::And:
+            std::set_intersection(array.begin(), array.end(),
+                                  operand.begin(), operand.end(), std::back_inserter(merged));
+            break;
+        case BitwiseOperation::Or:
+            std::set_union(array.begin(), array.end(),
+                           operand.begin(), operand.end(), std::back_inserter(merged));
+            break;
+        case BitwiseOperation::Xor:
+            std::set_symmetric_difference(array.begin(), array.end(),
+                                          operand.begin(), operand.end(), std::back_inserter(merged));
+            break;
+    }
+    array.swap(merged);
+    if (array.size() > compressedBitmapArrayMaximum) {
+        toBitmap(container);
+    }
+}
+
+bool HOT CompressedBitmapBuilder::add(const rocksdb::Slice& bitmap) {
+    if (!parse(bitmap)) {
+        return false;
+    }
+    if (!initialized) {
+        for (const ContainerView& view : views) {
+            assign(view, containers[view.key]);
+        }
+        initialized = true;
+        return true;
+    }
+    if (operation == BitwiseOperation::And) {
+        //Containers not present in the bitmap are cleared
+        auto view = views.begin();
+        for (auto it = containers.begin(); it != containers.end();) {
+            while (view != views.end() && view->key < it->first) {
+                ++view;
+            }
+            if (view == views.end() || view->key != it->first) {
+                it = containers.erase(it);
+                continue;
+            }
+            apply(*view, it->second);
+            ++it;
+        }
+        return true;
+    }
+    for (const ContainerView& view : views) {
+        auto it = containers.find(view.key);
+        if (it == containers.end()) {
+            //0 | x = 0 ^ x = x
+            assign(view, containers[view.key]);
+        } else {
+            apply(view, it->second);
+        }
+    }
+    return true;
+}
+
+void CompressedBitmapBuilder::finish(std::string& dst) {
+    static const size_t numWords = compressedBitmapContainerBytes / sizeof(uint64_t);
+    dst.clear();
+    dst.push_back('\x01');
+    for (const auto& container : containers) {
+        uint16_t key = container.first;
+        uint16_t cardinalityMinusOne;
+        const std::vector<uint16_t>& array = container.second.array;
+        if (container.second.bitmap.empty()) {
+            if (array.empty()) {
+                continue;
+            }
+            cardinalityMinusOne = (uint16_t) (array.size() - 1);
+            dst.append((const char*) &key, sizeof(uint16_t));
+            dst.append((const char*) &cardinalityMinusOne, sizeof(uint16_t));
+            dst.append((const char*) array.data(), array.size() * sizeof(uint16_t));
+            continue;
+        }
+        //AND and XOR may have cleared bits, so the bitmap might fit into an array now
+        const char* data = container.second.bitmap.data();
+        uint64_t words[numWords];
+        memcpy(words, data, compressedBitmapContainerBytes);
+        size_t cardinality = 0;
+        for (size_t i = 0; i < numWords; i++) {
+            cardinality += __builtin_popcountll(words[i]);
+        }
+        if (cardinality == 0) {
+            continue;
+        }
+        cardinalityMinusOne = (uint16_t) (cardinality - 1);
+        dst.append((const char*) &key, sizeof(uint16_t));
+        dst.append((const char*) &cardinalityMinusOne, sizeof(uint16_t));
+        if (cardinality > compressedBitmapArrayMaximum) {
+            dst.append(data, compressedBitmapContainerBytes);
+            continue;
+        }
+        for (size_t i = 0; i < numWords; i++) {
+            uint64_t word = words[i];
+            while (word != 0) {
+                uint16_t bit = (uint16_t) (i * 64 + __builtin_ctzll(word));
+                dst.append((const char*) &bit, sizeof(uint16_t));
+                word &= word - 1;
+            }
+        }
+    }
+    containers.clear();
+    initialized = false;
+}
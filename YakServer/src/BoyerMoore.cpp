@@ -28,15 +28,15 @@ void BoyerMooreHorspoolSearcher::initializeSkipTable() {
     }
 }
 
-const int BoyerMooreHorspoolSearcher::find(const char* corpus) {
+int64_t BoyerMooreHorspoolSearcher::find(const char* corpus) const {
     return find(corpus, strlen(corpus));
 }
 
-const int BoyerMooreHorspoolSearcher::find(const std::string& corpus) {
+int64_t BoyerMooreHorspoolSearcher::find(const std::string& corpus) const {
     return find(corpus.c_str(), corpus.size());
 }
 
-const int BoyerMooreHorspoolSearcher::find(const char* corpus, size_t corpusLength) {
+int64_t BoyerMooreHorspoolSearcher::find(const char* corpus, size_t corpusLength) const {
     assert(corpus);
     //Shortcut if there's an empty pattern (--> we DEFINE that as not found)
     if(patternLength == 0) {
@@ -46,16 +46,17 @@ const int BoyerMooreHorspoolSearcher::find(const char* corpus, size_t corpusLeng
     if (patternLength > corpusLength) {
         return -1;
     }
-    for(int k = patternLength - 1 ; k < (int)corpusLength ; ) {
-        int j = patternLength - 1;
-        int i = k;
-        while (j >= 0 && corpus[i] == pattern[j]) {
+    //Use size_t offsets to support corpora larger than 2 GiB
+    for(size_t k = patternLength - 1 ; k < corpusLength ; ) {
+        size_t j = patternLength - 1;
+        size_t i = k;
+        while (corpus[i] == pattern[j]) {
+            if (j == 0) {
+                return i;
+            }
             j--;
             i--;
         }
-        if (j == -1) {
-            return i + 1;
-        }
         k += skipTable[(uint8_t)corpus[k]];
     }
     //Couldn't find it 
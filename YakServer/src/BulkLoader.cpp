@@ -0,0 +1,141 @@
+#include "BulkLoader.hpp"
+#include <cstdio>
+#include <atomic>
+#include <rocksdb/merge_operator.h>
+
+/**
+ * The SST files of all update workers are created with unique names
+ */
+static std::atomic<uint64_t> sstFileCounter(0);
+
+BulkLoader::BulkLoader(rocksdb::DB* dbParam,
+                       const std::string& fileBasenameParam,
+                       uint64_t runSizeParam,
+                       bool inputSortedParam,
+                       bool mergeRequiredParam,
+                       KeyCounter* keyCounterParam) :
+                            db(dbParam),
+                            fileBasename(fileBasenameParam),
+                            runSize(runSizeParam),
+                            inputSorted(inputSortedParam),
+                            mergeRequired(mergeRequiredParam),
+                            keyCounter(keyCounterParam),
+                            ingestedFileCount(0) {
+    rocksdb::Options options = db->GetOptions();
+    sstFileWriter.reset(new rocksdb::SstFileWriter(rocksdb::EnvOptions(options), options));
+    mergeOperator = options.merge_operator;
+}
+
+BulkLoader::~BulkLoader() {
+    if (!sstFilename.empty()) {
+        sstFileWriter.reset();
+        remove(sstFilename.c_str());
+    }
+}
+
+bool BulkLoader::add(const rocksdb::Slice& key, const rocksdb::Slice& value) {
+    if (inputSorted) {
+        return writeRecord(key, value);
+    }
+    run.add(key, value);
+    if (run.getDataSize() >= runSize) {
+        return writeRun();
+    }
+    return true;
+}
+
+bool BulkLoader::finish() {
+    if (!run.isEmpty() && !writeRun()) {
+        return false;
+    }
+    if (!sstFilename.empty()) {
+        return ingestFile();
+    }
+    return true;
+}
+
+bool BulkLoader::writeRecord(const rocksdb::Slice& key, const rocksdb::Slice& value) {
+    if (sstFilename.empty()) {
+        sstFilename = fileBasename + std::to_string(sstFileCounter++) + ".sst";
+        status = sstFileWriter->Open(sstFilename);
+        if (!status.ok()) {
+            sstFilename.clear();
+            return false;
+        }
+    }
+    status = mergeRequired ? sstFileWriter->Merge(key, value) : sstFileWriter->Put(key, value);
+    if (!status.ok()) {
+        return false;
+    }
+    //The existence of the key is checked before the file is ingested
+    if (keyCounter != nullptr) {
+        fileKeys.emplace_back(key.data(), key.size());
+    }
+    if (sstFileWriter->FileSize() >= runSize) {
+        return ingestFile();
+    }
+    return true;
+}
+
+bool BulkLoader::writeRun() {
+    /**
+     * With the REPLACE merge operator, only the last record for a key matters.
+     * Otherwise all values need to be merged in order. They are folded into
+     * a single operand using the partial merge of the table's merge operator,
+     * so every key is written once. A SST file can only contain one record per key,
+     * so if the operator can't merge the values partially, a new file is started
+     * for every further value. The files overlap in that key only and are ingested in order.
+     */
+    run.sort(mergeRequired);
+    auto writeKey = [this](const rocksdb::Slice& key, const std::deque<rocksdb::Slice>& values) -> bool {
+        if (values.size() == 1) {
+            return writeRecord(key, values.front());
+        }
+        mergedValue.clear();
+        if (mergeOperator->PartialMergeMulti(key, values, &mergedValue, nullptr)) {
+            return writeRecord(key, mergedValue);
+        }
+        for (size_t i = 0; i < values.size(); i++) {
+            if (i > 0 && !sstFilename.empty() && !ingestFile()) {
+                return false;
+            }
+            if (!writeRecord(key, values[i])) {
+                return false;
+            }
+        }
+        return true;
+    };
+    bool success = run.forEachKey(writeKey);
+    run.clear();
+    //The next run is sorted independently, so its keys overlap with this file
+    if (success && !sstFilename.empty()) {
+        success = ingestFile();
+    }
+    return success;
+}
+
+bool BulkLoader::ingestFile() {
+    status = sstFileWriter->Finish();
+    if (status.ok()) {
+        //Other writes to the table are blocked while the keys are counted and ingested
+        KeyCountTracker keyCountTracker(keyCounter, db);
+        for (const std::string& key : fileKeys) {
+            keyCountTracker.recordPut(key);
+        }
+        rocksdb::IngestExternalFileOptions ingestOptions;
+        ingestOptions.move_files = true;
+        status = db->IngestExternalFile({sstFilename}, ingestOptions);
+        if (status.ok()) {
+            keyCountTracker.apply();
+        }
+    }
+    fileKeys.clear();
+    //If the file has not been moved (e.g. because of an error), remove it
+    remove(sstFilename.c_str());
+    sstFilename.clear();
+    if (!status.ok()) {
+        return false;
+    }
+    ingestedFileCount++;
+    return true;
+}
@@ -16,7 +16,8 @@ ClientSidePassiveJob::ClientSidePassiveJob(void* ctxParam,
              uint64_t scanLimitParam,
              Tablespace& tablespace,
              ThreadTerminationInfo* tti,
-             ThreadStatisticsInfo* statisticsInfo) :
+             ThreadStatisticsInfo* statisticsInfo,
+             SharedSnapshot snapshotParam) :
                     inSocket(zmq_socket(ctxParam, ZMQ_PAIR)),
                     outSocket(zmq_socket_new_connect(ctxParam, ZMQ_PUSH, externalRequestProxyEndpoint)),
                     keyMsgBuffer(new zmq_msg_t[chunksizeParam]),
@@ -25,6 +26,7 @@ ClientSidePassiveJob::ClientSidePassiveJob(void* ctxParam,
                     scanLimit(scanLimitParam),
                     chunksize(chunksizeParam),
                     db(tablespace.getTable(tableId, ctxParam)),
+                    snapshot(snapshotParam ? snapshotParam : createSharedSnapshot(db)),
                     tti(tti),
                     threadStatisticsInfo(statisticsInfo),
                     logger(ctxParam, "AP worker " + std::to_string(apid)),
@@ -34,19 +36,24 @@ ClientSidePassiveJob::ClientSidePassiveJob(void* ctxParam,
         zmq_connect(inSocket, endpoint.c_str());
         //Setup the snapshot and iterator
         rocksdb::ReadOptions options;
-        this->snapshot = (rocksdb::Snapshot*) db->GetSnapshot();
-        options.snapshot = this->snapshot;
+        options.snapshot = snapshot.get();
         it = db->NewIterator(options);
         //Seek the iterator
         if (rangeStart.empty()) {
-            it->Seek(rangeStart);
-        } else {
             it->SeekToFirst();
+        } else {
+            it->Seek(rangeStart);
         }
         logger.debug("Initialized client-side job with chunksize "
                      + std::to_string(chunksize));
     }
 
+ClientSidePassiveJob::SharedSnapshot ClientSidePassiveJob::createSharedSnapshot(rocksdb::DB* db) {
+    return SharedSnapshot(db->GetSnapshot(), [db](const rocksdb::Snapshot* snapshot) {
+        db->ReleaseSnapshot(snapshot);
+    });
+}
+
 void ClientSidePassiveJob::mainLoop() {
     bool haveRangeEnd = !(rangeEnd.empty());
     rocksdb::Slice rangeEndSlice(rangeEnd);
@@ -154,7 +161,7 @@ void ClientSidePassiveJob::mainLoop() {
 ClientSidePassiveJob::~ClientSidePassiveJob() {
     //Free DB-related memory
     delete it;
-    db->ReleaseSnapshot(snapshot);
+    snapshot.reset(); //Released if no other partition uses it any more
     //Free buffer memory
     delete[] keyMsgBuffer;
     delete[] valueMsgBuffer;
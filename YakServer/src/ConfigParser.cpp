@@ -8,6 +8,7 @@
 #include <map>
 #include <rocksdb/options.h>
 #include <iostream>
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include "macros.hpp"
 #include "ConfigParser.hpp"
@@ -184,6 +185,10 @@ std::string ConfigParser::getTableConfigFile(uint32_t tableIndex) const {
     return getTableDirectory(tableIndex) + ".cfg";
 }
 
+std::string ConfigParser::getTableKeyCounterFile(uint32_t tableIndex) const {
+    return getTableDirectory(tableIndex) + ".keycounts";
+}
+
 unsigned long long ConfigParser::safeStoull(std::map<std::string, std::string>& cfg, const std::string& cfgKey) {
     const std::string& value = cfg[cfgKey];
     try {
@@ -208,6 +213,25 @@ int ConfigParser::safeStoi(std::map<std::string, std::string>& cfg, const std::s
     }
 }
 
+unsigned int ConfigParser::parseThreadCount(std::map<std::string, std::string>& cfg, const std::string& cfgKey) {
+    if(cfg[cfgKey] == "auto") {
+        //hardware_concurrency() may return 0 if it can't be determined
+        return std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    return safeStoull(cfg, cfgKey);
+}
+
+unsigned int ConfigParser::parseMaxThreadCount(std::map<std::string, std::string>& cfg,
+                                               const std::string& cfgKey, unsigned int minThreads) {
+    unsigned int maxThreads = std::max(minThreads, parseThreadCount(cfg, cfgKey));
+    if(maxThreads == 0) {
+        cerr << "\x1B[33m[Warn] Config key '" << cfgKey
+             << "' must not be 0\x1B[0;30m\n" << endl;
+        exit(1);
+    }
+    return maxThreads;
+}
+
 COLD ConfigParser::ConfigParser(int argc, char** argv) {
     //Handle --help or -h
     if(argc >= 2 &&
@@ -242,19 +266,67 @@ COLD ConfigParser::ConfigParser(int argc, char** argv) {
     logFile = cfg["Logging.log-file"];
     //Statistics options
     statisticsExpungeTimeout = safeStoull(cfg, "Statistics.expunge-timeout");
+    enableTableStatistics = parseBool(cfg["Statistics.table-statistics"]);
     //ZMQ options
     //FIXME Using space with token_compress=on seems a bit hackish. Could it cause errors?
     split(repEndpoints, cfg["ZMQ.rep-endpoints"], is_any_of(", "), token_compress_on);
     split(pullEndpoints, cfg["ZMQ.pull-endpoints"], is_any_of(", "), token_compress_on);
     split(subEndpoints, cfg["ZMQ.sub-endpoints"], is_any_of(", "), token_compress_on);
+    split(subConnectEndpoints, cfg["ZMQ.sub-connect-endpoints"], is_any_of(", "), token_compress_on);
+    //An empty topic list yields a single empty topic --> Subscribe to all messages
+    split(subTopics, cfg["ZMQ.sub-topics"], is_any_of(", "), token_compress_on);
+    split(watchEndpoints, cfg["ZMQ.watch-endpoints"], is_any_of(", "), token_compress_on);
+    if(watchEndpoints.size() == 1 && watchEndpoints[0].empty()) {
+        watchEndpoints.clear();
+    }
+    watchValues = parseBool(cfg["ZMQ.watch-values"]);
     zmqIPv4Only = parseBool(cfg["ZMQ.ipv4-only"]);
     externalRCVHWM = safeStoi(cfg, "ZMQ.external-rcv-hwm");
     externalSNDHWM = safeStoi(cfg, "ZMQ.external-snd-hwm");
     internalRCVHWM = safeStoi(cfg, "ZMQ.internal-rcv-hwm");
     internalSNDHWM = safeStoi(cfg, "ZMQ.internal-snd-hwm");
+    //Worker thread options
+    readWorkerThreads = parseThreadCount(cfg, "Workers.read-threads");
+    readWorkerThreadsMax = parseMaxThreadCount(cfg,
+        "Workers.read-threads-max", readWorkerThreads);
+    scanWorkerThreads = parseThreadCount(cfg, "Workers.scan-threads");
+    scanWorkerThreadsMax = parseMaxThreadCount(cfg,
+        "Workers.scan-threads-max", scanWorkerThreads);
+    updateWorkerThreads = parseThreadCount(cfg, "Workers.update-threads");
+    updateWorkerThreadsMax = parseMaxThreadCount(cfg,
+        "Workers.update-threads-max", updateWorkerThreads);
+    longUpdateWorkerThreads = parseThreadCount(cfg, "Workers.long-update-threads");
+    longUpdateWorkerThreadsMax = parseMaxThreadCount(cfg,
+        "Workers.long-update-threads-max", longUpdateWorkerThreads);
+    asyncJobThreads = parseThreadCount(cfg, "Workers.async-threads");
+    workerScaleUpQueueDepth = safeStoull(cfg, "Workers.scale-up-queue-depth");
+    workerIdleTimeout = safeStoull(cfg, "Workers.idle-timeout");
+    groupCommitMaxBytes = safeStoull(cfg, "Workers.group-commit-max-bytes");
+    groupCommitDelay = safeStoull(cfg, "Workers.group-commit-delay");
+    if(cfg["Workers.update-sharding"] == "none") {
+        updateSharding = UpdateSharding::NoSharding;
+    } else if(cfg["Workers.update-sharding"] == "table") {
+        updateSharding = UpdateSharding::TableSharding;
+    } else if(cfg["Workers.update-sharding"] == "key") {
+        updateSharding = UpdateSharding::KeySharding;
+    } else {
+        cerr << "\x1B[33m[Warn] Can't parse update sharding configuration '"
+             << cfg["Workers.update-sharding"] << "'\x1B[0;30m\n" << endl;
+        exit(1);
+    }
     //Table options
     useMMapReads = parseBool(cfg["RocksDB.use-mmap-reads"]);
     useMMapWrites = parseBool(cfg["RocksDB.use-mmap-writes"]);
+    pipelinedWrite = parseBool(cfg["RocksDB.pipelined-write"]);
+    unorderedWrite = parseBool(cfg["RocksDB.unordered-write"]);
+    if(pipelinedWrite && unorderedWrite) {
+        cerr << "\x1B[33m[Warn] RocksDB.pipelined-write and RocksDB.unordered-write"
+             << " can't be enabled at the same time\x1B[0;30m\n" << endl;
+        exit(1);
+    }
+    blockCacheSize = safeStoull(cfg, "RocksDB.lru-cache-size");
+    blockCacheShardBits = safeStoi(cfg, "RocksDB.lru-cache-shard-bits");
+    writeBufferManagerSize = safeStoull(cfg, "RocksDB.write-buffer-manager-size");
     defaultTableBlockSize = safeStoull(cfg, "RocksDB.table-block-size");
     defaultWriteBufferSize = safeStoull(cfg, "RocksDB.write-buffer-size");
     defaultBloomFilterBitsPerKey = safeStoull(cfg, "RocksDB.bloom-filter-bits-per-key");
@@ -264,6 +336,10 @@ COLD ConfigParser::ConfigParser(int argc, char** argv) {
     //RocksDB options
     compactionMemoryBudget = safeStoull(cfg, "RocksDB.compaction-memory-budget");
     putBatchSize = safeStoull(cfg, "RocksDB.put-batch-size");
+    putBatchBytes = safeStoull(cfg, "RocksDB.put-batch-bytes");
+    putBatchLatency = safeStoull(cfg, "RocksDB.put-batch-latency");
+    readBatchSize = safeStoull(cfg, "RocksDB.read-batch-size");
+    bulkLoadRunSize = safeStoull(cfg, "RocksDB.bulk-load-run-size");
     if(cfg["RocksDB.concurrency"] == "auto") {
         rocksdbConcurrency = std::thread::hardware_concurrency();
     } else {
@@ -0,0 +1,322 @@
+#include "CopyRangeJob.hpp"
+#include <thread>
+#include <cstdio>
+#include <algorithm>
+#include "KeyCounter.hpp"
+#include "ThreadUtil.hpp"
+#include "protocol.hpp"
+#include "zutil.hpp"
+
+CopyRangeJob::CopyRangeJob(void* ctxParam,
+             uint64_t apidParam,
+             uint32_t sourceTableId,
+             uint32_t targetTableId,
+             const ScanRange& rangeParam,
+             uint8_t writeFlags,
+             uint8_t copyFlags,
+             Tablespace& tablespace,
+             ConfigParser& cfgParam,
+             ThreadTerminationInfo* ttiParam,
+             ThreadStatisticsInfo* statisticsInfoParam) :
+                    readerFinished(false),
+                    aborted(false),
+                    apid(apidParam),
+                    range(rangeParam),
+                    chunkSize(std::max<uint32_t>(cfgParam.putBatchSize, 1)),
+                    synchronousDelete(isSynchronousDelete(copyFlags)),
+                    ingestFiles(isIngestExternalFiles(copyFlags)),
+                    mergeRequired(false),
+                    sourceTable(tablespace.getTable(sourceTableId, ctxParam)),
+                    targetTable(tablespace.getTable(targetTableId, ctxParam)),
+                    snapshot(sourceTable->GetSnapshot()),
+                    keyCounter(tablespace.getKeyCounter(targetTableId)),
+                    sstFileCount(0),
+                    sstFileSizeLimit(0),
+                    inSocket(zmq_socket(ctxParam, ZMQ_PAIR)),
+                    cfg(cfgParam),
+                    tti(ttiParam),
+                    statisticsInfo(statisticsInfoParam),
+                    logger(ctxParam, "Copy job " + std::to_string(apidParam)) {
+    //The socket the router sends the stop message to
+    std::string endpoint = "inproc://apid/" + std::to_string(apid);
+    zmq_connect(inSocket, endpoint.c_str());
+    writeOptions.sync = isFullsync(writeFlags);
+    mergeRequired = tablespace.isMergeRequired(targetTableId);
+    for (Chunk& chunk : chunkBuffers) {
+        freeChunks.push_back(&chunk);
+    }
+    /**
+     * Ingested files replace existing records instead of merging them and
+     * the key counters would need the existence of every key to be checked
+     * while holding the write lock, so write batches are used in these cases.
+     */
+    if (ingestFiles && (mergeRequired || keyCounter != nullptr)) {
+        logger.debug("Target table uses a merge operator or key counters, copying using write batches");
+        ingestFiles = false;
+    }
+    if (ingestFiles) {
+        rocksdb::Options targetOptions = targetTable->GetOptions();
+        sstFileSizeLimit = targetOptions.target_file_size_base;
+        sstFileWriter.reset(new rocksdb::SstFileWriter(rocksdb::EnvOptions(targetOptions), targetOptions));
+    }
+    //Estimate the size of the range to report the progress
+    std::string rangeEnd;
+    if (getExplicitRangeEnd(sourceTable, range, rangeEnd).ok() && !rangeEnd.empty()) {
+        rocksdb::Range keyRange(range.start, rangeEnd);
+        uint64_t rangeSize = 0;
+        sourceTable->GetApproximateSizes(sourceTable->DefaultColumnFamily(), &keyRange, 1, &rangeSize,
+            rocksdb::DB::SizeApproximationFlags::INCLUDE_FILES | rocksdb::DB::SizeApproximationFlags::INCLUDE_MEMTABLES);
+        statisticsInfo->expectedDataBytes = rangeSize;
+    }
+}
+
+void CopyRangeJob::run() {
+    //The reader fills the next chunks while the job thread writes
+    std::thread readerThread(&CopyRangeJob::readSourceRange, this);
+    bool success = !synchronousDelete || deleteTargetRange();
+    bool stopped = false;
+    Chunk* chunk;
+    while (success && (chunk = popFullChunk()) != nullptr) {
+        uint64_t chunkRecords = chunk->sizes.size();
+        uint64_t chunkDataSize = chunk->data.size();
+        success = ingestFiles ? writeChunkToSstFile(chunk) : writeChunk(chunk);
+        releaseChunk(chunk);
+        if (success) {
+            statisticsInfo->addTransferredRecords(chunkRecords);
+            statisticsInfo->addTransferredDataBytes(chunkDataSize);
+        }
+        if (success && isStopRequested()) {
+            logger.debug("Copy job received stop message, exiting");
+            stopped = true;
+            break;
+        }
+    }
+    if (!success || stopped) {
+        abort();
+    }
+    readerThread.join();
+    if (success && !stopped) {
+        success = checkStatus(readStatus, "Error while reading the source range");
+    }
+    //Ingest the last, partial file
+    if (success && !stopped && !sstFilename.empty()) {
+        success = ingestSstFile();
+    }
+    statisticsInfo->setFinished();
+    if (success && !stopped) {
+        uint64_t runtime = std::max<uint64_t>(statisticsInfo->getRuntime(), 1);
+        logger.debug("Copied " + std::to_string(statisticsInfo->transferredRecords) + " records ("
+            + std::to_string(statisticsInfo->transferredDataBytes * 1000 / runtime / (1024 * 1024))
+            + " MiB/s)");
+    }
+}
+
+void CopyRangeJob::readSourceRange() {
+    setCurrentThreadName("Yak copy reader");
+    rocksdb::ReadOptions readOptions;
+    readOptions.snapshot = snapshot;
+    readOptions.fill_cache = false; //Don't evict the working set of the source table
+    rocksdb::Iterator* it = sourceTable->NewIterator(readOptions);
+    Chunk* chunk = acquireFreeChunk();
+    auto readRecord = [&](const rocksdb::Slice& key, const rocksdb::Slice& value) -> bool {
+        chunk->add(key, value);
+        if (chunk->sizes.size() >= chunkSize) {
+            pushFullChunk(chunk);
+            chunk = acquireFreeChunk();
+            return chunk != nullptr;
+        }
+        return true;
+    };
+    if (chunk != nullptr && scanRange<true>(it, range, readRecord)) {
+        //Hand over the last, partial chunk
+        if (chunk->sizes.empty()) {
+            releaseChunk(chunk);
+        } else {
+            pushFullChunk(chunk);
+        }
+    }
+    readStatus = it->status();
+    delete it;
+    std::lock_guard<std::mutex> lock(queueMutex);
+    readerFinished = true;
+    queueCondition.notify_all();
+}
+
+bool CopyRangeJob::deleteTargetRange() {
+    rocksdb::ReadOptions readOptions;
+    readOptions.fill_cache = false; //Deleted data won't be read again
+    //The iterator uses an implicit snapshot, so deleting while iterating is safe.
+    rocksdb::Iterator* it = targetTable->NewIterator(readOptions);
+    rocksdb::WriteBatch batch;
+    KeyCountTracker keyCountTracker(keyCounter, targetTable);
+    auto deleteRecord = [&](const rocksdb::Slice& key, const rocksdb::Slice& value) -> bool {
+        batch.Delete(key);
+        keyCountTracker.recordDeleteExisting(key);
+        if (batch.Count() >= (int) chunkSize) {
+            if (!checkStatus(targetTable->Write(writeOptions, &batch),
+                    "Error while deleting the target range")) {
+                return false;
+            }
+            keyCountTracker.apply();
+            batch.Clear();
+        }
+        return true;
+    };
+    bool success = scanRange<false>(it, range, deleteRecord)
+        && checkStatus(it->status(), "Error while iterating the target range");
+    delete it;
+    if (!success || !checkStatus(targetTable->Write(writeOptions, &batch),
+            "Error while deleting the target range")) {
+        return false;
+    }
+    keyCountTracker.apply();
+    return true;
+}
+
+bool CopyRangeJob::writeChunk(Chunk* chunk) {
+    //Reserve the approximate batch size, so it doesn't need to grow
+    rocksdb::WriteBatch batch(chunk->data.size() + chunk->sizes.size() * 16);
+    KeyCountTracker keyCountTracker(keyCounter, targetTable);
+    auto writeRecord = [&](const rocksdb::Slice& key, const rocksdb::Slice& value) -> bool {
+        if (mergeRequired) {
+            batch.Merge(key, value);
+        } else { //A simple put is enough (REPLACE merge operator)
+            batch.Put(key, value);
+        }
+        keyCountTracker.recordPut(key);
+        return true;
+    };
+    chunk->forEach(writeRecord);
+    if (!checkStatus(targetTable->Write(writeOptions, &batch),
+            "Error while writing to the target table")) {
+        return false;
+    }
+    keyCountTracker.apply();
+    return true;
+}
+
+bool CopyRangeJob::writeChunkToSstFile(Chunk* chunk) {
+    if (sstFilename.empty()) {
+        //The file is moved into the table directory, so it must be on the same filesystem
+        sstFilename = cfg.tableSaveFolder + "copy-" + std::to_string(apid)
+            + "-" + std::to_string(sstFileCount++) + ".sst";
+        if (!checkStatus(sstFileWriter->Open(sstFilename), "Error while creating SST file")) {
+            sstFilename.clear();
+            return false;
+        }
+    }
+    //The chunks are in key order, as required by the SST file writer
+    auto writeRecord = [&](const rocksdb::Slice& key, const rocksdb::Slice& value) -> bool {
+        return checkStatus(sstFileWriter->Put(key, value), "Error while writing SST file");
+    };
+    if (!chunk->forEach(writeRecord)) {
+        return false;
+    }
+    if (sstFileWriter->FileSize() >= sstFileSizeLimit) {
+        return ingestSstFile();
+    }
+    return true;
+}
+
+bool CopyRangeJob::ingestSstFile() {
+    rocksdb::Status status = sstFileWriter->Finish();
+    if (status.ok()) {
+        rocksdb::IngestExternalFileOptions ingestOptions;
+        ingestOptions.move_files = true;
+        status = targetTable->IngestExternalFile({sstFilename}, ingestOptions);
+    }
+    //If the file has not been moved (e.g. because of an error), remove it
+    remove(sstFilename.c_str());
+    sstFilename.clear();
+    return checkStatus(status, "Error while ingesting SST file into the target table");
+}
+
+bool CopyRangeJob::isStopRequested() {
+    if (yak_interrupted) {
+        return true;
+    }
+    zmq_pollitem_t items[1];
+    items[0].socket = inSocket;
+    items[0].events = ZMQ_POLLIN;
+    if (zmq_poll(items, 1, 0) <= 0) {
+        return false;
+    }
+    //The router does not forward client requests to copy jobs, so this is a stop message
+    zmq_msg_t frame;
+    zmq_msg_init(&frame);
+    zmq_msg_recv(&frame, inSocket, 0);
+    zmq_msg_close(&frame);
+    return true;
+}
+
+bool CopyRangeJob::checkStatus(const rocksdb::Status& status, const char* description) {
+    if (likely(status.ok())) {
+        return true;
+    }
+    logger.error(std::string(description) + ": " + status.ToString());
+    statisticsInfo->failed = true;
+    return false;
+}
+
+CopyRangeJob::Chunk* CopyRangeJob::acquireFreeChunk() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    queueCondition.wait(lock, [this]() {
+        return aborted || !freeChunks.empty();
+    });
+    if (aborted) {
+        return nullptr;
+    }
+    Chunk* chunk = freeChunks.back();
+    freeChunks.pop_back();
+    return chunk;
+}
+
+void CopyRangeJob::pushFullChunk(Chunk* chunk) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    fullChunks.push_back(chunk);
+    queueCondition.notify_all();
+}
+
+CopyRangeJob::Chunk* CopyRangeJob::popFullChunk() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    queueCondition.wait(lock, [this]() {
+        return aborted || readerFinished || !fullChunks.empty();
+    });
+    if (aborted || fullChunks.empty()) {
+        return nullptr;
+    }
+    Chunk* chunk = fullChunks.front();
+    fullChunks.pop_front();
+    return chunk;
+}
+
+void CopyRangeJob::releaseChunk(Chunk* chunk) {
+    chunk->clear(); //Keeps the allocated memory
+    std::lock_guard<std::mutex> lock(queueMutex);
+    freeChunks.push_back(chunk);
+    queueCondition.notify_all();
+}
+
+void CopyRangeJob::abort() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    aborted = true;
+    queueCondition.notify_all();
+}
+
+CopyRangeJob::~CopyRangeJob() {
+    //Remove the partial SST file of a failed or stopped copy
+    if (!sstFilename.empty()) {
+        sstFileWriter.reset();
+        remove(sstFilename.c_str());
+    }
+    sourceTable->ReleaseSnapshot(snapshot);
+    statisticsInfo->setFinished();
+    //Copy jobs don't serve client requests, so they don't need a grace period.
+    tti->setWantToTerminate();
+    tti->setExited();
+    tti->requestScrubJob();
+    //The router does not send stop messages to exited jobs,
+    // so the socket can be closed after the exit flag has been set
+    zmq_close(inSocket);
+    logger.debug("Copy job exiting");
+}
@@ -0,0 +1,158 @@
+#include "KeyCounter.hpp"
+#include <fstream>
+#include <cstdio>
+#include <memory>
+#include "macros.hpp"
+
+KeyCounter::KeyCounter(uint32_t prefixLength) : prefixLength(prefixLength), total(0) {
+}
+
+void KeyCounter::add(const rocksdb::Slice& key, int64_t delta) {
+    total.fetch_add(delta, std::memory_order_relaxed);
+    if (prefixLength > 0) {
+        //Keys shorter than the prefix length are counted as their own prefix
+        std::string prefix(key.data(), std::min<size_t>(key.size(), prefixLength));
+        std::lock_guard<std::mutex> lock(prefixCountsMutex);
+        int64_t& count = prefixCounts[prefix];
+        count += delta;
+        if (count == 0) {
+            prefixCounts.erase(prefix);
+        }
+    }
+}
+
+bool KeyCounter::countPrefix(const rocksdb::Slice& prefix, uint64_t& count) const {
+    if (prefix.size() == 0) {
+        count = getTotal();
+        return true;
+    }
+    if (prefix.size() > prefixLength) {
+        return false;
+    }
+    //All counted prefixes starting with the requested prefix are adjacent
+    std::string prefixStr = prefix.ToString();
+    std::lock_guard<std::mutex> lock(prefixCountsMutex);
+    int64_t sum = 0;
+    for (auto it = prefixCounts.lower_bound(prefixStr);
+            it != prefixCounts.end() && rocksdb::Slice(it->first).starts_with(prefix); ++it) {
+        sum += it->second;
+    }
+    count = sum;
+    return true;
+}
+
+rocksdb::Status COLD KeyCounter::recount(rocksdb::DB* db) {
+    total.store(0);
+    {
+        std::lock_guard<std::mutex> lock(prefixCountsMutex);
+        prefixCounts.clear();
+    }
+    rocksdb::ReadOptions readOptions;
+    readOptions.fill_cache = false;
+    std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(readOptions));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        add(it->key(), 1);
+    }
+    return it->status();
+}
+
+bool COLD KeyCounter::load(const std::string& filename) {
+    std::ifstream fin(filename.c_str(), std::ios::binary);
+    if (!fin.good()) {
+        return false;
+    }
+    //Format: Prefix length, total, number of prefixes, (prefix size, prefix, count)*
+    uint32_t filePrefixLength;
+    int64_t fileTotal;
+    uint64_t numPrefixes;
+    fin.read((char*) &filePrefixLength, sizeof(filePrefixLength));
+    fin.read((char*) &fileTotal, sizeof(fileTotal));
+    fin.read((char*) &numPrefixes, sizeof(numPrefixes));
+    std::map<std::string, int64_t> filePrefixCounts;
+    for (uint64_t i = 0; fin.good() && i < numPrefixes; i++) {
+        uint32_t prefixSize;
+        int64_t count;
+        fin.read((char*) &prefixSize, sizeof(prefixSize));
+        if (!fin.good() || prefixSize > filePrefixLength) {
+            break;
+        }
+        std::string prefix(prefixSize, '\0');
+        fin.read(&prefix[0], prefixSize);
+        fin.read((char*) &count, sizeof(count));
+        filePrefixCounts[prefix] = count;
+    }
+    bool valid = fin.good() && filePrefixLength == prefixLength
+        && filePrefixCounts.size() == numPrefixes;
+    fin.close();
+    //The counters are invalid as soon as the table is modified
+    remove(filename.c_str());
+    if (!valid) {
+        return false;
+    }
+    total.store(fileTotal);
+    std::lock_guard<std::mutex> lock(prefixCountsMutex);
+    prefixCounts.swap(filePrefixCounts);
+    return true;
+}
+
+bool COLD KeyCounter::save(const std::string& filename) const {
+    std::ofstream fout(filename.c_str(), std::ios::binary);
+    std::lock_guard<std::mutex> lock(prefixCountsMutex);
+    int64_t totalValue = total.load();
+    uint64_t numPrefixes = prefixCounts.size();
+    fout.write((const char*) &prefixLength, sizeof(prefixLength));
+    fout.write((const char*) &totalValue, sizeof(totalValue));
+    fout.write((const char*) &numPrefixes, sizeof(numPrefixes));
+    for (const auto& prefixCount : prefixCounts) {
+        uint32_t prefixSize = prefixCount.first.size();
+        fout.write((const char*) &prefixSize, sizeof(prefixSize));
+        fout.write(prefixCount.first.data(), prefixSize);
+        fout.write((const char*) &prefixCount.second, sizeof(prefixCount.second));
+    }
+    fout.close();
+    return fout.good();
+}
+
+KeyCountTracker::KeyCountTracker(KeyCounter* counter, rocksdb::DB* db)
+    : counter(counter), db(db) {
+    if (counter != nullptr) {
+        writeLock = std::unique_lock<std::mutex>(counter->getWriteMutex());
+    }
+}
+
+void KeyCountTracker::record(const rocksdb::Slice& key, bool knownToExist, bool existsAfterWrite) {
+    std::string keyStr = key.ToString();
+    auto it = changes.find(keyStr);
+    if (it != changes.end()) {
+        //Already written in this batch, only the final state changes
+        it->second.second = existsAfterWrite;
+        return;
+    }
+    bool existedBefore = knownToExist;
+    if (!existedBefore) {
+        //Get uses the bloom filters to avoid most reads for new keys.
+        // The value is only pinned, not copied, because the mutex is held.
+        rocksdb::ReadOptions readOptions;
+        rocksdb::PinnableSlice value;
+        existedBefore = db->Get(readOptions, db->DefaultColumnFamily(), key, &value).ok();
+    }
+    changes.emplace(std::move(keyStr), std::make_pair(existedBefore, existsAfterWrite));
+}
+
+void KeyCountTracker::apply() {
+    if (counter == nullptr) {
+        return;
+    }
+    for (const auto& change : changes) {
+        int64_t delta = (int64_t) change.second.second - (int64_t) change.second.first;
+        if (delta != 0) {
+            counter->add(change.first, delta);
+        }
+    }
+    changes.clear();
+    //The counter only uses the prefix of the key
+    for (const auto& prefixDelta : prefixDeltas) {
+        counter->add(prefixDelta.first, prefixDelta.second);
+    }
+    prefixDeltas.clear();
+}
@@ -2,139 +2,232 @@
 #include "Logger.hpp"
 #include "macros.hpp"
 #include "MergeAlgorithms.hpp"
+#include "PostingList.hpp"
 
 #include <iostream>
-#include <set>
 #include <rocksdb/env.h>
-#include <boost/algorithm/string.hpp>
 #include <algorithm>
 
-bool HOT Int64AddOperator::Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const {
-    // assuming 0 if no existing value
-    int64_t existing = 0;
-    if (existing_value != nullptr) {
-        if (unlikely(existing_value->size() != sizeof(int64_t))) {
-            // if existing_value is corrupted, treat it as 0
-            Log(logger, "existing value corruption");
-            existing = 0;
-        } else {
-            memcpy(&existing, existing_value->data(), sizeof(int64_t));
-        }
-    }
-    int64_t operand;
-    if (unlikely(value.size() != sizeof(int64_t))) {
-        // if existing_value is corrupted, treat it as 0
-        Log(logger, "operand value corruption");
-        operand = 0;
+/**
+ * Read a fixed-size numeric value. Corrupted values are treated as 0.
+ */
+template<typename T>
+static inline T readNumericValue(const rocksdb::Slice& value,
+                                 const char* corruptionMessage,
+                                 rocksdb::Logger* logger) {
+    T result = 0;
+    if (likely(value.size() == sizeof(T))) {
+        memcpy(&result, value.data(), sizeof(T));
     } else {
-        memcpy(&operand, value.data(), sizeof(int64_t));
+        Log(logger, "%s", corruptionMessage);
+    }
+    return result;
+}
+
+/**
+ * Store a fixed-size numeric value, reusing the memory of the output string
+ */
+template<typename T>
+static inline void writeNumericValue(T value, std::string& dst) {
+    dst.assign((const char*) &value, sizeof(T));
+}
+
+/**
+ * Fold the existing value (0 if there is none) and all operands in one pass.
+ * This yields the same result as merging the operands one by one.
+ */
+template<typename T, typename Operation>
+static inline bool numericFullMerge(const rocksdb::MergeOperator::MergeOperationInput& merge_in,
+                                    rocksdb::MergeOperator::MergeOperationOutput* merge_out,
+                                    Operation operation) {
+    T result = 0;
+    if (merge_in.existing_value != nullptr) {
+        result = readNumericValue<T>(*merge_in.existing_value,
+            "existing value corruption", merge_in.logger);
     }
-    int64_t result = existing + operand;
-    *new_value = std::move(std::string((char*)&result, sizeof(int64_t)));
+    for (const rocksdb::Slice& operand : merge_in.operand_list) {
+        result = operation(result,
+            readNumericValue<T>(operand, "operand value corruption", merge_in.logger));
+    }
+    writeNumericValue(result, merge_out->new_value);
     //Errors are treated as 0.
     return true;
 }
 
+/**
+ * Fold a sequence of operands into a single operand.
+ */
+template<typename T, typename Operation, typename Iterator>
+static inline bool numericPartialMerge(Iterator begin, Iterator end,
+                                       std::string* new_value,
+                                       rocksdb::Logger* logger,
+                                       Operation operation) {
+    if (begin == end) {
+        return false;
+    }
+    T result = readNumericValue<T>(*begin, "operand value corruption", logger);
+    for (++begin; begin != end; ++begin) {
+        result = operation(result, readNumericValue<T>(*begin, "operand value corruption", logger));
+    }
+    writeNumericValue(result, *new_value);
+    return true;
+}
+
+/**
+ * Two's complement add. Signed overflow would be undefined behaviour.
+ */
+static inline int64_t int64Add(int64_t a, int64_t b) {
+    return (int64_t) ((uint64_t) a + (uint64_t) b);
+}
+
+static inline double doubleAdd(double a, double b) {
+    return a + b;
+}
+
+static inline double doubleMultiply(double a, double b) {
+    return a * b;
+}
+
+bool HOT Int64AddOperator::FullMergeV2(const MergeOperationInput& merge_in,
+                                       MergeOperationOutput* merge_out) const {
+    return numericFullMerge<int64_t>(merge_in, merge_out, int64Add);
+}
+
+bool HOT Int64AddOperator::PartialMerge(const rocksdb::Slice& key,
+                                        const rocksdb::Slice& left_operand,
+                                        const rocksdb::Slice& right_operand,
+                                        std::string* new_value,
+                                        rocksdb::Logger* logger) const {
+    const rocksdb::Slice operands[] = {left_operand, right_operand};
+    return numericPartialMerge<int64_t>(operands, operands + 2, new_value, logger, int64Add);
+}
+
+bool HOT Int64AddOperator::PartialMergeMulti(const rocksdb::Slice& key,
+                                             const std::deque<rocksdb::Slice>& operand_list,
+                                             std::string* new_value,
+                                             rocksdb::Logger* logger) const {
+    return numericPartialMerge<int64_t>(operand_list.begin(), operand_list.end(),
+                                        new_value, logger, int64Add);
+}
+
 const char* Int64AddOperator::Name() const {
     return "Int64 add";
 }
 
-bool HOT DMulOperator::Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const {
-    //Assuming 0 if no existing value
-    double existing = 0;
-    if (existing_value) {
-        if (unlikely(existing_value->size() != sizeof(double))) {
-            // if existing_value is corrupted, treat it as 0
-            Log(logger, "existing value corruption");
-            existing = 0;
-        } else {
-            memcpy(&existing, existing_value->data(), sizeof(double));
-        }
-    }
+bool HOT DMulOperator::FullMergeV2(const MergeOperationInput& merge_in,
+                                   MergeOperationOutput* merge_out) const {
+    return numericFullMerge<double>(merge_in, merge_out, doubleMultiply);
+}
 
-    double operand;
-    if (unlikely(value.size() != sizeof(double))) {
-        // if existing_value is corrupted, treat it as 0
-        Log(logger, "operand value corruption");
-        operand = 0;
-    } else {
-        memcpy(&operand, value.data(), sizeof(double));
-    }
+bool HOT DMulOperator::PartialMerge(const rocksdb::Slice& key,
+                                    const rocksdb::Slice& left_operand,
+                                    const rocksdb::Slice& right_operand,
+                                    std::string* new_value,
+                                    rocksdb::Logger* logger) const {
+    const rocksdb::Slice operands[] = {left_operand, right_operand};
+    return numericPartialMerge<double>(operands, operands + 2, new_value, logger, doubleMultiply);
+}
 
-    double result = existing * operand;
-    *new_value = std::move(std::string((char*)&result, sizeof(double)));
-    //Errors are treated as 0.
-    return true;
+bool HOT DMulOperator::PartialMergeMulti(const rocksdb::Slice& key,
+                                         const std::deque<rocksdb::Slice>& operand_list,
+                                         std::string* new_value,
+                                         rocksdb::Logger* logger) const {
+    return numericPartialMerge<double>(operand_list.begin(), operand_list.end(),
+                                       new_value, logger, doubleMultiply);
 }
 
 const char* DMulOperator::Name() const {
     return "Double multiplication";
 }
 
-bool HOT DAddOperator::Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const {
-    //Assuming 0 if no existing value
-    double existing = 0;
-    if (existing_value) {
-        if (unlikely(existing_value->size() != sizeof(double))) {
-            // if existing_value is corrupted, treat it as 0
-            Log(logger, "existing value corruption");
-            existing = 0;
-        } else {
-            memcpy(&existing, existing_value->data(), sizeof(double));
-        }
-    }
+bool HOT DAddOperator::FullMergeV2(const MergeOperationInput& merge_in,
+                                   MergeOperationOutput* merge_out) const {
+    return numericFullMerge<double>(merge_in, merge_out, doubleAdd);
+}
 
-    double operand;
-    if (unlikely(value.size() != sizeof(double))) {
-        // if existing_value is corrupted, treat it as 0
-        Log(logger, "operand value corruption");
-        operand = 0;
-    } else {
-        memcpy(&operand, value.data(), sizeof(double));
-    }
+bool HOT DAddOperator::PartialMerge(const rocksdb::Slice& key,
+                                    const rocksdb::Slice& left_operand,
+                                    const rocksdb::Slice& right_operand,
+                                    std::string* new_value,
+                                    rocksdb::Logger* logger) const {
+    const rocksdb::Slice operands[] = {left_operand, right_operand};
+    return numericPartialMerge<double>(operands, operands + 2, new_value, logger, doubleAdd);
+}
 
-    double result = existing + operand;
-    *new_value = std::move(std::string((char*)&result, sizeof(double)));
-    //Errors are treated as 0.
-    return true;
+bool HOT DAddOperator::PartialMergeMulti(const rocksdb::Slice& key,
+                                         const std::deque<rocksdb::Slice>& operand_list,
+                                         std::string* new_value,
+                                         rocksdb::Logger* logger) const {
+    return numericPartialMerge<double>(operand_list.begin(), operand_list.end(),
+                                       new_value, logger, doubleAdd);
 }
 
 const char* DAddOperator::Name() const {
     return "Double add";
 }
 
-bool HOT AppendOperator::Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const {
-    // assuming empty if no existing value
-    std::string existing;
-    if (existing_value) {
-        existing = existing_value->ToString();
+/**
+ * Start a full merge result with the existing value (if any),
+ * reserving the final size so the operands can be appended without reallocation.
+ */
+static inline void initializeAppendResult(const rocksdb::MergeOperator::MergeOperationInput& merge_in,
+                                          std::string& result,
+                                          size_t operandOverhead) {
+    size_t resultSize = merge_in.existing_value == nullptr ? 0 : merge_in.existing_value->size();
+    for (const rocksdb::Slice& operand : merge_in.operand_list) {
+        resultSize += operand.size() + operandOverhead;
+    }
+    result.clear();
+    result.reserve(resultSize);
+    if (merge_in.existing_value != nullptr) {
+        result.append(merge_in.existing_value->data(), merge_in.existing_value->size());
     }
+}
 
-    *new_value = std::move(existing + value.ToString());
-    //Errors are treated as 0.
+/**
+ * Concatenate a sequence of operands into a single operand
+ */
+template<typename Iterator>
+static inline bool concatenateOperands(Iterator begin, Iterator end, std::string* new_value) {
+    size_t resultSize = 0;
+    for (Iterator it = begin; it != end; ++it) {
+        resultSize += it->size();
+    }
+    new_value->clear();
+    new_value->reserve(resultSize);
+    for (; begin != end; ++begin) {
+        new_value->append(begin->data(), begin->size());
+    }
     return true;
 }
 
+bool HOT AppendOperator::FullMergeV2(const MergeOperationInput& merge_in,
+                                     MergeOperationOutput* merge_out) const {
+    //Assuming empty if no existing value
+    std::string& result = merge_out->new_value;
+    initializeAppendResult(merge_in, result, 0);
+    for (const rocksdb::Slice& operand : merge_in.operand_list) {
+        result.append(operand.data(), operand.size());
+    }
+    return true;
+}
+
+bool HOT AppendOperator::PartialMerge(const rocksdb::Slice& key,
+                                      const rocksdb::Slice& left_operand,
+                                      const rocksdb::Slice& right_operand,
+                                      std::string* new_value,
+                                      rocksdb::Logger* logger) const {
+    const rocksdb::Slice operands[] = {left_operand, right_operand};
+    return concatenateOperands(operands, operands + 2, new_value);
+}
+
+bool HOT AppendOperator::PartialMergeMulti(const rocksdb::Slice& key,
+                                           const std::deque<rocksdb::Slice>& operand_list,
+                                           std::string* new_value,
+                                           rocksdb::Logger* logger) const {
+    return concatenateOperands(operand_list.begin(), operand_list.end(), new_value);
+}
+
 const char* AppendOperator::Name() const {
     return "AppendOperator";
 }
@@ -158,275 +251,340 @@ const char* ListAppendOperator::Name() const {
     return "List append";
 }
 
-bool HOT ListAppendOperator::Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const {
-    // assuming empty if no existing value
-    std::string existing;
-    if (existing_value) {
-        existing = existing_value->ToString();
+bool HOT ListAppendOperator::FullMergeV2(const MergeOperationInput& merge_in,
+                                         MergeOperationOutput* merge_out) const {
+    //Assuming empty if no existing value
+    std::string& result = merge_out->new_value;
+    initializeAppendResult(merge_in, result, sizeof(uint32_t));
+    for (const rocksdb::Slice& operand : merge_in.operand_list) {
+        //Note that it is not inherently safe to assume the new value size is < 4 GiB
+        uint32_t operandLength = operand.size();
+        result.append((const char*) &operandLength, sizeof(uint32_t));
+        result.append(operand.data(), operand.size());
     }
-    //Note that it is not inherently safe to assume the new value size is < 
-    uint32_t newValLength = value.size();
-    //In between the old and the new value, we need to add the 4 bytes size
-    *new_value = std::move(existing + std::string((const char*)&newValLength, sizeof(uint32_t)) + value.ToString());
     return true;
 }
 
+bool ListAppendOperator::PartialMerge(const rocksdb::Slice& key,
+                                      const rocksdb::Slice& left_operand,
+                                      const rocksdb::Slice& right_operand,
+                                      std::string* new_value,
+                                      rocksdb::Logger* logger) const {
+    //The combined operand would get another size prefix in the full merge
+    return false;
+}
+
+bool ListAppendOperator::PartialMergeMulti(const rocksdb::Slice& key,
+                                           const std::deque<rocksdb::Slice>& operand_list,
+                                           std::string* new_value,
+                                           rocksdb::Logger* logger) const {
+    return false;
+}
+
 const char* NULAppendOperator::Name() const {
     return "NUL-separated append";
 }
 
-bool HOT NULAppendOperator::Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const {
-    // assuming empty if no existing value
-    std::string existing;
-    if (existing_value) {
-        existing = existing_value->ToString();
+bool HOT NULAppendOperator::FullMergeV2(const MergeOperationInput& merge_in,
+                                        MergeOperationOutput* merge_out) const {
+    //Assuming empty if no existing value
+    std::string& result = merge_out->new_value;
+    initializeAppendResult(merge_in, result, 1);
+    for (const rocksdb::Slice& operand : merge_in.operand_list) {
+        if (!result.empty()) { //Add NUL separator in between
+            result.push_back('\0');
+        }
+        result.append(operand.data(), operand.size());
+    }
+    return true;
+}
+
+/**
+ * Join the operands with NUL separators. Empty operands do not get a separator
+ * in the full merge if the value is still empty, so the result
+ * would depend on the existing value. Those chains are not combined.
+ */
+template<typename Iterator>
+static inline bool joinNULOperands(Iterator begin, Iterator end, std::string* new_value) {
+    size_t resultSize = 0;
+    for (Iterator it = begin; it != end; ++it) {
+        if (it->empty()) {
+            return false;
+        }
+        resultSize += it->size() + 1;
     }
-    if(existing.size() == 0) {
-        *new_value = value.ToString();
-    } else { //Add NUL separator in between
-        *new_value = existing + std::string("\x00", 1) + value.ToString();
+    new_value->clear();
+    new_value->reserve(resultSize);
+    for (Iterator it = begin; it != end; ++it) {
+        if (it != begin) {
+            new_value->push_back('\0');
+        }
+        new_value->append(it->data(), it->size());
     }
     return true;
 }
 
+bool HOT NULAppendOperator::PartialMerge(const rocksdb::Slice& key,
+                                         const rocksdb::Slice& left_operand,
+                                         const rocksdb::Slice& right_operand,
+                                         std::string* new_value,
+                                         rocksdb::Logger* logger) const {
+    const rocksdb::Slice operands[] = {left_operand, right_operand};
+    return joinNULOperands(operands, operands + 2, new_value);
+}
+
+bool HOT NULAppendOperator::PartialMergeMulti(const rocksdb::Slice& key,
+                                              const std::deque<rocksdb::Slice>& operand_list,
+                                              std::string* new_value,
+                                              rocksdb::Logger* logger) const {
+    return joinNULOperands(operand_list.begin(), operand_list.end(), new_value);
+}
+
 const char* NULAppendSetOperator::Name() const {
     return "NUL-separated set append";
 }
 
-#include <iostream>
-using namespace std;
-
-bool NULAppendSetOperator::FullMerge(const rocksdb::Slice& key,
-                       const rocksdb::Slice* existing_value,
-                       const std::deque<std::string>& operand_list,
-                       std::string* new_value,
-                       rocksdb::Logger* logger) const {
-    //If there is a non-empty existing value
-    if(operand_list.empty()) {
-        //Trivial: Only existing value is present
-        if(existing_value == nullptr || existing_value->size() == 0) {
-            //Not even an existing value exists
-            *new_value = "";
-        } else { //We have an existing value
-            *new_value = existing_value->ToString();
-        }
-        return true;
-    }
-    std::set<std::string> resultSet;
-    //Split existing value (ignore if no existing value)
-    if (existing_value != nullptr && existing_value->size() != 0) {
-        splitByNUL(resultSet, existing_value->data(), existing_value->size());
+bool HOT NULAppendSetOperator::FullMergeV2(const MergeOperationInput& merge_in,
+                                           MergeOperationOutput* merge_out) const {
+    NULSetMerger merger;
+    //Ignore if no existing value
+    if (merge_in.existing_value != nullptr) {
+        merger.add(*merge_in.existing_value);
     }
-    //Add values to result set for all operand slices
-    for(const std::string& slice : operand_list) {
-        splitByNUL(resultSet, slice.data(), slice.size());
+    //Add values to result set for all operand slices (implicitly computes set union)
+    for(const rocksdb::Slice& operand : merge_in.operand_list) {
+        merger.add(operand);
     }
-    //Serilize & store new value
-    //NOTE: NUL string requires explicit constructor call
-    static const std::string nul = std::string("\0", 1);
-    *new_value = boost::algorithm::join(resultSet, nul);
+    merger.mergeInto(merge_out->new_value);
     return true;
 }
 
-bool NULAppendSetOperator::PartialMergeMulti(const rocksdb::Slice& key,
+bool HOT NULAppendSetOperator::PartialMergeMulti(const rocksdb::Slice& key,
                                const std::deque<rocksdb::Slice>& operand_list,
                                std::string* new_value, rocksdb::Logger* logger) const {
-    //If there is a non-empty existing value
-    std::set<std::string> resultSet;
-    //Add values to result set for all operand slices (implicitly computes set union)
-    for(const rocksdb::Slice& slice : operand_list) {
-        splitByNUL(resultSet, slice.data(), slice.size());
+    NULSetMerger merger;
+    for(const rocksdb::Slice& operand : operand_list) {
+        merger.add(operand);
     }
-    //Serilize & store new value
-    //NOTE: NUL string requires explicit constructor call
-    static const std::string nul = std::string("\0", 1);
-    *new_value = boost::algorithm::join(resultSet, nul);
+    merger.mergeInto(*new_value);
     return true;
 }
 
-bool HOT ANDOperator::Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const {
-    //Assuming 0 if no existing value
-    std::string existing;
-    if (existing_value) {
-        existing = existing_value->ToString();
-    } else {
-        //Skip complex boolean logic, just copy value
-        *new_value = value.ToString();
-        return true;
-    }
+const char* PostingsOperator::Name() const {
+    return "Postings";
+}
 
-    //Extract raw binary info
-    const char* existingData = existing.data();
-    size_t existingSize = existing.size();
-    const char* valueData = value.data();
-    size_t valueSize = value.size();
-
-    /*
-     * Allocate the result memory (will be copied to the result string later)
-     * Writing to a string's data() could produce undefined behaviour
-     *  with some C++ STL implementations
-     */
-    size_t dstSize = std::max(existingSize, valueSize);
-    char* dst = new char[dstSize];
-
-    /*
-     * Perform bytewise boolean operation, ignoring extra bytes
-     * TODO: Optimize to use 128+-bit SSE / 64 bit / 32 bit operator,
-     *       or check if the compiler is intelligent enough to do that
-     */
-    size_t numCommonBytes = std::min(existingSize, valueSize);
-    for(size_t i = 0; i < numCommonBytes; i++) {
-        dst[i] = existingData[i] & valueData[i];
+/**
+ * Add a plain entity list or a compressed posting list to the merger.
+ * Posting lists are decoded into a NUL-separated list stored in decoded.
+ * Values starting with the posting list marker that can't be decoded are either
+ * corrupt or plain lists starting with an empty entity ID, so they are added as plain lists.
+ */
+static void addPostingsInput(NULSetMerger& merger,
+                             std::deque<std::string>& decoded,
+                             const rocksdb::Slice& value,
+                             rocksdb::Logger* logger) {
+    if (isPostingList(value)) {
+        decoded.emplace_back();
+        if (decodeEntityList(value, decoded.back())) {
+            merger.add(decoded.back());
+            return;
+        }
+        decoded.pop_back();
+        Log(logger, "posting list corruption, merging as plain entity list");
     }
-    //Copy remaining bytes, if any
-    if(existingSize > numCommonBytes) {
-        memcpy(dst + numCommonBytes, existingData + numCommonBytes, existingSize - numCommonBytes);
-    } else if(valueSize > numCommonBytes) {
-        memcpy(dst + numCommonBytes, valueData + numCommonBytes, valueSize - numCommonBytes);
-    } //Else: Both have the same size, nothing to be done
-
-    //Copy dst buffer to new_value string
-    *new_value = std::move(std::string(dst, dstSize));
-    //Free allocated temporary resources
-    delete[] dst;
-    //This function does not have any logical error condition
-    return true;
+    merger.add(value);
 }
 
-const char* ANDOperator::Name() const {
-    return "Binary AND";
+/**
+ * Encode the merged set. Empty entity IDs are dropped.
+ */
+static void writePostings(NULSetMerger& merger, std::string& dst) {
+    PostingListWriter writer;
+    auto addEntry = [&writer](const rocksdb::Slice& entry) {
+        if (!entry.empty()) {
+            writer.add(entry);
+        }
+    };
+    merger.forEachMerged(addEntry);
+    writer.finish(dst);
 }
 
+bool HOT PostingsOperator::FullMergeV2(const MergeOperationInput& merge_in,
+                                       MergeOperationOutput* merge_out) const {
+    NULSetMerger merger;
+    std::deque<std::string> decoded;
+    if (merge_in.existing_value != nullptr) {
+        addPostingsInput(merger, decoded, *merge_in.existing_value, merge_in.logger);
+    }
+    for (const rocksdb::Slice& operand : merge_in.operand_list) {
+        addPostingsInput(merger, decoded, operand, merge_in.logger);
+    }
+    writePostings(merger, merge_out->new_value);
+    return true;
+}
 
-bool HOT OROperator::Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const {
-    //Assuming 0 if no existing value
-    std::string existing;
-    if (existing_value) {
-        existing = existing_value->ToString();
-    } else {
-        //Skip complex boolean logic, just copy value
-        *new_value = value.ToString();
-        return true;
+bool HOT PostingsOperator::PartialMergeMulti(const rocksdb::Slice& key,
+                                             const std::deque<rocksdb::Slice>& operand_list,
+                                             std::string* new_value,
+                                             rocksdb::Logger* logger) const {
+    NULSetMerger merger;
+    std::deque<std::string> decoded;
+    for (const rocksdb::Slice& operand : operand_list) {
+        addPostingsInput(merger, decoded, operand, logger);
     }
+    writePostings(merger, *new_value);
+    return true;
+}
 
-    //Extract raw binary info
-    const char* existingData = existing.data();
-    size_t existingSize = existing.size();
-    const char* valueData = value.data();
-    size_t valueSize = value.size();
-
-    /*
-     * Allocate the result memory (will be copied to the result string later)
-     * Writing to a string's data() could produce undefined behaviour
-     *  with some C++ STL implementations
-     */
-    size_t dstSize = std::max(existingSize, valueSize);
-    char* dst = new char[dstSize];
-
-    /*
-     * Perform bytewise boolean operation, ignoring extra bytes
-     * TODO: Optimize to use 128+-bit SSE / 64 bit / 32 bit operator,
-     *       or check if the compiler is intelligent enough to do that
-     */
-    size_t numCommonBytes = std::min(existingSize, valueSize);
-    for(size_t i = 0; i < numCommonBytes; i++) {
-        dst[i] = existingData[i] | valueData[i];
+/**
+ * Apply a boolean operation to a sequence of byte strings of arbitrary size.
+ * The shorter inputs are padded with the identity of the operation
+ * (0xFF for AND, 0x00 for OR and XOR), i.e. the remaining bytes are copied.
+ * The first input is copied into the result, the others are applied in place.
+ */
+template<typename Iterator>
+static void bitwiseFold(BitwiseOperation operation,
+                        const rocksdb::Slice* first,
+                        Iterator begin, Iterator end,
+                        std::string& dst) {
+    if (first == nullptr) {
+        if (begin == end) {
+            dst.clear();
+            return;
+        }
+        first = &*begin;
+        ++begin;
+    }
+    size_t resultSize = first->size();
+    for (Iterator it = begin; it != end; ++it) {
+        resultSize = std::max(resultSize, it->size());
+    }
+    char identity = (operation == BitwiseOperation::And) ? '\xFF' : '\x00';
+    dst.reserve(resultSize);
+    dst.assign(first->data(), first->size());
+    dst.resize(resultSize, identity);
+    for (; begin != end; ++begin) {
+        applyBitwiseOperation(operation, &dst[0], begin->data(), begin->size());
     }
-    //Copy remaining bytes, if any
-    if(existingSize > numCommonBytes) {
-        memcpy(dst + numCommonBytes, existingData + numCommonBytes, existingSize - numCommonBytes);
-    } else if(valueSize > numCommonBytes) {
-        memcpy(dst + numCommonBytes, valueData + numCommonBytes, valueSize - numCommonBytes);
-    } //Else: Both have the same size, nothing to be done
-
-    //Copy dst buffer to new_value string
-    *new_value = std::move(std::string(dst, dstSize));
-    //Free allocated temporary resources
-    delete[] dst;
+}
+
+BitwiseMergeOperator::BitwiseMergeOperator(BitwiseOperation operation) : operation(operation) {
+}
+
+bool HOT BitwiseMergeOperator::FullMergeV2(const MergeOperationInput& merge_in,
+                                           MergeOperationOutput* merge_out) const {
+    bitwiseFold(operation, merge_in.existing_value,
+                merge_in.operand_list.begin(), merge_in.operand_list.end(),
+                merge_out->new_value);
     //This function does not have any logical error condition
     return true;
 }
 
+bool HOT BitwiseMergeOperator::PartialMerge(const rocksdb::Slice& key,
+                                            const rocksdb::Slice& left_operand,
+                                            const rocksdb::Slice& right_operand,
+                                            std::string* new_value,
+                                            rocksdb::Logger* logger) const {
+    const rocksdb::Slice operands[] = {left_operand, right_operand};
+    bitwiseFold(operation, nullptr, operands, operands + 2, *new_value);
+    return true;
+}
+
+bool HOT BitwiseMergeOperator::PartialMergeMulti(const rocksdb::Slice& key,
+                                                 const std::deque<rocksdb::Slice>& operand_list,
+                                                 std::string* new_value,
+                                                 rocksdb::Logger* logger) const {
+    bitwiseFold(operation, nullptr, operand_list.begin(), operand_list.end(), *new_value);
+    return true;
+}
+
+ANDOperator::ANDOperator() : BitwiseMergeOperator(BitwiseOperation::And) {
+}
+
+const char* ANDOperator::Name() const {
+    return "Binary AND";
+}
+
+OROperator::OROperator() : BitwiseMergeOperator(BitwiseOperation::Or) {
+}
+
 const char* OROperator::Name() const {
     return "Binary OR";
 }
 
-bool HOT XOROperator::Merge(
-    const rocksdb::Slice& key,
-    const rocksdb::Slice* existing_value,
-    const rocksdb::Slice& value,
-    std::string* new_value,
-    rocksdb::Logger* logger) const {
-    //Assuming 0 if no existing value
-    std::string existing;
-    if (existing_value) {
-        existing = existing_value->ToString();
-    } else {
-        //Skip complex boolean logic, just copy value
-        *new_value = value.ToString();
-        return true;
-    }
+XOROperator::XOROperator() : BitwiseMergeOperator(BitwiseOperation::Xor) {
+}
+
+const char* XOROperator::Name() const {
+    return "Binary XOR";
+}
 
-    //Extract raw binary info
-    const char* existingData = existing.data();
-    size_t existingSize = existing.size();
-    const char* valueData = value.data();
-    size_t valueSize = value.size();
-
-    /*
-     * Allocate the result memory (will be copied to the result string later)
-     * Writing to a string's data() could produce undefined behaviour
-     *  with some C++ STL implementations
-     */
-    size_t dstSize = std::max(existingSize, valueSize);
-    char* dst = new char[dstSize];
-
-    /*
-     * Perform bytewise boolean operation, ignoring extra bytes
-     * TODO: Optimize to use 128+-bit SSE / 64 bit / 32 bit operator,
-     *       or check if the compiler is intelligent enough to do that
-     */
-    size_t numCommonBytes = std::min(existingSize, valueSize);
-    for(size_t i = 0; i < numCommonBytes; i++) {
-        dst[i] = existingData[i] ^ valueData[i];
+CompressedBitmapOperator::CompressedBitmapOperator(BitwiseOperation operation, const char* name)
+    : operation(operation), name(name) {
+}
+
+/**
+ * Apply a boolean operation to a sequence of compressed or raw bitmaps.
+ * Full merges must not fail (RocksDB would report every read of the key and
+ * every compaction including it as corrupt), so they skip corrupt bitmaps.
+ * Partial merges fail instead, so RocksDB keeps the operands.
+ * @param skipCorrupt true to skip corrupt bitmaps, false to fail
+ * @return false if any bitmap is corrupt and skipCorrupt is false
+ */
+template<typename Iterator>
+static bool compressedBitmapFold(BitwiseOperation operation,
+                                 const rocksdb::Slice* first,
+                                 Iterator begin, Iterator end,
+                                 std::string& dst,
+                                 rocksdb::Logger* logger,
+                                 bool skipCorrupt) {
+    CompressedBitmapBuilder builder(operation);
+    if (first != nullptr && !builder.add(*first)) {
+        Log(logger, "existing bitmap corruption");
+        if (!skipCorrupt) {
+            return false;
+        }
     }
-    //Copy remaining bytes, if any
-    if(existingSize > numCommonBytes) {
-        memcpy(dst + numCommonBytes, existingData + numCommonBytes, existingSize - numCommonBytes);
-    } else if(valueSize > numCommonBytes) {
-        memcpy(dst + numCommonBytes, valueData + numCommonBytes, valueSize - numCommonBytes);
-    } //Else: Both have the same size, nothing to be done
-
-    //Copy dst buffer to new_value string
-    *new_value = std::move(std::string(dst, dstSize));
-    //Free allocated temporary resources
-    delete[] dst;
-    //This function does not have any logical error condition
+    for (; begin != end; ++begin) {
+        if (!builder.add(*begin)) {
+            Log(logger, "operand bitmap corruption");
+            if (!skipCorrupt) {
+                return false;
+            }
+        }
+    }
+    builder.finish(dst);
     return true;
 }
 
-const char* XOROperator::Name() const {
-    return "Binary XOR";
+bool HOT CompressedBitmapOperator::FullMergeV2(const MergeOperationInput& merge_in,
+                                               MergeOperationOutput* merge_out) const {
+    return compressedBitmapFold(operation, merge_in.existing_value,
+                                merge_in.operand_list.begin(), merge_in.operand_list.end(),
+                                merge_out->new_value, merge_in.logger, true);
+}
+
+bool HOT CompressedBitmapOperator::PartialMerge(const rocksdb::Slice& key,
+                                                const rocksdb::Slice& left_operand,
+                                                const rocksdb::Slice& right_operand,
+                                                std::string* new_value,
+                                                rocksdb::Logger* logger) const {
+    const rocksdb::Slice operands[] = {left_operand, right_operand};
+    return compressedBitmapFold(operation, nullptr, operands, operands + 2,
+                                *new_value, logger, false);
+}
+
+bool HOT CompressedBitmapOperator::PartialMergeMulti(const rocksdb::Slice& key,
+                                                     const std::deque<rocksdb::Slice>& operand_list,
+                                                     std::string* new_value,
+                                                     rocksdb::Logger* logger) const {
+    return compressedBitmapFold(operation, nullptr, operand_list.begin(), operand_list.end(),
+                                *new_value, logger, false);
+}
+
+const char* CompressedBitmapOperator::Name() const {
+    return name;
 }
 
 std::shared_ptr<rocksdb::MergeOperator> createMergeOperator(
@@ -450,12 +608,20 @@ std::shared_ptr<rocksdb::MergeOperator> createMergeOperator(
         return std::make_shared<OROperator>();
     } else if(mergeOperatorCode == "XOR") {
         return std::make_shared<XOROperator>();
+    } else if(mergeOperatorCode == "ROARINGAND") {
+        return std::make_shared<CompressedBitmapOperator>(BitwiseOperation::And, "Compressed bitmap AND");
+    } else if(mergeOperatorCode == "ROARINGOR") {
+        return std::make_shared<CompressedBitmapOperator>(BitwiseOperation::Or, "Compressed bitmap OR");
+    } else if(mergeOperatorCode == "ROARINGXOR") {
+        return std::make_shared<CompressedBitmapOperator>(BitwiseOperation::Xor, "Compressed bitmap XOR");
     } else if(mergeOperatorCode == "LISTAPPEND") {
         return std::make_shared<ListAppendOperator>();
     } else if(mergeOperatorCode == "NULAPPEND") {
         return std::make_shared<NULAppendOperator>();
     } else if(mergeOperatorCode == "NULAPPENDSET") {
         return std::make_shared<NULAppendSetOperator>();
+    } else if(mergeOperatorCode == "POSTINGS") {
+        return std::make_shared<PostingsOperator>();
     } else {
         //FAIL
         return std::shared_ptr<rocksdb::MergeOperator>(nullptr);
@@ -464,4 +630,8 @@ std::shared_ptr<rocksdb::MergeOperator> createMergeOperator(
 
 bool isReplaceMergeOperator(const char* mergeOperatorCode) {
     return strcmp(mergeOperatorCode, "Replace") == 0;
-}
\ No newline at end of file
+}
+
+bool isPostingsMergeOperator(const char* mergeOperatorName) {
+    return strcmp(mergeOperatorName, "Postings") == 0;
+}
@@ -0,0 +1,443 @@
+/*
+ * File:   PostOffice.cpp
+ * Author: uli
+ *
+ * Created on 16. Oktober 2014, 18:02
+ */
+
+#include "PostOffice.hpp"
+#include <cassert>
+#include "zutil.hpp"
+#include "macros.hpp"
+#include "ThreadUtil.hpp"
+
+/**
+ * ZMQ reserves identities starting with a NUL byte,
+ * so the worker ID is prefixed
+ */
+static std::string workerIdentity(uint32_t workerId) {
+    return "w" + std::to_string(workerId);
+}
+
+PostOffice::PostOffice(void* ctx,
+                       const char* requestEndpoint,
+                       const char* workerEndpoint,
+                       const std::vector<WorkerPoolSize>& poolSizes,
+                       LaneClassifier classifier,
+                       WorkerFactory workerFactory,
+                       size_t maxQueuedRequests,
+                       size_t scaleUpQueueDepth,
+                       uint64_t idleTimeout,
+                       const std::string& name) :
+requestSocket(zmq_socket_new_bind(ctx, ZMQ_PULL, requestEndpoint)),
+workerSocket(zmq_socket_new_bind(ctx, ZMQ_ROUTER, workerEndpoint)),
+poolSizes(poolSizes),
+classifier(classifier),
+workerFactory(workerFactory),
+maxQueuedRequests(maxQueuedRequests),
+scaleUpQueueDepth(std::max<size_t>(scaleUpQueueDepth, 1)),
+idleTimeout(idleTimeout),
+queuedRequests(0),
+queues(poolSizes.size()),
+maxGroupBytes(0),
+maxGroupDelay(0),
+groupDeadlines(poolSizes.size(), Clock::time_point::max()),
+nextSequence(0),
+idleWorkers(poolSizes.size()),
+numWorkers(poolSizes.size(), 0),
+numStartingWorkers(poolSizes.size(), 0),
+nextWorkerId(0),
+stopping(false),
+thread(nullptr),
+logger(ctx, name) {
+}
+
+PostOffice::~PostOffice() {
+    join();
+    zmq_close(requestSocket);
+    zmq_close(workerSocket);
+}
+
+void PostOffice::enableRequestGroups(GroupClassifier groupClassifierParam,
+                                     size_t maxGroupBytesParam,
+                                     std::chrono::milliseconds maxGroupDelayParam) {
+    groupClassifier = groupClassifierParam;
+    maxGroupBytes = maxGroupBytesParam;
+    maxGroupDelay = maxGroupDelayParam;
+}
+
+void PostOffice::enableSharding(ShardClassifier shardClassifierParam) {
+    shardClassifier = shardClassifierParam;
+}
+
+void PostOffice::start() {
+    //NOTE: The post office thread owns both sockets from now on
+    thread = new std::thread(&PostOffice::run, this);
+}
+
+void COLD PostOffice::join() {
+    if(thread) {
+        thread->join();
+        delete thread;
+        thread = nullptr;
+    }
+}
+
+int PostOffice::connectWorker(void* socket, const char* workerEndpoint, uint32_t workerId) {
+    std::string identity = workerIdentity(workerId);
+    zmq_setsockopt(socket, ZMQ_IDENTITY, identity.data(), identity.size());
+    return zmq_connect(socket, workerEndpoint);
+}
+
+void PostOffice::reportReady(void* socket, uint8_t lane, Logger& logger) {
+    sendFrame(&lane, 1, socket, logger, "Worker ready message");
+}
+
+bool PostOffice::receiveMessage(void* socket, BufferedMessage& msg, Logger& logger) {
+    do {
+        zmq_msg_t* frame = new zmq_msg_t;
+        zmq_msg_init(frame);
+        if (unlikely(receiveLogError(frame, socket, logger, "Buffered message frame") == -1)) {
+            zmq_msg_close(frame);
+            delete frame;
+            return false;
+        }
+        msg.push_back(frame);
+    } while (socketHasMoreFrames(socket));
+    return true;
+}
+
+void PostOffice::closeMessage(BufferedMessage& msg) {
+    for (zmq_msg_t* frame : msg) {
+        zmq_msg_close(frame);
+        delete frame;
+    }
+    msg.clear();
+}
+
+void PostOffice::run() {
+    setCurrentThreadName("Yak post office");
+    //Start the minimum number of workers for each lane
+    for (uint8_t lane = 0; lane < poolSizes.size(); lane++) {
+        for (unsigned int i = 0; i < poolSizes[lane].minWorkers; i++) {
+            startWorker(lane);
+        }
+    }
+    zmq_pollitem_t items[2];
+    items[0].socket = workerSocket;
+    items[0].events = ZMQ_POLLIN;
+    items[1].socket = requestSocket;
+    items[1].events = ZMQ_POLLIN;
+    //Check for surplus idle workers regularly
+    long pollTimeout = (idleTimeout.count() == 0) ? -1
+        : std::min<long>(idleTimeout.count(), 1000);
+    while (!stopping || !workerThreads.empty()) {
+        //When too many requests are queued (or when stopping),
+        // stop accepting requests so the request socket HWM applies
+        int numItems = (stopping || queuedRequests >= maxQueuedRequests) ? 1 : 2;
+        if (unlikely(zmq_poll(items, numItems, getPollTimeout(pollTimeout)) == -1)) {
+            if (errno == ETERM) {
+                break;
+            }
+            continue;
+        }
+        if (items[0].revents) {
+            handleWorkerMessage();
+        }
+        if (numItems == 2 && items[1].revents) {
+            if (!handleRequest()) {
+                logger.trace("Stopping workers");
+                stopping = true;
+                for (uint8_t lane = 0; lane < idleWorkers.size(); lane++) {
+                    stopIdleWorkers(lane);
+                }
+            }
+        }
+        //Dispatch held back groups whose deadline has passed
+        for (uint8_t lane = 0; lane < groupDeadlines.size(); lane++) {
+            if (groupDeadlines[lane] != Clock::time_point::max()) {
+                dispatchQueuedRequests(lane);
+            }
+        }
+        if (!stopping && pollTimeout != -1) {
+            shrinkPools();
+        }
+    }
+}
+
+void PostOffice::handleWorkerMessage() {
+    zmq_msg_t identityFrame, laneFrame;
+    zmq_msg_init(&identityFrame);
+    if (unlikely(receiveExpectMore(&identityFrame, workerSocket, logger, "Worker identity frame") != 0)) {
+        recvAndIgnore(workerSocket, logger);
+        zmq_msg_close(&identityFrame);
+        return;
+    }
+    std::string worker((char*) zmq_msg_data(&identityFrame), zmq_msg_size(&identityFrame));
+    zmq_msg_close(&identityFrame);
+    zmq_msg_init(&laneFrame);
+    if (unlikely(receiveLogError(&laneFrame, workerSocket, logger, "Worker ready frame") == -1)) {
+        zmq_msg_close(&laneFrame);
+        return;
+    }
+    uint8_t lane = *((uint8_t*) zmq_msg_data(&laneFrame));
+    zmq_msg_close(&laneFrame);
+    assert(lane < queues.size());
+    if (startingWorkers.erase(worker)) {
+        numStartingWorkers[lane]--;
+    }
+    bool shardsReleased = releaseShards(worker);
+    //Hand out the oldest queued request or wait for the next one
+    IdleWorker idleWorker = {worker, Clock::now()};
+    idleWorkers[lane].push_back(idleWorker);
+    dispatchQueuedRequests(lane);
+    //Requests in other lanes might have been waiting for the released shards
+    if (shardsReleased) {
+        for (uint8_t otherLane = 0; otherLane < queues.size(); otherLane++) {
+            if (otherLane != lane) {
+                dispatchQueuedRequests(otherLane);
+            }
+        }
+    }
+    if (stopping) {
+        stopIdleWorkers(lane);
+    }
+}
+
+bool PostOffice::handleRequest() {
+    BufferedMessage msg;
+    receiveMessage(requestSocket, msg, logger);
+    //Stop message: One empty frame
+    if (unlikely(msg.size() == 1 && zmq_msg_size(msg[0]) == 0)) {
+        zmq_msg_close(msg[0]);
+        delete msg[0];
+        return false;
+    }
+    if (unlikely(msg.empty())) {
+        return true;
+    }
+    uint8_t lane = classifier(msg);
+    QueuedRequest request;
+    request.msg.swap(msg);
+    request.size = 0;
+    if (groupClassifier) {
+        request.groupKey = groupClassifier(request.msg);
+        for (zmq_msg_t* frame : request.msg) {
+            request.size += zmq_msg_size(frame);
+        }
+    }
+    if (shardClassifier) {
+        request.shardKey = shardClassifier(request.msg);
+        request.sequence = nextSequence++;
+        if (!request.shardKey.empty()) {
+            queuedShardRequests[request.shardKey].push_back(request.sequence);
+        }
+    }
+    bool groupable = !request.groupKey.empty();
+    queues[lane].push_back(std::move(request));
+    queuedRequests++;
+    if (idleWorkers[lane].empty()) {
+        //Grow the pool if requests pile up. Workers that are starting up
+        // will take care of scaleUpQueueDepth requests each.
+        // A lane without any worker always needs one, else its requests would never be processed.
+        if ((numWorkers[lane] == 0
+                || queues[lane].size() >= scaleUpQueueDepth * (numStartingWorkers[lane] + 1))
+                && numWorkers[lane] < poolSizes[lane].maxWorkers) {
+            startWorker(lane);
+        }
+    } else {
+        //A worker is idle, so the request can only be grouped with later requests
+        if (groupable && queues[lane].size() == 1 && maxGroupDelay.count() > 0) {
+            groupDeadlines[lane] = Clock::now() + maxGroupDelay;
+        }
+        dispatchQueuedRequests(lane);
+    }
+    return true;
+}
+
+void PostOffice::dispatch(const std::string& worker, BufferedMessage& msg) {
+    sendFrame(worker, workerSocket, logger, "Worker identity frame", ZMQ_SNDMORE);
+    for (size_t i = 0; i < msg.size(); i++) {
+        int flags = (i == msg.size() - 1) ? 0 : ZMQ_SNDMORE;
+        if (unlikely(zmq_msg_send(msg[i], workerSocket, flags) == -1)) {
+            logMessageSendError("Request frame to worker", logger);
+            zmq_msg_close(msg[i]);
+        }
+        delete msg[i];
+    }
+    msg.clear();
+}
+
+void PostOffice::dispatchQueuedRequests(uint8_t lane) {
+    std::deque<QueuedRequest>& queue = queues[lane];
+    while (!queue.empty() && !idleWorkers[lane].empty()) {
+        size_t start = findDispatchableRequest(lane);
+        if (start == queue.size()) {
+            return; //All requests wait for their shard
+        }
+        bool complete;
+        size_t groupSize = getGroupSize(lane, start, complete);
+        bool held = (groupDeadlines[lane] != Clock::time_point::max());
+        if (held && !complete && !stopping && Clock::now() < groupDeadlines[lane]) {
+            return; //Wait for more requests of the group
+        }
+        groupDeadlines[lane] = Clock::time_point::max();
+        //The most recently idle worker is most likely to be hot in cache
+        const std::string worker = idleWorkers[lane].back().identity;
+        idleWorkers[lane].pop_back();
+        if (groupSize > 1) {
+            sendFrame(worker, workerSocket, logger, "Worker identity frame", ZMQ_SNDMORE);
+            sendBinary((uint32_t) groupSize, workerSocket, logger, "Request group size frame");
+        }
+        for (size_t i = 0; i < groupSize; i++) {
+            QueuedRequest& request = queue[start];
+            if (!request.shardKey.empty()) {
+                //The shard stays busy until the worker reports ready again
+                auto it = queuedShardRequests.find(request.shardKey);
+                it->second.pop_front();
+                if (it->second.empty()) {
+                    queuedShardRequests.erase(it);
+                }
+                busyShards.insert(request.shardKey);
+                workerShards[worker].push_back(request.shardKey);
+            }
+            dispatch(worker, request.msg);
+            queue.erase(queue.begin() + start);
+        }
+        queuedRequests -= groupSize;
+    }
+}
+
+bool PostOffice::isShardReady(const QueuedRequest& request, size_t position) const {
+    if (request.shardKey.empty()) {
+        return true;
+    }
+    if (busyShards.count(request.shardKey)) {
+        return false;
+    }
+    auto it = queuedShardRequests.find(request.shardKey);
+    return it != queuedShardRequests.end()
+        && it->second.size() > position
+        && it->second[position] == request.sequence;
+}
+
+size_t PostOffice::findDispatchableRequest(uint8_t lane) const {
+    const std::deque<QueuedRequest>& queue = queues[lane];
+    if (!shardClassifier) {
+        return 0;
+    }
+    size_t i = 0;
+    while (i < queue.size() && !isShardReady(queue[i])) {
+        i++;
+    }
+    return i;
+}
+
+size_t PostOffice::getGroupSize(uint8_t lane, size_t start, bool& complete) const {
+    const std::deque<QueuedRequest>& queue = queues[lane];
+    const std::string& groupKey = queue[start].groupKey;
+    complete = true;
+    if (groupKey.empty()) {
+        return 1;
+    }
+    //Number of requests per shard in the group
+    std::map<std::string, size_t> shardCounts;
+    if (!queue[start].shardKey.empty()) {
+        shardCounts[queue[start].shardKey] = 1;
+    }
+    size_t groupBytes = queue[start].size;
+    size_t groupSize = 1;
+    for (; start + groupSize < queue.size(); groupSize++) {
+        const QueuedRequest& request = queue[start + groupSize];
+        if (request.groupKey != groupKey || groupBytes + request.size > maxGroupBytes) {
+            return groupSize;
+        }
+        //Requests of the group must not overtake requests of their shard
+        if (!request.shardKey.empty()) {
+            size_t& shardCount = shardCounts[request.shardKey];
+            if (!isShardReady(request, shardCount)) {
+                return groupSize;
+            }
+            shardCount++;
+        }
+        groupBytes += request.size;
+    }
+    complete = (groupBytes >= maxGroupBytes);
+    return groupSize;
+}
+
+bool PostOffice::releaseShards(const std::string& worker) {
+    auto it = workerShards.find(worker);
+    if (it == workerShards.end()) {
+        return false;
+    }
+    for (const std::string& shardKey : it->second) {
+        busyShards.erase(shardKey);
+    }
+    workerShards.erase(it);
+    return true;
+}
+
+long PostOffice::getPollTimeout(long defaultTimeout) const {
+    long timeout = defaultTimeout;
+    Clock::time_point now = Clock::now();
+    for (const Clock::time_point& deadline : groupDeadlines) {
+        if (deadline == Clock::time_point::max()) {
+            continue;
+        }
+        //Round up, the deadline must have passed when the poll returns
+        long remaining = std::max<long>(0,
+            std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count() / 1000 + 1);
+        timeout = (timeout == -1) ? remaining : std::min(timeout, remaining);
+    }
+    return timeout;
+}
+
+void PostOffice::startWorker(uint8_t lane) {
+    uint32_t workerId = nextWorkerId++;
+    std::string identity = workerIdentity(workerId);
+    workerThreads[identity] = workerFactory(lane, workerId);
+    startingWorkers.insert(identity);
+    numStartingWorkers[lane]++;
+    numWorkers[lane]++;
+    if (numWorkers[lane] > poolSizes[lane].minWorkers) {
+        logger.trace("Starting additional worker in lane " + std::to_string(lane)
+            + " (now " + std::to_string(numWorkers[lane]) + " workers)");
+    }
+}
+
+void PostOffice::stopWorker(uint8_t lane, const std::string& worker) {
+    sendFrame(worker, workerSocket, logger, "Worker identity frame", ZMQ_SNDMORE);
+    sendFrame("", 0, workerSocket, logger, "Worker stop message");
+    //The worker is idle, so it exits immediately
+    std::thread* workerThread = workerThreads[worker];
+    workerThread->join();
+    delete workerThread;
+    workerThreads.erase(worker);
+    numWorkers[lane]--;
+}
+
+void PostOffice::stopIdleWorkers(uint8_t lane) {
+    if (!queues[lane].empty()) {
+        return;
+    }
+    while (!idleWorkers[lane].empty()) {
+        stopWorker(lane, idleWorkers[lane].front().identity);
+        idleWorkers[lane].pop_front();
+    }
+}
+
+void PostOffice::shrinkPools() {
+    Clock::time_point now = Clock::now();
+    for (uint8_t lane = 0; lane < idleWorkers.size(); lane++) {
+        std::deque<IdleWorker>& idle = idleWorkers[lane];
+        while (!idle.empty()
+                && numWorkers[lane] > poolSizes[lane].minWorkers
+                && now - idle.front().idleSince > idleTimeout) {
+            stopWorker(lane, idle.front().identity);
+            idle.pop_front();
+            logger.trace("Stopped idle worker in lane " + std::to_string(lane)
+                + " (now " + std::to_string(numWorkers[lane]) + " workers)");
+        }
+    }
+}
@@ -0,0 +1,204 @@
+#include "PostingList.hpp"
+#include <algorithm>
+#include "macros.hpp"
+#include "MergeAlgorithms.hpp"
+
+static inline void appendVarint(std::string& dst, uint64_t value) {
+    while (value >= 0x80) {
+        dst.push_back((char) (value | 0x80));
+        value >>= 7;
+    }
+    dst.push_back((char) value);
+}
+
+/**
+ * Decode a varint and advance the position
+ * @return false if the data ends before the varint or the varint is too long
+ */
+static inline bool readVarint(const char*& position, const char* end, uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64 && position < end; shift += 7) {
+        uint8_t byte = (uint8_t) *position++;
+        value |= (uint64_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+PostingListWriter::PostingListWriter() : count(0), blockCount(0) {
+}
+
+void HOT PostingListWriter::add(const rocksdb::Slice& entry) {
+    if (count % postingBlockSize == 0) {
+        //First entry of a block: Stored in full in the skip index
+        appendVarint(index, data.size());
+        appendVarint(index, entry.size());
+        index.append(entry.data(), entry.size());
+        blockCount++;
+    } else {
+        size_t maxShared = std::min(previous.size(), entry.size());
+        size_t shared = 0;
+        while (shared < maxShared && previous[shared] == entry[shared]) {
+            shared++;
+        }
+        appendVarint(data, shared);
+        appendVarint(data, entry.size() - shared);
+        data.append(entry.data() + shared, entry.size() - shared);
+    }
+    previous.assign(entry.data(), entry.size());
+    count++;
+}
+
+void PostingListWriter::finish(std::string& dst) {
+    dst.clear();
+    dst.reserve(2 + 20 + index.size() + data.size());
+    dst.push_back('\x00');
+    dst.push_back('\x01');
+    appendVarint(dst, count);
+    appendVarint(dst, blockCount);
+    dst.append(index);
+    dst.append(data);
+    index.clear();
+    data.clear();
+    previous.clear();
+    count = 0;
+    blockCount = 0;
+}
+
+void encodeEntityList(const rocksdb::Slice& entityList, std::string& dst) {
+    NULSetMerger merger;
+    merger.add(entityList);
+    PostingListWriter writer;
+    auto addEntry = [&writer](const rocksdb::Slice& entry) {
+        if (!entry.empty()) {
+            writer.add(entry);
+        }
+    };
+    merger.forEachMerged(addEntry);
+    writer.finish(dst);
+}
+
+bool decodeEntityList(const rocksdb::Slice& value, std::string& dst) {
+    dst.clear();
+    PostingListReader reader;
+    if (!reader.open(value)) {
+        return false;
+    }
+    for (; reader.valid(); reader.next()) {
+        if (!dst.empty()) {
+            dst.push_back('\0');
+        }
+        dst.append(reader.current().data(), reader.current().size());
+    }
+    return !reader.isCorrupted();
+}
+
+PostingListReader::PostingListReader() : dataStart(nullptr), dataEnd(nullptr), position(nullptr),
+    count(0), currentBlock(0), remainingInBlock(0), isValid(false), corrupted(false) {
+}
+
+bool PostingListReader::open(const rocksdb::Slice& value) {
+    blocks.clear();
+    isValid = false;
+    corrupted = false;
+    if (!isPostingList(value)) {
+        corrupted = true;
+        return false;
+    }
+    const char* pos = value.data() + 2;
+    const char* end = value.data() + value.size();
+    uint64_t blockCount;
+    if (!readVarint(pos, end, count) || !readVarint(pos, end, blockCount)
+            || blockCount != (count + postingBlockSize - 1) / postingBlockSize
+            || blockCount > value.size()) {
+        corrupted = true;
+        return false;
+    }
+    blocks.resize(blockCount);
+    for (Block& block : blocks) {
+        uint64_t firstEntrySize;
+        if (!readVarint(pos, end, block.offset) || !readVarint(pos, end, firstEntrySize)
+                || firstEntrySize > (uint64_t) (end - pos)) {
+            corrupted = true;
+            return false;
+        }
+        block.firstEntry = rocksdb::Slice(pos, firstEntrySize);
+        pos += firstEntrySize;
+    }
+    dataStart = pos;
+    dataEnd = end;
+    if (count > 0) {
+        loadBlock(0);
+    } else if (pos != end) {
+        corrupted = true; //Trailing data
+    }
+    return !corrupted;
+}
+
+void PostingListReader::setCorrupted() {
+    corrupted = true;
+    isValid = false;
+}
+
+void PostingListReader::loadBlock(size_t block) {
+    currentBlock = block;
+    if (blocks[block].offset > (uint64_t) (dataEnd - dataStart)) {
+        setCorrupted();
+        return;
+    }
+    position = dataStart + blocks[block].offset;
+    remainingInBlock = std::min<uint64_t>(postingBlockSize, count - block * postingBlockSize) - 1;
+    currentEntry.assign(blocks[block].firstEntry.data(), blocks[block].firstEntry.size());
+    isValid = true;
+}
+
+void HOT PostingListReader::next() {
+    if (!isValid) {
+        return;
+    }
+    if (remainingInBlock == 0) {
+        //The blocks are stored back to back without any data after the last block
+        if (currentBlock + 1 < blocks.size()) {
+            if ((uint64_t) (position - dataStart) != blocks[currentBlock + 1].offset) {
+                setCorrupted();
+                return;
+            }
+            loadBlock(currentBlock + 1);
+        } else if (position != dataEnd) {
+            setCorrupted();
+        } else {
+            isValid = false;
+        }
+        return;
+    }
+    uint64_t shared, suffixSize;
+    if (!readVarint(position, dataEnd, shared) || !readVarint(position, dataEnd, suffixSize)
+            || shared > currentEntry.size() || suffixSize > (uint64_t) (dataEnd - position)) {
+        setCorrupted();
+        return;
+    }
+    currentEntry.resize(shared);
+    currentEntry.append(position, suffixSize);
+    position += suffixSize;
+    remainingInBlock--;
+}
+
+void HOT PostingListReader::seek(const rocksdb::Slice& target) {
+    if (!isValid || current().compare(target) >= 0) {
+        return;
+    }
+    //Find the last block starting at or before the target
+    auto nextBlock = std::upper_bound(blocks.begin() + currentBlock + 1, blocks.end(), target,
+        [](const rocksdb::Slice& key, const Block& block) {
+            return key.compare(block.firstEntry) < 0;
+        });
+    size_t targetBlock = (nextBlock - blocks.begin()) - 1;
+    if (targetBlock > currentBlock) {
+        loadBlock(targetBlock);
+    }
+    while (isValid && current().compare(target) < 0) {
+        next();
+    }
+}
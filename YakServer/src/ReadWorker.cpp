@@ -9,6 +9,9 @@
 #include <zmq.h>
 #include <string>
 #include <iostream>
+#include <algorithm>
+#include <deque>
+#include <rocksdb/statistics.h>
 #include "TableOpenHelper.hpp"
 #include "Tablespace.hpp"
 #include "protocol.hpp"
@@ -18,49 +21,85 @@
 #include "macros.hpp"
 #include "ThreadUtil.hpp"
 #include "FileUtils.hpp"
+#include "PostingList.hpp"
 
 /**
  * The main function for the read worker thread.
  */
-static void readWorkerThreadFunction(void* ctx, Tablespace& tablespace, ConfigParser& cfg) {
+static void readWorkerThreadFunction(void* ctx, Tablespace& tablespace, ConfigParser& cfg, uint8_t lane, uint32_t workerId) {
     setCurrentThreadName("Yak read worker");
-    ReadWorker readWorker(ctx, tablespace, cfg);
+    ReadWorker readWorker(ctx, tablespace, cfg, workerId);
     //Process requests until stop msg is encountered
-    while (readWorker.processNextRequest()) {
-    }
+    do {
+        readWorker.reportReady(lane);
+    } while (readWorker.processNextRequest());
+}
+
+/**
+ * Scans, counts, intersections and table info requests (which perform file IO)
+ * are processed by separate workers so they never delay point lookups.
+ */
+static uint8_t classifyReadRequest(const BufferedMessage& msg) {
+    //Frames: Routing, delimiter, header
+    if (msg.size() < 3 || zmq_msg_size(msg[2]) < 3) {
+        return shortRequestLane;
+    }
+    RequestType requestType = (RequestType) ((uint8_t*) zmq_msg_data(msg[2]))[2];
+    if (requestType == RequestType::ScanRequest
+            || requestType == RequestType::ListRequest
+            || requestType == RequestType::CountRequest
+            || requestType == RequestType::IntersectRequest
+            || requestType == RequestType::TableInfoRequest) {
+        return longRequestLane;
+    }
+    return shortRequestLane;
 }
 
 using namespace std;
 
+/**
+ * Values smaller than this size are copied into the response frame
+ * instead of being sent zero-copy from a pinned slice.
+ * ZMQ stores messages this small inline anyway.
+ */
+static const size_t zeroCopyMinimumValueSize = 64;
+
+/**
+ * ZMQ zero-copy free function that releases a heap-allocated PinnableSlice
+ * (passed as hint), i.e. unpins the block the value lives in.
+ */
+static void pinnableSliceFree(void* data, void* hint) {
+    delete (rocksdb::PinnableSlice*) hint;
+}
+
 ReadWorkerController::ReadWorkerController(void* context, Tablespace& tablespace, ConfigParser& cfg)
-    :  tablespace(tablespace), numThreads(3), context(context), cfg(cfg) {
+    :  tablespace(tablespace), context(context), cfg(cfg),
+    postOffice(context, readWorkerRequestAddr, readWorkerThreadAddr,
+        {{cfg.readWorkerThreads, cfg.readWorkerThreadsMax},
+         {cfg.scanWorkerThreads, cfg.scanWorkerThreadsMax}},
+        classifyReadRequest,
+        [this](uint8_t lane, uint32_t workerId) {
+            return new std::thread(readWorkerThreadFunction, this->context,
+                                   std::ref(this->tablespace),
+                                   std::ref(this->cfg), lane, workerId);
+        },
+        cfg.internalRCVHWM, cfg.workerScaleUpQueueDepth,
+        cfg.workerIdleTimeout, "Read post office") {
     //Initialize the push socket
-    workerPushSocket = zmq_socket_new_bind(context, ZMQ_PUSH, readWorkerThreadAddr);
+    workerPushSocket = zmq_socket_new_connect(context, ZMQ_PUSH, readWorkerRequestAddr);
 }
 
 void ReadWorkerController::start() {
-    threads = new std::thread*[numThreads];
-    for (unsigned int i = 0; i < numThreads; i++) {
-        threads[i] = new std::thread(readWorkerThreadFunction,
-                                     context, std::ref(tablespace),
-                                     std::ref(cfg));
-    }
+    postOffice.start();
 }
 
 void COLD ReadWorkerController::terminateAll() {
-    //Send an empty STOP message for each read worker threadt
-    for (unsigned int i = 0; i < numThreads; i++) {
-        //Send an empty msg (signals the table open thread to stop)
-        sendEmptyFrameMessage(workerPushSocket);
-    }
-    //Wait for each thread to exit
-    for (unsigned int i = 0; i < numThreads; i++) {
-        threads[i]->join();
-        delete threads[i];
-    }
-    numThreads = 0;
-    //Destroy the sockets, if any
     if(workerPushSocket) {
+        //Send an empty STOP message to the post office, which stops the workers
+        sendEmptyFrameMessage(workerPushSocket);
+        //Wait for each thread to exit
+        postOffice.join();
+        //Destroy the sockets, if any
         zmq_close(workerPushSocket);
         workerPushSocket = nullptr;
     }
@@ -69,27 +108,75 @@ void COLD ReadWorkerController::terminateAll() {
 ReadWorkerController::~ReadWorkerController() {
     //Gracefully terminate all workers
     terminateAll();
-    //Free the threadlist
-    delete[] threads;
 }
 
-ReadWorker::ReadWorker(void* ctx, Tablespace& tablespace, ConfigParser& cfg) :
-AbstractFrameProcessor(ctx, ZMQ_PULL, ZMQ_PUSH, "Read worker"),
+ReadWorker::ReadWorker(void* ctx, Tablespace& tablespace, ConfigParser& cfg, uint32_t workerId) :
+AbstractFrameProcessor(ctx, ZMQ_DEALER, ZMQ_PUSH, "Read worker"),
 tablespace(tablespace),
 tableOpenHelper(ctx, cfg),
-cfg(cfg) {
+cfg(cfg),
+keyFrames(std::max(cfg.readBatchSize, 1u)),
+sortedKeys(keyFrames.size()),
+values(keyFrames.size()),
+statuses(keyFrames.size()),
+keyOrder(keyFrames.size()),
+sortedPosition(keyFrames.size()),
+keyExists(new bool[keyFrames.size()]) {
     //Connect the socket that is used to proxy requests to the external req/rep socket
     zmq_connect(processorOutputSocket, externalRequestProxyEndpoint);
-    //Connect the socket that is used by the send() member function
-    zmq_connect(processorInputSocket, readWorkerThreadAddr);
+    //Connect the socket that receives requests from the post office
+    PostOffice::connectWorker(processorInputSocket, readWorkerThreadAddr, workerId);
     logger.trace("Read worker thread starting");
 }
 
+void ReadWorker::reportReady(uint8_t lane) {
+    PostOffice::reportReady(processorInputSocket, lane, logger);
+}
+
 ReadWorker::~ReadWorker() {
     logger.trace("Read worker thread stopping...");
+    delete[] keyExists;
     //Sockets are cleaned up in AbstractFrameProcessor
 }
 
+/**
+ * Build a zero-copy slice referencing the data of a ZMQ message
+ */
+static inline rocksdb::Slice frameSlice(zmq_msg_t* frame) {
+    return rocksdb::Slice((char*) zmq_msg_data(frame), zmq_msg_size(frame));
+}
+
+ssize_t ReadWorker::receiveKeyBatch(const char* frameDesc) {
+    size_t numKeys = 0;
+    while (numKeys < keyFrames.size() && socketHasMoreFrames(processorInputSocket)) {
+        zmq_msg_init(&keyFrames[numKeys]);
+        if (unlikely(!receiveMsgHandleError(&keyFrames[numKeys], frameDesc, true))) {
+            closeKeyBatch(numKeys + 1);
+            return -1;
+        }
+        numKeys++;
+    }
+    return numKeys;
+}
+
+void ReadWorker::closeKeyBatch(size_t numKeys) {
+    for (size_t i = 0; i < numKeys; i++) {
+        zmq_msg_close(&keyFrames[i]);
+    }
+}
+
+void ReadWorker::sortKeyBatch(size_t numKeys) {
+    //MultiGet can skip its internal sort and reuse
+    // index block lookups for neighbouring keys if the input is sorted
+    std::sort(keyOrder.begin(), keyOrder.begin() + numKeys,
+        [this](uint32_t a, uint32_t b) {
+            return frameSlice(&keyFrames[a]).compare(frameSlice(&keyFrames[b])) < 0;
+        });
+    for (size_t i = 0; i < numKeys; i++) {
+        sortedKeys[i] = frameSlice(&keyFrames[keyOrder[i]]);
+    }
+}
+
 void ReadWorker::handleExistsRequest(zmq_msg_t* headerFrame) {
     errorResponse = "\x31\x01\x12\x01";
     static const char* ackResponse = "\x31\x01\x12\x00";
@@ -102,47 +189,58 @@ void ReadWorker::handleExistsRequest(zmq_msg_t* headerFrame) {
     rocksdb::DB* db = tablespace.getTable(tableId, tableOpenHelper);
     //Create the response object
     rocksdb::ReadOptions readOptions;
-    string value;
+    //Values found in memory by KeyMayExist() are stored here (and discarded)
+    std::string memoryValue;
     //If there are no keys at all, just send ACK without SNDMORE, else with SNDMORE
     bool dataFramesAvailable = socketHasMoreFrames(processorInputSocket);
     sendResponseHeader(ackResponse, (dataFramesAvailable ? ZMQ_SNDMORE : 0));
-    //Read each read request
-    zmq_msg_t keyFrame;
-    zmq_msg_t previousResponse; //Needed to only send last frame without SNDMORE
-    bool havePreviousResponse = false;
+    //Process the keys batch-wise
     while (socketHasMoreFrames(processorInputSocket)) {
-        zmq_msg_init(&keyFrame);
-        if (unlikely(!receiveMsgHandleError(&keyFrame, "Receive exists key frame", true))) {
-            return;
-        }
-        //Build a slice of the key (zero-copy)
-        rocksdb::Slice key((char*) zmq_msg_data(&keyFrame), zmq_msg_size(&keyFrame));
-
-        rocksdb::Status status = db->Get(readOptions, key, &value);
-        if (unlikely(!checkRocksDBStatus(status, "RocksDB error while checking key for existence", true))) {
-            logger.trace("The key that caused the previous error was " + std::string((char*) zmq_msg_data(&keyFrame), zmq_msg_size(&keyFrame)));
-            zmq_msg_close(&keyFrame);
+        ssize_t numKeys = receiveKeyBatch("Receive exists key frame");
+        if (unlikely(numKeys == -1)) {
             return;
         }
-        zmq_msg_close(&keyFrame);
-        //Send the previous response, if any
-        if (havePreviousResponse) {
-            if (unlikely(!sendMsgHandleError(&previousResponse, ZMQ_SNDMORE, "ZMQ error while sending exists reply (not last)"))) {
-                return;
+        //Bloom filters and the memtable answer most lookups without any disk IO.
+        //Only keys that might exist but could not be found in memory are looked up
+        size_t numLookups = 0;
+        for (ssize_t i = 0; i < numKeys; i++) {
+            bool valueFound = false;
+            if (!db->KeyMayExist(readOptions, frameSlice(&keyFrames[i]), &memoryValue, &valueFound)) {
+                keyExists[i] = false;
+            } else if (valueFound) {
+                keyExists[i] = true;
+            } else {
+                keyOrder[numLookups++] = i;
             }
         }
-        //Generate the response for the current key
-        havePreviousResponse = true;
-        if (status.IsNotFound()) {
-            zmq_msg_init_data(&previousResponse, (void*) "\x00", 1, nullptr, nullptr);
-        } else {
-            zmq_msg_init_data(&previousResponse, (void*) "\x01", 1, nullptr, nullptr);
+        if (numLookups > 0) {
+            sortKeyBatch(numLookups);
+            db->MultiGet(readOptions, db->DefaultColumnFamily(), numLookups,
+                         sortedKeys.data(), values.data(), statuses.data(), true);
+            for (size_t i = 0; i < numLookups; i++) {
+                //Only the status is needed, so unpin the value immediately
+                values[i].Reset();
+            }
+            for (size_t i = 0; i < numLookups; i++) {
+                if (unlikely(!statuses[i].ok() && !statuses[i].IsNotFound())) {
+                    checkRocksDBStatus(statuses[i], "RocksDB error while checking key for existence", true);
+                    logger.trace("The key that caused the previous error was " + sortedKeys[i].ToString());
+                    closeKeyBatch(numKeys);
+                    return;
+                }
+                keyExists[keyOrder[i]] = statuses[i].ok();
+            }
         }
-    }
-    //Send the last response, if any (last msg, without MORE)
-    if (havePreviousResponse) {
-        if (unlikely(!sendMsgHandleError(&previousResponse, 0, "ZMQ error while sending last exists reply"))) {
-            return;
+        closeKeyBatch(numKeys);
+        //Send the responses in request order. The last one is sent without SNDMORE
+        bool lastBatch = !socketHasMoreFrames(processorInputSocket);
+        for (ssize_t i = 0; i < numKeys; i++) {
+            int flags = (lastBatch && i == numKeys - 1) ? 0 : ZMQ_SNDMORE;
+            if (unlikely(sendConstFrame(keyExists[i] ? "\x01" : "\x00", 1,
+                                        processorOutputSocket, logger,
+                                        "Exists reply", flags) == -1)) {
+                return;
+            }
         }
     }
 }
@@ -159,93 +257,131 @@ void ReadWorker::handleReadRequest(zmq_msg_t* headerFrame) {
     rocksdb::DB* db = tablespace.getTable(tableId, tableOpenHelper);
     //Create the response object
     rocksdb::ReadOptions readOptions;
-    rocksdb::Status status;
-    string value;
     //If there are no keys at all, just send ACK without SNDMORE, else with SNDMORE
     bool dataFramesAvailable = socketHasMoreFrames(processorInputSocket);
     sendResponseHeader(ackResponse, (dataFramesAvailable ? ZMQ_SNDMORE : 0));
-    //Read each read request
-    zmq_msg_t keyFrame;
-    zmq_msg_t previousResponse; //Needed to only send last frame without SNDMORE
-    bool havePreviousResponse = false;
+    //Process the keys batch-wise
+    zmq_msg_t response;
     while (socketHasMoreFrames(processorInputSocket)) {
-        zmq_msg_init(&keyFrame);
-        if (unlikely(!receiveMsgHandleError(&keyFrame, "Receive read key frame", true))) {
+        ssize_t numKeys = receiveKeyBatch("Receive read key frame");
+        if (unlikely(numKeys == -1)) {
             return;
         }
-        //Build a slice of the key (zero-copy)
-        rocksdb::Slice key((char*) zmq_msg_data(&keyFrame), zmq_msg_size(&keyFrame));
-        status = db->Get(readOptions, key, &value);
-        zmq_msg_close(&keyFrame);
-        if (unlikely(!checkRocksDBStatus(status, "RocksDB error while reading key", true))) {
-            logger.trace("The key that caused the error was " + key.ToString());
-            zmq_msg_close(&keyFrame);
-            return;
+        for (ssize_t i = 0; i < numKeys; i++) {
+            keyOrder[i] = i;
         }
-        //Send the previous response, if any
-        if (havePreviousResponse) {
-            if (unlikely(!sendMsgHandleError(&previousResponse,
-                                             ZMQ_SNDMORE,
-                                             "ZMQ error while sending read reply (not last)"))) {
+        sortKeyBatch(numKeys);
+        db->MultiGet(readOptions, db->DefaultColumnFamily(), numKeys,
+                     sortedKeys.data(), values.data(), statuses.data(), true);
+        for (ssize_t i = 0; i < numKeys; i++) {
+            sortedPosition[keyOrder[i]] = i;
+            if (unlikely(!statuses[i].ok() && !statuses[i].IsNotFound())) {
+                checkRocksDBStatus(statuses[i], "RocksDB error while reading key", true);
+                logger.trace("The key that caused the error was " + sortedKeys[i].ToString());
+                for (ssize_t j = 0; j < numKeys; j++) {
+                    values[j].Reset();
+                }
+                closeKeyBatch(numKeys);
                 return;
             }
         }
-        //Generate the response for the current read key
-        havePreviousResponse = true;
-        if (status.IsNotFound()) {
-            //Empty value
-            zmq_msg_init_data(&previousResponse, (void*) "", 0, nullptr, nullptr);
-        } else {
-            //Found sth, return value
-            zmq_msg_init_size(&previousResponse, value.size());
-            memcpy(zmq_msg_data(&previousResponse), value.c_str(), value.size());
+        closeKeyBatch(numKeys);
+        //Send the values in request order. The last one is sent without SNDMORE
+        bool lastBatch = !socketHasMoreFrames(processorInputSocket);
+        for (ssize_t i = 0; i < numKeys; i++) {
+            size_t resultIndex = sortedPosition[i];
+            rocksdb::PinnableSlice& value = values[resultIndex];
+            if (statuses[resultIndex].IsNotFound()) {
+                //Empty value
+                zmq_msg_init_data(&response, (void*) "", 0, nullptr, nullptr);
+            } else if (value.size() < zeroCopyMinimumValueSize) {
+                //ZMQ stores small messages inline, so copying is cheaper than pinning
+                zmq_msg_init_size(&response, value.size());
+                memcpy(zmq_msg_data(&response), value.data(), value.size());
+                value.Reset();
+            } else {
+                //Found sth, return value. The pin is moved to the heap
+                // and released by ZMQ once the frame has been sent
+                rocksdb::PinnableSlice* pinned = new rocksdb::PinnableSlice(std::move(value));
+                zmq_msg_init_data(&response, (void*) pinned->data(),
+                                  pinned->size(), pinnableSliceFree, pinned);
+            }
+            int flags = (lastBatch && i == numKeys - 1) ? 0 : ZMQ_SNDMORE;
+            if (unlikely(!sendMsgHandleError(&response, flags, "ZMQ error while sending read reply", errorResponse))) {
+                for (ssize_t j = 0; j < numKeys; j++) {
+                    values[j].Reset();
+                }
+                return;
+            }
         }
     }
-    //Send the last response, if any (last msg, without MORE)
-    if (havePreviousResponse) {
-        if (unlikely(!sendMsgHandleError(&previousResponse, 0, "ZMQ error while sending last read reply", errorResponse))) {
-            return;
-        }
+}
+
+bool ReadWorker::receivePredicate(ScanPredicate& predicate) {
+    if (!socketHasMoreFrames(processorInputSocket)) {
+        return true;
+    }
+    zmq_msg_t predicateFrame;
+    zmq_msg_init(&predicateFrame);
+    if (!receiveMsgHandleError(&predicateFrame, "Predicate frame", true)) {
+        return false;
     }
+    std::string errorMessage;
+    bool ok = predicate.compile((const char*) zmq_msg_data(&predicateFrame),
+                                zmq_msg_size(&predicateFrame), errorMessage);
+    zmq_msg_close(&predicateFrame);
+    if (!ok) {
+        logger.warn("Invalid scan predicate: " + errorMessage);
+        sendErrorResponseHeader(ZMQ_SNDMORE);
+        sendFrame("Invalid predicate: " + errorMessage, processorOutputSocket, logger, "Predicate error message");
+    }
+    return ok;
 }
 
 void ReadWorker::handleScanRequest(zmq_msg_t* headerFrame) {
-    errorResponse = "\x31\x01\x13\x01";
-    static const char* ackResponse = "\x31\x01\x13\x00";
+    processScanRequest(headerFrame, true);
+}
+
+/*
+ * NOTE: This is FULLY EQUIVALENT to the SCAN request, except it does not return values.
+ */
+void ReadWorker::handleListRequest(zmq_msg_t* headerFrame) {
+    processScanRequest(headerFrame, false);
+}
+
+void ReadWorker::processScanRequest(zmq_msg_t* headerFrame, bool emitValues) {
+    errorResponse = emitValues ? "\x31\x01\x13\x01" : "\x31\x01\x14\x01";
+    const char* ackResponse = emitValues ? "\x31\x01\x13\x00" : "\x31\x01\x14\x00";
     requestExpectedSize = 4;
     //Parse scan flags
-    if (!expectMinimumFrameSize(headerFrame, 4, "scan request header frame", true)) {
+    if (!expectMinimumFrameSize(headerFrame, 4, emitValues ? "scan request header frame" : "list request header frame", true)) {
         return;
     }
     uint8_t scanFlags = ((char*)zmq_msg_data(headerFrame))[3];
-    bool invertScanDirection = isScanDirectionInverted(scanFlags);
+    ScanRange range;
+    range.inverted = isScanDirectionInverted(scanFlags);
     //Parse table ID
     uint32_t tableId;
-    if (!parseUint32Frame(tableId, "Table ID frame in scan request", true)) {
+    if (!parseUint32Frame(tableId, emitValues ? "Table ID frame in scan request" : "Table ID frame in list request", true)) {
         return;
     }
     //Check if there is a range frame at all
-    if (!expectNextFrame("Only table ID frame found in scan request, range missing", true)) {
+    if (!expectNextFrame(emitValues ? "Only table ID frame found in scan request, range missing" : "Only table ID frame found in list request, range missing", true)) {
         return;
     }
     //Get the table to read from
     rocksdb::DB* db = tablespace.getTable(tableId, tableOpenHelper);
     //Parse limit frame. For now we just assume UINT64_MAX is close enough to infinite
-    uint64_t scanLimit;
-    if (!parseUint64FrameOrAssumeDefault(scanLimit,
+    if (!parseUint64FrameOrAssumeDefault(range.limit,
                 std::numeric_limits<uint64_t>::max(),
-                "scan limit frame",
+                emitValues ? "scan limit frame" : "list limit frame",
                 true)) {
         return;
     }
     //Parse the from-to range
-    std::string rangeStartStr;
-    std::string rangeEndStr;
-    if (!parseRangeFrames(rangeStartStr, rangeEndStr, "Scan request scan range parsing", true)) {
+    if (!parseRangeFrames(range.start, range.end, emitValues ? "scan request scan range parsing" : "list request scan range parsing", true)) {
         return;
     }
-    bool haveRangeStart = !(rangeStartStr.empty());
-    bool haveRangeEnd = !(rangeEndStr.empty());
     //Parse the filter frames
     std::string keyFilterStr = "";
     std::string valueFilterStr = "";
@@ -265,326 +401,337 @@ void ReadWorker::handleScanRequest(zmq_msg_t* headerFrame) {
         return;
     }
     //Parse number of records to skip
-    uint64_t scanSkipCount = 0;
-    if (!parseUint64FrameOrAssumeDefault(scanSkipCount, 0 /* default */,
-                "Receive scan skip frame", true)) {
+    if (!parseUint64FrameOrAssumeDefault(range.skip, 0 /* default */,
+                emitValues ? "Receive scan skip frame" : "Receive list skip frame", true)) {
+        return;
+    }
+    //Create the substring searchers (unexpensive for empty strings)
+    ScanFilter filter(keyFilterStr, valueFilterStr);
+    //Parse the predicate frame, if any
+    if (!receivePredicate(filter.predicate)) {
         return;
     }
-    //Create the boyer moore searchers (unexpensive for empty strings)
-    bool haveKeyFilter = !(keyFilterStr.empty());
-    bool haveValueFilter = !(valueFilterStr.empty());
-    BoyerMooreHorspoolSearcher keyFilter(keyFilterStr);
-    BoyerMooreHorspoolSearcher valueFilter(valueFilterStr);
-    //Convert the str to a slice, to compare the iterator slice in-place
-    rocksdb::Slice rangeEndSlice(rangeEndStr);
-    //Do the compaction (takes LONG)
-    //Create the response object
-    rocksdb::ReadOptions readOptions;
-    rocksdb::Status status;
     //Create the iterator
+    rocksdb::ReadOptions readOptions;
     rocksdb::Iterator* it = db->NewIterator(readOptions);
-    if (haveRangeStart) {
-        it->Seek(rangeStartStr);
-    } else if(invertScanDirection) {
-        it->SeekToLast();
-    } else { //Non-inverted scan
-        it->SeekToFirst();
+    bool ok = emitValues
+        ? sendScanResponse<true>(it, range, filter, ackResponse)
+        : sendScanResponse<false>(it, range, filter, ackResponse);
+    if (!ok) {
+        delete it;
+        return;
     }
+    //Check if any error occured during iteration
+    if (!checkRocksDBStatus(it->status(),
+            "RocksDB error while scanning",
+            true)) {
+        delete it;
+        return;
+    }
+    delete it;
+}
+
+template<bool EmitValues>
+bool ReadWorker::sendScanResponse(rocksdb::Iterator* it, const ScanRange& range,
+                                  ScanFilter& filter, const char* ackResponse) {
     //If the range is empty, the header needs to be sent w/out MORE,
     // so we can't send it right away
     bool sentHeader = false;
-    //Iterate over all key-values in the range
-    zmq_msg_t keyMsg, valueMsg;
-    bool haveLastValueMsg = false; //Needed to send only last frame without SNDMORE
-    for (; it->Valid(); (invertScanDirection ? it->Prev() : it->Next())) {
-        rocksdb::Slice key = it->key();
-        const char* keyData = key.data();
-        size_t keySize = key.size();
-        //Check scan limit
-        if (scanLimit <= 0) {
-            break;
-        }
-        scanLimit--;
-        //Check if we have to stop here
-        int compareResult = (haveRangeEnd ? key.compare(rangeEndSlice) : 0);
-        if (haveRangeEnd
-                && (!invertScanDirection || compareResult <= 0)
-                && (invertScanDirection  || compareResult >= 0)) {
-            break;
-        }
-        rocksdb::Slice value = it->value();
-        const char* valueData = value.data();
-        size_t valueSize = value.size();
-        //Check key / value filters, if any
-        if(haveKeyFilter && keyFilter.find(keyData, keySize) == -1) {
-            scanLimit++; //Revert decrement from above
-            continue; //Next key/value, if any
-        }
-        if(haveValueFilter && valueFilter.find(valueData, valueSize) == -1) {
-            scanLimit++; //Revert decrement from above
-            continue; //Next key/value, if any
-        }
-        //Check if the frame needs to be skipped
-        if(scanSkipCount > 0) {
-            scanSkipCount--;
-            continue;
-        }
-        //Send the previous value msg, if any
+    //The last frame (value for scans, key for lists) is held back
+    // so it can be sent without SNDMORE
+    zmq_msg_t lastMsg;
+    bool haveLastMsg = false;
+    auto sendRecord = [&](const rocksdb::Slice& key, const rocksdb::Slice& value) -> bool {
         if (!sentHeader) {
             sendResponseHeader(ackResponse, ZMQ_SNDMORE);
             sentHeader = true;
         }
-        if (haveLastValueMsg) {
-            if (unlikely(!sendMsgHandleError(&valueMsg, ZMQ_SNDMORE, "ZMQ error while sending scan reply (not last)", true))) {
-                delete it;
-                return;
+        //Send the previous msg, if any
+        if (haveLastMsg) {
+            haveLastMsg = false;
+            if (unlikely(!sendMsgHandleError(&lastMsg, ZMQ_SNDMORE, "ZMQ error while sending scan reply (not last)", true))) {
+                return false;
             }
         }
         //Convert the slices into msgs and send them
-        haveLastValueMsg = true;
-        zmq_msg_init_size(&keyMsg, keySize);
-        zmq_msg_init_size(&valueMsg, valueSize);
-        memcpy(zmq_msg_data(&keyMsg), keyData, keySize);
-        memcpy(zmq_msg_data(&valueMsg), valueData, valueSize);
-        if (unlikely(!sendMsgHandleError(&keyMsg, ZMQ_SNDMORE, "ZMQ error while sending scan reply (not last)", true))) {
-            zmq_msg_close(&valueMsg);
-            delete it;
-            return;
+        if (EmitValues) {
+            zmq_msg_t keyMsg;
+            zmq_msg_init_size(&keyMsg, key.size());
+            memcpy(zmq_msg_data(&keyMsg), key.data(), key.size());
+            if (unlikely(!sendMsgHandleError(&keyMsg, ZMQ_SNDMORE, "ZMQ error while sending scan reply (not last)", true))) {
+                return false;
+            }
         }
+        const rocksdb::Slice& last = EmitValues ? value : key;
+        zmq_msg_init_size(&lastMsg, last.size());
+        memcpy(zmq_msg_data(&lastMsg), last.data(), last.size());
+        haveLastMsg = true;
+        return true;
+    };
+    if (!scanRange<EmitValues>(it, range, filter, sendRecord)) {
+        return false;
     }
-    //Send the previous value msg, if any
-    if (haveLastValueMsg) {
-        if (unlikely(!sendMsgHandleError(&valueMsg, 0, "ZMQ error while sending last scan reply", true))) {
-            delete it;
-            return;
+    //Send the previous msg, if any
+    if (haveLastMsg) {
+        if (unlikely(!sendMsgHandleError(&lastMsg, 0, "ZMQ error while sending last scan reply", true))) {
+            return false;
         }
     }
     //If the scanned range is empty, the header has not been sent yet
     if (!sentHeader) {
         sendResponseHeader(ackResponse, 0);
     }
-    //Check if any error occured during iteration
-    if (!checkRocksDBStatus(it->status(),
-            "RocksDB error while scanning",
-            true)) {
-        delete it;
-        return;
-    }
-    delete it;
+    return true;
 }
 
-/*
- * NOTE: This is FULLY EQUIVALENT to the SCAN request, except it does not return values.
+/**
+ * Estimate the number of keys in a range from the table metadata
+ * without reading any data blocks.
+ *
+ * Files entirely inside the range contribute their number of entries
+ * minus their number of deletions. For the files crossing the range boundaries,
+ * the number of entries is interpolated from the approximate size of the range.
+ * The error bound is the number of entries whose contribution is unknown:
+ * Deletions, entries of boundary files and memtable entries
+ * (which might overwrite keys in the files). Older versions of
+ * overwritten keys that have not been compacted yet are not included.
  */
-void ReadWorker::handleListRequest(zmq_msg_t* headerFrame) {
-    //FIXME Dedup with scan request
-    errorResponse = "\x31\x01\x14\x01";
-    static const char* ackResponse = "\x31\x01\x14\x00";
-    requestExpectedSize = 4;
-    //Parse scan flags
-    if (!expectMinimumFrameSize(headerFrame, 4, "list request header frame", true)) {
-        return;
+static rocksdb::Status estimateRangeCount(rocksdb::DB* db, const ScanRange& range,
+                                          uint64_t& estimate, uint64_t& errorBound) {
+    estimate = 0;
+    errorBound = 0;
+    //The approximation functions need an explicit range end
+    std::string rangeLimit;
+    rocksdb::Status status = getExplicitRangeEnd(db, range, rangeLimit);
+    rocksdb::Slice rangeStart(range.start);
+    if (!status.ok() || rangeLimit.empty() || rangeStart.compare(rangeLimit) >= 0) {
+        return status; //Error or empty range
+    }
+    rocksdb::Range keyRange(rangeStart, rangeLimit);
+    uint64_t memtableCount = 0;
+    uint64_t memtableSize = 0;
+    db->GetApproximateMemTableStats(keyRange, &memtableCount, &memtableSize);
+    std::vector<rocksdb::LiveFileMetaData> files;
+    db->GetLiveFilesMetaData(&files);
+    uint64_t containedSize = 0;
+    uint64_t boundaryEntries = 0;
+    uint64_t boundarySize = 0;
+    for (const rocksdb::LiveFileMetaData& file : files) {
+        rocksdb::Slice smallestKey(file.smallestkey);
+        rocksdb::Slice largestKey(file.largestkey);
+        if (largestKey.compare(rangeStart) < 0 || smallestKey.compare(keyRange.limit) >= 0) {
+            continue; //No overlap
+        }
+        if (smallestKey.compare(rangeStart) >= 0 && largestKey.compare(keyRange.limit) < 0) {
+            uint64_t deletions = std::min(file.num_deletions, file.num_entries);
+            estimate += file.num_entries - deletions;
+            errorBound += deletions;
+            containedSize += file.size;
+        } else {
+            boundaryEntries += file.num_entries;
+            boundarySize += file.size;
+        }
     }
-    uint8_t scanFlags = ((char*)zmq_msg_data(headerFrame))[3];
-    bool invertScanDirection = isScanDirectionInverted(scanFlags);
+    //Interpolate the boundary files using the approximate size of the range
+    if (boundarySize > 0) {
+        uint64_t rangeSize = 0;
+        db->GetApproximateSizes(db->DefaultColumnFamily(), &keyRange, 1, &rangeSize);
+        uint64_t boundaryRangeSize = std::min(boundarySize,
+            rangeSize > containedSize ? rangeSize - containedSize : 0);
+        estimate += (uint64_t) ((double) boundaryEntries * boundaryRangeSize / boundarySize);
+        errorBound += boundaryEntries;
+    }
+    estimate += memtableCount;
+    errorBound += memtableCount;
+    return rocksdb::Status::OK();
+}
+
+void ReadWorker::handleCountRequest(zmq_msg_t* headerFrame) {
+    errorResponse = "\x31\x01\x11\x01";
+    static const char* ackResponse = "\x31\x01\x11\x00";
+    requestExpectedSize = 4;
+    CountMode countMode = getCountMode(headerFrame);
     //Parse table ID
     uint32_t tableId;
-    if (!parseUint32Frame(tableId, "Table ID frame in list request", true)) {
+    if (!parseUint32Frame(tableId, "Table ID frame in count request", true)) {
         return;
     }
     //Check if there is a range frame at all
-    if (!expectNextFrame("Only table ID frame found in list request, range missing", true)) {
+    if (!expectNextFrame("Only table ID frame found in count request, range missing", true)) {
         return;
     }
     //Get the table to read from
     rocksdb::DB* db = tablespace.getTable(tableId, tableOpenHelper);
-    //Parse limit frame. For now we just assume UINT64_MAX is close enough to infinite
-    uint64_t listLimit;
-    if (!parseUint64FrameOrAssumeDefault(listLimit,
-                std::numeric_limits<uint64_t>::max(),
-                "Receive list limit frame",
-                true)) {
-        return;
-    }
     //Parse the from-to range
-    std::string rangeStartStr;
-    std::string rangeEndStr;
-    if (!parseRangeFrames(rangeStartStr, rangeEndStr, "List request scan range parsing", true)) {
-        return;
-    }
-    bool haveRangeStart = !(rangeStartStr.empty());
-    bool haveRangeEnd = !(rangeEndStr.empty());
-    //Parse the filter frames
-    std::string keyFilterStr = "";
-    std::string valueFilterStr = "";
-    if(!expectNextFrame("Expected key filter frame", true)) {
-        return;
-    }
-    if(!receiveStringFrame(keyFilterStr, "Error while receiveing key filter string", true)) {
-        return;
-    }
-    if(!expectNextFrame("Expected value filter frame", true)) {
-        return;
-    }
-    if(!receiveStringFrame(valueFilterStr, "Error while receiveing key filter string", true)) {
-        return;
-    }
-    if(!expectNextFrame("Expected skip frame", true)) {
-        return;
-    }
-    //Parse number of records to skip
-    uint64_t scanSkipCount = 0;
-    if (!parseUint64FrameOrAssumeDefault(scanSkipCount, 0 /* default */,
-                "Receive list skip frame", true)) {
-        return;
-    }
-    //Create the boyer moore searchers (unexpensive for empty strings)
-    bool haveKeyFilter = !(keyFilterStr.empty());
-    bool haveValueFilter = !(valueFilterStr.empty());
-    BoyerMooreHorspoolSearcher keyFilter(keyFilterStr);
-    BoyerMooreHorspoolSearcher valueFilter(valueFilterStr);
-    //Convert the str to a slice, to compare the iterator slice in-place
-    rocksdb::Slice rangeEndSlice(rangeEndStr);
-    //Do the compaction (takes LONG)
-    //Create the response object
-    rocksdb::ReadOptions readOptions;
-    rocksdb::Status status;
-    //Create the iterator
-    rocksdb::Iterator* it = db->NewIterator(readOptions);
-    if (haveRangeStart) {
-        it->Seek(rangeStartStr);
-    } else if(invertScanDirection) {
-        it->SeekToLast();
-    } else { //Non-inverted scan
-        it->SeekToFirst();
-    }
-    //If the range is empty, the header needs to be sent w/out MORE,
-    // so we can't send it right away
-    bool sentHeader = false;
-    //Iterate over all key-values in the range
-    zmq_msg_t keyMsg;
-    bool haveLastKeyMsg = false; //Needed to send only last frame without SNDMORE
-    for (; it->Valid(); (invertScanDirection ? it->Prev() : it->Next())) {
-        rocksdb::Slice key = it->key();
-        const char* keyData = key.data();
-        size_t keySize = key.size();
-        //Check list limit
-        if (listLimit <= 0) {
-            break;
-        }
-        listLimit--;
-        //Check if we have to stop here
-        int compareResult = (haveRangeEnd ? key.compare(rangeEndSlice) : 0);
-        if (haveRangeEnd
-                && (!invertScanDirection || compareResult <= 0)
-                && (invertScanDirection  || compareResult >= 0)) {
-            break;
-        }
-        rocksdb::Slice value = it->value();
-        const char* valueData = value.data();
-        size_t valueSize = value.size();
-        //Check key / value filters, if any
-        if(haveKeyFilter && keyFilter.find(keyData, keySize) == -1) {
-            listLimit++; //Revert decrement from above
-            continue; //Next key/value, if any
-        }
-        if(haveValueFilter && valueFilter.find(valueData, valueSize) == -1) {
-            listLimit++; //Revert decrement from above
-            continue; //Next key/value, if any
-        }
-        //Check if the frame needs to be skipped
-        if(scanSkipCount > 0) {
-            scanSkipCount--;
-            continue;
+    ScanRange range;
+    parseRangeFrames(range.start, range.end, "Count request compact range parsing");
+    uint64_t count = 0;
+    uint64_t errorBound = 0;
+    if (countMode == CountMode::Iterate) {
+        //Create the iterator
+        rocksdb::ReadOptions readOptions;
+        rocksdb::Iterator* it = db->NewIterator(readOptions);
+        auto countRecord = [&count](const rocksdb::Slice& key, const rocksdb::Slice& value) -> bool {
+            count++;
+            return true;
+        };
+        scanRange<false>(it, range, countRecord);
+        //Check if any error occured during iteration
+        if (!checkRocksDBStatus(it->status(), "RocksDB error while counting", true)) {
+            delete it;
+            return;
         }
-        //Send the previous value msg, if any
-        if (!sentHeader) {
-            sendResponseHeader(ackResponse, ZMQ_SNDMORE);
-            sentHeader = true;
+        delete it;
+    } else if (countMode == CountMode::Approximate) {
+        rocksdb::Status status = estimateRangeCount(db, range, count, errorBound);
+        if (!checkRocksDBStatus(status, "RocksDB error while estimating count", true)) {
+            return;
         }
-        if (haveLastKeyMsg) {
-            if (unlikely(!sendMsgHandleError(&keyMsg, ZMQ_SNDMORE, "ZMQ error while sending list reply (not last)", true))) {
-                delete it;
-                return;
-            }
+    } else if (countMode == CountMode::KeyCounters) {
+        //The start key is the prefix to count
+        KeyCounter* keyCounter = tablespace.getKeyCounter(tableId);
+        std::string errorMessage;
+        if (keyCounter == nullptr) {
+            errorMessage = "Key counters are not enabled for table " + std::to_string(tableId);
+        } else if (!range.end.empty()) {
+            errorMessage = "Key counters only support prefixes, but a range end key has been given";
+        } else if (!keyCounter->countPrefix(range.start, count)) {
+            errorMessage = "Prefix is longer than the counted prefix length "
+                + std::to_string(keyCounter->getPrefixLength());
         }
-        //Convert the slices into msgs and send them
-        haveLastKeyMsg = true;
-        zmq_msg_init_size(&keyMsg, keySize);
-        memcpy(zmq_msg_data(&keyMsg), keyData, keySize);
-    }
-    //Send the previous value msg, if any
-    if (haveLastKeyMsg) {
-        if (unlikely(!sendMsgHandleError(&keyMsg, 0, "ZMQ error while sending last list reply", true))) {
-            delete it;
+        if (!errorMessage.empty()) {
+            logger.warn(errorMessage);
+            sendErrorResponseHeader(ZMQ_SNDMORE);
+            sendFrame(errorMessage, processorOutputSocket, logger, "Count error message");
             return;
         }
-    }
-    //If the scanned range is empty, the header has not been sent yet
-    if (!sentHeader) {
-        sendResponseHeader(ackResponse, 0);
-    }
-    //Check if any error occured during iteration
-    if (!checkRocksDBStatus(it->status(),
-            "RocksDB error while scanning",
-            true)) {
-        delete it;
+    } else {
+        std::string errorMessage = "Unknown count mode " + std::to_string((uint8_t) countMode);
+        logger.warn(errorMessage);
+        sendErrorResponseHeader(ZMQ_SNDMORE);
+        sendFrame(errorMessage, processorOutputSocket, logger, "Count error message");
         return;
     }
-    delete it;
+    //Send ACK and count
+    sendResponseHeader(ackResponse, ZMQ_SNDMORE);
+    if (countMode == CountMode::Approximate) {
+        sendBinary<uint64_t>(count, processorOutputSocket, logger, "Count", ZMQ_SNDMORE);
+        sendBinary<uint64_t>(errorBound, processorOutputSocket, logger, "Count error bound");
+    } else {
+        sendBinary<uint64_t>(count, processorOutputSocket, logger);
+    }
 }
 
-void ReadWorker::handleCountRequest(zmq_msg_t* headerFrame) {
-    errorResponse = "\x31\x01\x11\x01";
-    static const char* ackResponse = "\x31\x01\x11\x00";
+void ReadWorker::handleIntersectRequest(zmq_msg_t* headerFrame) {
+    errorResponse = "\x31\x01\x15\x01";
+    static const char* ackResponse = "\x31\x01\x15\x00";
+    bool ignoreMissingKeys = isIgnoreMissingKeys(getIntersectFlags(headerFrame));
     //Parse table ID
     uint32_t tableId;
-    if (!parseUint32Frame(tableId, "Table ID frame in count request", true)) {
+    if (!parseUint32Frame(tableId, "Table ID frame in intersect request", true)) {
         return;
     }
-    //Check if there is a range frame at all
-    if (!expectNextFrame("Only table ID frame found in count request, range missing", true)) {
+    if (!expectNextFrame("Only table ID frame found in intersect request, limit missing", true)) {
+        return;
+    }
+    uint64_t limit;
+    if (!parseUint64FrameOrAssumeDefault(limit,
+                std::numeric_limits<uint64_t>::max(),
+                "intersect limit frame", true)) {
         return;
     }
     //Get the table to read from
     rocksdb::DB* db = tablespace.getTable(tableId, tableOpenHelper);
-    //Parse the from-to range
-    std::string rangeStartStr;
-    std::string rangeEndStr;
-    parseRangeFrames(rangeStartStr, rangeEndStr, "Count request compact range parsing");
-    bool haveRangeStart = !(rangeStartStr.empty());
-    bool haveRangeEnd = !(rangeEndStr.empty());
-    //Convert the str to a slice, to compare the iterator slice in-place
-    rocksdb::Slice rangeEndSlice(rangeEndStr);
-    //Do the compaction (takes LONG)
-    //Create the response object
+    bool postingsTable = tablespace.isPostingsTable(tableId);
+    //Look up the lists batch-wise. The values stay pinned until the intersection is done
     rocksdb::ReadOptions readOptions;
-    rocksdb::Status status;
-    //Create the iterator
-    rocksdb::Iterator* it = db->NewIterator(readOptions);
-    if (haveRangeStart) {
-        it->Seek(rangeStartStr);
-    } else {
-        it->SeekToFirst();
+    std::vector<rocksdb::PinnableSlice> lists;
+    bool missingList = false;
+    while (socketHasMoreFrames(processorInputSocket)) {
+        ssize_t numKeys = receiveKeyBatch("Receive intersect key frame");
+        if (unlikely(numKeys == -1)) {
+            return;
+        }
+        for (ssize_t i = 0; i < numKeys; i++) {
+            keyOrder[i] = i;
+        }
+        sortKeyBatch(numKeys);
+        db->MultiGet(readOptions, db->DefaultColumnFamily(), numKeys,
+                     sortedKeys.data(), values.data(), statuses.data(), true);
+        for (ssize_t i = 0; i < numKeys; i++) {
+            if (unlikely(!statuses[i].ok() && !statuses[i].IsNotFound())) {
+                checkRocksDBStatus(statuses[i], "RocksDB error while reading intersect key", true);
+                logger.trace("The key that caused the error was " + sortedKeys[i].ToString());
+                for (ssize_t j = 0; j < numKeys; j++) {
+                    values[j].Reset();
+                }
+                closeKeyBatch(numKeys);
+                return;
+            }
+        }
+        closeKeyBatch(numKeys);
+        for (ssize_t i = 0; i < numKeys; i++) {
+            if (statuses[i].IsNotFound() || values[i].empty()) {
+                missingList = missingList || !ignoreMissingKeys;
+                values[i].Reset();
+            } else {
+                lists.emplace_back(std::move(values[i]));
+            }
+        }
     }
-    uint64_t count = 0;
-    //Iterate over all key-values in the range
-    for (; it->Valid(); it->Next()) {
-        rocksdb::Slice key = it->key();
-        if (haveRangeEnd && key.compare(rangeEndSlice) >= 0) {
-            break;
+    if (missingList) {
+        lists.clear();
+    }
+    auto sendCorruptionError = [this]() {
+        static const char* errorMessage = "Corrupt posting list in intersect request";
+        logger.error(errorMessage);
+        sendErrorResponseHeader(ZMQ_SNDMORE);
+        sendFrame(errorMessage, strlen(errorMessage), processorOutputSocket, logger, "Intersect error message");
+    };
+    //Plain entity lists (e.g. NULAPPENDSET tables or values that have not been merged yet)
+    // are converted to posting lists first
+    std::deque<std::string> encodedLists;
+    std::vector<PostingListReader> readers(lists.size());
+    std::vector<PostingListReader*> sortedReaders;
+    for (size_t i = 0; i < lists.size(); i++) {
+        if (!postingsTable || !readers[i].open(lists[i])) {
+            encodedLists.emplace_back();
+            encodeEntityList(lists[i], encodedLists.back());
+            readers[i].open(encodedLists.back());
+        }
+        sortedReaders.push_back(&readers[i]);
+    }
+    //The shortest list drives the intersection
+    std::sort(sortedReaders.begin(), sortedReaders.end(),
+        [](const PostingListReader* a, const PostingListReader* b) {
+            return a->size() < b->size();
+        });
+    //Collect the result, so corrupt lists can be reported before sending anything
+    std::string resultData;
+    std::vector<size_t> resultEnds;
+    auto collectEntry = [&resultData, &resultEnds](const rocksdb::Slice& entry) -> bool {
+        resultData.append(entry.data(), entry.size());
+        resultEnds.push_back(resultData.size());
+        return true;
+    };
+    intersectPostingLists(sortedReaders, limit, collectEntry);
+    for (const PostingListReader& reader : readers) {
+        if (reader.isCorrupted()) {
+            sendCorruptionError();
+            return;
         }
-        count++;
     }
-    //Check if any error occured during iteration
-    if (!checkRocksDBStatus(it->status(), "RocksDB error while counting", true)) {
-        delete it;
-        return;
+    //Send header & entities. The last entity is sent without SNDMORE
+    sendResponseHeader(ackResponse, resultEnds.empty() ? 0 : ZMQ_SNDMORE);
+    size_t start = 0;
+    for (size_t i = 0; i < resultEnds.size(); i++) {
+        int flags = (i == resultEnds.size() - 1) ? 0 : ZMQ_SNDMORE;
+        if (unlikely(sendFrame(resultData.data() + start, resultEnds[i] - start,
+                               processorOutputSocket, logger, "Intersect result", flags) == -1)) {
+            return;
+        }
+        start = resultEnds[i];
     }
-    delete it;
-    //Send ACK and count
-    sendResponseHeader(ackResponse, ZMQ_SNDMORE);
-    sendBinary<uint64_t>(count, processorOutputSocket, logger);
 }
 
 void ReadWorker::handleTableInfoRequest(zmq_msg_t* headerFrame) {
@@ -612,6 +759,30 @@ void ReadWorker::handleTableInfoRequest(zmq_msg_t* headerFrame) {
     //Add the approximate size of the table directory
     size_t tableDirSize = getDirectoryFilesize(cfg.getTableDirectory(tableIndex).c_str());
     paramsMap["FileSize"] = std::to_string(tableDirSize);
+    //Add block cache info. For the shared cache, usage and capacity
+    // refer to the cache as a whole, but the hit ratio refers to this table only.
+    if (table != nullptr) {
+        paramsMap["BlockCacheShared"] = (params.dedicatedCacheSize == 0 ? "true" : "false");
+        std::string value;
+        if (table->GetProperty("rocksdb.block-cache-capacity", &value)) {
+            paramsMap["BlockCacheCapacity"] = value;
+        }
+        if (table->GetProperty("rocksdb.block-cache-usage", &value)) {
+            paramsMap["BlockCacheUsage"] = value;
+        }
+        std::shared_ptr<rocksdb::Statistics> statistics = table->GetOptions().statistics;
+        if (statistics) {
+            uint64_t hits = statistics->getTickerCount(rocksdb::BLOCK_CACHE_HIT);
+            uint64_t misses = statistics->getTickerCount(rocksdb::BLOCK_CACHE_MISS);
+            paramsMap["BlockCacheHits"] = std::to_string(hits);
+            paramsMap["BlockCacheMisses"] = std::to_string(misses);
+            if (hits + misses > 0) {
+                paramsMap["BlockCacheHitRatio"] = std::to_string((double) hits / (hits + misses));
+            }
+        }
+        //Add write statistics since the table has been opened
+        tablespace.getWriteStatistics(tableIndex)->toMap(paramsMap);
+    }
     //Send header & k/v map
     sendResponseHeader(ackResponse, ZMQ_SNDMORE);
     sendMap(paramsMap, "table info request params map", false);
@@ -662,6 +833,8 @@ bool ReadWorker::processNextRequest() {
         handleScanRequest(&headerFrame);
     } else if (requestType == RequestType::ListRequest) {
         handleListRequest(&headerFrame);
+    } else if (requestType == RequestType::IntersectRequest) {
+        handleIntersectRequest(&headerFrame);
     } else if (requestType == RequestType::TableInfoRequest) {
         handleTableInfoRequest(&headerFrame);
     } else {
@@ -0,0 +1,231 @@
+#include "ScanPredicate.hpp"
+#include <cstring>
+#include <algorithm>
+#include "macros.hpp"
+
+/**
+ * Reads little-endian values from a predicate program
+ * and checks for premature end of program
+ */
+class PredicateProgramReader {
+public:
+    PredicateProgramReader(const char* program, size_t length)
+        : program(program), length(length), position(0) {
+    }
+    bool atEnd() const {
+        return position >= length;
+    }
+    size_t getPosition() const {
+        return position;
+    }
+    template<typename T>
+    bool read(T& dst) {
+        if (length - position < sizeof(T)) {
+            return false;
+        }
+        memcpy(&dst, program + position, sizeof(T));
+        position += sizeof(T);
+        return true;
+    }
+    /**
+     * Read a string prefixed by its 4-byte length
+     */
+    bool readString(std::string& dst) {
+        uint32_t stringLength;
+        if (!read(stringLength) || length - position < stringLength) {
+            return false;
+        }
+        dst.assign(program + position, stringLength);
+        position += stringLength;
+        return true;
+    }
+private:
+    const char* program;
+    size_t length;
+    size_t position;
+};
+
+/**
+ * Limits the recursion depth of the evaluation
+ */
+static const uint32_t maxPredicateDepth = 256;
+
+/**
+ * Limits the total length of the ContainsAny/ContainsAll patterns of a predicate.
+ * The automata use a dense transition table of 1 KiB per pattern byte.
+ */
+static const size_t maxMultiPatternBytes = 16 * 1024;
+
+ScanPredicate::ScanPredicate() : root(0) {
+}
+
+bool COLD ScanPredicate::compile(const char* program, size_t length, std::string& errorMessage) {
+    PredicateProgramReader reader(program, length);
+    std::vector<uint32_t> stack;
+    std::vector<uint32_t> depths; //Node index --> depth of the subtree
+    size_t multiPatternBytes = 0;
+    while (!reader.atEnd()) {
+        size_t instructionOffset = reader.getPosition();
+        std::string offsetInfo = " at offset " + std::to_string(instructionOffset);
+        uint8_t instruction;
+        reader.read(instruction);
+        Node node;
+        node.opcode = (PredicateOpcode) (instruction & ~PredicateTargetValue);
+        node.targetValue = (instruction & PredicateTargetValue) != 0;
+        node.left = node.right = 0;
+        node.offset = 0;
+        node.matcher = 0;
+        switch (node.opcode) {
+            case PredicateOpcode::Prefix:
+            case PredicateOpcode::Suffix:
+            case PredicateOpcode::Contains:
+            case PredicateOpcode::Regex: {
+                if (!reader.readString(node.pattern)) {
+                    errorMessage = "Truncated predicate pattern" + offsetInfo;
+                    return false;
+                }
+                if (node.opcode == PredicateOpcode::Contains) {
+                    node.matcher = searchers.size();
+                    searchers.emplace_back(new SubstringSearcher(node.pattern));
+                } else if (node.opcode == PredicateOpcode::Regex) {
+                    /**
+                     * RE2 runs in linear time and constant stack space, so client-supplied
+                     * expressions can't crash the worker like a backtracking engine
+                     * on large values. The memory of the compiled expression is limited by max_mem.
+                     * Keys and values are binary, so the expression matches bytes, not UTF-8.
+                     */
+                    RE2::Options options;
+                    options.set_encoding(RE2::Options::EncodingLatin1);
+                    options.set_log_errors(false);
+                    std::unique_ptr<RE2> regex(new RE2(node.pattern, options));
+                    if (!regex->ok()) {
+                        errorMessage = "Invalid regular expression" + offsetInfo + ": " + regex->error();
+                        return false;
+                    }
+                    node.matcher = regexes.size();
+                    regexes.push_back(std::move(regex));
+                }
+                break;
+            }
+            case PredicateOpcode::EqualsAt: {
+                if (!reader.read(node.offset) || !reader.readString(node.pattern)) {
+                    errorMessage = "Truncated equals-at predicate" + offsetInfo;
+                    return false;
+                }
+                break;
+            }
+            case PredicateOpcode::ContainsAny:
+            case PredicateOpcode::ContainsAll: {
+                uint32_t numPatterns;
+                //Each pattern needs at least its 4-byte length
+                if (!reader.read(numPatterns)
+                        || numPatterns > (length - reader.getPosition()) / 4) {
+                    errorMessage = "Truncated multi-pattern predicate" + offsetInfo;
+                    return false;
+                }
+                std::vector<std::string> patterns(numPatterns);
+                for (uint32_t i = 0; i < numPatterns; i++) {
+                    if (!reader.readString(patterns[i])) {
+                        errorMessage = "Truncated multi-pattern predicate" + offsetInfo;
+                        return false;
+                    }
+                    multiPatternBytes += patterns[i].size();
+                    if (multiPatternBytes > maxMultiPatternBytes) {
+                        errorMessage = "Multi-pattern predicates exceed the limit of "
+                            + std::to_string(maxMultiPatternBytes) + " pattern bytes" + offsetInfo;
+                        return false;
+                    }
+                }
+                node.matcher = automata.size();
+                automata.emplace_back(new AhoCorasickAutomaton(patterns));
+                break;
+            }
+            case PredicateOpcode::Not: {
+                if (stack.empty()) {
+                    errorMessage = "Missing operand for NOT" + offsetInfo;
+                    return false;
+                }
+                node.left = stack.back();
+                stack.pop_back();
+                break;
+            }
+            case PredicateOpcode::And:
+            case PredicateOpcode::Or: {
+                if (stack.size() < 2) {
+                    errorMessage = "Missing operand for AND/OR" + offsetInfo;
+                    return false;
+                }
+                node.right = stack.back();
+                stack.pop_back();
+                node.left = stack.back();
+                stack.pop_back();
+                break;
+            }
+            default: {
+                errorMessage = "Unknown predicate opcode " + std::to_string(instruction) + offsetInfo;
+                return false;
+            }
+        }
+        uint32_t depth = 1;
+        if (node.opcode == PredicateOpcode::Not) {
+            depth = depths[node.left] + 1;
+        } else if (node.opcode == PredicateOpcode::And || node.opcode == PredicateOpcode::Or) {
+            depth = std::max(depths[node.left], depths[node.right]) + 1;
+        }
+        if (depth > maxPredicateDepth) {
+            errorMessage = "Predicate is nested too deeply" + offsetInfo;
+            return false;
+        }
+        depths.push_back(depth);
+        stack.push_back(nodes.size());
+        nodes.push_back(std::move(node));
+    }
+    //An empty program is allowed and matches everything
+    if (stack.size() > 1) {
+        errorMessage = "Predicate program leaves " + std::to_string(stack.size())
+            + " operands, combine them using AND or OR";
+        return false;
+    }
+    if (!stack.empty()) {
+        root = stack.back();
+    }
+    return true;
+}
+
+bool HOT ScanPredicate::evaluate(uint32_t nodeIndex, const char* key, size_t keySize,
+                                 const char* value, size_t valueSize) {
+    const Node& node = nodes[nodeIndex];
+    const char* data = node.targetValue ? value : key;
+    size_t size = node.targetValue ? valueSize : keySize;
+    const std::string& pattern = node.pattern;
+    switch (node.opcode) {
+        case PredicateOpcode::Prefix:
+            return size >= pattern.size()
+                && memcmp(data, pattern.data(), pattern.size()) == 0;
+        case PredicateOpcode::Suffix:
+            return size >= pattern.size()
+                && memcmp(data + size - pattern.size(), pattern.data(), pattern.size()) == 0;
+        case PredicateOpcode::Contains:
+            //Empty patterns are contained in everything
+            return pattern.empty() || searchers[node.matcher]->find(data, size) != -1;
+        case PredicateOpcode::EqualsAt:
+            return node.offset <= size && size - node.offset >= pattern.size()
+                && memcmp(data + node.offset, pattern.data(), pattern.size()) == 0;
+        case PredicateOpcode::Regex:
+            return RE2::PartialMatch(re2::StringPiece(data, size), *regexes[node.matcher]);
+        case PredicateOpcode::ContainsAny:
+            return automata[node.matcher]->matchesAny(data, size);
+        case PredicateOpcode::ContainsAll:
+            return automata[node.matcher]->matchesAll(data, size);
+        case PredicateOpcode::Not:
+            return !evaluate(node.left, key, keySize, value, valueSize);
+        case PredicateOpcode::And:
+            return evaluate(node.left, key, keySize, value, valueSize)
+                && evaluate(node.right, key, keySize, value, valueSize);
+        case PredicateOpcode::Or:
+            return evaluate(node.left, key, keySize, value, valueSize)
+                || evaluate(node.right, key, keySize, value, valueSize);
+        default:
+            return false;
+    }
+}
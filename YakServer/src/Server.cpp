@@ -94,6 +94,7 @@ void HOT KeyValueServer::handleRequestResponse() {
             || requestType == RequestType::ExistsRequest
             || requestType == RequestType::ScanRequest
             || requestType == RequestType::ListRequest
+            || requestType == RequestType::IntersectRequest
             || requestType == RequestType::TableInfoRequest) {
         /*
          * NOTE: Table info requests are routed (arbitrarily) to read worker threads,
@@ -110,22 +111,22 @@ void HOT KeyValueServer::handleRequestResponse() {
     } else if (requestType == RequestType::OpenTableRequest
             || requestType == RequestType::CloseTableRequest
             || requestType == RequestType::CompactTableRequest
-            || requestType == RequestType::TruncateTableRequest) {
+            || requestType == RequestType::TruncateTableRequest
+            || requestType == RequestType::MoveTableRequest
+            || requestType == RequestType::WatchTestRequest) {
         /**
-         * Table open/close/compact/truncate requests are redirected to the table opener
+         * Table open/close/compact/truncate/move requests are redirected to the table opener
          *  in the update threads in order to avoid introducing overhead
          * by starting specific threads.
+         * Watch test requests are published by the update threads, so the
+         *  test event is published after preceding table change events.
          *
          * These requests should are not expected to arrive in high-load situations
          * but merely provide a convenience tool for interactive access.
          *
-         * In the worst case, some work piles up for a compacting thread, but
-         * as compacting is not the kind of operation you want to do while
-         * heavily writing to the database anyway, this is considered
-         * a non-bug and improvement only
-         *
-         * In the future, this might be avoided by different worker scheduling
-         * algorithms (post office style)
+         * Compactions and truncations are scheduled to a separate lane
+         * by the update post office, so they don't block puts and deletes
+         * that arrive while they are being processed.
          */
         void* dstSocket = updateWorkerController.workerPushSocket;
         //Send the info frame (--> we have addr info)
@@ -141,7 +142,8 @@ void HOT KeyValueServer::handleRequestResponse() {
         }
     } else if (requestType == RequestType::PutRequest
             || requestType == RequestType::DeleteRequest
-            || requestType == RequestType::DeleteRangeRequest) {
+            || requestType == RequestType::DeleteRangeRequest
+            || requestType == RequestType::BulkLoadRequest) {
         void* workerSocket = updateWorkerController.workerPushSocket;
         /**
          * Only for partsync messages the routing info (addr + delim frame)
@@ -247,8 +249,7 @@ void HOT KeyValueServer::handleRequestResponse() {
     }
 }
 
-void HOT KeyValueServer::handlePushPull() {
-    void* sock = externalPullSocket;
+void HOT KeyValueServer::handlePushPull(void* sock) {
     //Receive the header frame
     zmq_msg_t headerFrame;
     zmq_msg_init(&headerFrame);
@@ -270,7 +271,8 @@ void HOT KeyValueServer::handlePushPull() {
     RequestType requestType = (RequestType) (uint8_t) headerData[2];
     if (likely(requestType == RequestType::PutRequest
             || requestType == RequestType::DeleteRequest
-            || requestType == RequestType::DeleteRangeRequest)) {
+            || requestType == RequestType::DeleteRangeRequest
+            || requestType == RequestType::BulkLoadRequest)) {
         //Send the message to the update worker (--> processed async)
         //This is simpler than the req/rep controller because no
         // response flags need to be checked
@@ -300,6 +302,24 @@ void HOT KeyValueServer::handlePushPull() {
     }
 }
 
+void HOT KeyValueServer::handleSubscription() {
+    void* sock = externalSubSocket;
+    //The topic frame has already been matched by the subscription filter
+    zmq_msg_t topicFrame;
+    zmq_msg_init(&topicFrame);
+    if(receiveLogError(&topicFrame, sock, logger, "Topic frame") == -1) {
+        zmq_msg_close(&topicFrame);
+        return;
+    }
+    bool haveRequest = zmq_msg_more(&topicFrame);
+    zmq_msg_close(&topicFrame);
+    if(unlikely(!haveRequest)) {
+        logger.warn("Received message without request over SUB socket");
+        return;
+    }
+    handlePushPull(sock);
+}
+
 KeyValueServer::KeyValueServer(ConfigParser& configParserParam) :
 ctx(zmq_ctx_new()),
 logServer(ctx, LogLevel::Trace, true), //Autostart log server
@@ -309,9 +329,10 @@ externalSubSocket(nullptr),
 externalPullSocket(nullptr),
 responseProxySocket(nullptr),
 tableOpenServer(ctx, configParserParam, tables),
+watchDistributor(ctx, configParserParam),
 updateWorkerController(ctx, tables, configParserParam),
 readWorkerController(ctx, tables, configParserParam),
-asyncJobRouterController(ctx, tables),
+asyncJobRouterController(ctx, tables, configParserParam),
 logger(ctx, "Request router"),
 configParser(configParserParam)
  {
@@ -362,6 +383,30 @@ configParser(configParserParam)
         logger.debug("Binding PULL socket to " + endpoint);
         zmq_bind(externalPullSocket, endpoint.c_str());
     }
+    /*
+     * SUB
+     * Publishers (e.g. a master instance replicating its writes) send
+     * the topic frame followed by an update request
+     */
+    externalSubSocket = zmq_socket(ctx, ZMQ_SUB);
+    setHWM(externalSubSocket, configParser.externalRCVHWM, configParser.externalSNDHWM, logger);
+    if(!configParser.zmqIPv4Only) {
+        zmq_set_ipv6(externalSubSocket, true);
+    }
+    for(const std::string& topic : configParser.subTopics) {
+        zmq_setsockopt(externalSubSocket, ZMQ_SUBSCRIBE, topic.data(), topic.size());
+    }
+    for(const std::string& endpoint : configParser.subEndpoints) {
+        logger.debug("Binding SUB socket to " + endpoint);
+        zmq_bind(externalSubSocket, endpoint.c_str());
+    }
+    for(const std::string& endpoint : configParser.subConnectEndpoints) {
+        if(endpoint.empty()) { //Not configured
+            continue;
+        }
+        logger.debug("Connecting SUB socket to " + endpoint);
+        zmq_connect(externalSubSocket, endpoint.c_str());
+    }
     //Response proxy socket to route asynchronous responses
     responseProxySocket = zmq_socket_new_bind_hwm(ctx, ZMQ_PULL,
         externalRequestProxyEndpoint, configParser.externalRCVHWM,
@@ -397,18 +442,19 @@ KeyValueServer::~KeyValueServer() {
 }
 
 void KeyValueServer::start() {
-    //TODO sub poller
-    zmq_pollitem_t items[3];
+    zmq_pollitem_t items[4];
     items[0].socket = externalRepSocket;
     items[0].events = ZMQ_POLLIN;
     items[1].socket = externalPullSocket;
     items[1].events = ZMQ_POLLIN;
     items[2].socket = responseProxySocket;
     items[2].events = ZMQ_POLLIN;
+    items[3].socket = externalSubSocket;
+    items[3].events = ZMQ_POLLIN;
     //Main server event loop. Returns after being interrupted
     //The stop server request simulates the interrupt
     while(true) {
-        if(unlikely(zmq_poll(items, 3, -1) == -1)) {
+        if(unlikely(zmq_poll(items, 4, -1) == -1)) {
             if(yak_interrupted) {
                 break;
             }
@@ -420,7 +466,10 @@ void KeyValueServer::start() {
             handleRequestResponse();
         }
         if(items[1].revents) {
-            handlePushPull();
+            handlePushPull(externalPullSocket);
+        }
+        if(items[3].revents) {
+            handleSubscription();
         }
         if(items[2].revents) { //Response proxy
             /**
@@ -450,6 +499,7 @@ void KeyValueServer::start() {
      * in order to be able to log all errors
      */
     updateWorkerController.terminateAll();
+    watchDistributor.terminate(); //Publishes the events of the update workers first
     readWorkerController.terminateAll();
     asyncJobRouterController.terminate();
     tableOpenServer.terminate();
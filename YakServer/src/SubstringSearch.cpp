@@ -0,0 +1,139 @@
+#include "SubstringSearch.hpp"
+#include <cstring>
+#include "macros.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/**
+ * Check if the pattern occurs at a candidate position where the first
+ * and the last byte are already known to match
+ */
+static inline bool matchesInner(const char* candidate, const char* pattern, size_t patternLength) {
+    return patternLength <= 2
+        || memcmp(candidate + 1, pattern + 1, patternLength - 2) == 0;
+}
+
+/**
+ * Scalar search for the remaining positions that don't fill a whole SIMD block
+ */
+static inline int64_t findTail(const char* corpus, size_t corpusLength,
+        const char* pattern, size_t patternLength, size_t offset) {
+    for (size_t i = offset; i + patternLength <= corpusLength; i++) {
+        if (corpus[i] == pattern[0]
+                && corpus[i + patternLength - 1] == pattern[patternLength - 1]
+                && matchesInner(corpus + i, pattern, patternLength)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#ifdef HAVE_X86_SIMD
+
+static int64_t HOT __attribute__((target("sse2"))) findSSE2(
+        const char* corpus, size_t corpusLength,
+        const char* pattern, size_t patternLength) {
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[patternLength - 1]);
+    size_t i = 0;
+    //Each iteration checks the 16 positions [i, i + 16)
+    for (; i + patternLength + 15 <= corpusLength; i += 16) {
+        __m128i blockFirst = _mm_loadu_si128((const __m128i*)(corpus + i));
+        __m128i blockLast = _mm_loadu_si128((const __m128i*)(corpus + i + patternLength - 1));
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast)));
+        while (mask != 0) {
+            size_t candidate = i + __builtin_ctz(mask);
+            if (matchesInner(corpus + candidate, pattern, patternLength)) {
+                return candidate;
+            }
+            mask &= mask - 1; //Clear lowest set bit
+        }
+    }
+    return findTail(corpus, corpusLength, pattern, patternLength, i);
+}
+
+static int64_t HOT __attribute__((target("avx2"))) findAVX2(
+        const char* corpus, size_t corpusLength,
+        const char* pattern, size_t patternLength) {
+    const __m256i first = _mm256_set1_epi8(pattern[0]);
+    const __m256i last = _mm256_set1_epi8(pattern[patternLength - 1]);
+    size_t i = 0;
+    //Each iteration checks the 32 positions [i, i + 32)
+    for (; i + patternLength + 31 <= corpusLength; i += 32) {
+        __m256i blockFirst = _mm256_loadu_si256((const __m256i*)(corpus + i));
+        __m256i blockLast = _mm256_loadu_si256((const __m256i*)(corpus + i + patternLength - 1));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(
+            _mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast)));
+        while (mask != 0) {
+            size_t candidate = i + __builtin_ctz(mask);
+            if (matchesInner(corpus + candidate, pattern, patternLength)) {
+                return candidate;
+            }
+            mask &= mask - 1; //Clear lowest set bit
+        }
+    }
+    return findTail(corpus, corpusLength, pattern, patternLength, i);
+}
+
+#endif //HAVE_X86_SIMD
+
+bool SubstringSearcher::isSupported(Implementation implementation) {
+    switch (implementation) {
+        case Implementation::Auto:
+        case Implementation::BoyerMooreHorspool:
+            return true;
+#ifdef HAVE_X86_SIMD
+        case Implementation::SSE2:
+            return __builtin_cpu_supports("sse2");
+        case Implementation::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+SubstringSearcher::Implementation SubstringSearcher::getFastestImplementation() {
+    //Evaluated only once
+    static const Implementation fastest =
+        isSupported(Implementation::AVX2) ? Implementation::AVX2
+        : (isSupported(Implementation::SSE2) ? Implementation::SSE2
+           : Implementation::BoyerMooreHorspool);
+    return fastest;
+}
+
+SubstringSearcher::SubstringSearcher(const std::string& patternParam,
+                                     Implementation implementationParam)
+    : pattern(patternParam),
+      implementation(implementationParam),
+      bmhSearcher(pattern) {
+    if (implementation == Implementation::Auto || !isSupported(implementation)) {
+        implementation = getFastestImplementation();
+    }
+}
+
+int64_t SubstringSearcher::find(const std::string& corpus) const {
+    return find(corpus.data(), corpus.size());
+}
+
+int64_t HOT SubstringSearcher::find(const char* corpus, size_t corpusLength) const {
+    size_t patternLength = pattern.size();
+    //Empty patterns are DEFINED as not found, like in BoyerMooreHorspoolSearcher
+    if (patternLength == 0 || patternLength > corpusLength) {
+        return -1;
+    }
+    switch (implementation) {
+#ifdef HAVE_X86_SIMD
+        case Implementation::AVX2:
+            return findAVX2(corpus, corpusLength, pattern.data(), patternLength);
+        case Implementation::SSE2:
+            return findSSE2(corpus, corpusLength, pattern.data(), patternLength);
+#endif
+        default:
+            return bmhSearcher.find(corpus, corpusLength);
+    }
+}
@@ -29,17 +29,21 @@ int sendTableOperationRequest(void* socket, TableOperationRequestType requestTyp
 }
 
 TableOpenParameters::TableOpenParameters(const ConfigParser& cfg) :
-    lruCacheSize(cfg.defaultLRUCacheSize),
+    dedicatedCacheSize(0),
     tableBlockSize(cfg.defaultTableBlockSize),
     writeBufferSize(cfg.defaultWriteBufferSize),
     bloomFilterBitsPerKey(cfg.defaultBloomFilterBitsPerKey),
     compression(cfg.defaultCompression),
-    mergeOperatorCode(cfg.defaultMergeOperator) {
+    mergeOperatorCode(cfg.defaultMergeOperator),
+    keyCounterPrefixLength(-1) {
 }
 
 void TableOpenParameters::parseFromParameterMap(std::map<std::string, std::string>& parameters) {
-    if(parameters.count("LRUCacheSize")) {
-        lruCacheSize = stoull(parameters["LRUCacheSize"]);
+    if(parameters.count("DedicatedLRUCacheSize")) {
+        dedicatedCacheSize = stoull(parameters["DedicatedLRUCacheSize"]);
+    } else if(parameters.count("LRUCacheSize")) {
+        //Legacy clients: A per-table cache size means a dedicated cache
+        dedicatedCacheSize = stoull(parameters["LRUCacheSize"]);
     }
     if(parameters.count("Blocksize")) {
         tableBlockSize = stoull(parameters["Blocksize"]);
@@ -56,23 +60,33 @@ void TableOpenParameters::parseFromParameterMap(std::map<std::string, std::strin
     if(parameters.count("MergeOperator")) {
         mergeOperatorCode = parameters["MergeOperator"];
     }
+    if(parameters.count("KeyCounterPrefixLength")) {
+        keyCounterPrefixLength = stoll(parameters["KeyCounterPrefixLength"]);
+    }
 }
 
 void COLD TableOpenParameters::toParameterMap(std::map<std::string, std::string>& parameters) {
-    parameters["LRUCacheSize"] = std::to_string(lruCacheSize);
+    parameters["DedicatedLRUCacheSize"] = std::to_string(dedicatedCacheSize);
     parameters["Blocksize"] = std::to_string(tableBlockSize);
     parameters["WriteBufferSize"] = std::to_string(writeBufferSize);
     parameters["BloomFilterBitsPerKey"] = std::to_string(bloomFilterBitsPerKey);
     parameters["CompressionMode"] = compressionModeToString(compression);
     parameters["MergeOperator"] = mergeOperatorCode;
+    parameters["KeyCounterPrefixLength"] = std::to_string(keyCounterPrefixLength);
 }
 
-TableOpenParameters::GetOptionsResult TableOpenParameters::getOptions(rocksdb::Options& options) {
+TableOpenParameters::GetOptionsResult TableOpenParameters::getOptions(
+        rocksdb::Options& options,
+        const std::shared_ptr<rocksdb::Cache>& sharedCache) {
     rocksdb::BlockBasedTableOptions bbOptions;
     //For all numeric options: <= 0 --> disable / use default
-    if(lruCacheSize > 0) {
-        bbOptions.block_cache =
-            std::shared_ptr<rocksdb::Cache>(rocksdb::NewLRUCache(lruCacheSize));
+    if(dedicatedCacheSize > 0) {
+        bbOptions.block_cache = rocksdb::NewLRUCache(dedicatedCacheSize);
+    } else if(sharedCache) {
+        bbOptions.block_cache = sharedCache;
+    } else {
+        //Without this, RocksDB would create an 8 MiB cache for each table
+        bbOptions.no_block_cache = true;
     }
     if (tableBlockSize > 0) {
         bbOptions.block_size = tableBlockSize;
@@ -111,8 +125,11 @@ void COLD TableOpenParameters::readTableConfigFile(const ConfigParser& cfg, uint
             assert(sepIndex != std::string::npos);
             std::string key = line.substr(0, sepIndex);
             std::string value = line.substr(sepIndex+1);
-            if(key == "LRUCacheSize") {
-                lruCacheSize = stoull(value);
+            if(key == "DedicatedLRUCacheSize") {
+                dedicatedCacheSize = stoull(value);
+            } else if(key == "LRUCacheSize") {
+                //Written by older versions for every table. Ignore it so
+                // existing tables use the shared cache.
             } else if(key == "Blocksize") {
                 tableBlockSize = stoull(value);
             } else if(key == "WriteBufferSize") {
@@ -123,6 +140,8 @@ void COLD TableOpenParameters::readTableConfigFile(const ConfigParser& cfg, uint
                 compression = compressionModeFromString(value);
             } else if(key == "MergeOperator") {
                 mergeOperatorCode = value;
+            } else if(key == "KeyCounterPrefixLength") {
+                keyCounterPrefixLength = stoll(value);
             } else {
                 std::cerr << "Unknown key in table config file : "
                          << key << " (= " << value << ")" << std::endl;
@@ -135,8 +154,8 @@ void COLD TableOpenParameters::readTableConfigFile(const ConfigParser& cfg, uint
 void COLD TableOpenParameters::writeToFile(const ConfigParser& cfg, uint32_t tableIndex) {
     std::string cfgFileName = cfg.getTableConfigFile(tableIndex);
     std::ofstream fout(cfgFileName.c_str());
-    if(lruCacheSize != std::numeric_limits<uint64_t>::max()) {
-        fout << "LRUCacheSize=" << lruCacheSize << '\n';
+    if(dedicatedCacheSize > 0) {
+        fout << "DedicatedLRUCacheSize=" << dedicatedCacheSize << '\n';
     }
     if(tableBlockSize != std::numeric_limits<uint64_t>::max()) {
         fout << "Blocksize=" << tableBlockSize << '\n';
@@ -149,6 +168,9 @@ void COLD TableOpenParameters::writeToFile(const ConfigParser& cfg, uint32_t tab
     }
     fout << "CompressionMode=" << compressionModeToString(compression) << '\n';
     fout << "MergeOperator=" << mergeOperatorCode << '\n';
+    if(keyCounterPrefixLength >= 0) {
+        fout << "KeyCounterPrefixLength=" << keyCounterPrefixLength << '\n';
+    }
     fout.close();
 }
 
@@ -233,6 +255,23 @@ void COLD TableOpenHelper::truncateTable(TableOpenHelper::IndexType index) {
     recvAndIgnore(reqSocket, logger);
 }
 
+std::string COLD TableOpenHelper::moveTable(TableOpenHelper::IndexType source,
+                                            TableOpenHelper::IndexType target) {
+    if(sendTableOperationRequest(reqSocket, TableOperationRequestType::MoveTable, ZMQ_SNDMORE) == -1) {
+        logMessageSendError("table move message", logger);
+    }
+    sendFrame(&source, sizeof (IndexType), reqSocket, logger, "Source table index", ZMQ_SNDMORE);
+    sendFrame(&target, sizeof (IndexType), reqSocket, logger, "Target table index");
+    //Wait for the reply and return string
+    std::string ret;
+    if(zmqRecvString(reqSocket, ret) == -1) {
+        logMessageRecvError("table move response", logger);
+        //Internal communication error
+        return "\x20";
+    }
+    return ret;
+}
+
 COLD TableOpenHelper::~TableOpenHelper() {
     zmq_close(reqSocket);
 }
@@ -3,17 +3,22 @@
 #include <fstream>
 #include <dirent.h>
 #include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
 #include <stdint.h>
 #include <iostream>
 #include <map>
 #include <string>
 #include <zmq.h>
+#include <rocksdb/statistics.h>
 
 #include "TableOpenHelper.hpp"
 #include "MergeOperators.hpp"
 #include "macros.hpp"
 #include "endpoints.hpp"
 #include "zutil.hpp"
+#include "FileUtils.hpp"
 
 using namespace std;
 
@@ -128,7 +133,6 @@ void TableOpenServer::tableOpenWorkerThread() {
         //Do the operation, depending on the request type
         if (requestType == TableOperationRequestType::OpenTable) { //Open table
             //Extract parameters
-            TableOpenParameters parameters(configParser); //Initialize with defaults == unset
             std::map<std::string, std::string> parameterMap;
             if(!receiveMap(parameterMap, "table open parameter map", false)) {
                 //See above for detailed comment on err handling here
@@ -136,94 +140,25 @@ void TableOpenServer::tableOpenWorkerThread() {
                 zmq_send_const(processorInputSocket, nullptr, 0, 0);
                 continue;
             }
-            //NOTE: We can't actually insert the config from parameterMap into
-            // parameters, because it needs to take precedence to the table config file
-            tablespace.ensureSize(tableIndex);
             //Open the table only if it hasn't been opened yet, else just ignore the request
+            std::string reply(1, '\x00'); //No action required, but return status is OK
             if (!tablespace.isTableOpen(tableIndex)) {
-                std::string tableDir = configParser.getTableDirectory(tableIndex);
-                //Override default values with the last values from the table config file, if any
-                parameters.readTableConfigFile(configParser, tableIndex);
-                //Override default + config with custom open parameters, if any
-                parameters.parseFromParameterMap(parameterMap);
-                //NOTE: Any option that has not been set up until now is now used from the config default
-                rocksdb::Options options;
-                options.IncreaseParallelism(configParser.rocksdbConcurrency);
-                if(configParser.compactionStyle
-                            == CompactionStyle::LevelStyleCompaction) {
-                    options.OptimizeLevelStyleCompaction(
-                            configParser.compactionMemoryBudget);
-                } else if(configParser.compactionStyle
-                            == CompactionStyle::UniversalStyleCompaction) {
-                    options.OptimizeUniversalStyleCompaction(
-                            configParser.compactionMemoryBudget);
-                } else {
-                    logger.error("Invalid compaction style value (internal error)");
-                }
-                options.allow_mmap_reads = configParser.useMMapReads;
-                options.allow_mmap_writes = configParser.useMMapWrites;
-                TableOpenParameters::GetOptionsResult res = parameters.getOptions(options);
-                //Handle error code in table open parameters:
-                switch(res) {
-                    case TableOpenParameters::GetOptionsResult::MergeOperatorCodeIllegal: {
-                        logger.error("Unknown merge operator code: " + parameters.mergeOperatorCode);
-                        //Fail
-                        std::string errorReplyString = "\x11Merge operator " + parameters.mergeOperatorCode + " not recognized";
-                        if (unlikely(zmq_send(processorInputSocket, errorReplyString.data(), errorReplyString.size(), 0) == -1)) {
-                            logMessageSendError("table open error reply", logger);
-                        }
-                        continue; //Recv loop
-                    }
-                    case TableOpenParameters::GetOptionsResult::Success: {
-                        //Success, nothing to be done
-                        break;
-                    }
-                    default: {
-                        //Log unknown code, but proceed as in case of success
-                        logger.error("Internal error: Unknown getOptions() return code (continuing with REPLACE): "
-                                     + std::to_string((int)res));
-                        //Use default
-                        //Set default merge operator
-                        options.merge_operator = createMergeOperator("REPLACE");
-                        break;
-                    }
-                }
-                //Open the table
-                rocksdb::Status status = rocksdb::DB::Open(options, tableDir.c_str(),
-                    tablespace.getTablePointer(tableIndex));
-                if (likely(status.ok())) {
-                    //Write the persistent config data
-                    parameters.writeToFile(configParser, tableIndex);
-                    //Send ACK reply
-                    if (unlikely(zmq_send_const(processorInputSocket, "\x00", 1, 0) == -1)) {
-                        logMessageSendError("table open (success) reply", logger);
-                    }
-                    //Log success
-                    logger.info(std::string("Opened table #")
-                        + std::to_string(tableIndex)
-                        + " compression mode = "
-                        + compressionModeToString(parameters.compression)
-                        + " using merge operator "
-                        + options.merge_operator->Name());
-                    //Set merge operator trivial flag
-                    tablespace.setMergeRequired(tableIndex,
-                        !isReplaceMergeOperator(options.merge_operator->Name()));
-                } else { //status == not ok
-                    std::string errorDescription = "Error while trying to open table #"
-                        + std::to_string(tableIndex) + " in directory " + tableDir
-                        + ": " + status.ToString();
-                    logger.error(errorDescription);
-                    //Send error reply
-                    std::string errorReplyString = "\x10" + errorDescription;
-                    if (unlikely(zmq_send(processorInputSocket, errorReplyString.data(), errorReplyString.size(), 0) == -1)) {
-                        logMessageSendError("table open error reply", logger);
-                    }
-                }
-            } else { // Table already open
-                //No action required, but return status is OK
-                if (unlikely(zmq_send_const(processorInputSocket, "\x00", 1, 0) == -1)) {
-                    logMessageSendError("table open (no action needed) reply", logger);
-                }
+                reply = openTable(tableIndex, parameterMap);
+            }
+            if (unlikely(zmq_send(processorInputSocket, reply.data(), reply.size(), 0) == -1)) {
+                logMessageSendError("table open reply", logger);
+            }
+        } else if (requestType == TableOperationRequestType::MoveTable) {
+            uint32_t targetTableIndex;
+            if(!parseUint32Frame(targetTableIndex, "target table id frame", false)) {
+                //See above for detailed comment on err handling here
+                disposeRemainingMsgParts();
+                zmq_send_const(processorInputSocket, nullptr, 0, 0);
+                continue;
+            }
+            std::string reply = moveTable(tableIndex, targetTableIndex);
+            if (unlikely(zmq_send(processorInputSocket, reply.data(), reply.size(), 0) == -1)) {
+                logMessageSendError("table move reply", logger);
             }
         } else if (requestType == TableOperationRequestType::CloseTable) { //Close table
             //No need to close if table is not open
@@ -277,6 +212,8 @@ void TableOpenServer::tableOpenWorkerThread() {
             //Now remove the table directory itself (it should be empty now)
             //Errors (e.g. for nonexistent dirs) do not exist
             rmdir(dirname.c_str());
+            //The saved key counters are not valid for the empty table
+            unlink(configParser.getTableKeyCounterFile(tableIndex).c_str());
             logger.debug("Truncated table in " + dirname);
             if (unlikely(zmq_send_const(processorInputSocket, (char*)&responseCode, 1, 0) == -1)) {
                 logMessageSendError("table truncate (success) reply", logger);
@@ -297,3 +234,161 @@ void TableOpenServer::tableOpenWorkerThread() {
     //We received an exit msg, cleanupzmq_bind(
     zmq_close(processorInputSocket);
 }
+
+std::string COLD TableOpenServer::openTable(uint32_t tableIndex,
+                                            std::map<std::string, std::string>& parameterMap) {
+    TableOpenParameters parameters(configParser); //Initialize with defaults == unset
+    //NOTE: We can't actually insert the config from parameterMap into
+    // parameters, because it needs to take precedence to the table config file
+    std::string tableDir = configParser.getTableDirectory(tableIndex);
+    //Override default values with the last values from the table config file, if any
+    parameters.readTableConfigFile(configParser, tableIndex);
+    //Override default + config with custom open parameters, if any
+    parameters.parseFromParameterMap(parameterMap);
+    //NOTE: Any option that has not been set up until now is now used from the config default
+    rocksdb::Options options;
+    options.IncreaseParallelism(configParser.rocksdbConcurrency);
+    if(configParser.compactionStyle
+                == CompactionStyle::LevelStyleCompaction) {
+        options.OptimizeLevelStyleCompaction(
+                configParser.compactionMemoryBudget);
+    } else if(configParser.compactionStyle
+                == CompactionStyle::UniversalStyleCompaction) {
+        options.OptimizeUniversalStyleCompaction(
+                configParser.compactionMemoryBudget);
+    } else {
+        logger.error("Invalid compaction style value (internal error)");
+    }
+    options.allow_mmap_reads = configParser.useMMapReads;
+    options.allow_mmap_writes = configParser.useMMapWrites;
+    options.enable_pipelined_write = configParser.pipelinedWrite;
+    options.unordered_write = configParser.unorderedWrite;
+    //Memory is bounded by resources shared among all tables
+    options.write_buffer_manager = tablespace.getWriteBufferManager();
+    if(configParser.enableTableStatistics) {
+        options.statistics = rocksdb::CreateDBStatistics();
+    }
+    TableOpenParameters::GetOptionsResult res =
+        parameters.getOptions(options, tablespace.getBlockCache());
+    //Handle error code in table open parameters:
+    switch(res) {
+        case TableOpenParameters::GetOptionsResult::MergeOperatorCodeIllegal: {
+            logger.error("Unknown merge operator code: " + parameters.mergeOperatorCode);
+            //Fail
+            return "\x11Merge operator " + parameters.mergeOperatorCode + " not recognized";
+        }
+        case TableOpenParameters::GetOptionsResult::Success: {
+            //Success, nothing to be done
+            break;
+        }
+        default: {
+            //Log unknown code, but proceed as in case of success
+            logger.error("Internal error: Unknown getOptions() return code (continuing with REPLACE): "
+                         + std::to_string((int)res));
+            //Use default
+            //Set default merge operator
+            options.merge_operator = createMergeOperator("REPLACE");
+            break;
+        }
+    }
+    //Open the table
+    rocksdb::DB* db = nullptr;
+    rocksdb::Status status = rocksdb::DB::Open(options, tableDir.c_str(), &db);
+    //Initialize the key counters before any worker can write to the table
+    KeyCounter* keyCounter = nullptr;
+    if (status.ok() && parameters.keyCounterPrefixLength >= 0) {
+        keyCounter = new KeyCounter(parameters.keyCounterPrefixLength);
+        if (!keyCounter->load(configParser.getTableKeyCounterFile(tableIndex))) {
+            logger.info("Counting keys of table #" + std::to_string(tableIndex));
+            status = keyCounter->recount(db);
+            if (!status.ok()) {
+                delete keyCounter;
+                delete db;
+            }
+        }
+    }
+    if (unlikely(!status.ok())) {
+        std::string errorDescription = "Error while trying to open table #"
+            + std::to_string(tableIndex) + " in directory " + tableDir
+            + ": " + status.ToString();
+        logger.error(errorDescription);
+        return "\x10" + errorDescription;
+    }
+    //Make the table visible to the workers.
+    // The merge operator flags need to be set at the same time
+    tablespace.setTable(tableIndex, db,
+        !isReplaceMergeOperator(options.merge_operator->Name()),
+        isPostingsMergeOperator(options.merge_operator->Name()),
+        keyCounter);
+    //Write the persistent config data
+    parameters.writeToFile(configParser, tableIndex);
+    //Log success
+    logger.info(std::string("Opened table #")
+        + std::to_string(tableIndex)
+        + " compression mode = "
+        + compressionModeToString(parameters.compression)
+        + " using merge operator "
+        + options.merge_operator->Name());
+    return std::string(1, '\x00');
+}
+
+/**
+ * Rename a file belonging to a table, replacing the file of the target table.
+ * If the source file does not exist, the target file is removed.
+ */
+static bool moveTableFile(const std::string& source, const std::string& target) {
+    if (fileExists(source)) {
+        return rename(source.c_str(), target.c_str()) == 0;
+    }
+    unlink(target.c_str());
+    return true;
+}
+
+std::string COLD TableOpenServer::moveTable(uint32_t tableIndex, uint32_t targetTableIndex) {
+    std::string sourceDir = configParser.getTableDirectory(tableIndex);
+    std::string targetDir = configParser.getTableDirectory(targetTableIndex);
+    if (tableIndex == targetTableIndex) {
+        return "\x10Source and target table are the same";
+    }
+    if (!fileExists(sourceDir)) {
+        return "\x10Source table #" + std::to_string(tableIndex) + " does not exist";
+    }
+    //Never overwrite existing data. Truncate the target table to move into its slot.
+    if (tablespace.isTableOpen(targetTableIndex) || fileExists(targetDir)) {
+        return "\x10Target table #" + std::to_string(targetTableIndex)
+            + " exists, it needs to be truncated before moving a table into its slot";
+    }
+    /**
+     * The table must be closed during the rename.
+     * Closing it saves the key counters, so they are moved with the table.
+     */
+    bool wasOpen = tablespace.isTableOpen(tableIndex);
+    if (wasOpen) {
+        logger.info("Closing table " + std::to_string(tableIndex)
+                    + " due to pending move request");
+        delete tablespace.eraseAndGetTableEntry(tableIndex);
+    }
+    //Renaming the directory atomically moves all the data, independent of the table size
+    if (rename(sourceDir.c_str(), targetDir.c_str()) != 0) {
+        std::string errorDescription = "Error while trying to move table directory "
+            + sourceDir + " to " + targetDir + ": " + strerror(errno);
+        logger.error(errorDescription);
+        return "\x10" + errorDescription;
+    }
+    if (!moveTableFile(configParser.getTableConfigFile(tableIndex),
+                       configParser.getTableConfigFile(targetTableIndex))
+            || !moveTableFile(configParser.getTableKeyCounterFile(tableIndex),
+                              configParser.getTableKeyCounterFile(targetTableIndex))) {
+        //The table data has been moved, it can still be opened using explicit parameters
+        logger.error("Error while trying to move the config files of table #"
+            + std::to_string(tableIndex) + ": " + strerror(errno));
+    }
+    logger.info("Moved table #" + std::to_string(tableIndex)
+        + " to #" + std::to_string(targetTableIndex));
+    //Reopen the table in its new slot using the parameters from the config file
+    if (wasOpen) {
+        std::map<std::string, std::string> parameterMap;
+        return openTable(targetTableIndex, parameterMap);
+    }
+    return std::string(1, '\x00');
+}
@@ -6,29 +6,114 @@
  */
 
 #include "Tablespace.hpp"
+#include <cassert>
+
+Tablespace::TableChunk::TableChunk() : next(nullptr) {
+    for (IndexType i = 0; i < chunkSize; i++) {
+        entries[i].table.store(nullptr, std::memory_order_relaxed);
+        entries[i].mergeRequired.store(false, std::memory_order_relaxed);
+        entries[i].postingsTable.store(false, std::memory_order_relaxed);
+        entries[i].keyCounter.store(nullptr, std::memory_order_relaxed);
+    }
+}
 
 Tablespace::Tablespace(ConfigParser& cfg, IndexType defaultTablespaceSize)
-        : databases(defaultTablespaceSize), cfg(cfg) {
-    ensureSize(defaultTablespaceSize);
-    //Use malloc here to allow usage of realloc
-    //Initialize all pointers to zero
-    for (size_t i = 0; i < databases.size(); i++) {
-        databases[i] = nullptr;
+        : firstChunk(new TableChunk()), maximumOpenTableNumber(-1), cfg(cfg) {
+    if (cfg.blockCacheSize > 0) {
+        blockCache = rocksdb::NewLRUCache(cfg.blockCacheSize, cfg.blockCacheShardBits);
+    }
+    if (cfg.writeBufferManagerSize > 0) {
+        writeBufferManager = std::make_shared<rocksdb::WriteBufferManager>(
+            cfg.writeBufferManagerSize);
+    }
+    //Preallocate the chunks for the default size
+    if (defaultTablespaceSize > 0) {
+        getOrCreateEntry(defaultTablespaceSize - 1);
     }
 }
 
+Tablespace::TableEntry* Tablespace::getOrCreateEntry(IndexType index) {
+    TableChunk* chunk = firstChunk;
+    for (IndexType i = index / chunkSize; i > 0; i--) {
+        TableChunk* next = chunk->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            //Append a new chunk. If another thread was faster, use its chunk instead
+            TableChunk* newChunk = new TableChunk();
+            if (chunk->next.compare_exchange_strong(next, newChunk,
+                    std::memory_order_acq_rel, std::memory_order_acquire)) {
+                next = newChunk;
+            } else {
+                delete newChunk;
+            }
+        }
+        chunk = next;
+    }
+    return &chunk->entries[index % chunkSize];
+}
+
+void Tablespace::setTable(IndexType index, TableType table, bool mergeRequired,
+                          bool postingsTable, KeyCounter* keyCounter) {
+    TableEntry* entry = getOrCreateEntry(index);
+    entry->mergeRequired.store(mergeRequired, std::memory_order_relaxed);
+    entry->postingsTable.store(postingsTable, std::memory_order_relaxed);
+    entry->keyCounter.store(keyCounter, std::memory_order_relaxed);
+    entry->writeStatistics.reset(cfg.putBatchBytes, cfg.putBatchLatency);
+    //Release: Readers that see the table also see the flags
+    entry->table.store(table, std::memory_order_release);
+    if ((int32_t) index > maximumOpenTableNumber.load(std::memory_order_relaxed)) {
+        maximumOpenTableNumber.store(index, std::memory_order_relaxed);
+    }
+}
+
+Tablespace::TableType Tablespace::eraseAndGetTableEntry(IndexType index) {
+    TableEntry* entry = findEntry(index);
+    if (entry == nullptr) {
+        return nullptr;
+    }
+    TableType db = entry->table.exchange(nullptr, std::memory_order_acq_rel);
+    releaseKeyCounter(index, *entry);
+    //Find the new maximum open table if the maximum table has been closed
+    if ((int32_t) index == maximumOpenTableNumber.load(std::memory_order_relaxed)) {
+        int32_t newMaximum = (int32_t) index - 1;
+        while (newMaximum >= 0 && !isTableOpen(newMaximum)) {
+            newMaximum--;
+        }
+        maximumOpenTableNumber.store(newMaximum, std::memory_order_relaxed);
+    }
+    return db;
+}
+
 void Tablespace::cleanup() {
     //Flush & delete all databases
-    for (size_t i = 0; i < databases.size(); i++) {
-        if (databases[i] != nullptr) {
-            delete databases[i];
+    IndexType chunkOffset = 0;
+    for (TableChunk* chunk = firstChunk; chunk != nullptr;
+            chunk = chunk->next.load(std::memory_order_acquire), chunkOffset += chunkSize) {
+        for (IndexType i = 0; i < chunkSize; i++) {
+            TableType db = chunk->entries[i].table.exchange(nullptr);
+            if (db != nullptr) {
+                delete db;
+            }
+            releaseKeyCounter(chunkOffset + i, chunk->entries[i]);
         }
     }
-    databases.clear();
-    mergeRequired.clear();
+    maximumOpenTableNumber.store(-1);
 }
 
 
+void Tablespace::releaseKeyCounter(IndexType index, TableEntry& entry) {
+    KeyCounter* keyCounter = entry.keyCounter.exchange(nullptr);
+    if (keyCounter != nullptr) {
+        {
+            //Wait for the writes that are currently being counted
+            std::lock_guard<std::mutex> lock(keyCounter->getWriteMutex());
+            //Reused when the table is opened again
+            keyCounter->save(cfg.getTableKeyCounterFile(index));
+        }
+        std::lock_guard<std::mutex> lock(retiredKeyCountersMutex);
+        retiredKeyCounters.push_back(keyCounter);
+    }
+}
+
 Tablespace::TableType Tablespace::getTable(IndexType index, void* ctx) {
     TableOpenHelper helper(ctx, cfg);
     return getTable(index, helper);
@@ -36,28 +121,30 @@ Tablespace::TableType Tablespace::getTable(IndexType index, void* ctx) {
 
 Tablespace::~Tablespace() {
     cleanup();
+    //No other thread may use the tablespace any more,
+    // so the chunks and the retired key counters can be freed
+    for (KeyCounter* keyCounter : retiredKeyCounters) {
+        delete keyCounter;
+    }
+    TableChunk* chunk = firstChunk;
+    while (chunk != nullptr) {
+        TableChunk* next = chunk->next.load();
+        delete chunk;
+        chunk = next;
+    }
 }
 
 Tablespace::TableType Tablespace::getTable(IndexType index, TableOpenHelper& openHelper) {
     //Check if the database has already been opened
-    if (databases[index] == nullptr || index >= databases.size()) {
+    Tablespace::TableType ret = getTableIfOpen(index);
+    if (ret == nullptr) {
         openHelper.openTable(index);
+        ret = getTableIfOpen(index);
     }
-    Tablespace::TableType ret = databases[index];   
     assert(ret != nullptr); //If this fails, the database could not be opened properly
     return ret;
 }
 
-Tablespace::TableType Tablespace::getTableIfOpen(IndexType index) {
-    if(index >= databases.size()) {
-        return nullptr;
-    }
-    return databases[index];
-}
-
 void Tablespace::closeTable(IndexType index) {
-    if (databases[index] != nullptr) {
-        delete databases[index];
-        databases[index] = nullptr;
-    }
+    delete eraseAndGetTableEntry(index);
 }
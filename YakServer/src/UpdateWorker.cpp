@@ -13,6 +13,9 @@
 #include <rocksdb/write_batch.h>
 #include <functional>
 #include <bitset>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
 #include "Tablespace.hpp"
 #include "Logger.hpp"
 #include "zutil.hpp"
@@ -20,14 +23,25 @@
 #include "endpoints.hpp"
 #include "macros.hpp"
 #include "ThreadUtil.hpp"
+#include "ScanEngine.hpp"
+#include "BulkLoader.hpp"
+#include "WatchDistributor.hpp"
 
 using namespace std;
 
-UpdateWorker::UpdateWorker(void* ctx, Tablespace& tablespace, ConfigParser& configParser) :
-AbstractFrameProcessor(ctx, ZMQ_PULL, ZMQ_PUSH, "Update worker"),
+/**
+ * Approximate write batch overhead in bytes,
+ * used to reserve the batch buffer in advance
+ */
+static const uint64_t writeBatchHeaderSize = 12;
+static const uint64_t writeBatchRecordOverhead = 12; //Type tag & key/value size varints
+
+UpdateWorker::UpdateWorker(void* ctx, Tablespace& tablespace, ConfigParser& configParser, uint32_t workerId) :
+AbstractFrameProcessor(ctx, ZMQ_DEALER, ZMQ_PUSH, "Update worker"),
 tableOpenHelper(ctx, configParser),
 tablespace(tablespace),
-cfg(configParser) {
+cfg(configParser),
+watchSocket(WatchDistributor::connectPublisher(ctx, configParser, logger)) {
     //Set HWM
     setHWM(processorInputSocket, configParser.internalRCVHWM,
             configParser.internalRCVHWM, logger);
@@ -35,15 +49,22 @@ cfg(configParser) {
     if(zmq_connect(processorOutputSocket, externalRequestProxyEndpoint) == -1) {
         logOperationError("Connect Update worker processor output socket", logger);
     }
-    //Connect the socket that is used by the send() member functions
-    if(zmq_connect(processorInputSocket, updateWorkerThreadAddr)) {
+    //Connect the socket that receives requests from the post office
+    if(PostOffice::connectWorker(processorInputSocket, updateWorkerThreadAddr, workerId)) {
         logOperationError("Connect Update worker processor input socket", logger);
     }
     logger.trace("Update worker thread starting");
 }
 
+void UpdateWorker::reportReady(uint8_t lane) {
+    PostOffice::reportReady(processorInputSocket, lane, logger);
+}
+
 UpdateWorker::~UpdateWorker() {
     logger.trace("Update worker thread terminating");
+    if (watchSocket != nullptr) {
+        zmq_close(watchSocket);
+    }
     //Sockets are cleaned up in AbstractFrameProcessor
 }
 
@@ -66,6 +87,14 @@ bool UpdateWorker::processNextMessage() {
         zmq_msg_close(&haveReplyAddrFrame);
         return false;
     }
+    //A group of write requests dispatched at once by the post office
+    if(zmq_msg_size(&haveReplyAddrFrame) == sizeof(uint32_t)) {
+        uint32_t groupSize;
+        memcpy(&groupSize, zmq_msg_data(&haveReplyAddrFrame), sizeof(uint32_t));
+        zmq_msg_close(&haveReplyAddrFrame);
+        handleWriteGroup(groupSize);
+        return true;
+    }
     char haveReplyAddrFrameContent = ((char*) zmq_msg_data(&haveReplyAddrFrame))[0];
     zmq_msg_close(&haveReplyAddrFrame);
     //If it's not a stop msg frame, we expect a header frame
@@ -130,10 +159,14 @@ bool UpdateWorker::processNextMessage() {
         handleCompactRequest(haveReplyAddr);
     } else if (requestType == RequestType::TruncateTableRequest) {
         handleTableTruncateRequest(haveReplyAddr);
+    } else if (requestType == RequestType::MoveTableRequest) {
+        handleTableMoveRequest(haveReplyAddr);
+    } else if (requestType == RequestType::WatchTestRequest) {
+        handleWatchTestRequest(haveReplyAddr);
     } else if (requestType == RequestType::DeleteRangeRequest) {
         handleDeleteRangeRequest(haveReplyAddr);
-    } else if (requestType == RequestType::CopyRangeRequest) {
-        handleCopyRangeRequest(haveReplyAddr);
+    } else if (requestType == RequestType::BulkLoadRequest) {
+        handleBulkLoadRequest(haveReplyAddr);
     } else {
         logger.error(std::string("Internal routing error: request type ")
                 + std::to_string((uint8_t)requestType) + " routed to update worker thread!");
@@ -151,14 +184,13 @@ bool UpdateWorker::processNextMessage() {
 
 void UpdateWorker::handlePutRequest(bool generateResponse) {
     /**
-     * IMPORTANT: We stopped using batches because they are *incredibly*
-     * inefficient! They just append to a std::string on each operation.
-     * This is so inefficient the worker thread sometimes needs
-     * several *seconds* for a single >10k batch!
-     * 
-     * Instead, we re-batch into fixed-size batches. Individual puts
-     * are too slow and lock too much.
-     * 
+     * Large write batches block the table for a long time and
+     * small batches increase the write overhead, so we re-batch
+     * the records into batches of an adaptive number of bytes,
+     * see TableWriteStatistics.
+     * The batch buffer is reserved in advance, so appending records
+     * does not need to reallocate it.
+     *
      * NOTE regarding request IDs: The request has 4 bytes, instead of the default 3.
      * This needs to be passed to functions generating the response
      * header.
@@ -177,75 +209,374 @@ void UpdateWorker::handlePutRequest(bool generateResponse) {
     if (!parseUint32Frame(tableId, "Table ID frame", generateResponse)) {
         return;
     }
+    //All frames of a message have already been received by ZMQ,
+    // so buffering them does not cost any memory
+    BufferedMessage frames;
+    if (socketHasMoreFrames(processorInputSocket)
+            && !PostOffice::receiveMessage(processorInputSocket, frames, logger)) {
+        PostOffice::closeMessage(frames);
+        if (generateResponse) {
+            sendErrorResponseHeader(ZMQ_SNDMORE);
+            sendFrame("Failed to receive put frames", processorOutputSocket, logger, "Put error message");
+        }
+        return;
+    }
+    //Check if there is a key but no value before writing anything
+    if (frames.size() % 2 != 0) {
+        PostOffice::closeMessage(frames);
+        static const char* errString = "Protocol error: Found key frame, but no value frame. They must occur in pairs!";
+        logger.warn(errString);
+        if (generateResponse) {
+            sendErrorResponseHeader(ZMQ_SNDMORE);
+            sendFrame(errString, strlen(errString), processorOutputSocket, logger, errString);
+        }
+        return;
+    }
     //Get the table
     rocksdb::DB* db = tablespace.getTable(tableId, tableOpenHelper);
-    rocksdb::WriteBatch batch;
-    const uint32_t maxBatchSize = cfg.putBatchSize;
-    uint32_t currentBatchSize = 0;
+    TableWriteStatistics* writeStatistics = tablespace.getWriteStatistics(tableId);
+    const uint64_t maxBatchBytes = writeStatistics->getBatchBytes();
+    //Reserve the batch for the records of this request, but not more than one batch
+    uint64_t requestBytes = writeBatchHeaderSize;
+    for (zmq_msg_t* frame : frames) {
+        requestBytes += zmq_msg_size(frame) + writeBatchRecordOverhead / 2;
+    }
+    rocksdb::WriteBatch batch(std::min(requestBytes, maxBatchBytes + writeBatchRecordOverhead));
     //Check if we need to use Merge instead of Put (i.e. if we have a non-REPLACE merge operator)
     bool mergeRequired = tablespace.isMergeRequired(tableId);
-    //The entire update is processed in one batch. Empty batches are allowed.
+    KeyCountTracker keyCountTracker(tablespace.getKeyCounter(tableId), db);
+    //Empty batches are allowed.
+    for (size_t i = 0; i < frames.size(); i += 2) {
+        size_t keySize = zmq_msg_size(frames[i]);
+        size_t valueSize = zmq_msg_size(frames[i + 1]);
+        //Ignore frame pair if both are empty
+        if(keySize == 0 && valueSize == 0) {
+            continue;
+        }
+        //Write into batch
+        rocksdb::Slice keySlice((char*) zmq_msg_data(frames[i]), keySize);
+        rocksdb::Slice valueSlice((char*) zmq_msg_data(frames[i + 1]), valueSize);
+        if(mergeRequired) {
+            batch.Merge(keySlice, valueSlice);
+        } else { //A simple put is enough (REPLACE merge operator)
+            batch.Put(keySlice, valueSlice);
+        }
+        keyCountTracker.recordPut(keySlice);
+        //If batch is full, write to db
+        if(batch.GetDataSize() >= maxBatchBytes) {
+            if (!writeUpdateBatch(db, writeOptions, batch, *writeStatistics, true, generateResponse)) {
+                PostOffice::closeMessage(frames);
+                return;
+            }
+            keyCountTracker.apply();
+            batch.Clear();
+        }
+    }
+    //Write last batch part
+    if (!writeUpdateBatch(db, writeOptions, batch, *writeStatistics, false, generateResponse)) {
+        PostOffice::closeMessage(frames);
+        return;
+    }
+    keyCountTracker.apply();
+    publishWatchEvent(tableId, RequestType::PutRequest, frames);
+    PostOffice::closeMessage(frames);
+    //Send success code
+    if (generateResponse) {
+        //Send success code
+        sendResponseHeader(ackResponse);
+    }
+}
+
+bool UpdateWorker::writeUpdateBatch(rocksdb::DB* db,
+                                    const rocksdb::WriteOptions& writeOptions,
+                                    rocksdb::WriteBatch& batch,
+                                    TableWriteStatistics& writeStatistics,
+                                    bool fullBatch,
+                                    bool generateResponse) {
+    auto startTime = std::chrono::steady_clock::now();
+    rocksdb::Status status = db->Write(writeOptions, &batch);
+    auto writeTime = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime);
+    if (!checkRocksDBStatus(status,
+            "Database error while processing update request: ",
+            generateResponse)) {
+        return false;
+    }
+    writeStatistics.recordWrite(batch.Count(), batch.GetDataSize(),
+                                writeTime.count(), fullBatch);
+    return true;
+}
+
+void UpdateWorker::publishWatchEvent(uint32_t tableId, RequestType eventType,
+                                     const BufferedMessage& frames, size_t firstFrame) {
+    if (watchSocket == nullptr) {
+        return;
+    }
+    //Collect the frames to publish. Empty put pairs have been ignored
+    bool isPut = (eventType == RequestType::PutRequest);
+    std::vector<zmq_msg_t*> eventFrames;
+    for (size_t i = firstFrame; i < frames.size(); i += (isPut ? 2 : 1)) {
+        if (isPut && zmq_msg_size(frames[i]) == 0 && zmq_msg_size(frames[i + 1]) == 0) {
+            continue;
+        }
+        eventFrames.push_back(frames[i]);
+        if (isPut && cfg.watchValues) {
+            eventFrames.push_back(frames[i + 1]);
+        }
+    }
+    if (eventFrames.empty()) {
+        return;
+    }
+    //Topic: Table ID + event type
+    char topic[sizeof(uint32_t) + 1];
+    memcpy(topic, &tableId, sizeof(uint32_t));
+    topic[sizeof(uint32_t)] = (char) eventType;
+    sendFrame(topic, sizeof(topic), watchSocket, logger, "Watch event topic frame", ZMQ_SNDMORE);
+    //The frames are shared with the request, not copied
+    zmq_msg_t eventFrame;
+    for (size_t i = 0; i < eventFrames.size(); i++) {
+        zmq_msg_init(&eventFrame);
+        zmq_msg_copy(&eventFrame, eventFrames[i]);
+        int flags = (i == eventFrames.size() - 1) ? 0 : ZMQ_SNDMORE;
+        if (unlikely(zmq_msg_send(&eventFrame, watchSocket, flags) == -1)) {
+            logMessageSendError("Watch event frame", logger);
+            zmq_msg_close(&eventFrame);
+        }
+    }
+}
+
+void UpdateWorker::handleWatchTestRequest(bool generateResponse) {
+    errorResponse = "\x31\x01\x08\x01";
+    static const char* ackResponse = "\x31\x01\x08\x00";
+    //Parse table ID
+    uint32_t tableId;
+    if (!parseUint32Frame(tableId, "Table ID frame", generateResponse)) {
+        return;
+    }
+    if (!expectNextFrame("Only received table ID frame, token frame missing", generateResponse)) {
+        return;
+    }
+    BufferedMessage tokenFrames;
+    if (!PostOffice::receiveMessage(processorInputSocket, tokenFrames, logger)) {
+        PostOffice::closeMessage(tokenFrames);
+        return;
+    }
+    if (watchSocket == nullptr) {
+        PostOffice::closeMessage(tokenFrames);
+        static const char* errString = "Watch notify is disabled (no watch-endpoints configured)";
+        if (generateResponse) {
+            sendErrorResponseHeader(ZMQ_SNDMORE);
+            sendFrame(errString, strlen(errString), processorOutputSocket, logger, errString);
+        }
+        return;
+    }
+    publishWatchEvent(tableId, RequestType::WatchTestRequest, tokenFrames);
+    PostOffice::closeMessage(tokenFrames);
+    if (generateResponse) {
+        sendResponseHeader(ackResponse);
+    }
+}
+
+/**
+ * Find the header frame of a buffered update request
+ * (frames: Have reply addr flag, [routing, delimiter,] header, ...)
+ * @return false if the message does not contain a header frame
+ */
+static bool findUpdateRequestHeader(const BufferedMessage& msg, size_t& headerIndex) {
+    if (msg.empty() || zmq_msg_size(msg[0]) == 0) {
+        return false;
+    }
+    headerIndex = (((char*) zmq_msg_data(msg[0]))[0] == 1) ? 3 : 1;
+    return msg.size() > headerIndex && zmq_msg_size(msg[headerIndex]) >= 3;
+}
+
+void UpdateWorker::handleWriteGroup(uint32_t groupSize) {
+    std::vector<BufferedMessage> requests(groupSize);
+    for (BufferedMessage& request : requests) {
+        if (!PostOffice::receiveMessage(processorInputSocket, request, logger)) {
+            for (BufferedMessage& receivedRequest : requests) {
+                PostOffice::closeMessage(receivedRequest);
+            }
+            return;
+        }
+    }
+    //The post office only groups put and delete requests with a table ID frame
+    size_t headerIndex = 0;
+    findUpdateRequestHeader(requests[0], headerIndex);
+    uint32_t tableId = extractBinary<uint32_t>(requests[0][headerIndex + 1]);
+    rocksdb::DB* db = tablespace.getTable(tableId, tableOpenHelper);
+    bool mergeRequired = tablespace.isMergeRequired(tableId);
+    rocksdb::WriteOptions writeOptions;
+    //Reserve the batch for all records of the group
+    uint64_t groupBytes = writeBatchHeaderSize;
+    for (BufferedMessage& request : requests) {
+        findUpdateRequestHeader(request, headerIndex);
+        for (size_t j = headerIndex + 2; j < request.size(); j++) {
+            groupBytes += zmq_msg_size(request[j]) + writeBatchRecordOverhead / 2;
+        }
+    }
+    rocksdb::WriteBatch batch(groupBytes);
+    //Error message for each request (empty --> no error)
+    std::vector<std::string> errors(groupSize);
+    //Keep the write lock of the key counter until the batch has been written
+    KeyCountTracker keyCountTracker(tablespace.getKeyCounter(tableId), db);
+    for (uint32_t i = 0; i < groupSize; i++) {
+        BufferedMessage& request = requests[i];
+        findUpdateRequestHeader(request, headerIndex);
+        zmq_msg_t* header = request[headerIndex];
+        //One fsync covers all requests of the group
+        if (isFullsync(getWriteFlags(header))) {
+            writeOptions.sync = true;
+        }
+        size_t dataIndex = headerIndex + 2;
+        if (getRequestType(header) == RequestType::DeleteRequest) {
+            for (size_t j = dataIndex; j < request.size(); j++) {
+                rocksdb::Slice keySlice((char*) zmq_msg_data(request[j]), zmq_msg_size(request[j]));
+                batch.Delete(keySlice);
+                keyCountTracker.recordDelete(keySlice);
+            }
+            continue;
+        }
+        //Put request. Check the frames before writing anything to the batch
+        if ((request.size() - dataIndex) % 2 != 0) {
+            errors[i] = "Protocol error: Found key frame, but no value frame. They must occur in pairs!";
+            logger.warn(errors[i]);
+            continue;
+        }
+        for (size_t j = dataIndex; j < request.size(); j += 2) {
+            size_t keySize = zmq_msg_size(request[j]);
+            size_t valueSize = zmq_msg_size(request[j + 1]);
+            //Ignore frame pair if both are empty
+            if(keySize == 0 && valueSize == 0) {
+                continue;
+            }
+            rocksdb::Slice keySlice((char*) zmq_msg_data(request[j]), keySize);
+            rocksdb::Slice valueSlice((char*) zmq_msg_data(request[j + 1]), valueSize);
+            if(mergeRequired) {
+                batch.Merge(keySlice, valueSlice);
+            } else {
+                batch.Put(keySlice, valueSlice);
+            }
+            keyCountTracker.recordPut(keySlice);
+        }
+    }
+    auto startTime = std::chrono::steady_clock::now();
+    rocksdb::Status status = db->Write(writeOptions, &batch);
+    auto writeTime = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime);
+    if (likely(status.ok())) {
+        keyCountTracker.apply();
+        //The group size is determined by the post office, so it is not used for adaptation
+        tablespace.getWriteStatistics(tableId)->recordWrite(
+            batch.Count(), batch.GetDataSize(), writeTime.count(), false);
+        for (uint32_t i = 0; i < groupSize; i++) {
+            if (errors[i].empty()) {
+                findUpdateRequestHeader(requests[i], headerIndex);
+                publishWatchEvent(tableId, getRequestType(requests[i][headerIndex]),
+                                  requests[i], headerIndex + 2);
+            }
+        }
+    } else {
+        logger.error("Database error while processing grouped write requests: " + status.ToString());
+    }
+    //Send the responses to the PARTSYNC requesters
+    for (uint32_t i = 0; i < groupSize; i++) {
+        BufferedMessage& request = requests[i];
+        findUpdateRequestHeader(request, headerIndex);
+        if (headerIndex == 3) {
+            zmq_msg_t* header = request[headerIndex];
+            char response[] = "\x31\x01\x20\x00";
+            response[2] = (char) getRequestType(header);
+            if (!status.ok() && errors[i].empty()) {
+                errors[i] = "Database error while processing update request: " + status.ToString();
+            }
+            if (!errors[i].empty()) {
+                response[3] = 0x01;
+            }
+            zmq_msg_send(request[1], processorOutputSocket, ZMQ_SNDMORE);
+            zmq_msg_send(request[2], processorOutputSocket, ZMQ_SNDMORE);
+            AbstractFrameProcessor::sendResponseHeader(processorOutputSocket, logger, header,
+                response, errors[i].empty() ? 0 : ZMQ_SNDMORE);
+            //The header frame has been closed or sent
+            zmq_msg_init(header);
+            if (!errors[i].empty()) {
+                sendFrame(errors[i], processorOutputSocket, logger, "Write error message");
+            }
+        }
+        PostOffice::closeMessage(request);
+    }
+}
+
+void UpdateWorker::handleBulkLoadRequest(bool generateResponse) {
+    errorResponse = "\x31\x01\x25\x01";
+    static const char* ackResponse = "\x31\x01\x25\x00";
+    requestExpectedSize = 5;
+    uint8_t bulkLoadFlags = getBulkLoadFlags(&headerFrame);
+    //Parse table ID
+    uint32_t tableId;
+    if (!parseUint32Frame(tableId, "Table ID frame", generateResponse)) {
+        return;
+    }
+    //Get the table
+    rocksdb::DB* db = tablespace.getTable(tableId, tableOpenHelper);
+    /**
+     * The SST files are created in the table directory, so ingesting them
+     * only creates a hard link. RocksDB ignores them until they are ingested.
+     */
+    BulkLoader bulkLoader(db,
+        cfg.getTableDirectory(tableId) + "/bulkload-",
+        cfg.bulkLoadRunSize,
+        isKeysSorted(bulkLoadFlags),
+        tablespace.isMergeRequired(tableId),
+        tablespace.getKeyCounter(tableId));
     bool haveMoreData = socketHasMoreFrames(processorInputSocket);
     zmq_msg_t keyFrame, valueFrame;
-    uint64_t elementCounter = 0;
     while (haveMoreData) {
         zmq_msg_init(&keyFrame);
         zmq_msg_init(&valueFrame);
         //The next two frames contain key and value
         if (unlikely(!receiveMsgHandleError(&keyFrame,
-                "Receive put key frame", errorResponse))) {
-            break;
+                "Receive bulk load key frame", generateResponse))) {
+            return;
         }
         //Check if there is a key but no value
         if (!expectNextFrame("Protocol error: Found key frame, but no value frame. They must occur in pairs!",
                              generateResponse)) {
+            zmq_msg_close(&keyFrame);
             return;
         }
-        if (unlikely(!receiveMsgHandleError(&valueFrame, "Receive put value frame", generateResponse))) {
-            break;
+        if (unlikely(!receiveMsgHandleError(&valueFrame, "Receive bulk load value frame", generateResponse))) {
+            zmq_msg_close(&keyFrame);
+            return;
         }
         //Check if we have more frames
         haveMoreData = zmq_msg_more(&valueFrame);
         //Ignore frame pair if both are empty
         size_t keySize = zmq_msg_size(&keyFrame);
         size_t valueSize = zmq_msg_size(&valueFrame);
-        if(keySize == 0 && valueSize == 0) {
-            continue;
+        bool success = true;
+        if(keySize != 0 || valueSize != 0) {
+            success = bulkLoader.add(
+                rocksdb::Slice((char*) zmq_msg_data(&keyFrame), keySize),
+                rocksdb::Slice((char*) zmq_msg_data(&valueFrame), valueSize));
         }
-        //Write into batch
-        rocksdb::Slice keySlice((char*) zmq_msg_data(&keyFrame), keySize);
-        rocksdb::Slice valueSlice((char*) zmq_msg_data(&valueFrame), valueSize);
-        if(mergeRequired) {
-            batch.Merge(keySlice, valueSlice);
-        } else { //A simple put is enough (REPLACE merge operator)
-            batch.Put(keySlice, valueSlice);
-        }
-        currentBatchSize++;
-        //If batch is full, write to db
-        if(currentBatchSize >= maxBatchSize) {
-            rocksdb::Status status = db->Write(writeOptions, &batch);
-            if (!checkRocksDBStatus(status,
-                    "Database error while processing update request: ",
-                    generateResponse)) {
-                return;
-            }
-            batch.Clear();
-            currentBatchSize = 0;
-        }
-        //Statistics
-        elementCounter++;
-        //Cleanup
         zmq_msg_close(&keyFrame);
         zmq_msg_close(&valueFrame);
+        if (!success) {
+            //Files that have been ingested before stay in the table
+            checkRocksDBStatus(bulkLoader.getStatus(),
+                "Database error while processing bulk load request: ", generateResponse);
+            return;
+        }
     }
-    //Write last batch part
-    rocksdb::Status status = db->Write(writeOptions, &batch);
-    if (!checkRocksDBStatus(status, "Database error while processing update request: ", generateResponse)) {
+    if (!bulkLoader.finish()) {
+        checkRocksDBStatus(bulkLoader.getStatus(),
+            "Database error while processing bulk load request: ", generateResponse);
         return;
     }
-    //Send success code
+    logger.trace("Bulk load ingested " + std::to_string(bulkLoader.getIngestedFileCount())
+        + " SST files into table #" + std::to_string(tableId));
     if (generateResponse) {
-        //Send success code
         sendResponseHeader(ackResponse);
     }
 }
@@ -270,33 +601,43 @@ void UpdateWorker::handleDeleteRequest(bool generateResponse) {
     if (!parseUint32Frame(tableId, "Table ID frame", generateResponse)) {
         return;
     }
-    bool haveMoreData = socketHasMoreFrames(processorInputSocket);
+    //Receive the key frames. They are kept until the write has finished
+    // in order to publish them to watchers
+    BufferedMessage keyFrames;
+    if (socketHasMoreFrames(processorInputSocket)
+            && !PostOffice::receiveMessage(processorInputSocket, keyFrames, logger)) {
+        PostOffice::closeMessage(keyFrames);
+        if (generateResponse) {
+            sendErrorResponseHeader(ZMQ_SNDMORE);
+            sendFrame("Failed to receive deletion key frames", processorOutputSocket, logger, "Delete error message");
+        }
+        return;
+    }
     //Get the table
     rocksdb::DB* db = tablespace.getTable(tableId, tableOpenHelper);
     //The entire update is processed in one batch. This seems reasonable because
     // delete batch requests
-    zmq_msg_t keyFrame;
-    rocksdb::WriteBatch batch;
-    while (haveMoreData) {
-        zmq_msg_init(&keyFrame);
-        //The next two frames contain key and value
-        if (unlikely(!receiveMsgHandleError(&keyFrame, "Receive deletion key frame", generateResponse))) {
-            return;
-        }
+    uint64_t requestBytes = writeBatchHeaderSize;
+    for (zmq_msg_t* keyFrame : keyFrames) {
+        requestBytes += zmq_msg_size(keyFrame) + writeBatchRecordOverhead;
+    }
+    rocksdb::WriteBatch batch(requestBytes);
+    KeyCountTracker keyCountTracker(tablespace.getKeyCounter(tableId), db);
+    for (zmq_msg_t* keyFrame : keyFrames) {
         //Convert to RocksDB
-        rocksdb::Slice keySlice((char*) zmq_msg_data(&keyFrame), zmq_msg_size(&keyFrame));
+        rocksdb::Slice keySlice((char*) zmq_msg_data(keyFrame), zmq_msg_size(keyFrame));
         batch.Delete(keySlice);
-        //Check if we have more frames
-        haveMoreData = zmq_msg_more(&keyFrame);
-        //Cleanup
-        zmq_msg_close(&keyFrame);
+        keyCountTracker.recordDelete(keySlice);
     }
-    //Commit the batch
-    rocksdb::Status status = db->Write(writeOptions, &batch);
-    //If something went wrong, send an error response
-    if (!checkRocksDBStatus(status, "Database error while processing delete request: ", generateResponse)) {
+    //Commit the batch. If something went wrong, an error response is sent
+    if (!writeUpdateBatch(db, writeOptions, batch, *tablespace.getWriteStatistics(tableId),
+                          false, generateResponse)) {
+        PostOffice::closeMessage(keyFrames);
         return;
     }
+    keyCountTracker.apply();
+    publishWatchEvent(tableId, RequestType::DeleteRequest, keyFrames);
+    PostOffice::closeMessage(keyFrames);
     //Send success code
     if (generateResponse) {
         //Send success code
@@ -357,15 +698,17 @@ void UpdateWorker::handleCompactRequest(bool generateResponse) {
 
 void UpdateWorker::handleDeleteRangeRequest(bool generateResponse) {
     /*
-    * NOTE regarding request IDs: The request has 4 bytes, instead of the default 3.
+    * NOTE regarding request IDs: The request has 5 bytes, instead of the default 3.
     * This needs to be passed to functions generating the response
     * header.
     */
     errorResponse = "\x31\x01\x22\x01";
     static const char* ackResponse = "\x31\x01\x22\x00";
+    requestExpectedSize = 5;
     //Process the flags
     uint8_t flags = getWriteFlags(&headerFrame);
     bool fullsync = isFullsync(flags); //= Send reply after flushed to disk
+    bool compactAfterDelete = isCompactAfterDelete(getDeleteRangeFlags(&headerFrame));
     //Convert options to RocksDB
     rocksdb::WriteOptions writeOptions;
     writeOptions.sync = fullsync;
@@ -394,211 +737,100 @@ void UpdateWorker::handleDeleteRangeRequest(bool generateResponse) {
     //Get the table
     rocksdb::DB* db = tablespace.getTable(tableId, tableOpenHelper);
     //Parse the from-to range
-    std::string rangeStartStr;
-    std::string rangeEndStr;
-    parseRangeFrames(rangeStartStr,
-            rangeEndStr, "Parsing delete range request key range frames");
-    bool haveRangeStart = !(rangeStartStr.empty());
-    bool haveRangeEnd = !(rangeEndStr.empty());
-    //Convert the str to a slice, to compare the iterator slice in-place
-    rocksdb::Slice rangeEndSlice(rangeEndStr);
-    //Create the response object
+    ScanRange range;
+    range.limit = scanLimit;
+    parseRangeFrames(range.start,
+            range.end, "Parsing delete range request key range frames");
     rocksdb::ReadOptions readOptions;
+    readOptions.fill_cache = false; //Deleted data won't be read again
     rocksdb::Status status;
-    //Create the iterator
-    rocksdb::Iterator* it = db->NewIterator(readOptions);
-    //All deletes are applied in one batch
-    // This also avoids construct like deleting while iterating
-    rocksdb::WriteBatch batch;
-    if (haveRangeStart) {
-        it->Seek(rangeStartStr);
-    } else {
-        it->SeekToFirst();
-    }
-    uint64_t count = 0;
-    //Iterate over all key-values in the range
-    for (; it->Valid(); it->Next()) {
-        count++;
-        //Check limit
-        if (scanLimit <= 0) {
-            break;
-        }
-        scanLimit--;
-        //Check range end
-        rocksdb::Slice key = it->key();
-        if (haveRangeEnd && key.compare(rangeEndSlice) >= 0) {
-            break;
-        }
-        //Both checks passed, delete it
-        batch.Delete(key);
-    }
-    //Check if any error occured during iteration
-    if (!checkRocksDBStatus(it->status(), "RocksDB error while processing delete request", true)) {
+    uint64_t deletedCount = 0;
+    KeyCountTracker keyCountTracker(tablespace.getKeyCounter(tableId), db);
+    if (range.limit == std::numeric_limits<uint64_t>::max()) {
+        /*
+         * Without a limit, a single range tombstone deletes the entire range,
+         * so the memory usage and the number of tombstones don't depend on the
+         * number of deleted keys. The keys are only iterated to count them.
+         */
+        std::string rangeEnd;
+        status = getExplicitRangeEnd(db, range, rangeEnd);
+        if (!checkRocksDBStatus(status, "RocksDB error while processing delete range request", generateResponse)) {
+            return;
+        }
+        rocksdb::Iterator* it = db->NewIterator(readOptions);
+        auto countRecord = [&](const rocksdb::Slice& key, const rocksdb::Slice& value) -> bool {
+            keyCountTracker.recordRangeDeleteExisting(key);
+            deletedCount++;
+            return true;
+        };
+        scanRange<false>(it, range, countRecord);
+        status = it->status();
         delete it;
-        return;
-    }
-    delete it;
-    //Apply the batch
-    status = db->Write(writeOptions, &batch);
-    //If something went wrong, send an error response
-    if (!checkRocksDBStatus(status,
-            "Database error while processing delete request: ", generateResponse)) {
-        return;
-    }
-    //Create the response if neccessary
-    if (generateResponse) {
-        sendResponseHeader(ackResponse);
-    }
-}
-
-void UpdateWorker::handleCopyRangeRequest(bool generateResponse) {
-    /*
-    * NOTE regarding request IDs: The request has 4 bytes, instead of the default 3.
-    * This needs to be passed to functions generating the response
-    * header.
-    */
-    errorResponse = "\x31\x01\x24\x01";
-    static const char* ackResponse = "\x31\x01\x24\x00";
-    //Process the flags
-    uint8_t writeFlags = getWriteFlags(&headerFrame);
-    uint8_t copyFlags = getCopyFlags(&headerFrame);
-    bool fullsync = isFullsync(writeFlags); //= Send reply after flushed to disk
-    bool synchronousDelete = isSynchronousDelete(copyFlags); //= Send reply after flushed to disk
-    //Convert options to RocksDB
-    rocksdb::WriteOptions writeOptions;
-    writeOptions.sync = fullsync;
-    //Parse table IDs
-    uint32_t sourceTableId;
-    if (!parseUint32Frame(sourceTableId, "Source table ID frame", generateResponse)) {
-        return;
-    }
-    uint32_t targetTableId;
-    if (!parseUint32Frame(targetTableId, "Target table ID frame", generateResponse)) {
-        return;
-    }
-    //Check if the limit frame is present at all
-    if (!expectNextFrame("Only table ID frame found in copy range request, ĺimit frame missing", generateResponse)) {
-        return;
-    }
-    //Parse limit frame. For now we just assume UINT64_MAX is close enough to infinite
-    uint64_t scanLimit;
-    if (!parseUint64FrameOrAssumeDefault(scanLimit,
-                std::numeric_limits<uint64_t>::max(),
-                "Receive scan limit frame",
-                true)) {
-        return;
-    }
-    //Check if there are range frames
-    if (!expectNextFrame("Only table ID frame found in delete range request, range missing",
-            generateResponse)) {
-        return;
-    }
-    //Get the table
-    rocksdb::DB* sourceTable = tablespace.getTable(sourceTableId, tableOpenHelper);
-    rocksdb::DB* targetTable = tablespace.getTable(targetTableId, tableOpenHelper);
-    bool mergeRequired = tablespace.isMergeRequired(targetTableId);
-    //Parse the from-to range
-    std::string rangeStartStr;
-    std::string rangeEndStr;
-    parseRangeFrames(rangeStartStr,
-            rangeEndStr, "Parsing delete range request key range frames");
-    bool haveRangeStart = !(rangeStartStr.empty());
-    bool haveRangeEnd = !(rangeEndStr.empty());
-    //Convert the str to a slice, to compare the iterator slice in-place
-    rocksdb::Slice rangeEndSlice(rangeEndStr);
-    //Create the response object
-    rocksdb::ReadOptions readOptions;
-    rocksdb::Status status;
-    /**
-     * Perform synchronous deletion if required
-     */
-    if(synchronousDelete) {
-        rocksdb::Iterator* it = targetTable->NewIterator(readOptions);
-        // This also avoids construct like deleting while iterating
-        rocksdb::WriteBatch batch;
-        if (haveRangeStart) {
-            it->Seek(rangeStartStr);
-        } else {
-            it->SeekToFirst();
-        }
-        uint64_t count = 0;
-        //Iterate over all key-values in the range
-        for (; it->Valid(); it->Next()) {
-            count++;
-            //Check limit
-            if (scanLimit <= 0) {
-                break;
+        if (!checkRocksDBStatus(status, "RocksDB error while processing delete range request", generateResponse)) {
+            return;
+        }
+        if (deletedCount > 0) {
+            rocksdb::WriteBatch batch;
+            batch.DeleteRange(range.start, rangeEnd);
+            status = db->Write(writeOptions, &batch);
+            if (!checkRocksDBStatus(status,
+                    "Database error while processing delete range request: ", generateResponse)) {
+                return;
             }
-            scanLimit--;
-            //Check range end
-            rocksdb::Slice key = it->key();
-            if (haveRangeEnd && key.compare(rangeEndSlice) >= 0) {
-                break;
+            keyCountTracker.apply();
+            //Drop the deleted data and the tombstone from the table files
+            if (compactAfterDelete) {
+                rocksdb::Slice rangeStartSlice(range.start);
+                rocksdb::Slice rangeEndSlice(rangeEnd);
+                rocksdb::CompactRangeOptions compactOptions;
+                db->CompactRange(compactOptions, &rangeStartSlice, &rangeEndSlice);
             }
-            //Both checks passed, delete it
+        }
+    } else {
+        /*
+         * With a limit, the keys are deleted individually in fixed-size batches.
+         * The iterator uses an implicit snapshot, so deleting while iterating is safe.
+         */
+        rocksdb::Iterator* it = db->NewIterator(readOptions);
+        rocksdb::WriteBatch batch;
+        const uint32_t maxBatchSize = cfg.putBatchSize;
+        auto deleteRecord = [&](const rocksdb::Slice& key, const rocksdb::Slice& value) -> bool {
             batch.Delete(key);
+            keyCountTracker.recordDeleteExisting(key);
+            deletedCount++;
+            if (batch.Count() >= (int) maxBatchSize) {
+                status = db->Write(writeOptions, &batch);
+                if (!checkRocksDBStatus(status,
+                        "Database error while processing delete range request: ", generateResponse)) {
+                    return false;
+                }
+                keyCountTracker.apply();
+                batch.Clear();
+            }
+            return true;
+        };
+        if (!scanRange<false>(it, range, deleteRecord)) {
+            delete it;
+            return;
         }
         //Check if any error occured during iteration
-        if (!checkRocksDBStatus(it->status(), "RocksDB error while processing delete request", true)) {
+        if (!checkRocksDBStatus(it->status(), "RocksDB error while processing delete range request", generateResponse)) {
             delete it;
             return;
         }
         delete it;
-        //Apply the batch
-        status = targetTable->Write(writeOptions, &batch);
-    }
-    /**
-     * Perform copying of data
-     */
-    rocksdb::Iterator* srcIterator = targetTable->NewIterator(readOptions);
-    rocksdb::WriteBatch batch;
-    const uint32_t maxBatchSize = cfg.putBatchSize;
-    uint32_t currentBatchSize = 0;
-    //The entire update is processed in one batch. Empty batches are allowed.
-    bool haveMoreData = socketHasMoreFrames(processorInputSocket);
-    uint64_t elementCounter = 0;
-    for (; srcIterator->Valid(); srcIterator->Next()) {
-        //Check limit
-        if (scanLimit <= 0) {
-            break;
-        }
-        scanLimit--;
-        //Check range end
-        rocksdb::Slice key = srcIterator->key();
-        if (haveRangeEnd && key.compare(rangeEndSlice) >= 0) {
-            break;
-        }
-        //Write into batch
-        if(mergeRequired) {
-            batch.Merge(srcIterator->key(), srcIterator->value());
-        } else { //A simple put is enough (REPLACE merge operator)
-            batch.Put(srcIterator->key(), srcIterator->value());
-        }
-        currentBatchSize++;
-        //If batch is full, write to db
-        if(currentBatchSize >= maxBatchSize) {
-            rocksdb::Status status = targetTable->Write(writeOptions, &batch);
-            if (!checkRocksDBStatus(status,
-                    "Database error while processing copy table request (put batch subrequest): ",
-                    generateResponse)) {
-                return;
-            }
-            batch.Clear();
-            currentBatchSize = 0;
+        //Write the last batch
+        status = db->Write(writeOptions, &batch);
+        if (!checkRocksDBStatus(status,
+                "Database error while processing delete range request: ", generateResponse)) {
+            return;
         }
-        //Statistics
-        elementCounter++;
-    }
-    //Perform last write
-    status = targetTable->Write(writeOptions, &batch);
-    //If something went wrong, send an error response
-    if (!checkRocksDBStatus(status,
-            "Database error while processing delete request: ", generateResponse)) {
-        return;
+        keyCountTracker.apply();
     }
     //Create the response if neccessary
     if (generateResponse) {
-        sendResponseHeader(ackResponse);
+        sendResponseHeader(ackResponse, ZMQ_SNDMORE);
+        sendBinary<uint64_t>(deletedCount, processorOutputSocket, logger, "Deleted key count");
     }
 }
 
@@ -668,58 +900,161 @@ void UpdateWorker::handleTableTruncateRequest(bool generateResponse) {
     }
 }
 
+void UpdateWorker::handleTableMoveRequest(bool generateResponse) {
+    errorResponse = "\x31\x01\x07\x01";
+    uint32_t sourceTableId;
+    uint32_t targetTableId;
+    if (!parseUint32Frame(sourceTableId, "Source table ID frame", generateResponse)) {
+        return;
+    }
+    if (!parseUint32Frame(targetTableId, "Target table ID frame", generateResponse)) {
+        return;
+    }
+    //Move the table (closes and reopens the table if neccessary)
+    std::string ret = tableOpenHelper.moveTable(sourceTableId, targetTableId);
+    if (generateResponse) {
+        unsigned char responseHeader[4] = {0x31, 0x01, 0x07, 0xFF};
+        responseHeader[3] = ret.data()[0];
+        bool isErrorResponse = (responseHeader[3] != 0x00);
+        sendResponseHeader((const char*) responseHeader, (isErrorResponse ? ZMQ_SNDMORE : 0));
+        //Send error description if response code indicates error
+        if(isErrorResponse) {
+            std::string errDesc = ret.substr(1);
+            sendMsgHandleError(errDesc, 0, nullptr, false);
+        }
+    }
+}
+
 /**
  * Pretty stubby update thread loop.
  * This is what should contain the scheduler client code in the future.
  */
-static void updateWorkerThreadFunction(void* ctx, Tablespace& tablespace, ConfigParser& configParser) {
+static void updateWorkerThreadFunction(void* ctx, Tablespace& tablespace, ConfigParser& configParser, uint8_t lane, uint32_t workerId) {
     setCurrentThreadName("Yak upd worker");
-    UpdateWorker updateWorker(ctx, tablespace, configParser);
-    while (true) {
-        if (!updateWorker.processNextMessage()) {
-            break;
-        }
+    UpdateWorker updateWorker(ctx, tablespace, configParser, workerId);
+    do {
+        updateWorker.reportReady(lane);
+    } while (updateWorker.processNextMessage());
+}
+
+/**
+ * Compactions and range operations are processed by separate workers
+ * so they never delay puts and deletes.
+ */
+static uint8_t classifyUpdateRequest(const BufferedMessage& msg) {
+    size_t headerIndex;
+    if (!findUpdateRequestHeader(msg, headerIndex)) {
+        return shortRequestLane;
     }
+    RequestType requestType = (RequestType) ((uint8_t*) zmq_msg_data(msg[headerIndex]))[2];
+    if (requestType == RequestType::CompactTableRequest
+            || requestType == RequestType::TruncateTableRequest
+            || requestType == RequestType::MoveTableRequest
+            || requestType == RequestType::DeleteRangeRequest
+            || requestType == RequestType::BulkLoadRequest) {
+        return longRequestLane;
+    }
+    return shortRequestLane;
 }
 
+/**
+ * Put and delete requests for the same table can be written in one batch.
+ * The group key is the table ID frame.
+ */
+static std::string groupUpdateRequest(const BufferedMessage& msg) {
+    size_t headerIndex;
+    if (!findUpdateRequestHeader(msg, headerIndex)
+            || msg.size() <= headerIndex + 1
+            || zmq_msg_size(msg[headerIndex + 1]) != sizeof(uint32_t)) {
+        return "";
+    }
+    RequestType requestType = (RequestType) ((uint8_t*) zmq_msg_data(msg[headerIndex]))[2];
+    if (requestType != RequestType::PutRequest
+            && requestType != RequestType::DeleteRequest) {
+        return "";
+    }
+    return std::string((char*) zmq_msg_data(msg[headerIndex + 1]), sizeof(uint32_t));
+}
+
+/**
+ * Shard table writes by table ID or, for single-key puts and deletes
+ * in key sharding mode, by table ID and key hash.
+ */
+static std::string shardUpdateRequest(const BufferedMessage& msg, UpdateSharding sharding) {
+    size_t headerIndex;
+    if (!findUpdateRequestHeader(msg, headerIndex)
+            || msg.size() <= headerIndex + 1
+            || zmq_msg_size(msg[headerIndex + 1]) != sizeof(uint32_t)) {
+        return "";
+    }
+    RequestType requestType = (RequestType) ((uint8_t*) zmq_msg_data(msg[headerIndex]))[2];
+    if (requestType != RequestType::PutRequest
+            && requestType != RequestType::DeleteRequest
+            && requestType != RequestType::DeleteRangeRequest
+            && requestType != RequestType::BulkLoadRequest
+            && requestType != RequestType::CompactTableRequest
+            && requestType != RequestType::TruncateTableRequest) {
+        return "";
+    }
+    std::string shardKey((char*) zmq_msg_data(msg[headerIndex + 1]), sizeof(uint32_t));
+    size_t dataFrames = msg.size() - headerIndex - 2;
+    bool singleKey = (requestType == RequestType::PutRequest && dataFrames == 2)
+        || (requestType == RequestType::DeleteRequest && dataFrames == 1);
+    if (sharding == UpdateSharding::KeySharding && singleKey) {
+        zmq_msg_t* keyFrame = msg[headerIndex + 2];
+        size_t keyHash = std::hash<std::string>()(
+            std::string((char*) zmq_msg_data(keyFrame), zmq_msg_size(keyFrame)));
+        shardKey.append((char*) &keyHash, sizeof(keyHash));
+    }
+    return shardKey;
+}
 
 UpdateWorkerController::UpdateWorkerController(void* context, Tablespace& tablespace, ConfigParser& configParserArg)
 : tablespace(tablespace),
-numThreads(3),
 context(context),
 logger(context, "Update worker controller"),
-configParser(configParserArg)
+configParser(configParserArg),
+postOffice(context, updateWorkerRequestAddr, updateWorkerThreadAddr,
+    {{configParserArg.updateWorkerThreads, configParserArg.updateWorkerThreadsMax},
+     {configParserArg.longUpdateWorkerThreads, configParserArg.longUpdateWorkerThreadsMax}},
+    classifyUpdateRequest,
+    [this](uint8_t lane, uint32_t workerId) {
+        return new std::thread(updateWorkerThreadFunction,
+                               this->context,
+                               std::ref(this->tablespace),
+                               std::ref(this->configParser),
+                               lane, workerId);
+    },
+    configParserArg.internalRCVHWM, configParserArg.workerScaleUpQueueDepth,
+    configParserArg.workerIdleTimeout, "Update post office")
  {
+    if (configParser.groupCommitMaxBytes > 0) {
+        postOffice.enableRequestGroups(groupUpdateRequest,
+            configParser.groupCommitMaxBytes,
+            std::chrono::milliseconds(configParser.groupCommitDelay));
+    }
+    if (configParser.updateSharding != UpdateSharding::NoSharding) {
+        UpdateSharding sharding = configParser.updateSharding;
+        postOffice.enableSharding([sharding](const BufferedMessage& msg) {
+            return shardUpdateRequest(msg, sharding);
+        });
+    }
     //Initialize the push socket
-    workerPushSocket = zmq_socket_new_bind_hwm(context, ZMQ_PUSH,
-        updateWorkerThreadAddr, configParser.internalRCVHWM,
+    workerPushSocket = zmq_socket_new_connect(context, ZMQ_PUSH, updateWorkerRequestAddr);
+    setHWM(workerPushSocket, configParser.internalRCVHWM,
         configParser.internalRCVHWM, logger);
 }
 
 void UpdateWorkerController::start() {
-    threads = new std::thread*[numThreads];
-    for (unsigned int i = 0; i < numThreads; i++) {
-        threads[i] = new std::thread(updateWorkerThreadFunction,
-                                     context,
-                                     std::ref(tablespace),
-                                     std::ref(configParser)
-                                    );
-    }
+    postOffice.start();
 }
 
 void COLD UpdateWorkerController::terminateAll() {
     if(workerPushSocket) {
-        //Send an empty STOP message for each update thread
-        for (unsigned int i = 0; i < numThreads; i++) {
-            //Send an empty msg (signals the table open thread to stop)
-            sendEmptyFrameMessage(workerPushSocket);
-        }
+        //Send an empty STOP message to the post office, which stops the workers
+        sendEmptyFrameMessage(workerPushSocket);
         //Wait for each thread to exit
-        for (unsigned int i = 0; i < numThreads; i++) {
-            threads[i]->join();
-            delete threads[i];
-        }
-        numThreads = 0;
+        postOffice.join();
         //Destroy the sockets, if any
         zmq_close(workerPushSocket);
         workerPushSocket = nullptr;
@@ -729,6 +1064,4 @@ void COLD UpdateWorkerController::terminateAll() {
 UpdateWorkerController::~UpdateWorkerController() {
     //Gracefully terminate any update worker that is left
     terminateAll();
-    //Free the threadlist
-    delete[] threads;
 }
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "WatchDistributor.hpp"
+#include <map>
+#include <rocksdb/options.h>
+#include "ConfigParser.hpp"
+#include "zutil.hpp"
+#include "macros.hpp"
+#include "endpoints.hpp"
+#include "ThreadUtil.hpp"
+
+WatchDistributor::WatchDistributor(void* ctxParam, ConfigParser& cfg) :
+ctx(ctxParam),
+pullSocket(nullptr),
+pubSocket(nullptr),
+thread(nullptr),
+logger(ctxParam, "Watch distributor") {
+    if (!isEnabled(cfg)) {
+        return;
+    }
+    //Bind synchronously, the update workers connect while starting up
+    pullSocket = zmq_socket_new_bind_hwm(ctx, ZMQ_PULL, watchDistributorEndpoint,
+        cfg.internalRCVHWM, cfg.internalSNDHWM, logger);
+    pubSocket = zmq_socket(ctx, ZMQ_PUB);
+    setHWM(pubSocket, cfg.externalRCVHWM, cfg.externalSNDHWM, logger);
+    if (!cfg.zmqIPv4Only) {
+        zmq_set_ipv6(pubSocket, true);
+    }
+    for (const std::string& endpoint : cfg.watchEndpoints) {
+        logger.debug("Binding watch PUB socket to " + endpoint);
+        if (zmq_bind(pubSocket, endpoint.c_str()) == -1) {
+            logOperationError(("Binding watch PUB socket to " + endpoint).c_str(), logger);
+        }
+    }
+    //NOTE: The distributor thread owns both sockets from now on
+    thread = new std::thread(&WatchDistributor::run, this);
+}
+
+WatchDistributor::~WatchDistributor() {
+    terminate();
+}
+
+void COLD WatchDistributor::terminate() {
+    if (thread == nullptr) {
+        return;
+    }
+    void* tempSocket = zmq_socket_new_connect(ctx, ZMQ_PUSH, watchDistributorEndpoint);
+    sendFrame("", 0, tempSocket, logger, "Watch distributor stop message");
+    thread->join();
+    delete thread;
+    thread = nullptr;
+    zmq_close(tempSocket);
+    zmq_close(pullSocket);
+    zmq_close(pubSocket);
+}
+
+bool WatchDistributor::isEnabled(const ConfigParser& cfg) {
+    return !cfg.watchEndpoints.empty();
+}
+
+void* WatchDistributor::connectPublisher(void* ctx, ConfigParser& cfg, Logger& logger) {
+    if (!isEnabled(cfg)) {
+        return nullptr;
+    }
+    void* socket = zmq_socket_new_connect(ctx, ZMQ_PUSH, watchDistributorEndpoint);
+    setHWM(socket, cfg.internalRCVHWM, cfg.internalSNDHWM, logger);
+    return socket;
+}
+
+void WatchDistributor::run() {
+    setCurrentThreadName("Yak watch");
+    zmq_msg_t frame;
+    while (true) {
+        zmq_msg_init(&frame);
+        if (unlikely(receiveLogError(&frame, pullSocket, logger, "Watch event frame") == -1)) {
+            zmq_msg_close(&frame);
+            if (errno == ETERM) {
+                break;
+            }
+            continue;
+        }
+        bool more = zmq_msg_more(&frame);
+        //Stop message: One empty frame
+        if (!more && zmq_msg_size(&frame) == 0) {
+            zmq_msg_close(&frame);
+            break;
+        }
+        //Forward the frame. The PUB socket drops the event if no subscriber matches
+        if (unlikely(zmq_msg_send(&frame, pubSocket, more ? ZMQ_SNDMORE : 0) == -1)) {
+            logMessageSendError("Watch event frame", logger);
+            zmq_msg_close(&frame);
+        }
+    }
+}
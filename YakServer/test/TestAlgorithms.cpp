@@ -1,10 +1,22 @@
 #define BOOST_TEST_DYN_LINK
 #include <boost/test/unit_test.hpp>
+#include <boost/algorithm/string/join.hpp>
 #include <set>
+#include <map>
 #include <iostream>
 #include <string>
 #include <cstring>
+#include <random>
 #include "MergeAlgorithms.hpp"
+#include "RangeSplit.hpp"
+#include "SubstringSearch.hpp"
+#include "AhoCorasick.hpp"
+#include "ScanPredicate.hpp"
+#include "ScanEngine.hpp"
+#include "SortedRun.hpp"
+#include "WriteStatistics.hpp"
+#include "PostingList.hpp"
+#include "Bitmap.hpp"
 
 using namespace std;
 
@@ -55,4 +67,789 @@ BOOST_AUTO_TEST_CASE(TestSplitByNUL) {
     expected.clear();
 }
 
+BOOST_AUTO_TEST_CASE(TestNULSetMerger) {
+    NULSetMerger merger;
+    std::string result = "garbage";
+    //Test empty
+    merger.mergeInto(result);
+    BOOST_CHECK_EQUAL("", result);
+    //Sorted existing value, unsorted operands with duplicates
+    merger.add("a\0c\0e", 5);
+    merger.add("d\0b\0d", 5);
+    merger.add("", 0);
+    merger.add("f\0a", 3);
+    merger.mergeInto(result);
+    BOOST_CHECK_EQUAL(std::string("a\0b\0c\0d\0e\0f", 11), result);
+    //Same result as the std::set based algorithm, including empty elements
+    merger.clear();
+    std::set<std::string> expected;
+    const std::string values[] = {std::string("x\0\0y", 4), std::string("\0b\0", 3), "zz"};
+    for(const std::string& value : values) {
+        merger.add(value.data(), value.size());
+        splitByNUL(expected, value.data(), value.size());
+    }
+    merger.mergeInto(result);
+    BOOST_CHECK_EQUAL(boost::algorithm::join(expected, std::string("\0", 1)), result);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(RangeSplit)
+
+BOOST_AUTO_TEST_CASE(TestComputeSplitKeys) {
+    std::vector<std::string> expected;
+    std::vector<std::string> result;
+    //No parts --> no split
+    std::vector<KeyRangeWeight> parts;
+    result = computeSplitKeys(parts, "", "", 4);
+    BOOST_CHECK_EQUAL_COLLECTIONS_SIMPLE(expected, result);
+    //Equally sized parts (given in random order)
+    parts = {{"c", "cz", 10}, {"a", "az", 10}, {"d", "dz", 10}, {"b", "bz", 10}};
+    expected = {"b", "c", "d"};
+    result = computeSplitKeys(parts, "", "", 4);
+    BOOST_CHECK_EQUAL_COLLECTIONS_SIMPLE(expected, result);
+    expected = {"c"};
+    result = computeSplitKeys(parts, "", "", 2);
+    BOOST_CHECK_EQUAL_COLLECTIONS_SIMPLE(expected, result);
+    //One partition --> no split
+    expected.clear();
+    result = computeSplitKeys(parts, "", "", 1);
+    BOOST_CHECK_EQUAL_COLLECTIONS_SIMPLE(expected, result);
+    //More partitions than parts
+    expected = {"b", "c", "d"};
+    result = computeSplitKeys(parts, "", "", 16);
+    BOOST_CHECK_EQUAL_COLLECTIONS_SIMPLE(expected, result);
+    //Weighted: The large first part gets its own partition
+    parts = {{"a", "az", 30}, {"b", "bz", 10}, {"c", "cz", 10}, {"d", "dz", 10}};
+    expected = {"b"};
+    result = computeSplitKeys(parts, "", "", 2);
+    BOOST_CHECK_EQUAL_COLLECTIONS_SIMPLE(expected, result);
+    //Range limits: Parts outside the range are ignored,
+    // split keys are strictly inside the range
+    parts = {{"a", "az", 10}, {"b", "bz", 10}, {"c", "cz", 10}, {"d", "dz", 10}};
+    expected = {"c"};
+    result = computeSplitKeys(parts, "bb", "d", 2);
+    BOOST_CHECK_EQUAL_COLLECTIONS_SIMPLE(expected, result);
+    //Overlapping parts with the same smallest key are not split
+    parts = {{"a", "z", 10}, {"a", "m", 10}};
+    expected.clear();
+    result = computeSplitKeys(parts, "", "", 2);
+    BOOST_CHECK_EQUAL_COLLECTIONS_SIMPLE(expected, result);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(SubstringSearch)
+
+static const SubstringSearcher::Implementation substringSearchImplementations[] = {
+    SubstringSearcher::Implementation::BoyerMooreHorspool,
+    SubstringSearcher::Implementation::SSE2,
+    SubstringSearcher::Implementation::AVX2
+};
+
+/**
+ * Check that all implementations yield the same result as std::string::find()
+ */
+static void checkSubstringSearch(const std::string& pattern, const std::string& corpus) {
+    size_t pos = corpus.find(pattern);
+    int64_t expected = (pos == std::string::npos || pattern.empty()) ? -1 : pos;
+    for (SubstringSearcher::Implementation impl : substringSearchImplementations) {
+        if (!SubstringSearcher::isSupported(impl)) {
+            continue;
+        }
+        SubstringSearcher searcher(pattern, impl);
+        BOOST_CHECK_EQUAL(expected, searcher.find(corpus));
+    }
+    BoyerMooreHorspoolSearcher bmhSearcher(pattern);
+    BOOST_CHECK_EQUAL(expected, bmhSearcher.find(corpus));
+}
+
+BOOST_AUTO_TEST_CASE(TestSubstringSearchEdgeCases) {
+    //Empty pattern is defined as not found
+    checkSubstringSearch("", "abc");
+    checkSubstringSearch("", "");
+    //Pattern longer than corpus
+    checkSubstringSearch("abcd", "abc");
+    //Single-byte and two-byte patterns
+    checkSubstringSearch("a", "a");
+    checkSubstringSearch("c", "abc");
+    checkSubstringSearch("bc", "abc");
+    checkSubstringSearch("ca", "abc");
+    //Match at the beginning and at the end of a long corpus
+    std::string corpus(1000, 'x');
+    checkSubstringSearch("xyz", "xyz" + corpus);
+    checkSubstringSearch("xyz", corpus + "xyz");
+    checkSubstringSearch("xyz", corpus + "xy");
+    //First and last byte match, but not the middle
+    checkSubstringSearch("abcda", std::string(100, 'a') + "abxda" + "abcda");
+    //Binary data including NUL bytes
+    checkSubstringSearch(std::string("\0\xFF\0", 3), std::string("ab\0\xFF\x01\0\xFF\0", 8));
+    //Match crossing every offset of a SIMD block
+    for (size_t offset = 0; offset < 70; offset++) {
+        checkSubstringSearch("needle", std::string(offset, 'n') + "needle" + std::string(offset, 'e'));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestSubstringSearchRandom) {
+    //Small alphabet to get many candidate matches
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> charDist('a', 'd');
+    std::uniform_int_distribution<size_t> patternLengthDist(1, 8);
+    std::uniform_int_distribution<size_t> corpusLengthDist(0, 300);
+    for (int i = 0; i < 2000; i++) {
+        std::string pattern(patternLengthDist(rng), 'a');
+        for (char& c : pattern) {
+            c = charDist(rng);
+        }
+        std::string corpus(corpusLengthDist(rng), 'a');
+        for (char& c : corpus) {
+            c = charDist(rng);
+        }
+        checkSubstringSearch(pattern, corpus);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(Predicates)
+
+BOOST_AUTO_TEST_CASE(TestAhoCorasick) {
+    AhoCorasickAutomaton automaton({"he", "she", "his", "hers", ""});
+    BOOST_CHECK_EQUAL(4, automaton.getNumPatterns());
+    BOOST_CHECK(automaton.matchesAny("ushers", 6));
+    BOOST_CHECK(automaton.matchesAny("xxhis", 5));
+    BOOST_CHECK(!automaton.matchesAny("hxsxr", 5));
+    BOOST_CHECK(!automaton.matchesAny("", 0));
+    //"ushers" contains he, she and hers, but not his
+    BOOST_CHECK(!automaton.matchesAll("ushers", 6));
+    BOOST_CHECK(automaton.matchesAll("ushers his", 10));
+    //Repeated evaluation must not reuse state from previous evaluations
+    BOOST_CHECK(!automaton.matchesAll("his", 3));
+    BOOST_CHECK(!automaton.matchesAll("ushers", 6));
+    //Patterns that are suffixes of other patterns (found via failure links)
+    AhoCorasickAutomaton suffixAutomaton({"abcd", "bc", "c"});
+    BOOST_CHECK(suffixAutomaton.matchesAll("abcd", 4));
+    BOOST_CHECK(suffixAutomaton.matchesAny("xbcx", 4));
+    BOOST_CHECK(!suffixAutomaton.matchesAll("xbcx", 4));
+    //Binary patterns
+    AhoCorasickAutomaton binaryAutomaton({std::string("\0\xFF", 2)});
+    BOOST_CHECK(binaryAutomaton.matchesAny("a\0\xFF", 3));
+    //No patterns: Nothing matches any, everything matches all
+    AhoCorasickAutomaton emptyAutomaton({});
+    BOOST_CHECK(!emptyAutomaton.matchesAny("abc", 3));
+    BOOST_CHECK(emptyAutomaton.matchesAll("abc", 3));
+}
+
+/**
+ * Utility to build predicate programs
+ */
+static std::string predicateString(uint32_t length, const std::string& str) {
+    return std::string((const char*)&length, 4) + str;
+}
+
+static std::string predicateLeaf(PredicateOpcode opcode, const std::string& pattern, bool value = false) {
+    char instruction = (char) opcode | (value ? PredicateTargetValue : 0);
+    return std::string(1, instruction) + predicateString(pattern.size(), pattern);
+}
+
+static std::string predicateOperator(PredicateOpcode opcode) {
+    return std::string(1, (char) opcode);
+}
+
+static bool matchesPredicate(const std::string& program, const std::string& key, const std::string& value) {
+    ScanPredicate predicate;
+    std::string errorMessage;
+    BOOST_REQUIRE(predicate.compile(program.data(), program.size(), errorMessage));
+    return predicate.matches(key.data(), key.size(), value.data(), value.size());
+}
+
+static bool isValidPredicate(const std::string& program) {
+    ScanPredicate predicate;
+    std::string errorMessage;
+    return predicate.compile(program.data(), program.size(), errorMessage);
+}
+
+BOOST_AUTO_TEST_CASE(TestScanPredicate) {
+    //Empty program matches everything
+    BOOST_CHECK(matchesPredicate("", "key", "value"));
+    //Prefix and suffix, on key and value
+    std::string prefix = predicateLeaf(PredicateOpcode::Prefix, "user:");
+    BOOST_CHECK(matchesPredicate(prefix, "user:1", "x"));
+    BOOST_CHECK(!matchesPredicate(prefix, "use", "user:1"));
+    std::string valueSuffix = predicateLeaf(PredicateOpcode::Suffix, "}", true);
+    BOOST_CHECK(matchesPredicate(valueSuffix, "a", "{}"));
+    BOOST_CHECK(!matchesPredicate(valueSuffix, "}", "{"));
+    //Contains
+    std::string contains = predicateLeaf(PredicateOpcode::Contains, "error", true);
+    BOOST_CHECK(matchesPredicate(contains, "k", "fatal error occured"));
+    BOOST_CHECK(!matchesPredicate(contains, "error", "ok"));
+    //Equality at a byte offset
+    uint64_t offset = 2;
+    std::string equalsAt = std::string(1, (char) PredicateOpcode::EqualsAt | PredicateTargetValue)
+        + std::string((const char*)&offset, 8) + predicateString(2, "ok");
+    BOOST_CHECK(matchesPredicate(equalsAt, "k", "xxok"));
+    BOOST_CHECK(matchesPredicate(equalsAt, "k", "xxokxx"));
+    BOOST_CHECK(!matchesPredicate(equalsAt, "k", "xxo"));
+    BOOST_CHECK(!matchesPredicate(equalsAt, "k", "x"));
+    BOOST_CHECK(!matchesPredicate(equalsAt, "k", "okxx"));
+    //Regular expressions
+    std::string regex = predicateLeaf(PredicateOpcode::Regex, "^[0-9]+-[a-z]+$");
+    BOOST_CHECK(matchesPredicate(regex, "123-abc", ""));
+    BOOST_CHECK(!matchesPredicate(regex, "123-abc!", ""));
+    BOOST_CHECK(!isValidPredicate(predicateLeaf(PredicateOpcode::Regex, "([a-z")));
+    //Large values must not exhaust the stack (backtracking engines recurse per repetition)
+    std::string largeValue(1 << 20, 'a');
+    std::string alternation = predicateLeaf(PredicateOpcode::Regex, "(a|b)*c", true);
+    BOOST_CHECK(!matchesPredicate(alternation, "k", largeValue));
+    BOOST_CHECK(matchesPredicate(alternation, "k", largeValue + "c"));
+    //Binary data is matched bytewise
+    std::string binaryRegex = predicateLeaf(PredicateOpcode::Regex, "^\\x00[\\x80-\\xFF]+$");
+    BOOST_CHECK(matchesPredicate(binaryRegex, std::string("\0\xFF\x80", 3), ""));
+    BOOST_CHECK(!matchesPredicate(binaryRegex, std::string("\0a", 2), ""));
+    //Multiple patterns
+    std::string patterns = predicateString(2, "") + predicateString(3, "foo") + predicateString(3, "bar");
+    std::string containsAny = std::string(1, (char) PredicateOpcode::ContainsAny) + patterns;
+    std::string containsAll = std::string(1, (char) PredicateOpcode::ContainsAll) + patterns;
+    BOOST_CHECK(matchesPredicate(containsAny, "xbarx", ""));
+    BOOST_CHECK(!matchesPredicate(containsAny, "xbaz", ""));
+    BOOST_CHECK(matchesPredicate(containsAll, "barfoo", ""));
+    BOOST_CHECK(!matchesPredicate(containsAll, "xbarx", ""));
+    //Boolean operators (RPN): prefix AND NOT contains
+    std::string andNot = prefix + contains + predicateOperator(PredicateOpcode::Not)
+        + predicateOperator(PredicateOpcode::And);
+    BOOST_CHECK(matchesPredicate(andNot, "user:1", "all ok"));
+    BOOST_CHECK(!matchesPredicate(andNot, "user:1", "error"));
+    BOOST_CHECK(!matchesPredicate(andNot, "group:1", "all ok"));
+    std::string orProgram = prefix + contains + predicateOperator(PredicateOpcode::Or);
+    BOOST_CHECK(matchesPredicate(orProgram, "group:1", "error"));
+    BOOST_CHECK(!matchesPredicate(orProgram, "group:1", "ok"));
+    //Invalid programs
+    BOOST_CHECK(!isValidPredicate(predicateOperator(PredicateOpcode::Not)));
+    BOOST_CHECK(!isValidPredicate(prefix + predicateOperator(PredicateOpcode::And)));
+    BOOST_CHECK(!isValidPredicate(prefix + prefix));
+    BOOST_CHECK(!isValidPredicate(prefix.substr(0, prefix.size() - 1)));
+    BOOST_CHECK(!isValidPredicate(std::string(1, '\x7F')));
+    std::string tooManyPatterns = std::string(1, (char) PredicateOpcode::ContainsAny) + predicateString(1000000, "");
+    BOOST_CHECK(!isValidPredicate(tooManyPatterns));
+    //The automata are limited to 16 KiB of patterns in total, also across multiple nodes
+    std::string largePattern(10000, 'x');
+    std::string largeContainsAny = std::string(1, (char) PredicateOpcode::ContainsAny)
+        + predicateString(1, "") + predicateString(largePattern.size(), largePattern);
+    BOOST_CHECK(isValidPredicate(largeContainsAny));
+    BOOST_CHECK(!isValidPredicate(largeContainsAny + largeContainsAny + predicateOperator(PredicateOpcode::Or)));
+    std::string deeplyNested = prefix + std::string(1000, (char) PredicateOpcode::Not);
+    BOOST_CHECK(!isValidPredicate(deeplyNested));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/**
+ * Minimal iterator over a sorted in-memory record list
+ */
+class VectorIterator {
+public:
+    VectorIterator(const std::vector<std::pair<std::string, std::string> >& records)
+        : records(records), position(0) {
+    }
+    bool Valid() const {
+        return position >= 0 && position < (ssize_t) records.size();
+    }
+    void SeekToFirst() {
+        position = 0;
+    }
+    void SeekToLast() {
+        position = records.size() - 1;
+    }
+    void Seek(const rocksdb::Slice& target) {
+        position = 0;
+        while (Valid() && key().compare(target) < 0) {
+            position++;
+        }
+    }
+    void Next() {
+        position++;
+    }
+    void Prev() {
+        position--;
+    }
+    rocksdb::Slice key() const {
+        return records[position].first;
+    }
+    rocksdb::Slice value() const {
+        return records[position].second;
+    }
+private:
+    const std::vector<std::pair<std::string, std::string> >& records;
+    ssize_t position;
+};
+
+/**
+ * Run a range iteration and return the visited keys and values, joined by ","
+ */
+template<bool EmitValues, typename Filter>
+static std::string visitRange(const ScanRange& range, Filter& filter) {
+    static const std::vector<std::pair<std::string, std::string> > records = {
+        {"a", "1"}, {"b", "2"}, {"c", "x3"}, {"d", "4"}, {"e", "x5"}, {"f", "6"}
+    };
+    VectorIterator it(records);
+    std::string result;
+    auto visitor = [&result](const rocksdb::Slice& key, const rocksdb::Slice& value) -> bool {
+        result += key.ToString() + value.ToString() + ",";
+        return true;
+    };
+    scanRange<EmitValues>(&it, range, filter, visitor);
+    return result;
+}
+
+BOOST_AUTO_TEST_SUITE(ScanEngine)
+
+BOOST_AUTO_TEST_CASE(TestScanRange) {
+    NoScanFilter noFilter;
+    ScanRange range;
+    BOOST_CHECK_EQUAL("a1,b2,cx3,d4,ex5,f6,", visitRange<true>(range, noFilter));
+    BOOST_CHECK_EQUAL("a,b,c,d,e,f,", visitRange<false>(range, noFilter));
+    //Forward range: End is exclusive
+    range.start = "b";
+    range.end = "e";
+    BOOST_CHECK_EQUAL("b2,cx3,d4,", visitRange<true>(range, noFilter));
+    //Inverted range
+    range.inverted = true;
+    range.start = "e";
+    range.end = "b";
+    BOOST_CHECK_EQUAL("ex5,d4,cx3,", visitRange<true>(range, noFilter));
+    range.start = "";
+    range.end = "";
+    BOOST_CHECK_EQUAL("f,e,d,c,b,a,", visitRange<false>(range, noFilter));
+    //Limit and skip
+    range.inverted = false;
+    range.limit = 3;
+    range.skip = 1;
+    BOOST_CHECK_EQUAL("b2,cx3,", visitRange<true>(range, noFilter));
+}
+
+BOOST_AUTO_TEST_CASE(TestScanRangeFilter) {
+    ScanRange range;
+    //Filter mismatches do not count against the limit, skipped records do
+    ScanFilter valueFilter("", "x");
+    BOOST_CHECK(!valueFilter.isEmpty());
+    BOOST_CHECK_EQUAL("cx3,ex5,", visitRange<true>(range, valueFilter));
+    range.limit = 2;
+    range.skip = 1;
+    BOOST_CHECK_EQUAL("ex5,", visitRange<true>(range, valueFilter));
+    //Value filters also apply to list-style iterations
+    range = ScanRange();
+    BOOST_CHECK_EQUAL("c,e,", visitRange<false>(range, valueFilter));
+    ScanFilter keyFilter("d", "");
+    BOOST_CHECK_EQUAL("d4,", visitRange<true>(range, keyFilter));
+    ScanFilter emptyFilter("", "");
+    BOOST_CHECK(emptyFilter.isEmpty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/**
+ * Return the records of a sorted run, joined by ","
+ */
+static std::string sortedRunToString(const SortedRun& run) {
+    std::string result;
+    auto visitor = [&result](const rocksdb::Slice& key, const rocksdb::Slice& value) -> bool {
+        result += key.ToString() + value.ToString() + ",";
+        return true;
+    };
+    run.forEach(visitor);
+    return result;
+}
+
+BOOST_AUTO_TEST_SUITE(BulkLoad)
+
+BOOST_AUTO_TEST_CASE(TestSortedRun) {
+    SortedRun run;
+    BOOST_CHECK(run.isEmpty());
+    run.add("c", "1");
+    run.add("a", "2");
+    run.add("c", "3");
+    run.add("b", "4");
+    run.add("a", "5");
+    BOOST_CHECK_EQUAL(10, run.getDataSize());
+    //Duplicates are kept in insertion order
+    SortedRun copy = run;
+    copy.sort(true);
+    BOOST_CHECK_EQUAL("a2,a5,b4,c1,c3,", sortedRunToString(copy));
+    //Duplicates are grouped by key
+    std::string groups;
+    auto groupVisitor = [&groups](const rocksdb::Slice& key, const std::deque<rocksdb::Slice>& values) -> bool {
+        groups += key.ToString() + ":";
+        for (const rocksdb::Slice& value : values) {
+            groups += value.ToString();
+        }
+        groups += ",";
+        return true;
+    };
+    BOOST_CHECK(copy.forEachKey(groupVisitor));
+    BOOST_CHECK_EQUAL("a:25,b:4,c:13,", groups);
+    //Many duplicates of few keys
+    SortedRun duplicates;
+    for (size_t i = 0; i < 1000; i++) {
+        duplicates.add(i % 2 == 0 ? "even" : "odd", std::to_string(i % 10));
+    }
+    duplicates.sort(true);
+    size_t numKeys = 0, numValues = 0;
+    auto countVisitor = [&](const rocksdb::Slice& key, const std::deque<rocksdb::Slice>& values) -> bool {
+        numKeys++;
+        numValues += values.size();
+        //Insertion order is kept within the key
+        return values[0] == rocksdb::Slice(key == rocksdb::Slice("even") ? "0" : "1");
+    };
+    BOOST_CHECK(duplicates.forEachKey(countVisitor));
+    BOOST_CHECK_EQUAL(2, numKeys);
+    BOOST_CHECK_EQUAL(1000, numValues);
+    //Only the last record per key is kept
+    run.sort(false);
+    BOOST_CHECK_EQUAL("a5,b4,c3,", sortedRunToString(run));
+    //Keys are compared bytewise, shorter keys first
+    run.clear();
+    BOOST_CHECK(run.isEmpty());
+    run.add("ab", "1");
+    run.add(rocksdb::Slice("\xFF", 1), "2");
+    run.add("a", "3");
+    run.add("", "4");
+    run.sort(false);
+    BOOST_CHECK_EQUAL("4,a3,ab1,\xFF" "2,", sortedRunToString(run));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(WriteStatistics)
+
+BOOST_AUTO_TEST_CASE(TestAdaptiveBatchSize) {
+    TableWriteStatistics statistics;
+    statistics.reset(65536, 1000);
+    BOOST_CHECK_EQUAL(65536, statistics.getBatchBytes());
+    //Partial batches don't change the batch size
+    statistics.recordWrite(10, 100, 10, false);
+    BOOST_CHECK_EQUAL(65536, statistics.getBatchBytes());
+    //Fast full batches double it, slow ones halve it
+    statistics.recordWrite(100, 65536, 100, true);
+    BOOST_CHECK_EQUAL(131072, statistics.getBatchBytes());
+    statistics.recordWrite(100, 131072, 2000, true);
+    BOOST_CHECK_EQUAL(65536, statistics.getBatchBytes());
+    //Latencies near the target keep it
+    statistics.recordWrite(100, 65536, 800, true);
+    BOOST_CHECK_EQUAL(65536, statistics.getBatchBytes());
+    //The batch size is limited
+    for (int i = 0; i < 20; i++) {
+        statistics.recordWrite(1, 1, 5000, true);
+    }
+    BOOST_CHECK_EQUAL(minWriteBatchBytes, statistics.getBatchBytes());
+    std::map<std::string, std::string> map;
+    statistics.toMap(map);
+    BOOST_CHECK_EQUAL("24", map["Writes"]);
+    BOOST_CHECK_EQUAL("330", map["WrittenRecords"]);
+    //Without target latency, the batch size is fixed
+    statistics.reset(1 << 30, 0);
+    BOOST_CHECK_EQUAL(maxWriteBatchBytes, statistics.getBatchBytes());
+    statistics.recordWrite(1, 1, 5000, true);
+    BOOST_CHECK_EQUAL(maxWriteBatchBytes, statistics.getBatchBytes());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(PostingList)
+
+/**
+ * Decode a posting list into a vector of entries
+ */
+static std::vector<std::string> decodePostingList(const std::string& encoded) {
+    std::vector<std::string> entries;
+    PostingListReader reader;
+    BOOST_CHECK(reader.open(encoded));
+    for (; reader.valid(); reader.next()) {
+        entries.push_back(reader.current().ToString());
+    }
+    BOOST_CHECK(!reader.isCorrupted());
+    return entries;
+}
+
+static std::string createEntityId(size_t n) {
+    return "entity" + std::to_string(n * 3);
+}
+
+BOOST_AUTO_TEST_CASE(TestEncodeDecode) {
+    std::string encoded;
+    //Unsorted with duplicates and empty IDs
+    encodeEntityList(rocksdb::Slice("c\0a\0\0b\0a", 8), encoded);
+    BOOST_CHECK(isPostingList(encoded));
+    std::vector<std::string> expected = {"a", "b", "c"};
+    std::vector<std::string> result = decodePostingList(encoded);
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), result.begin(), result.end());
+    //Multiple blocks
+    PostingListWriter writer;
+    std::set<std::string> sortedIds;
+    for (size_t i = 0; i < 1000; i++) {
+        sortedIds.insert(createEntityId(i));
+    }
+    for (const std::string& id : sortedIds) {
+        writer.add(id);
+    }
+    writer.finish(encoded);
+    result = decodePostingList(encoded);
+    BOOST_CHECK_EQUAL_COLLECTIONS(sortedIds.begin(), sortedIds.end(), result.begin(), result.end());
+    //Seek skips to the correct block
+    PostingListReader reader;
+    BOOST_CHECK(reader.open(encoded));
+    BOOST_CHECK_EQUAL(1000, reader.size());
+    reader.seek("entity2");
+    BOOST_CHECK_EQUAL("entity2001", reader.current().ToString());
+    reader.seek("entity999");
+    BOOST_CHECK_EQUAL("entity999", reader.current().ToString());
+    reader.seek("f");
+    BOOST_CHECK(!reader.valid());
+    //Corrupt data
+    BOOST_CHECK(!reader.open(encoded.substr(0, 2)));
+    BOOST_CHECK(!reader.open("abc"));
+    //Decode to a plain list
+    std::string entityList;
+    encodeEntityList(rocksdb::Slice("c\0a\0b", 5), encoded);
+    BOOST_CHECK(decodeEntityList(encoded, entityList));
+    BOOST_CHECK_EQUAL(std::string("a\0b\0c", 5), entityList);
+    //Trailing data
+    BOOST_CHECK(!decodeEntityList(encoded + "x", entityList));
+    BOOST_CHECK(decodeEntityList(rocksdb::Slice("\0\x01\0\0", 4), entityList));
+    BOOST_CHECK(!decodeEntityList(rocksdb::Slice("\0\x01\0\0x", 5), entityList));
+    //Plain list starting with an empty entity ID and an entity ID starting with 0x01
+    BOOST_CHECK(isPostingList(rocksdb::Slice("\0\x01" "foo\0bar", 9)));
+    BOOST_CHECK(!decodeEntityList(rocksdb::Slice("\0\x01" "foo\0bar", 9), entityList));
+}
+
+BOOST_AUTO_TEST_CASE(TestIntersect) {
+    //Multiples of 2, 3 and 5 --> Multiples of 30
+    std::set<std::string> lists[3];
+    std::set<std::string> expected;
+    for (size_t i = 0; i < 3000; i++) {
+        std::string id = createEntityId(i);
+        if (i % 2 == 0) lists[0].insert(id);
+        if (i % 3 == 0) lists[1].insert(id);
+        if (i % 5 == 0) lists[2].insert(id);
+        if (i % 30 == 0) expected.insert(id);
+    }
+    std::string encoded[3];
+    PostingListReader readers[3];
+    std::vector<PostingListReader*> readerPointers;
+    for (size_t i = 0; i < 3; i++) {
+        PostingListWriter writer;
+        for (const std::string& id : lists[i]) {
+            writer.add(id);
+        }
+        writer.finish(encoded[i]);
+        BOOST_CHECK(readers[i].open(encoded[i]));
+        readerPointers.push_back(&readers[i]);
+    }
+    std::vector<std::string> result;
+    auto collect = [&result](const rocksdb::Slice& entry) -> bool {
+        result.push_back(entry.ToString());
+        return true;
+    };
+    BOOST_CHECK(intersectPostingLists(readerPointers, 1000000, collect));
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), result.begin(), result.end());
+    //Limit
+    result.clear();
+    for (size_t i = 0; i < 3; i++) {
+        BOOST_CHECK(readers[i].open(encoded[i]));
+    }
+    BOOST_CHECK(intersectPostingLists(readerPointers, 5, collect));
+    BOOST_CHECK_EQUAL(5, result.size());
+    BOOST_CHECK_EQUAL(*expected.begin(), result[0]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(Bitmap)
+
+BOOST_AUTO_TEST_CASE(TestApplyBitwiseOperation) {
+    std::mt19937 rng(42);
+    //Odd size: Vector, word and byte loop are used
+    std::string a(1000, '\0'), b(1000, '\0');
+    for (size_t i = 0; i < a.size(); i++) {
+        a[i] = (char) rng();
+        b[i] = (char) rng();
+    }
+    std::string andResult = a, orResult = a, xorResult = a;
+    applyBitwiseOperation(BitwiseOperation::And, &andResult[0], b.data(), b.size());
+    applyBitwiseOperation(BitwiseOperation::Or, &orResult[0], b.data(), b.size());
+    applyBitwiseOperation(BitwiseOperation::Xor, &xorResult[0], b.data(), b.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        BOOST_CHECK_EQUAL((char) (a[i] & b[i]), andResult[i]);
+        BOOST_CHECK_EQUAL((char) (a[i] | b[i]), orResult[i]);
+        BOOST_CHECK_EQUAL((char) (a[i] ^ b[i]), xorResult[i]);
+    }
+}
+
+/**
+ * Create a raw bitmap operand with the given bits set
+ */
+static std::string createRawBitmap(const std::set<uint32_t>& bits) {
+    std::string bitmap(1, '\0');
+    for (uint32_t bit : bits) {
+        if (bitmap.size() <= 1 + bit / 8) {
+            bitmap.resize(2 + bit / 8, '\0');
+        }
+        bitmap[1 + bit / 8] |= (char) (1 << (bit % 8));
+    }
+    return bitmap;
+}
+
+/**
+ * Create a compressed bitmap that stores every container as an array
+ */
+static std::string createCompressedBitmap(const std::set<uint32_t>& bits) {
+    std::map<uint16_t, std::vector<uint16_t> > containers;
+    for (uint32_t bit : bits) {
+        containers[bit >> 16].push_back((uint16_t) bit);
+    }
+    std::string bitmap(1, '\x01');
+    for (const auto& container : containers) {
+        uint16_t cardinalityMinusOne = (uint16_t) (container.second.size() - 1);
+        bitmap.append((const char*) &container.first, 2);
+        bitmap.append((const char*) &cardinalityMinusOne, 2);
+        bitmap.append((const char*) container.second.data(), container.second.size() * 2);
+    }
+    return bitmap;
+}
+
+/**
+ * Decode a compressed bitmap by converting it to a raw bitmap
+ */
+static std::set<uint32_t> decodeCompressedBitmap(const std::string& compressed) {
+    std::set<uint32_t> bits;
+    BOOST_REQUIRE(compressed.size() >= 1 && compressed[0] == '\x01');
+    size_t pos = 1;
+    while (pos < compressed.size()) {
+        uint16_t key, cardinalityMinusOne;
+        memcpy(&key, compressed.data() + pos, 2);
+        memcpy(&cardinalityMinusOne, compressed.data() + pos + 2, 2);
+        pos += 4;
+        size_t cardinality = (size_t) cardinalityMinusOne + 1;
+        if (cardinality <= compressedBitmapArrayMaximum) {
+            for (size_t i = 0; i < cardinality; i++, pos += 2) {
+                uint16_t bit;
+                memcpy(&bit, compressed.data() + pos, 2);
+                bits.insert(((uint32_t) key << 16) | bit);
+            }
+        } else {
+            for (size_t i = 0; i < 65536; i++) {
+                if (compressed[pos + i / 8] & (1 << (i % 8))) {
+                    bits.insert(((uint32_t) key << 16) | i);
+                }
+            }
+            pos += compressedBitmapContainerBytes;
+        }
+    }
+    return bits;
+}
+
+BOOST_AUTO_TEST_CASE(TestCompressedBitmap) {
+    //Sparse bits in the first container, dense bits in the second one
+    std::set<uint32_t> sparse = {1, 7, 100, 65535, 70000};
+    std::set<uint32_t> dense;
+    for (uint32_t i = 65536; i < 65536 + 10000; i += 2) {
+        dense.insert(i);
+    }
+    std::string compressed;
+    CompressedBitmapBuilder orBuilder(BitwiseOperation::Or);
+    BOOST_CHECK(orBuilder.add(createRawBitmap(sparse)));
+    BOOST_CHECK(orBuilder.add(createRawBitmap(dense)));
+    orBuilder.finish(compressed);
+    std::set<uint32_t> expected = sparse;
+    expected.insert(dense.begin(), dense.end());
+    std::set<uint32_t> result = decodeCompressedBitmap(compressed);
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), result.begin(), result.end());
+    //Compressed input, AND with a raw bitmap. Missing bits are 0
+    CompressedBitmapBuilder andBuilder(BitwiseOperation::And);
+    BOOST_CHECK(andBuilder.add(compressed));
+    BOOST_CHECK(andBuilder.add(createRawBitmap({7, 65536, 65537, 70000})));
+    andBuilder.finish(compressed);
+    expected = {7, 65536, 70000};
+    result = decodeCompressedBitmap(compressed);
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), result.begin(), result.end());
+    //XOR clears bits set twice. Empty containers are dropped
+    CompressedBitmapBuilder xorBuilder(BitwiseOperation::Xor);
+    BOOST_CHECK(xorBuilder.add(compressed));
+    BOOST_CHECK(xorBuilder.add(createRawBitmap({65536, 70000, 200000})));
+    xorBuilder.finish(compressed);
+    expected = {7, 200000};
+    result = decodeCompressedBitmap(compressed);
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), result.begin(), result.end());
+    //Corrupt input
+    BOOST_CHECK(!xorBuilder.add(std::string("\x01\x00", 2)));
+    BOOST_CHECK(!xorBuilder.add("\x02"));
+    //Array entries that are not strictly ascending
+    BOOST_CHECK(!xorBuilder.add(std::string("\x01\x00\x00\x01\x00\x05\x00\x05\x00", 9)));
+}
+
+BOOST_AUTO_TEST_CASE(TestCompressedBitmapSparse) {
+    //Two bits in every one of the 65536 containers
+    std::set<uint32_t> even, odd;
+    for (uint32_t key = 0; key < 65536; key++) {
+        even.insert((key << 16) | 0);
+        even.insert((key << 16) | 2);
+        odd.insert((key << 16) | 1);
+        odd.insert((key << 16) | 2);
+    }
+    std::string compressed;
+    CompressedBitmapBuilder orBuilder(BitwiseOperation::Or);
+    BOOST_CHECK(orBuilder.add(createCompressedBitmap(even)));
+    BOOST_CHECK(orBuilder.add(createCompressedBitmap(odd)));
+    orBuilder.finish(compressed);
+    //Every container stays an array of three entries
+    BOOST_CHECK_EQUAL(compressed.size(), 1 + 65536 * (4 + 3 * 2));
+    std::set<uint32_t> expected = even;
+    expected.insert(odd.begin(), odd.end());
+    std::set<uint32_t> result = decodeCompressedBitmap(compressed);
+    BOOST_CHECK(result == expected);
+    CompressedBitmapBuilder andBuilder(BitwiseOperation::And);
+    BOOST_CHECK(andBuilder.add(createCompressedBitmap(even)));
+    BOOST_CHECK(andBuilder.add(createCompressedBitmap(odd)));
+    andBuilder.finish(compressed);
+    BOOST_CHECK_EQUAL(compressed.size(), 1 + 65536 * (4 + 2));
+    expected.clear();
+    for (uint32_t key = 0; key < 65536; key++) {
+        expected.insert((key << 16) | 2);
+    }
+    result = decodeCompressedBitmap(compressed);
+    BOOST_CHECK(result == expected);
+    CompressedBitmapBuilder xorBuilder(BitwiseOperation::Xor);
+    BOOST_CHECK(xorBuilder.add(createCompressedBitmap(even)));
+    BOOST_CHECK(xorBuilder.add(createCompressedBitmap(odd)));
+    xorBuilder.finish(compressed);
+    BOOST_CHECK_EQUAL(compressed.size(), 1 + 65536 * (4 + 2 * 2));
+    expected.clear();
+    for (uint32_t key = 0; key < 65536; key++) {
+        expected.insert((key << 16) | 0);
+        expected.insert((key << 16) | 1);
+    }
+    result = decodeCompressedBitmap(compressed);
+    BOOST_CHECK(result == expected);
+    //Arrays are converted to a bitmap once they exceed the array maximum
+    std::set<uint32_t> low, high;
+    for (uint32_t i = 0; i < 3000; i++) {
+        low.insert(i);
+        high.insert(10000 + i);
+    }
+    BOOST_CHECK(orBuilder.add(createCompressedBitmap(low)));
+    BOOST_CHECK(orBuilder.add(createCompressedBitmap(high)));
+    orBuilder.finish(compressed);
+    BOOST_CHECK_EQUAL(compressed.size(), 1 + 4 + compressedBitmapContainerBytes);
+    expected = low;
+    expected.insert(high.begin(), high.end());
+    result = decodeCompressedBitmap(compressed);
+    BOOST_CHECK(result == expected);
+    //... and shrink back to an array if AND clears enough bits
+    BOOST_CHECK(andBuilder.add(compressed));
+    BOOST_CHECK(andBuilder.add(createCompressedBitmap(low)));
+    andBuilder.finish(compressed);
+    BOOST_CHECK_EQUAL(compressed.size(), 1 + 4 + 3000 * 2);
+    result = decodeCompressedBitmap(compressed);
+    BOOST_CHECK(result == low);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,7 @@ from YakDB.Conversion import ZMQBinaryUtil
 from YakDB.Exceptions import ParameterException, YakDBProtocolException
 from YakDB.DataProcessor import ClientSidePassiveJob
 from YakDB.ConnectionBase import YakDBConnectionBase
+from YakDB.Predicate import Predicate
 import zmq
 
 class Connection(YakDBConnectionBase):
@@ -72,6 +73,7 @@ class Connection(YakDBConnectionBase):
             return
         YakDBConnectionBase._checkDictionaryForNone(valueDict)
         #Send header frame
+        self._sendTopic()
         self.socket.send(YakDBConnectionBase._getWriteHeader(b"\x20", partsync, fullsync, requestId), zmq.SNDMORE)
         #Send the table number
         self._sendBinary32(tableNo)
@@ -93,11 +95,50 @@ class Connection(YakDBConnectionBase):
         if self.mode is zmq.REQ:
             msgParts = self.socket.recv_multipart(copy=True)
             YakDBConnectionBase._checkHeaderFrame(msgParts, b'\x20')
+    def bulkLoad(self, tableNo, records, presorted=False, partsync=False, fullsync=False, requestId=b""):
+        """
+        Write key-value pairs by building SST files on the server and ingesting them
+        into the table. This is much faster than put() for large initial loads,
+        but every request creates at least one file, so send large requests
+        (several megabytes) only.
+
+        This request can be used in REQ/REP, PUSH/PULL and PUB/SUB mode.
+
+        @param tableNo The numeric, unsigned table number to write to
+        @param records A dictionary or a list of (key, value) tuples.
+                        If a key occurs multiple times in a list, the last value wins
+                        (or the values are merged in order if the table uses a merge operator
+                        other than REPLACE).
+        @param presorted Set this to True if records is a list of pairs
+                        with strictly ascending binary keys. This avoids sorting on the server.
+        @param partsync If set to true, subsequent reads are guaranteed to return the written values
+        """
+        #Check parameters
+        YakDBConnectionBase._checkParameterType(tableNo, int, "tableNo")
+        if isinstance(records, dict):
+            records = list(records.items())
+        if len(records) == 0:
+            return
+        #Send header frame
+        self._sendTopic()
+        header = YakDBConnectionBase._getWriteHeader(b"\x25", partsync, fullsync, b"")
+        self.socket.send(header + (b"\x01" if presorted else b"\x00") + requestId, zmq.SNDMORE)
+        #Send the table number
+        self._sendBinary32(tableNo)
+        #Send key/value pairs, the last value without SNDMORE
+        for i, (key, value) in enumerate(records):
+            self.socket.send(ZMQBinaryUtil.convertToBinary(key), zmq.SNDMORE)
+            isLast = (i == len(records) - 1)
+            self.socket.send(ZMQBinaryUtil.convertToBinary(value), 0 if isLast else zmq.SNDMORE)
+        #If this is a req/rep connection, receive a reply
+        if self.mode is zmq.REQ:
+            msgParts = self.socket.recv_multipart(copy=True)
+            YakDBConnectionBase._checkHeaderFrame(msgParts, b'\x25')
     def delete(self, tableNo, keys, partsync=False, fullsync=False, requestId=b""):
         """
         Delete one or multiples values, identified by their keys, from a table.
 
-        This request may be used in REQ/REP and PUSH/PULL mode.
+        This request can be used in REQ/REP, PUSH/PULL and PUB/SUB mode.
 
         @param tableNo The table number to delete in
         @param keys A list, tuple or single value.
@@ -112,6 +153,7 @@ class Connection(YakDBConnectionBase):
         YakDBConnectionBase._checkParameterType(tableNo, int, "tableNo")
         convertedKeys = ZMQBinaryUtil.convertToBinary(keys)
         #Send header frame
+        self._sendTopic()
         self.socket.send(YakDBConnectionBase._getWriteHeader(b"\x21", partsync, fullsync, requestId), zmq.SNDMORE)
         #Send the table number frame
         self._sendBinary32(tableNo)
@@ -141,7 +183,9 @@ class Connection(YakDBConnectionBase):
         @param mapKeys If this is set to true, a mapping from the original keys to
                         values is performed, the return value is a dictionary key->value
                         rather than a value list. Mapping keys introduces additional overhead.
-        @return A list of values, correspondent to the key order (or a dict, depends on mapKeys parameter)
+        @return A list of values, correspondent to the key order (or a dict, depends on mapKeys parameter).
+                        Values of POSTINGS tables are compressed posting lists,
+                        use YakDBUtils.decodePostingList() to decode them.
         """
         #Check if this connection instance is setup correctly
         self._checkSingleConnection()
@@ -170,7 +214,7 @@ class Connection(YakDBConnectionBase):
         if mapKeys:
             values = YakDBConnectionBase._mapReadKeyValues(keys, values)
         return values
-    def scan(self, tableNo, startKey=None, endKey=None, limit=None, keyFilter=None, valueFilter=None, skip=0, invert=False, mapData=False, requestId=b""):
+    def scan(self, tableNo, startKey=None, endKey=None, limit=None, keyFilter=None, valueFilter=None, skip=0, invert=False, mapData=False, requestId=b"", predicate=None):
         """
         Synchronous scan. Scans an entire range at once.
         The scan stops at the table end, endKey (exclusive) or when
@@ -188,6 +232,8 @@ class Connection(YakDBConnectionBase):
         @param skip The number of records to skip at the beginning. Filter mismatches do not count.
         @param invert Set this to True to invert the scan direction
         @param mapData If this is set to False, a list of tuples is returned instead of a directory
+        @param predicate A YakDB.Predicate.Predicate instance (or its serialized program) the server
+            evaluates for each record. Only matching records are returned.
         @return A dictionary of the returned key/value pairs
         """
         #Check parameters and create binary-string only key list
@@ -210,7 +256,10 @@ class Connection(YakDBConnectionBase):
         #Send value filter parameters
         self.socket.send(b"" if valueFilter is None else valueFilter, zmq.SNDMORE)
         #Send skip number
-        self._sendBinary64(skip, more=False)
+        self._sendBinary64(skip, more=(predicate is not None))
+        #Send predicate program
+        if predicate is not None:
+            self.socket.send(predicate.serialize() if isinstance(predicate, Predicate) else predicate)
         #Wait for reply
         msgParts = self.socket.recv_multipart(copy=True)
         YakDBConnectionBase._checkHeaderFrame(msgParts, b'\x13') #Remap the returned key/value pairs to a dict
@@ -221,7 +270,7 @@ class Connection(YakDBConnectionBase):
         else:
             return YakDBConnectionBase._mapScanToTupleList(dataParts)
 
-    def list(self, tableNo, startKey=None, endKey=None, limit=None, keyFilter=None, valueFilter=None, skip=0, invert=False, mapData=False, requestId=b""):
+    def list(self, tableNo, startKey=None, endKey=None, limit=None, keyFilter=None, valueFilter=None, skip=0, invert=False, mapData=False, requestId=b"", predicate=None):
         """
         Synchronous list. Fully equivalent to scan, but only returns keys.
         See scan documentation for further reference.
@@ -246,13 +295,16 @@ class Connection(YakDBConnectionBase):
         #Send value filter parameters
         self.socket.send(b"" if valueFilter is None else valueFilter, zmq.SNDMORE)
         #Send skip number
-        self._sendBinary64(skip, more=False)
+        self._sendBinary64(skip, more=(predicate is not None))
+        #Send predicate program
+        if predicate is not None:
+            self.socket.send(predicate.serialize() if isinstance(predicate, Predicate) else predicate)
         #Wait for reply
         msgParts = self.socket.recv_multipart(copy=True)
         YakDBConnectionBase._checkHeaderFrame(msgParts, b'\x14') #Remap the returned key/value pairs to a dict
         dataParts = msgParts[1:]
         return dataParts
-    def deleteRange(self, tableNo, startKey, endKey, limit=None):
+    def deleteRange(self, tableNo, startKey, endKey, limit=None, compact=False):
         """
         Deletes a range of keys in the database
         The deletion stops at the table end, endKey (exclusive) or when
@@ -262,7 +314,9 @@ class Connection(YakDBConnectionBase):
         @param startKey The first key to scan, inclusive, or None or "" (both equivalent) to start at the beginning
         @param endKey The last key to scan, exclusive, or None or "" (both equivalent) to end at the end of table
         @param limit The maximum number of keys to delete, or None, if no limit shall be imposed
-        @return A dictionary of the returned key/value pairs
+        @param compact If this is set to True, the deleted range is compacted
+            after deleting it to reclaim the disk space immediately. Ignored if a limit is given.
+        @return The number of deleted keys
         """
         #Check parameters and create binary-string only key list
         YakDBConnectionBase._checkParameterType(tableNo, int, "tableNo")
@@ -270,7 +324,7 @@ class Connection(YakDBConnectionBase):
         self._checkSingleConnection()
         self._checkRequestReply()
         #Send header frame
-        self.socket.send(b"\x31\x01\x22", zmq.SNDMORE)
+        self.socket.send(b"\x31\x01\x22\x00" + (b"\x01" if compact else b"\x00"), zmq.SNDMORE)
         #Send the table number frame
         self._sendBinary32(tableNo, more=True)
         # Send maximum number of records to delete
@@ -280,34 +334,73 @@ class Connection(YakDBConnectionBase):
         #Wait for reply
         msgParts = self.socket.recv_multipart(copy=True)
         YakDBConnectionBase._checkHeaderFrame(msgParts, b'\x22')
-    def copyRange(self, srcTable, dstTable, startKey, endKey, limit=None, synchronousDelete=False):
+        return struct.unpack("<Q", msgParts[1])[0]
+    def copyRange(self, srcTable, dstTable, startKey, endKey, limit=None, synchronousDelete=False, ingestFiles=False, fullsync=False):
         """
         Server-side copy from one table subrange to another.
+        The copy is performed asynchronously by a job on the server.
+        Use jobStatistics() to check the progress.
 
-        @param tableNo The table number to read from
+        @param srcTable The table number to read from
         @param dstTable, The table number to write to
         @param startKey The first key to scan, inclusive, or None or "" (both equivalent) to start at the beginning
         @param endKey The last key to scan, exclusive, or None or "" (both equivalent) to end at the end of table
-        @param limit The maximum number of keys to delete, or None, if no limit shall be imposed
-        @param synchronousDelete Whether to delete the previous talbes
-        @return A dictionary of the returned key/value pairs
-        """
-        #Check parameters and create binary-string only key list
-        YakDBConnectionBase._checkParameterType(tableNo, int, "tableNo")
+        @param limit The maximum number of keys to copy, or None, if no limit shall be imposed
+        @param synchronousDelete Whether to delete the range in the target table before copying
+        @param ingestFiles Whether to write SST files that are ingested into the target table.
+            Faster for large copies, existing records are replaced.
+        @param fullsync Whether to write the records synchronously to disk
+        @return The APID of the copy job
+        """
+        YakDBConnectionBase._checkParameterType(srcTable, int, "srcTable")
+        YakDBConnectionBase._checkParameterType(dstTable, int, "dstTable")
         #Check if this connection instance is setup correctly
         self._checkSingleConnection()
         self._checkRequestReply()
         #Send header frame
-        self.socket.send(b"\x31\x01\x24\x00" + b"\x01" if synchronousDelete else b"\x00", zmq.SNDMORE)
-        #Send the table number frame
+        writeFlags = 0x02 if fullsync else 0x00
+        copyFlags = (0x01 if synchronousDelete else 0x00) | (0x02 if ingestFiles else 0x00)
+        self.socket.send(b"\x31\x01\x60" + struct.pack("<BB", writeFlags, copyFlags), zmq.SNDMORE)
+        #Send the table number frames
         self._sendBinary32(srcTable, more=True)
         self._sendBinary32(dstTable, more=True)
+        # Send maximum number of records to copy
+        self._sendBinary64(limit, more=True)
         #Send range. "" --> empty frame --> start/end of tabe
         self._sendRange(startKey,  endKey)
         #Wait for reply
         msgParts = self.socket.recv_multipart(copy=True)
-        YakDBConnectionBase._checkHeaderFrame(msgParts, b'\x24')
-    def count(self, tableNo, startKey, endKey):
+        YakDBConnectionBase._checkHeaderFrame(msgParts, b'\x60')
+        if len(msgParts) < 2:
+            raise YakDBProtocolException("Table range copy response does not contain APID frame")
+        return struct.unpack('<q', msgParts[1])[0]
+    def jobStatistics(self):
+        """
+        Get the statistics of all running jobs and recently finished jobs.
+        @return A dictionary APID --> statistics dictionary. Besides the statistics
+            reported by the server (e.g. "transferredDataBytes", "expectedDataBytes", "throughput"),
+            the statistics dictionary contains the "type" and "state" codes of the job.
+        """
+        self._checkSingleConnection()
+        self._checkRequestReply()
+        self.socket.send(b"\x31\x01\x48\x00")
+        msgParts = self.socket.recv_multipart(copy=True)
+        YakDBConnectionBase._checkHeaderFrame(msgParts, b'\x48')
+        jobs = {}
+        frames = msgParts[1:]
+        i = 0
+        while i < len(frames):
+            apid, jobType, jobState = struct.unpack("<QBB", frames[i])
+            statistics = {"type": jobType, "state": jobState}
+            i += 1
+            #Key/value pairs until the empty delimiter frame
+            while i < len(frames) and len(frames[i]) > 0:
+                statistics[frames[i].decode("utf-8")] = int(frames[i + 1])
+                i += 2
+            i += 1
+            jobs[apid] = statistics
+        return jobs
+    def count(self, tableNo, startKey, endKey, mode="exact"):
         """
         self._checkSingleConnection()
         Count a range of
@@ -318,7 +411,10 @@ class Connection(YakDBConnectionBase):
         @param tableNo The table number to scan in
         @param startKey The first key to scan, inclusive, or None or "" (both equivalent) to start at the beginning
         @param endKey The last key to scan, exclusive, or None or "" (both equivalent) to end at the end of table
-        @return The count, as integer
+        @param mode "exact" to iterate over the range, "approximate" to estimate the count
+            from the table metadata or "counters" to use the key counters of the table
+            (startKey is the prefix to count, endKey must be None)
+        @return The count, as integer. For approximate counts, a tuple (count, error bound)
         """
         #Check parameters and create binary-string only key list
         YakDBConnectionBase._checkParameterType(tableNo, int, "tableNo")
@@ -326,7 +422,10 @@ class Connection(YakDBConnectionBase):
         self._checkSingleConnection()
         self._checkRequestReply()
         #Send header frame
-        self.socket.send(b"\x31\x01\x11", zmq.SNDMORE)
+        countModes = {"exact": b"\x00", "approximate": b"\x01", "counters": b"\x02"}
+        if mode not in countModes:
+            raise ParameterException("Count mode must be one of %s" % list(countModes.keys()))
+        self.socket.send(b"\x31\x01\x11" + countModes[mode], zmq.SNDMORE)
         #Send the table number frame
         self._sendBinary32(tableNo)
         #Send range. "" --> empty frame --> start/end of table
@@ -337,6 +436,8 @@ class Connection(YakDBConnectionBase):
         #Deserialize
         binaryCount = msgParts[1]
         count = struct.unpack("<Q", binaryCount)[0]
+        if mode == "approximate":
+            return (count, struct.unpack("<Q", msgParts[2])[0])
         return count
     def exists(self, tableNo, keys):
         """
@@ -385,7 +486,37 @@ class Connection(YakDBConnectionBase):
         for msgPart in msgParts[1:]:
             processedValues.append(False if msgPart == b"\x00" else True)
         return processedValues
-    def openTable(self, tableNo, lruCacheSize=None, writeBufferSize=None, tableBlocksize=None, bloomFilterBitsPerKey=None, compression="SNAPPY", mergeOperator="REPLACE"):
+    def intersect(self, tableNo, keys, limit=None, ignoreMissing=False):
+        """
+        Compute the intersection of the entity lists stored in the given keys on the server,
+        e.g. for multi-token inverted index searches.
+        Works for POSTINGS tables and for NUL-separated lists (e.g. NULAPPENDSET tables).
+
+        @param tableNo The table number to read from
+        @param keys A list or tuple of keys (see read() for the mapping of non-binary keys)
+        @param limit The maximum number of entities to return, or None for no limit
+        @param ignoreMissing If this is True, keys that don't exist or have an empty value
+            are skipped. Else, they yield an empty intersection.
+        @return A list of the entities contained in all lists, in ascending binary order
+        """
+        YakDBConnectionBase._checkParameterType(tableNo, int, "tableNo")
+        convertedKeys = ZMQBinaryUtil.convertToBinaryList(keys)
+        #Check if this connection instance is setup correctly
+        self._checkSingleConnection()
+        self._checkRequestReply()
+        #Send header frame
+        self.socket.send(b"\x31\x01\x15" + (b"\x01" if ignoreMissing else b"\x00"), zmq.SNDMORE)
+        #Send the table number frame
+        self._sendBinary32(tableNo)
+        #Send the limit and the keys. The last frame is sent without SNDMORE
+        self._sendBinary64(limit, more=bool(convertedKeys))
+        for i, key in enumerate(convertedKeys):
+            self.socket.send(key, (zmq.SNDMORE if i < len(convertedKeys) - 1 else 0))
+        #Wait for reply
+        msgParts = self.socket.recv_multipart(copy=True)
+        YakDBConnectionBase._checkHeaderFrame(msgParts, b'\x15')
+        return msgParts[1:]
+    def openTable(self, tableNo, lruCacheSize=None, writeBufferSize=None, tableBlocksize=None, bloomFilterBitsPerKey=None, compression="SNAPPY", mergeOperator="REPLACE", keyCounterPrefixLength=None):
         """
         Open a table.
 
@@ -403,6 +534,8 @@ class Connection(YakDBConnectionBase):
         @param tableBlocksize The table block size in bytes, or None to assume default
         @param writeBufferSize The table write buffer size, or None to assume defaults
         @parameter bloomFilterBitsPerKey If this is set to none, no bloom filter is used, else a bloom filter with the given number of bits per key is used.
+        @param keyCounterPrefixLength If this is not None, the server maintains key counters for exact count(mode="counters") requests.
+            0 counts the entire table, n > 0 additionally counts per n-byte key prefix.
         """
         #Check parameters and create binary-string only key list
         YakDBConnectionBase._checkParameterType(tableNo, int, "tableNo")
@@ -429,6 +562,8 @@ class Connection(YakDBConnectionBase):
             self.__sendDecimalParam(b"WriteBufferSize", writeBufferSize)
         if bloomFilterBitsPerKey is not None:
             self.__sendDecimalParam(b"BloomFilterBitsPerKey", bloomFilterBitsPerKey)
+        if keyCounterPrefixLength is not None:
+            self.__sendDecimalParam(b"KeyCounterPrefixLength", keyCounterPrefixLength)
         self._sendBytesParam(b"MergeOperator", mergeOperator)
         self._sendBytesParam(b"CompressionMode", compression, flags=0)
         #Receive and etract response code
@@ -452,6 +587,44 @@ class Connection(YakDBConnectionBase):
         self._sendBinary32(tableNo, 0) #No SNDMORE flag
         msgParts = self.socket.recv_multipart(copy=True)
         YakDBConnectionBase._checkHeaderFrame(msgParts, b'\x04')
+    def moveTable(self, srcTableNo, dstTableNo):
+        """
+        Move (rename) a table into an unused table number.
+        The table files are renamed, so this is fast regardless of the table size.
+        The target table must not exist, truncate it before moving a table into its slot.
+        @param srcTableNo The table number to move
+        @param dstTableNo The new table number
+        """
+        YakDBConnectionBase._checkParameterType(srcTableNo, int, "srcTableNo")
+        YakDBConnectionBase._checkParameterType(dstTableNo, int, "dstTableNo")
+        #Check if this connection instance is setup correctly
+        self._checkSingleConnection()
+        self._checkRequestReply()
+        #Send header frame
+        self.socket.send(b"\x31\x01\x07", zmq.SNDMORE)
+        #Send the table number frames
+        self._sendBinary32(srcTableNo, more=True)
+        self._sendBinary32(dstTableNo, more=False)
+        msgParts = self.socket.recv_multipart(copy=True)
+        YakDBConnectionBase._checkHeaderFrame(msgParts, b'\x07')
+    def watchTest(self, tableNo, token):
+        """
+        Publish a watch test event with the given token to the subscribers of a table.
+        Send this until the token is received on the SUB socket
+        to make sure the subscription is live.
+        @param tableNo The table number the subscriber watches
+        @param token A unique token, e.g. uuid.uuid4().bytes
+        """
+        YakDBConnectionBase._checkParameterType(tableNo, int, "tableNo")
+        #Check if this connection instance is setup correctly
+        self._checkSingleConnection()
+        self._checkRequestReply()
+        #Send header frame
+        self.socket.send(b"\x31\x01\x08", zmq.SNDMORE)
+        self._sendBinary32(tableNo, more=True)
+        self.socket.send(ZMQBinaryUtil.convertToBinary(token))
+        msgParts = self.socket.recv_multipart(copy=True)
+        YakDBConnectionBase._checkHeaderFrame(msgParts, b'\x08')
     def closeTable(self, tableNo):
         """
         Close a table.
@@ -535,6 +708,38 @@ class Connection(YakDBConnectionBase):
         #Get the APID and create a new job instance
         apid = struct.unpack('<q', msgParts[1])[0]
         return ClientSidePassiveJob(self,  apid)
+    def initializePartitionedDataJob(self, tableNo, partitions, startKey=None, endKey=None, chunksize=None):
+        """
+        Initialize multiple jobs on the server that scan consecutive partitions
+        of a range from the same snapshot. The partitions can be scanned in parallel,
+        e.g. using one connection per partition.
+        @param tableNo The table number to scan in
+        @param partitions The requested number of partitions. The server might use less partitions.
+        @param startKey The first key to scan, inclusive, or None or "" (both equivalent) to start at the beginning
+        @param endKey The last key to scan, exclusive, or None or "" (both equivalent) to end at the end of table
+        @param chunksize How many key/value pairs will be returned for a single request. None --> Serverside default
+        @return A list of PassiveDataJob instances, one for each partition in key order
+        """
+        YakDBConnectionBase._checkParameterType(tableNo, int, "tableNo")
+        YakDBConnectionBase._checkParameterType(partitions, int, "partitions")
+        YakDBConnectionBase._checkParameterType(chunksize, int, "chunksize",  allowNone=True)
+        self._checkSingleConnection()
+        self._checkRequestReply()
+        #Send header frame
+        self.socket.send(b"\x31\x01\x42", zmq.SNDMORE)
+        self._sendBinary32(tableNo)
+        self._sendBinary32(chunksize)
+        self._sendBinary64(None)
+        self._sendRange(startKey,  endKey, more=True)
+        self._sendBinary32(partitions, more=False)
+        #Receive response
+        msgParts = self.socket.recv_multipart(copy=True)
+        YakDBConnectionBase._checkHeaderFrame(msgParts, b'\x42')
+        if len(msgParts) < 3:
+            raise YakDBProtocolException("CSPTMIR response does not contain APID and partitions frames")
+        apid = struct.unpack('<q', msgParts[1])[0]
+        numPartitions = struct.unpack('<I', msgParts[2])[0]
+        return [ClientSidePassiveJob(self, apid + i) for i in range(numPartitions)]
     def _requestJobDataChunk(self,  apid):
         """
         Requests a data chunk for a given asynchronous Job.
@@ -214,10 +214,19 @@ class YakDBConnectionBase(object):
         """Sets the current YakDB connection into Push/pull mode (default)"""
         self.socket = self.context.socket(zmq.PUSH)
         self.mode = zmq.PUSH
-    def usePubMode(self):
-        """Sets the current YakDB connection into publish/subscribe mode"""
+    def usePubMode(self, topic=b""):
+        """
+        Sets the current YakDB connection into publish/subscribe mode
+        @param topic The topic frame sent before each request, e.g. b"mirrors/12".
+                Servers only receive requests whose topic starts with one of their sub-topics.
+        """
         self.socket = self.context.socket(zmq.PUB)
         self.mode = zmq.PUB
+        self.topic = ZMQBinaryUtil.convertToBinary(topic)
+    def _sendTopic(self):
+        """In publish/subscribe mode, send the topic frame"""
+        if self.mode is zmq.PUB:
+            self.socket.send(self.topic, zmq.SNDMORE)
     def useDealerMode(self):
         """
         Sets the current YakDB connection into DEALER-based REQ/REP mode
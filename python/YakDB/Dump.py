@@ -80,16 +80,25 @@ def dumpYDF(conn, outputFilename, tableNo, startKey=None, endKey=None, limit=Non
         for key, value in job:
             __writeYDFKeyValue(outfile, key, value)
 
-def importYDFDump(conn, inputFilename, tableNo):
+def importYDFDump(conn, inputFilename, tableNo, bulkLoad=True, bulkLoadChunkSize=32*1024*1024):
     """
     Import a database dump in YDF format
+
+    Keyword arguments:
+        bulkLoad -- If True, the records are imported using bulk load requests,
+                    which build SST files on the server instead of writing
+                    the records one by one. Dumps are written in key order,
+                    so the server does not need to sort them.
+        bulkLoadChunkSize -- Number of key and value bytes per bulk load request.
     """
-    #Auto-batch writes
-    batch = AutoWriteBatch(conn, tableNo)
     #Transparent decompression
     openFunction = open
     if inputFilename.endswith(".gz"): openFunction = gzip.open
     if inputFilename.endswith(".xz"): openFunction = lzma.open
+    #Auto-batch writes
+    batch = None if bulkLoad else AutoWriteBatch(conn, tableNo)
+    chunk = []
+    chunkBytes = 0
     with openFunction(inputFilename, "rb") as infile:
         __verifyYDFFileHeader(infile)
         while True:
@@ -97,4 +106,14 @@ def importYDFDump(conn, inputFilename, tableNo):
             #None --> EOF
             if ret is None: break
             key, value = ret
-            batch.putSingle(key, value)
+            if batch is not None:
+                batch.putSingle(key, value)
+                continue
+            chunk.append(ret)
+            chunkBytes += len(key) + len(value)
+            if chunkBytes >= bulkLoadChunkSize:
+                conn.bulkLoad(tableNo, chunk, presorted=True, partsync=True)
+                chunk = []
+                chunkBytes = 0
+    if chunk:
+        conn.bulkLoad(tableNo, chunk, presorted=True, partsync=True)
@@ -47,15 +47,24 @@ class InvertedIndex(object):
         """Given a DB key, extracts the level"""
         return dbKey.rpartition(b"\x1E")[0]
     @staticmethod
-    def splitValues(dbValue):
+    def splitValueList(dbValue):
         """
-        Given a DB values, extracts the list of related entities
+        Given a DB value, extracts the list of related entities.
+        Compressed posting lists (POSTINGS tables) are decoded,
+        any other value is split at NUL characters.
         """
         #Empty input --> empty output
-        if not dbValue: return set()
+        if not dbValue: return []
         #Ensure we're dealing with byte strings
         if type(dbValue) == str: dbValue = dbValue.encode("utf-8")
-        return set(dbValue.split(b'\x00'))
+        entities = YakDBUtils.decodePostingList(dbValue)
+        return dbValue.split(b'\x00') if entities is None else entities
+    @staticmethod
+    def splitValues(dbValue):
+        """
+        Given a DB values, extracts the set of related entities
+        """
+        return set(InvertedIndex.splitValueList(dbValue))
     @staticmethod
     def _processReadResult(scanResult):
         """
@@ -149,27 +158,21 @@ class InvertedIndex(object):
         """
         Search multiple tokens in the inverted index (by exact match)
 
+        The intersection of the token hit sets is computed on the server,
+        so only the result is transferred (one request per level).
+
         Keyword arguments:
             strict: If this is set to False, token/level combinations
                 without results will be ignored. Else, they yield an empty result set
                 for that level.
         """
-        #Strategy Perform a large one-shot read to avoid any overhead
-        levelsTokens = list(itertools.product(levels, tokens))
-        #Perform read, with results being returned in known order
-        readKeys = [InvertedIndex.getKey(token, level) for (level, token) in levelsTokens]
-        readResult = self.conn.read(self.tableNo, readKeys)
-        #Iterate over results
         res = {}
-        for (value, (level, token)) in zip(readResult, levelsTokens):
-            hits = InvertedIndex.splitValues(value)
+        for level in levels:
+            readKeys = [InvertedIndex.getKey(token, level) for token in tokens]
+            hits = self.conn.intersect(self.tableNo, readKeys, ignoreMissing=not strict)
             #Skip empty hitsets except in strict mode
             if not (hits or strict): continue
-            #Initialize set if required
-            if level not in res:
-                res[level] = set(hits)
-            else: #Merge already existing hitset with current hitset
-                res[level] = res[level] & set(hits)
+            res[level] = set(hits)
         return res
     def searchMultiTokenPrefix(self, tokens, levels=[b""], limit=25, strict=False):
         """
@@ -246,7 +249,7 @@ class IndexIterator(KeyValueIterator):
     def __next__(self):
         k, v = KeyValueIterator.__next__(self)
         level, _, token = k.partition(b"\x1E")
-        entities = [InvertedIndex.splitEntityIdPart(d) for d in v.split(b"\x00")]
+        entities = [InvertedIndex.splitEntityIdPart(d) for d in InvertedIndex.splitValueList(v)]
         return (level, token, entities)
 
 if __name__ == "__main__":
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+# -*- coding: utf8 -*-
+"""
+Builder for server-side scan predicates.
+A predicate program is a sequence of instructions in reverse polish notation,
+see the scan request documentation in external-protocol.md.
+
+Usage example (keys starting with "user:" whose value does not contain "deleted"):
+    pred = Predicate().prefix(b"user:").contains(b"deleted", value=True).negate().andOp()
+    conn.scan(1, predicate=pred)
+"""
+import struct
+from YakDB.Conversion import ZMQBinaryUtil
+
+class Predicate:
+    PREFIX = 0x01
+    SUFFIX = 0x02
+    CONTAINS = 0x03
+    EQUALS_AT = 0x04
+    REGEX = 0x05
+    CONTAINS_ANY = 0x06
+    CONTAINS_ALL = 0x07
+    NOT = 0x10
+    AND = 0x11
+    OR = 0x12
+    TARGET_VALUE = 0x80
+    def __init__(self):
+        self.program = b""
+    @staticmethod
+    def _pack(pattern):
+        pattern = ZMQBinaryUtil.convertToBinary(pattern)
+        return struct.pack("<I", len(pattern)) + pattern
+    def _opcode(self, opcode, value):
+        self.program += struct.pack("B", opcode | (Predicate.TARGET_VALUE if value else 0))
+        return self
+    def prefix(self, pattern, value=False):
+        """Push: The key (or value) starts with pattern"""
+        self._opcode(Predicate.PREFIX, value)
+        self.program += Predicate._pack(pattern)
+        return self
+    def suffix(self, pattern, value=False):
+        """Push: The key (or value) ends with pattern"""
+        self._opcode(Predicate.SUFFIX, value)
+        self.program += Predicate._pack(pattern)
+        return self
+    def contains(self, pattern, value=False):
+        """Push: The key (or value) contains pattern"""
+        self._opcode(Predicate.CONTAINS, value)
+        self.program += Predicate._pack(pattern)
+        return self
+    def equalsAt(self, offset, pattern, value=False):
+        """Push: The key (or value) contains pattern at the given byte offset"""
+        self._opcode(Predicate.EQUALS_AT, value)
+        self.program += struct.pack("<Q", offset) + Predicate._pack(pattern)
+        return self
+    def regex(self, pattern, value=False):
+        """Push: The key (or value) matches the RE2 regex (search semantics, matching bytes)"""
+        self._opcode(Predicate.REGEX, value)
+        self.program += Predicate._pack(pattern)
+        return self
+    def containsAny(self, patterns, value=False):
+        """Push: The key (or value) contains at least one of the patterns"""
+        self._opcode(Predicate.CONTAINS_ANY, value)
+        self.program += struct.pack("<I", len(patterns))
+        self.program += b"".join(Predicate._pack(pattern) for pattern in patterns)
+        return self
+    def containsAll(self, patterns, value=False):
+        """Push: The key (or value) contains each of the patterns"""
+        self._opcode(Predicate.CONTAINS_ALL, value)
+        self.program += struct.pack("<I", len(patterns))
+        self.program += b"".join(Predicate._pack(pattern) for pattern in patterns)
+        return self
+    def negate(self):
+        """Pop one operand, push its negation"""
+        return self._opcode(Predicate.NOT, False)
+    def andOp(self):
+        """Pop two operands, push their conjunction"""
+        return self._opcode(Predicate.AND, False)
+    def orOp(self):
+        """Pop two operands, push their disjunction"""
+        return self._opcode(Predicate.OR, False)
+    def serialize(self):
+        return self.program
@@ -1,5 +1,6 @@
 #!/usr/bin/env python3
 # -*- coding: utf8 -*-
+import struct
 
 class YakDBUtils:
     """
@@ -41,6 +42,109 @@ class YakDBUtils:
             return bytes(keyList)
         #The key consists of 0xFF characters only: Extend length
         return key + b"\x00"
+    @staticmethod
+    def rawBitmapOperand(bits):
+        """
+        Create a merge operand for the ROARINGAND/ROARINGOR/ROARINGXOR
+        merge operators that has the given bit indices set.
+
+        >>> YakDBUtils.rawBitmapOperand([0, 9])
+        b'\\x00\\x01\\x02'
+        """
+        bitmap = bytearray((max(bits) // 8 + 1) if bits else 0)
+        for bit in bits:
+            bitmap[bit // 8] |= 1 << (bit % 8)
+        return b"\x00" + bytes(bitmap)
+    @staticmethod
+    def decodeBitmap(value):
+        """
+        Decode a compressed bitmap value of a ROARINGAND/ROARINGOR/ROARINGXOR table
+        into the sorted list of set bit indices.
+        Assumes the server is little-endian.
+
+        >>> YakDBUtils.decodeBitmap(b"\\x01\\x01\\x00\\x01\\x00\\x05\\x00\\x07\\x00")
+        [65541, 65543]
+        """
+        bits = []
+        if not value: return bits
+        if value[0] == 0: #Raw bitmap
+            return [i for i in range((len(value) - 1) * 8)
+                    if value[1 + i // 8] & (1 << (i % 8))]
+        pos = 1
+        while pos < len(value):
+            key, cardinalityMinusOne = struct.unpack("<HH", value[pos:pos + 4])
+            pos += 4
+            cardinality = cardinalityMinusOne + 1
+            if cardinality <= 4096: #Array container
+                bits += [(key << 16) | bit for bit in
+                         struct.unpack("<%dH" % cardinality, value[pos:pos + 2 * cardinality])]
+                pos += 2 * cardinality
+            else: #Bitmap container
+                bits += [(key << 16) | i for i in range(65536)
+                         if value[pos + i // 8] & (1 << (i % 8))]
+                pos += 8192
+        return bits
+
+    @staticmethod
+    def decodePostingList(value):
+        """
+        Decode a compressed posting list value of a POSTINGS table
+        into the sorted list of entity IDs (see doc/inverted-index.md).
+        Returns None if the value is not a valid posting list,
+        e.g. because it is a plain NUL-separated entity list.
+
+        >>> YakDBUtils.decodePostingList(b"\\x00\\x01\\x02\\x01\\x00\\x05apple\\x02\\x05ricot")
+        [b'apple', b'apricot']
+        >>> YakDBUtils.decodePostingList(b"\\x00\\x01\\x00\\x00")
+        []
+        >>> YakDBUtils.decodePostingList(b"\\x00\\x01foo\\x00bar") is None
+        True
+        """
+        if len(value) < 2 or value[0] != 0 or value[1] != 1: return None
+        pos = 2
+        def readVarint():
+            nonlocal pos
+            result = 0
+            for shift in range(0, 64, 7):
+                if pos >= len(value): break
+                byte = value[pos]
+                pos += 1
+                result |= (byte & 0x7F) << shift
+                if not byte & 0x80: return result
+            raise ValueError("Invalid varint")
+        try:
+            count = readVarint()
+            blockCount = readVarint()
+            if blockCount != (count + 63) // 64 or blockCount > len(value):
+                return None
+            #Skip index: (block offset, first entry)
+            blocks = []
+            for _ in range(blockCount):
+                offset = readVarint()
+                size = readVarint()
+                if size > len(value) - pos: return None
+                blocks.append((offset, value[pos:pos + size]))
+                pos += size
+            dataStart = pos
+            entries = []
+            #The blocks are stored back to back without any data after the last block
+            for i, (offset, firstEntry) in enumerate(blocks):
+                if offset > len(value) - dataStart or (i > 0 and pos - dataStart != offset):
+                    return None
+                pos = dataStart + offset
+                entry = firstEntry
+                entries.append(entry)
+                for _ in range(min(64, count - i * 64) - 1):
+                    shared = readVarint()
+                    suffixSize = readVarint()
+                    if shared > len(entry) or suffixSize > len(value) - pos:
+                        return None
+                    entry = entry[:shared] + value[pos:pos + suffixSize]
+                    pos += suffixSize
+                    entries.append(entry)
+            return entries if pos == len(value) else None
+        except ValueError:
+            return None
 
 def makeUnique(it):
     """Return the given iterable without duplicates, maintaining its order"""
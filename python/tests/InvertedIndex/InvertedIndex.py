@@ -1,5 +1,6 @@
 #!/usr/bin/env python3
 from YakDB.InvertedIndex.InvertedIndex import *
+from YakDB.Utils import YakDBUtils
 import unittest
 
 class TestInvertedIndex(unittest.TestCase):
@@ -39,6 +40,42 @@ class TestInvertedIndex(unittest.TestCase):
         res = InvertedIndex.splitValues(b"a\x00b\x00cd\x00a\x00\x00ef\x00")
         self.assertEqual(res, {b"a", b"b", b"cd", b"ef", b""})
 
+    @staticmethod
+    def encodePostingList(entities):
+        "Encode a sorted list of entities like the POSTINGS merge operator"
+        def varint(value):
+            result = b""
+            while value >= 0x80:
+                result += bytes([(value & 0x7F) | 0x80])
+                value >>= 7
+            return result + bytes([value])
+        index, data = b"", b""
+        for i, entity in enumerate(entities):
+            if i % 64 == 0:
+                index += varint(len(data)) + varint(len(entity)) + entity
+            else:
+                previous = entities[i - 1]
+                shared = 0
+                while shared < min(len(previous), len(entity)) and previous[shared] == entity[shared]:
+                    shared += 1
+                data += varint(shared) + varint(len(entity) - shared) + entity[shared:]
+        return b"\x00\x01" + varint(len(entities)) + varint((len(entities) + 63) // 64) + index + data
+
+    def testSplitValuesPostingList(self):
+        #Test 1: Multiple blocks
+        entities = sorted(b"entity%d" % (i * 7) for i in range(1000))
+        encoded = TestInvertedIndex.encodePostingList(entities)
+        self.assertEqual(YakDBUtils.decodePostingList(encoded), entities)
+        self.assertEqual(InvertedIndex.splitValues(encoded), set(entities))
+        self.assertDictEqual(InvertedIndex._processReadResult([(b"L1", encoded)]), {b"L1": set(entities)})
+        #Test 2: Empty posting list
+        self.assertEqual(InvertedIndex.splitValues(b"\x00\x01\x00\x00"), set())
+        #Test 3: Invalid posting lists are plain lists
+        self.assertIsNone(YakDBUtils.decodePostingList(encoded + b"x"))
+        self.assertIsNone(YakDBUtils.decodePostingList(encoded[:-1]))
+        res = InvertedIndex.splitValues(b"\x00\x01foo\x00bar")
+        self.assertEqual(res, {b"", b"\x01foo", b"bar"})
+
     def testExtractLevel(self):
         #Test 1
         res = InvertedIndex.extractLevel(b"thelevel\x1Ethetoken")